@@ -0,0 +1,395 @@
+// Copyright (c) 2021 Arno Galvez
+
+#include "bench/AllocatorBench.h"
+
+#include "platform/Sys.h"
+#include "renderer/VkAllocator.h"
+#include "renderer/VkBackend.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace vkRuna
+{
+using namespace render;
+
+static const VkDeviceSize CHURN_BLOCK_SIZE		= VkDeviceSize( 256 ) << 20;
+static const uint32_t	  CHURN_SAMPLE_INTERVAL = 1024; // Ops between two fragmentation samples
+static const uint32_t	  STRESS_LARGE_RATIO	= 16;	// One allocation in 16 bypasses the thread caches
+static const uint32_t	  STRESS_FRAME_OPS		= 1024; // Allocations per thread and frame
+static const uint32_t	  STRESS_IDLE_FRAMES	= 256;	// Frames without allocations, several cache trim periods
+
+// 1 - largest free range / free bytes, 0 when the free memory is contiguous
+static double GetFragmentation( const VulkanBlock &block )
+{
+	const VkDeviceSize freeBytes = block.GetSize() - block.GetAllocatedSize();
+	if ( freeBytes == 0 )
+	{
+		return 0.0;
+	}
+
+	return 1.0 - double( block.GetLargestFreeRange() ) / double( freeBytes );
+}
+
+bool RunAllocatorChurn( const allocBenchOpts_t &opts, FILE *out )
+{
+	const vulkanContext_t &vkContext = GetVulkanContext();
+
+	const int memoryTypeIndex =
+		FindMemoryType( &vkContext.gpu.memProps, UINT32_MAX, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT );
+	if ( memoryTypeIndex < 0 )
+	{
+		sys::Error( "No device local memory type" );
+		return false;
+	}
+
+	const VkDeviceSize granularity = vkContext.gpu.properties.limits.bufferImageGranularity;
+
+	VulkanBlock block( static_cast< uint32_t >( memoryTypeIndex ), CHURN_BLOCK_SIZE, VULKAN_MEMORY_USAGE_GPU_ONLY );
+	block.Init();
+
+	// Log uniform sizes from 256 B to 256 KiB, filling half of the block on average. A few optimal images so that the
+	// granularity rules apply.
+	static const VkDeviceSize				 ALIGNMENTS[] = { 16, 256, 4096 };
+	std::mt19937							 rng( opts.seed );
+	std::uniform_real_distribution< double > sizeLog2( 8.0, 18.0 );
+
+	std::vector< vulkanAllocation_t > live;
+	live.reserve( opts.liveCount * 2 );
+
+	const double nsPerTick = 1e9 / double( sys::ClockTicksFrequency() );
+
+	uint64_t allocCount	 = 0;
+	uint64_t freeCount	 = 0;
+	uint64_t failedCount = 0;
+	int64_t	 allocTicks	 = 0;
+	int64_t	 freeTicks	 = 0;
+
+	auto alloc = [ & ]() {
+		const VkDeviceSize			 size	   = VkDeviceSize( std::exp2( sizeLog2( rng ) ) );
+		const VkDeviceSize			 alignment = ALIGNMENTS[ rng() % 3 ];
+		const vulkanAllocationType_t type =
+			rng() % 8 == 0 ? VULKAN_ALLOCATION_TYPE_IMAGE_OPTIMAL : VULKAN_ALLOCATION_TYPE_BUFFER;
+
+		vulkanAllocation_t allocation;
+
+		const int64_t ticks = sys::GetClockTicks();
+		const bool	  ok	= block.Alloc( size, alignment, granularity, type, allocation );
+		allocTicks += sys::GetClockTicks() - ticks;
+
+		++allocCount;
+		if ( ok )
+		{
+			live.emplace_back( allocation );
+		}
+		else
+		{
+			++failedCount;
+		}
+
+		return ok;
+	};
+
+	auto release = [ & ]() {
+		const size_t	   index	  = rng() % live.size();
+		vulkanAllocation_t allocation = live[ index ];
+		live[ index ]				  = live.back();
+		live.pop_back();
+
+		const int64_t ticks = sys::GetClockTicks();
+		block.Free( allocation );
+		freeTicks += sys::GetClockTicks() - ticks;
+
+		++freeCount;
+	};
+
+	// Fill up to the live count, then alloc and free at random around it
+	while ( live.size() < opts.liveCount )
+	{
+		if ( !alloc() )
+		{
+			break;
+		}
+	}
+
+	double	 fragmentationSum = 0.0;
+	double	 fragmentationMax = 0.0;
+	uint32_t sampleCount	  = 0;
+
+	for ( uint32_t i = 0; i < opts.ops; ++i )
+	{
+		const bool below = live.size() < opts.liveCount;
+		if ( live.empty() || ( rng() % 4 == 0 ) != below )
+		{
+			if ( !alloc() && !live.empty() )
+			{
+				release(); // Block full
+			}
+		}
+		else
+		{
+			release();
+		}
+
+		if ( i % CHURN_SAMPLE_INTERVAL == 0 )
+		{
+			const double fragmentation = GetFragmentation( block );
+			fragmentationSum += fragmentation;
+			fragmentationMax = std::max( fragmentationMax, fragmentation );
+			++sampleCount;
+		}
+	}
+
+	const size_t	   liveCount		= live.size();
+	const VkDeviceSize usedBytes		= block.GetAllocatedSize();
+	const VkDeviceSize largestFreeRange = block.GetLargestFreeRange();
+	const double	   fragmentation	= GetFragmentation( block );
+
+	// Every free chunk merges back into a single one
+	while ( !live.empty() )
+	{
+		release();
+	}
+	const bool merged = block.GetAllocatedSize() == 0 && block.GetLargestFreeRange() == block.GetSize();
+
+	std::fprintf( out, "{\n" );
+	std::fprintf( out, "  \"benchmark\": \"churn\",\n" );
+	std::fprintf( out, "  \"device\": \"%s\",\n", vkContext.gpu.properties.deviceName );
+	std::fprintf( out, "  \"ops\": %u,\n", opts.ops );
+	std::fprintf( out, "  \"allocs\": %llu,\n", static_cast< unsigned long long >( allocCount ) );
+	std::fprintf( out, "  \"frees\": %llu,\n", static_cast< unsigned long long >( freeCount ) );
+	std::fprintf( out, "  \"failedAllocs\": %llu,\n", static_cast< unsigned long long >( failedCount ) );
+	std::fprintf( out, "  \"allocNs\": %f,\n", allocCount > 0 ? double( allocTicks ) * nsPerTick / allocCount : 0.0 );
+	std::fprintf( out, "  \"freeNs\": %f,\n", freeCount > 0 ? double( freeTicks ) * nsPerTick / freeCount : 0.0 );
+	std::fprintf( out, "  \"liveAllocations\": %zu,\n", liveCount );
+	std::fprintf( out, "  \"blockBytes\": %llu,\n", static_cast< unsigned long long >( block.GetSize() ) );
+	std::fprintf( out, "  \"usedBytes\": %llu,\n", static_cast< unsigned long long >( usedBytes ) );
+	std::fprintf( out, "  \"largestFreeRange\": %llu,\n", static_cast< unsigned long long >( largestFreeRange ) );
+	std::fprintf( out, "  \"fragmentation\": %f,\n", fragmentation );
+	std::fprintf( out, "  \"meanFragmentation\": %f,\n", sampleCount > 0 ? fragmentationSum / sampleCount : 0.0 );
+	std::fprintf( out, "  \"maxFragmentation\": %f,\n", fragmentationMax );
+	std::fprintf( out, "  \"mergedOnceFreed\": %s\n", merged ? "true" : "false" );
+	std::fprintf( out, "}\n" );
+
+	return merged;
+}
+
+struct stressThread_t
+{
+	std::thread	 thread;
+	uint64_t	 allocCount		= 0;
+	uint64_t	 freeCount		= 0;
+	int64_t		 allocTicks		= 0;
+	int64_t		 freeTicks		= 0;
+	VkDeviceSize requestedBytes = 0;
+	VkDeviceSize servedBytes	= 0; // Size classes of the thread caches included
+};
+
+static VkDeviceSize GetReservedBytes()
+{
+	std::vector< memoryTypeStats_t > stats;
+	g_vulkanAllocator.GetStats( stats );
+
+	VkDeviceSize reserved = 0;
+	for ( const memoryTypeStats_t &typeStats : stats )
+	{
+		reserved += typeStats.reservedBytes;
+	}
+
+	return reserved;
+}
+
+static uint32_t GetStressFrameCount( const allocBenchOpts_t &opts )
+{
+	const uint32_t opCount = opts.ops / std::max( opts.threadCount, 1u );
+	return std::max( ( opCount + STRESS_FRAME_OPS - 1 ) / STRESS_FRAME_OPS, 1u );
+}
+
+static void RunStressThread( const allocBenchOpts_t &opts,
+							 uint32_t				 threadIndex,
+							 std::atomic< uint32_t > &doneCount,
+							 std::atomic< uint32_t > &steppedCount,
+							 std::atomic< bool > &	 exit,
+							 stressThread_t &		 result )
+{
+	// Log uniform sizes from 64 B to 64 KiB, UBOs and small storage buffers. Large ones up to 1 MiB.
+	std::mt19937							 rng( opts.seed + threadIndex );
+	std::uniform_real_distribution< double > smallLog2( 6.0, 16.0 );
+	std::uniform_real_distribution< double > largeLog2( 17.0, 20.0 );
+
+	std::vector< vulkanAllocation_t > live( std::max( opts.liveCount, 1u ) );
+
+	const uint32_t opCount = opts.ops / std::max( opts.threadCount, 1u );
+	for ( uint32_t i = 0; i < opCount; ++i )
+	{
+		// One frame of work, then wait for the main thread to step to the next
+		if ( i > 0 && i % STRESS_FRAME_OPS == 0 )
+		{
+			++doneCount;
+			while ( steppedCount < i / STRESS_FRAME_OPS )
+			{
+				std::this_thread::yield();
+			}
+		}
+
+		vulkanAllocation_t &allocation = live[ i % live.size() ];
+		if ( allocation.block != nullptr )
+		{
+			const int64_t ticks = sys::GetClockTicks();
+			g_vulkanAllocator.Free( allocation );
+			result.freeTicks += sys::GetClockTicks() - ticks;
+			++result.freeCount;
+		}
+
+		const bool large = rng() % STRESS_LARGE_RATIO == 0;
+
+		VkMemoryRequirements requirements {};
+		requirements.size			= VkDeviceSize( std::exp2( large ? largeLog2( rng ) : smallLog2( rng ) ) );
+		requirements.alignment		= rng() % 2 == 0 ? 256 : 16;
+		requirements.memoryTypeBits = UINT32_MAX;
+
+		const vulkanMemoryUsage_t usage = large ? VULKAN_MEMORY_USAGE_GPU_ONLY : VULKAN_MEMORY_USAGE_CPU_TO_GPU;
+
+		const int64_t ticks = sys::GetClockTicks();
+		allocation			= g_vulkanAllocator.Alloc( VULKAN_ALLOCATION_TYPE_BUFFER, usage, requirements );
+		result.allocTicks += sys::GetClockTicks() - ticks;
+		++result.allocCount;
+
+		result.requestedBytes += requirements.size;
+		result.servedBytes += allocation.size;
+	}
+
+	for ( vulkanAllocation_t &allocation : live )
+	{
+		g_vulkanAllocator.Free( allocation );
+	}
+
+	// The caches of the thread live until the main thread measured them
+	++doneCount;
+	while ( !exit )
+	{
+		std::this_thread::yield();
+	}
+}
+
+bool RunAllocatorStress( const allocBenchOpts_t &opts, FILE *out )
+{
+	const vulkanContext_t &vkContext = GetVulkanContext();
+
+	// Frames are stepped here from now on, nothing may still use the memory the backend freed
+	vkDeviceWaitIdle( vkContext.device );
+	g_vulkanAllocator.EmptyGarbage( UINT64_MAX );
+
+	const VkDeviceSize reservedBefore = GetReservedBytes();
+	const double	   nsPerTick	  = 1e9 / double( sys::ClockTicksFrequency() );
+
+	std::atomic< uint32_t >		  doneCount { 0 };
+	std::atomic< uint32_t >		  steppedCount { 0 };
+	std::atomic< bool >			  exit { false };
+	std::vector< stressThread_t > threads( std::max( opts.threadCount, 1u ) );
+
+	const int64_t startTicks = sys::GetClockTicks();
+
+	for ( uint32_t i = 0; i < threads.size(); ++i )
+	{
+		threads[ i ].thread = std::thread( RunStressThread,
+										   std::cref( opts ),
+										   i,
+										   std::ref( doneCount ),
+										   std::ref( steppedCount ),
+										   std::ref( exit ),
+										   std::ref( threads[ i ] ) );
+	}
+
+	// Frames end once every thread did its share. Frees are released SWAPCHAIN_BUFFERING_LEVEL frames later, into
+	// the caches of their threads.
+	const uint32_t frameCount  = GetStressFrameCount( opts );
+	const uint32_t threadCount = static_cast< uint32_t >( threads.size() );
+	uint64_t	   frameId	   = 1;
+	for ( uint32_t frame = 1; frame <= frameCount; ++frame )
+	{
+		while ( doneCount < frame * threadCount )
+		{
+			std::this_thread::yield();
+		}
+
+		++frameId;
+		g_vulkanAllocator.BeginFrame( frameId );
+		g_vulkanAllocator.EmptyGarbage( frameId - SWAPCHAIN_BUFFERING_LEVEL );
+
+		steppedCount = frame;
+	}
+
+	const double wallMs = double( sys::GetClockTicks() - startTicks ) * nsPerTick * 1e-6;
+
+	++frameId;
+	g_vulkanAllocator.BeginFrame( frameId );
+	g_vulkanAllocator.EmptyGarbage( frameId );
+	const VkDeviceSize reservedCached = GetReservedBytes();
+
+	// Idle caches give their ranges back without an explicit trim
+	for ( uint32_t frame = 0; frame < STRESS_IDLE_FRAMES; ++frame )
+	{
+		++frameId;
+		g_vulkanAllocator.BeginFrame( frameId );
+		g_vulkanAllocator.EmptyGarbage( frameId );
+	}
+	const VkDeviceSize reservedIdle = GetReservedBytes();
+
+	g_vulkanAllocator.Trim();
+	const VkDeviceSize reservedTrimmed = GetReservedBytes();
+
+	exit = true;
+	for ( stressThread_t &thread : threads )
+	{
+		thread.thread.join();
+	}
+
+	stressThread_t total;
+	for ( const stressThread_t &thread : threads )
+	{
+		total.allocCount += thread.allocCount;
+		total.freeCount += thread.freeCount;
+		total.allocTicks += thread.allocTicks;
+		total.freeTicks += thread.freeTicks;
+		total.requestedBytes += thread.requestedBytes;
+		total.servedBytes += thread.servedBytes;
+	}
+
+	const uint64_t opCount = total.allocCount + total.freeCount;
+
+	std::fprintf( out, "{\n" );
+	std::fprintf( out, "  \"benchmark\": \"stress\",\n" );
+	std::fprintf( out, "  \"device\": \"%s\",\n", vkContext.gpu.properties.deviceName );
+	std::fprintf( out, "  \"threads\": %zu,\n", threads.size() );
+	// Fewer than threads inflates the timings
+	std::fprintf( out, "  \"hardwareThreads\": %u,\n", std::thread::hardware_concurrency() );
+	std::fprintf( out, "  \"allocs\": %llu,\n", static_cast< unsigned long long >( total.allocCount ) );
+	std::fprintf( out, "  \"frees\": %llu,\n", static_cast< unsigned long long >( total.freeCount ) );
+	std::fprintf( out, "  \"frames\": %u,\n", frameCount );
+	std::fprintf( out, "  \"wallMs\": %f,\n", wallMs );
+	std::fprintf( out, "  \"opsPerSecond\": %f,\n", wallMs > 0.0 ? 1e3 * double( opCount ) / wallMs : 0.0 );
+	std::fprintf( out,
+				  "  \"allocNs\": %f,\n",
+				  total.allocCount > 0 ? double( total.allocTicks ) * nsPerTick / total.allocCount : 0.0 );
+	std::fprintf( out,
+				  "  \"freeNs\": %f,\n",
+				  total.freeCount > 0 ? double( total.freeTicks ) * nsPerTick / total.freeCount : 0.0 );
+	std::fprintf( out,
+				  "  \"sizeOverhead\": %f,\n",
+				  total.requestedBytes > 0 ? double( total.servedBytes ) / double( total.requestedBytes ) - 1.0 : 0.0 );
+	std::fprintf( out, "  \"reservedBytesBefore\": %llu,\n", static_cast< unsigned long long >( reservedBefore ) );
+	std::fprintf( out, "  \"reservedBytesCached\": %llu,\n", static_cast< unsigned long long >( reservedCached ) );
+	std::fprintf( out, "  \"reservedBytesIdle\": %llu,\n", static_cast< unsigned long long >( reservedIdle ) );
+	std::fprintf( out, "  \"reservedBytesTrimmed\": %llu\n", static_cast< unsigned long long >( reservedTrimmed ) );
+	std::fprintf( out, "}\n" );
+
+	// Every block the threads used was released
+	return reservedIdle == reservedBefore && reservedTrimmed == reservedBefore;
+}
+
+} // namespace vkRuna
@@ -0,0 +1,27 @@
+// Copyright (c) 2021 Arno Galvez
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+
+namespace vkRuna
+{
+struct allocBenchOpts_t
+{
+	uint32_t ops		 = 1000000;
+	uint32_t liveCount	 = 4096; // Allocations alive while churning, per thread for the stress benchmark
+	uint32_t seed		 = 1;
+	uint32_t threadCount = 4;
+};
+
+// Random alloc and free patterns against the TLSF free lists of a single VulkanBlock, reports the time per operation
+// and the fragmentation. The backend must be initialized, with the mock device the block is host memory.
+bool RunAllocatorChurn( const allocBenchOpts_t &opts, FILE *out );
+
+// Threads allocating and freeing small buffers through g_vulkanAllocator while the main thread steps frames and
+// releases the deferred frees. Reports the time per operation and the memory that thread caches keep once the
+// threads stopped, after idle frames and after trimming them.
+bool RunAllocatorStress( const allocBenchOpts_t &opts, FILE *out );
+
+} // namespace vkRuna
@@ -0,0 +1,545 @@
+// Copyright (c) 2021 Arno Galvez
+
+#include "bench/AllocatorBench.h"
+#include "game/Game.h"
+#include "platform/Sys.h"
+#include "renderer/GPUProfiler.h"
+#include "renderer/RenderGraph.h"
+#include "renderer/RenderProgs.h"
+#include "renderer/ShaderCache.h"
+#include "renderer/RenderSystem.h"
+#include "renderer/ShaderLexer.h"
+#include "renderer/VFX.h"
+#include "renderer/VkBackend.h"
+#include "rnLib/Camera.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+using namespace vkRuna;
+using namespace vkRuna::sys;
+
+namespace vkRuna
+{
+struct benchOpts_t
+{
+	uint32_t				   frames		= 1000;
+	uint32_t				   warmupFrames = 100; // Shaders compile and buffers settle, not measured
+	double					   deltaFrame	= 1.0 / 60.0;
+	uint32_t				   width		= 1280;
+	uint32_t				   height		= 720;
+	std::string				   outputPath; // stdout when empty
+	std::string				   csvPath;	   // Per frame GPU timings, see GPUProfiler::SetCsvPath
+	std::vector< std::string > vfxPaths;
+	std::string				   allocator; // Allocator benchmark run instead of the VFXs
+	allocBenchOpts_t		   allocOpts;
+	uint32_t				   recordingThreads = 0; // Recording benchmark from 1 to this many threads, 0 skips it
+};
+
+// Steps the simulation with a fixed delta, seen from the default camera of the editor
+class BenchGame : public Game
+{
+   public:
+	void Init() final;
+	void Shutdown() final {}
+
+	void RunFrame() final;
+
+	void   BindAction( userAction_t, int ) final {} // No input, the camera is fixed
+	double GetDeltaFrame() const final { return m_deltaFrame; }
+	int	   GetCamProjView( const float **ptr ) final;
+
+	void SetDeltaFrame( double deltaFrame ) { m_deltaFrame = deltaFrame; }
+	void SetAspect( float aspect ) { m_cam.SetAspect( aspect ); }
+
+   private:
+	Camera m_cam;
+	double m_deltaFrame = 0.0;
+	double m_time		= 0.0;
+};
+
+static BenchGame g_benchGame;
+Game *const		 g_game = &g_benchGame;
+
+void BenchGame::Init()
+{
+	cameraFrame_t &camFrame = m_cam.GetFrame();
+	camFrame.p				= { -3.0f, 0.0f, 0.0f };
+	camFrame.a				= 0.0f;
+	camFrame.fov			= 90.0f;
+
+	m_cam.UpdateProjView();
+}
+
+void BenchGame::RunFrame()
+{
+	m_time += m_deltaFrame;
+
+	float		fDeltaFrame	 = static_cast< float >( m_deltaFrame );
+	float		fTime		 = static_cast< float >( m_time );
+	float		timeVec[ 8 ] = { fDeltaFrame, fDeltaFrame, fDeltaFrame, fDeltaFrame, fTime, fTime, fTime, fTime };
+	const char *varNames[]	 = { GlobalsTokenizer::GetProjStr(),
+								 GlobalsTokenizer::GetViewStr(),
+								 GlobalsTokenizer::GetDeltaFrameStr(),
+								 GlobalsTokenizer::GetTimeStr() };
+
+	render::g_renderSystem->SetUBOVar( 2, varNames, m_cam.GetProjPtr() );
+	render::g_renderSystem->SetUBOVar( 2, varNames + 2, timeVec );
+}
+
+int BenchGame::GetCamProjView( const float **ptr )
+{
+	*ptr = m_cam.GetProjPtr();
+	return 2 * 4 * 4;
+}
+
+static void PrintUsage()
+{
+	std::printf( "Usage: vkRunaBench [options] file.vfx...\n"
+				 "       vkRunaBench [options] --recording-threads <n> file.vfx...\n"
+				 "       vkRunaBench [options] --allocator churn|stress\n"
+				 "  --frames <n>         Measured frames (default 1000)\n"
+				 "  --warmup <n>         Frames run before measuring (default 100)\n"
+				 "  --delta <seconds>    Fixed simulation step (default 1/60)\n"
+				 "  --width <pixels>     Offscreen image width (default 1280)\n"
+				 "  --height <pixels>    Offscreen image height (default 720)\n"
+				 "  --output <file.json> Report path (default stdout)\n"
+				 "  --csv <file.csv>     GPU timings of every frame\n"
+				 "  --recording-threads <n>\n"
+				 "                       Records the same frame with 1 to n threads, --frames times each\n"
+				 "  --allocator churn    Random allocs and frees against a single memory block\n"
+				 "  --allocator stress   Threads allocating and freeing small buffers\n"
+				 "  --ops <n>            Allocator operations (default 1000000)\n"
+				 "  --live <n>           Allocations alive, per thread for stress (default 4096)\n"
+				 "  --threads <n>        Threads of the stress benchmark (default 4)\n"
+				 "  --seed <n>           Seed of the random operations (default 1)\n" );
+}
+
+static bool ParseArgs( int argc, char **argv, benchOpts_t &opts )
+{
+	for ( int i = 1; i < argc; ++i )
+	{
+		const char *arg	  = argv[ i ];
+		const char *value = i + 1 < argc ? argv[ i + 1 ] : nullptr;
+
+		if ( std::strncmp( arg, "--", 2 ) != 0 )
+		{
+			// Made absolute before sys::Init changes the working directory
+			opts.vfxPaths.emplace_back( std::filesystem::absolute( arg ).string() );
+			continue;
+		}
+
+		if ( value == nullptr )
+		{
+			Error( "Missing value of option \"%s\"", arg );
+			return false;
+		}
+		++i;
+
+		if ( std::strcmp( arg, "--frames" ) == 0 )
+		{
+			opts.frames = static_cast< uint32_t >( std::strtoul( value, nullptr, 10 ) );
+		}
+		else if ( std::strcmp( arg, "--warmup" ) == 0 )
+		{
+			opts.warmupFrames = static_cast< uint32_t >( std::strtoul( value, nullptr, 10 ) );
+		}
+		else if ( std::strcmp( arg, "--delta" ) == 0 )
+		{
+			opts.deltaFrame = std::strtod( value, nullptr );
+		}
+		else if ( std::strcmp( arg, "--width" ) == 0 )
+		{
+			opts.width = static_cast< uint32_t >( std::strtoul( value, nullptr, 10 ) );
+		}
+		else if ( std::strcmp( arg, "--height" ) == 0 )
+		{
+			opts.height = static_cast< uint32_t >( std::strtoul( value, nullptr, 10 ) );
+		}
+		else if ( std::strcmp( arg, "--output" ) == 0 )
+		{
+			opts.outputPath = std::filesystem::absolute( value ).string();
+		}
+		else if ( std::strcmp( arg, "--csv" ) == 0 )
+		{
+			opts.csvPath = std::filesystem::absolute( value ).string();
+		}
+		else if ( std::strcmp( arg, "--recording-threads" ) == 0 )
+		{
+			opts.recordingThreads = static_cast< uint32_t >( std::strtoul( value, nullptr, 10 ) );
+		}
+		else if ( std::strcmp( arg, "--allocator" ) == 0 )
+		{
+			opts.allocator = value;
+		}
+		else if ( std::strcmp( arg, "--ops" ) == 0 )
+		{
+			opts.allocOpts.ops = static_cast< uint32_t >( std::strtoul( value, nullptr, 10 ) );
+		}
+		else if ( std::strcmp( arg, "--live" ) == 0 )
+		{
+			opts.allocOpts.liveCount = static_cast< uint32_t >( std::strtoul( value, nullptr, 10 ) );
+		}
+		else if ( std::strcmp( arg, "--threads" ) == 0 )
+		{
+			opts.allocOpts.threadCount = static_cast< uint32_t >( std::strtoul( value, nullptr, 10 ) );
+		}
+		else if ( std::strcmp( arg, "--seed" ) == 0 )
+		{
+			opts.allocOpts.seed = static_cast< uint32_t >( std::strtoul( value, nullptr, 10 ) );
+		}
+		else
+		{
+			Error( "Unknown option \"%s\"", arg );
+			return false;
+		}
+	}
+
+	if ( !opts.allocator.empty() )
+	{
+		return ( opts.allocator == "churn" || opts.allocator == "stress" ) && opts.vfxPaths.empty() &&
+			   opts.recordingThreads == 0;
+	}
+
+	return opts.frames > 0 && opts.width > 0 && opts.height > 0 && opts.deltaFrame >= 0.0 && !opts.vfxPaths.empty();
+}
+
+static std::string ToJSONString( const std::string &str )
+{
+	std::string ret = "\"";
+	for ( char c : str )
+	{
+		if ( c == '"' || c == '\\' )
+		{
+			ret += '\\';
+		}
+		ret += c;
+	}
+	ret += '"';
+
+	return ret;
+}
+
+// Returns the number of recorded commands
+static int RunFrame()
+{
+	static render::Backend &	 renderBackend = render::Backend::GetInstance();
+	static render::RenderSystem &renderSystem  = render::RenderSystem::GetInstance();
+
+	g_game->RunFrame();
+
+	render::gpuCmd_t *preRenderCmds = nullptr;
+	render::gpuCmd_t *renderCmds	= nullptr;
+
+	const int preRenderCmdsCount = renderSystem.GetPreRenderCmds( &preRenderCmds );
+	const int renderCmdsCount	 = renderSystem.GetRenderCmds( &renderCmds );
+
+	renderBackend.ExecuteCommands( preRenderCmdsCount, preRenderCmds, renderCmdsCount, renderCmds );
+
+	return preRenderCmdsCount + renderCmdsCount;
+}
+
+static FILE *OpenOutput( const benchOpts_t &opts )
+{
+	if ( opts.outputPath.empty() )
+	{
+		return stdout;
+	}
+
+	FILE *out = std::fopen( opts.outputPath.c_str(), "w" );
+	if ( out == nullptr )
+	{
+		Error( "Could not open \"%s\"", opts.outputPath.c_str() );
+	}
+
+	return out;
+}
+
+static void CloseOutput( FILE *out )
+{
+	if ( out != stdout )
+	{
+		std::fclose( out );
+	}
+}
+
+static int RunAllocatorBenchmark( const benchOpts_t &opts )
+{
+	FILE *out = OpenOutput( opts );
+	if ( out == nullptr )
+	{
+		return EXIT_FAILURE;
+	}
+
+	const bool ok = opts.allocator == "churn" ? RunAllocatorChurn( opts.allocOpts, out )
+											  : RunAllocatorStress( opts.allocOpts, out );
+
+	CloseOutput( out );
+
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+static int RunRecordingBenchmark( const benchOpts_t &opts )
+{
+	render::VulkanBackend &renderBackend = render::VulkanBackend::GetInstance();
+
+	// The simulation stands still, every thread count records the same commands
+	g_benchGame.SetDeltaFrame( 0.0 );
+
+	const uint32_t threadCount = std::min< uint32_t >( opts.recordingThreads, render::RECORDING_MAX_THREADS );
+
+	std::vector< double > recordMs( threadCount );
+	int					  cmdCount = 0;
+	for ( uint32_t i = 0; i < threadCount; ++i )
+	{
+		renderBackend.SetRecordingThreadCount( i + 1 );
+
+		// Resets the accumulated statistics
+		renderBackend.GetFrameStats();
+
+		for ( uint32_t frame = 0; frame < opts.frames; ++frame )
+		{
+			cmdCount = RunFrame();
+			renderBackend.Present();
+		}
+
+		recordMs[ i ] = renderBackend.GetFrameStats().recordMs;
+	}
+
+	FILE *out = OpenOutput( opts );
+	if ( out == nullptr )
+	{
+		return EXIT_FAILURE;
+	}
+
+	const render::vulkanContext_t &vkContext = render::GetVulkanContext();
+
+	std::fprintf( out, "{\n" );
+	std::fprintf( out, "  \"benchmark\": \"recording\",\n" );
+	std::fprintf( out, "  \"device\": %s,\n", ToJSONString( vkContext.gpu.properties.deviceName ).c_str() );
+	std::fprintf( out, "  \"frames\": %u,\n", opts.frames );
+	std::fprintf( out, "  \"commands\": %d,\n", cmdCount );
+	std::fprintf( out, "  \"minRangeSize\": %d,\n", render::RECORDING_MIN_RANGE_SIZE );
+	std::fprintf( out, "  \"threads\": [\n" );
+	for ( uint32_t i = 0; i < threadCount; ++i )
+	{
+		std::fprintf( out,
+					  "    { \"threads\": %u, \"recordMs\": %f, \"speedup\": %f }%s\n",
+					  i + 1,
+					  recordMs[ i ],
+					  recordMs[ i ] > 0.0 ? recordMs[ 0 ] / recordMs[ i ] : 0.0,
+					  i + 1 < threadCount ? "," : "" );
+	}
+	std::fprintf( out, "  ]\n" );
+	std::fprintf( out, "}\n" );
+
+	CloseOutput( out );
+
+	return EXIT_SUCCESS;
+}
+
+static int RunBenchmark( const benchOpts_t &opts )
+{
+	render::VulkanBackend &renderBackend = render::VulkanBackend::GetInstance();
+	render::RenderSystem & renderSystem	 = render::RenderSystem::GetInstance();
+
+	renderBackend.SetHeadless( opts.width, opts.height );
+	renderBackend.Init();
+	renderSystem.Init();
+
+	// Only needs the device
+	if ( !opts.allocator.empty() )
+	{
+		return RunAllocatorBenchmark( opts );
+	}
+
+	g_benchGame.SetDeltaFrame( opts.deltaFrame );
+	g_benchGame.SetAspect( static_cast< float >( opts.width ) / static_cast< float >( opts.height ) );
+	g_game->Init();
+
+	const double  msPerTick		 = 1e3 / double( ClockTicksFrequency() );
+	const int64_t loadStartTicks = GetClockTicks();
+
+	// Together, so that their shaders are compiled in parallel
+	std::vector< const char * > vfxPaths;
+	for ( const std::string &path : opts.vfxPaths )
+	{
+		vfxPaths.emplace_back( path.c_str() );
+	}
+
+	std::vector< render::VFXManager::VFXContent_t > loaded( vfxPaths.size() );
+	render::g_vfxManager.AddVFXsFromFiles( vfxPaths.size(), vfxPaths.data(), loaded.data() );
+
+	for ( size_t i = 0; i < loaded.size(); ++i )
+	{
+		if ( !loaded[ i ]->IsValid() )
+		{
+			Error( "Could not load VFX \"%s\"", vfxPaths[ i ] );
+			return EXIT_FAILURE;
+		}
+	}
+
+	const double loadMs = double( GetClockTicks() - loadStartTicks ) * msPerTick;
+
+	for ( uint32_t i = 0; i < opts.warmupFrames; ++i )
+	{
+		RunFrame();
+		renderBackend.Present();
+	}
+
+	if ( opts.recordingThreads > 0 )
+	{
+		return RunRecordingBenchmark( opts );
+	}
+
+	// Pipelines are created while loading and during the first frames, faster once the pipeline cache is warm
+	const render::pipelineCacheStats_t pipelineStats = render::g_pipelineManager.GetPipelineCacheStats();
+	const render::shaderCacheStats_t   shaderStats	 = render::g_shaderCache.GetStats();
+
+	if ( !opts.csvPath.empty() && !render::g_gpuProfiler.SetCsvPath( opts.csvPath.c_str() ) )
+	{
+		return EXIT_FAILURE;
+	}
+
+	// Resets the accumulated statistics
+	renderBackend.GetFrameStats();
+
+	std::vector< double > buildMs( opts.frames );
+	const int64_t		  startTicks = GetClockTicks();
+
+	for ( uint32_t i = 0; i < opts.frames; ++i )
+	{
+		// From the simulation step to the submit, Present blocks on the frames in flight
+		const int64_t frameTicks = GetClockTicks();
+		RunFrame();
+		buildMs[ i ] = double( GetClockTicks() - frameTicks ) * msPerTick;
+
+		renderBackend.Present();
+	}
+
+	const double			   totalMs	  = double( GetClockTicks() - startTicks ) * msPerTick;
+	const render::frameStats_t frameStats = renderBackend.GetFrameStats();
+
+	render::g_gpuProfiler.SetCsvPath( nullptr );
+
+	double buildMeanMs = 0.0;
+	for ( double ms : buildMs )
+	{
+		buildMeanMs += ms;
+	}
+	buildMeanMs /= double( buildMs.size() );
+
+	std::sort( buildMs.begin(), buildMs.end() );
+	const double buildP50Ms = buildMs[ buildMs.size() / 2 ];
+	const double buildP95Ms = buildMs[ std::min( buildMs.size() - 1, buildMs.size() * 95 / 100 ) ];
+
+	FILE *out = OpenOutput( opts );
+	if ( out == nullptr )
+	{
+		return EXIT_FAILURE;
+	}
+
+	const render::vulkanContext_t &vkContext = render::GetVulkanContext();
+
+	std::fprintf( out, "{\n" );
+	std::fprintf( out, "  \"device\": %s,\n", ToJSONString( vkContext.gpu.properties.deviceName ).c_str() );
+	std::fprintf( out, "  \"frames\": %u,\n", opts.frames );
+	std::fprintf( out, "  \"warmupFrames\": %u,\n", opts.warmupFrames );
+	std::fprintf( out, "  \"deltaFrame\": %f,\n", opts.deltaFrame );
+	std::fprintf( out, "  \"width\": %u,\n", opts.width );
+	std::fprintf( out, "  \"height\": %u,\n", opts.height );
+	std::fprintf( out, "  \"framesInFlight\": %u,\n", frameStats.framesInFlight );
+	std::fprintf( out, "  \"loadMs\": %f,\n", loadMs );
+	std::fprintf( out, "  \"pipelineCacheWarm\": %s,\n", pipelineStats.warm ? "true" : "false" );
+	std::fprintf( out, "  \"pipelineCacheBytes\": %zu,\n", pipelineStats.loadedSize );
+	std::fprintf( out, "  \"pipelines\": %u,\n", pipelineStats.pipelineCount );
+	std::fprintf( out, "  \"pipelineMs\": %f,\n", pipelineStats.pipelineMs );
+	std::fprintf( out, "  \"shaderCacheHits\": %u,\n", shaderStats.hits );
+	std::fprintf( out, "  \"shaderCacheMisses\": %u,\n", shaderStats.misses );
+	std::fprintf( out, "  \"framesPerSecond\": %f,\n", totalMs > 0.0 ? 1e3 * double( opts.frames ) / totalMs : 0.0 );
+	std::fprintf( out, "  \"cpuFrameMs\": %f,\n", frameStats.cpuFrameMs );
+	std::fprintf( out, "  \"cpuFrameBuildMs\": %f,\n", buildMeanMs );
+	std::fprintf( out, "  \"cpuFrameBuildP50Ms\": %f,\n", buildP50Ms );
+	std::fprintf( out, "  \"cpuFrameBuildP95Ms\": %f,\n", buildP95Ms );
+	std::fprintf( out, "  \"cpuFrameBuildMaxMs\": %f,\n", buildMs.back() );
+	std::fprintf( out, "  \"recordMs\": %f,\n", frameStats.recordMs );
+	std::fprintf( out, "  \"fenceWaitMs\": %f,\n", frameStats.fenceWaitMs );
+
+	// Of the last frame, the render graph declares the same passes every frame and only compiles them again on changes
+	const render::rgStats_t graphStats = render::g_renderGraph.GetStats();
+	std::fprintf( out, "  \"passes\": %u,\n", graphStats.passCount );
+	std::fprintf( out, "  \"graphCompiles\": %u,\n", graphStats.compiledCount );
+	std::fprintf( out, "  \"graphReuses\": %u,\n", graphStats.reusedCount );
+	std::fprintf( out, "  \"barriers\": %u,\n", graphStats.barrierCount );
+	std::fprintf( out, "  \"bufferBarriers\": %u,\n", graphStats.bufferBarrierCount );
+	std::fprintf( out, "  \"imageBarriers\": %u,\n", graphStats.imageBarrierCount );
+	std::fprintf( out, "  \"transientBytes\": %llu,\n", static_cast< unsigned long long >( graphStats.transientSize ) );
+	std::fprintf( out,
+				  "  \"transientHeapBytes\": %llu,\n",
+				  static_cast< unsigned long long >( graphStats.transientHeapSize ) );
+
+	// Averaged over the last GPU_PROFILER_AVERAGE_FRAMES completed frames
+	double gpuMs = 0.0;
+	std::fprintf( out, "  \"vfxs\": [\n" );
+	const render::VFXManager::VFXContainer_t &vfxs = render::g_vfxManager.GetContainer();
+	for ( size_t i = 0; i < vfxs.size(); ++i )
+	{
+		const render::VFX &		   vfx	   = *vfxs[ i ];
+		const render::gpuTimings_t timings = render::g_gpuProfiler.GetTimings( vfx.GetPath().c_str() );
+		gpuMs += timings.computeMs + timings.renderMs;
+
+		std::fprintf( out,
+					  "    { \"path\": %s, \"capacity\": %u, \"gpuComputeMs\": %f, \"gpuRenderMs\": %f }%s\n",
+					  ToJSONString( vfx.GetPath() ).c_str(),
+					  vfx.GetCapacity(),
+					  timings.computeMs,
+					  timings.renderMs,
+					  i + 1 < vfxs.size() ? "," : "" );
+	}
+	std::fprintf( out, "  ],\n" );
+	std::fprintf( out, "  \"gpuMs\": %f\n", gpuMs );
+	std::fprintf( out, "}\n" );
+
+	CloseOutput( out );
+
+	return EXIT_SUCCESS;
+}
+
+} // namespace vkRuna
+
+int main( int argc, char **argv )
+{
+	benchOpts_t opts;
+	if ( !ParseArgs( argc, argv, opts ) )
+	{
+		PrintUsage();
+		return EXIT_FAILURE;
+	}
+
+	int exitCode = EXIT_FAILURE;
+
+	try
+	{
+		sys::Init();
+
+		exitCode = RunBenchmark( opts );
+
+		render::RenderSystem::GetInstance().Shutdown();
+		render::Backend::GetInstance().Shutdown();
+		g_game->Shutdown();
+
+		sys::Shutdown();
+	}
+	catch ( const std::exception &e )
+	{
+		FatalError( "%s", e.what() );
+	}
+
+	return exitCode;
+}
@@ -236,6 +236,8 @@ void GameLocal::G_Ticker()
 
 void GameLocal::P_Ticker()
 {
+	const winProps_t &winProps = Window::GetInstance().GetProps();
+	m_cmd.cam.SetAspect( static_cast< float >( winProps.width ) / static_cast< float >( winProps.height ) );
 	m_cmd.cam.UpdateProjView();
 
 	if ( !m_paused )
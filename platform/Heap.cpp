@@ -2,16 +2,18 @@
 
 #include "Heap.h"
 
+#include "platform/Profiler.h"
+
 #include <cstdlib>
 
 void *operator new( std::size_t count )
 {
 	auto ptr = malloc( count );
-	// TracyAlloc( ptr, count );
+	RUNA_PROFILE_ALLOC( ptr, count, "CPU heap" );
 	return ptr;
 }
 void operator delete( void *ptr ) noexcept
 {
-	// TracyFree( ptr );
+	RUNA_PROFILE_FREE( ptr, "CPU heap" );
 	free( ptr );
 }
@@ -0,0 +1,15 @@
+// Copyright (c) 2021 Arno Galvez
+
+#pragma once
+
+// TRACY_ENABLE is defined project wide, the client is only compiled in when its sources are available.
+// Tracy identifies memory pools by name pointer: pool names must be string literals or outlive the allocations.
+#if defined( TRACY_ENABLE ) && __has_include( "external/tracy/Tracy.hpp" )
+	#include "external/tracy/Tracy.hpp"
+
+	#define RUNA_PROFILE_ALLOC( ptr, size, pool ) TracyAllocN( ptr, size, pool )
+	#define RUNA_PROFILE_FREE( ptr, pool )		  TracyFreeN( ptr, pool )
+#else
+	#define RUNA_PROFILE_ALLOC( ptr, size, pool )
+	#define RUNA_PROFILE_FREE( ptr, pool )
+#endif
@@ -2,9 +2,11 @@
 
 #pragma once
 
+#include "external/cereal/cereal.hpp"
 #include "platform/Sys.h" // #TODO get error handling out of this header
 
 #include <string>
+#include <vector>
 
 namespace vkRuna
 {
@@ -79,7 +81,7 @@ void save( Archive &ar, const SerializableData &obj )
 		}
 		default:
 		{
-			FatalError( "When serializing object of type SerializableData: unknown type %d.", obj.type );
+			sys::FatalError( "When serializing object of type SerializableData: unknown type %d.", obj.type );
 			break;
 		}
 	}
@@ -127,7 +129,7 @@ void load( Archive &ar, SerializableData &obj )
 		}
 		default:
 		{
-			FatalError( "When serializing object of type SerializableData: unknown type %d.", obj.type );
+			sys::FatalError( "When serializing object of type SerializableData: unknown type %d.", obj.type );
 			break;
 		}
 	}
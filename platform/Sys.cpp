@@ -3,14 +3,27 @@
 #include "platform/Sys.h"
 
 #include "platform/Check.h"
-#include "platform/Window.h"
 #include "platform/defines.h"
 
+#include <cerrno>
+#include <clocale>
 #include <cstdarg>
+#include <cstdio>
 #include <cstdlib>
 #include <cstring>
-#include <direct.h>
-#include <windows.h>
+#include <filesystem>
+#include <system_error>
+
+#ifdef _WIN32
+	#include "platform/Window.h"
+
+	#include <direct.h>
+	#include <windows.h>
+#else
+	#include <chrono>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
 
 namespace vkRuna
 {
@@ -42,10 +55,14 @@ void Shutdown() {}
 
 sysCallRet_t Chdir( const char *path )
 {
+#ifdef _WIN32
 	int ret = ::_chdir( path );
+#else
+	int ret = ::chdir( path );
+#endif
 	if ( ret == -1 )
 	{
-		errno_t err = errno;
+		int err = errno;
 		switch ( err )
 		{
 			case ( ENOENT ): return sysCallRet_t::PATH_NOT_FOUND;
@@ -59,10 +76,14 @@ sysCallRet_t Chdir( const char *path )
 
 sysCallRet_t Mkdir( const char *path )
 {
+#ifdef _WIN32
 	int ret = ::_mkdir( path );
+#else
+	int ret = ::mkdir( path, 0755 );
+#endif
 	if ( ret == -1 )
 	{
-		errno_t err = errno;
+		int err = errno;
 		switch ( err )
 		{
 			case ( EEXIST ): return sysCallRet_t::DIR_EXIST;
@@ -85,6 +106,7 @@ std::string GetExePath()
 	bool								   shouldContinue = true;
 	do
 	{
+#ifdef _WIN32
 		DWORD result	= GetModuleFileNameA( nullptr, &buf[ 0 ], static_cast< DWORD >( size ) );
 		DWORD lastError = GetLastError();
 		if ( result == 0 )
@@ -105,6 +127,24 @@ std::string GetExePath()
 		{
 			shouldContinue = false;
 		}
+#else
+		ssize_t result = ::readlink( "/proc/self/exe", &buf[ 0 ], size );
+		if ( result <= 0 )
+		{
+			shouldContinue = false;
+		}
+		else if ( static_cast< size_type >( result ) < size )
+		{
+			buf[ result ]  = 0;
+			havePath	   = true;
+			shouldContinue = false;
+		}
+		else
+		{
+			size *= 2;
+			buf.resize( size );
+		}
+#endif
 	} while ( shouldContinue );
 
 	std::string ret = &buf[ 0 ];
@@ -113,7 +153,7 @@ std::string GetExePath()
 
 std::string ExtractDirPath( const std::string &path )
 {
-	std::string::size_type n = path.rfind( '\\' );
+	std::string::size_type n = path.find_last_of( "\\/" );
 	if ( n != std::string::npos )
 	{
 		return path.substr( 0, n );
@@ -126,7 +166,7 @@ std::string ExtractDirPath( const std::string &path )
 
 std::string ExtractFileName( const std::string &path )
 {
-	std::string::size_type n = path.rfind( '\\' );
+	std::string::size_type n = path.find_last_of( "\\/" );
 	if ( n != std::string::npos )
 	{
 		return path.substr( n + 1 );
@@ -170,6 +210,7 @@ void FatalError( const char *fmt... )
 	Error( fmt );
 	va_end( argptr );
 
+#ifdef _WIN32
 	Window::GetInstance().OnFatalError();
 
 	std::printf( "\x1b[31mFATAL ERROR\x1b[0m: close window to quit..." );
@@ -190,10 +231,18 @@ void FatalError( const char *fmt... )
 	}
 
 	::ExitProcess( 0 );
+#else
+	// No window to close, headless runs must report the failure to their caller
+	std::printf( "\x1b[31mFATAL ERROR\x1b[0m\n" );
+	std::fflush( stdout );
+
+	std::exit( EXIT_FAILURE );
+#endif
 }
 
 int Sys_GenerateEvents()
 {
+#ifdef _WIN32
 	MSG msg;
 	while ( ::PeekMessage( &msg, NULL, 0, 0, PM_REMOVE ) )
 	{
@@ -206,6 +255,7 @@ int Sys_GenerateEvents()
 		::TranslateMessage( &msg );
 		::DispatchMessageW( &msg );
 	}
+#endif
 
 	return 0;
 }
@@ -260,6 +310,42 @@ std::string ReadFile( const char *path )
 	return buff;
 }
 
+bool WriteFileAtomic( const char *path, const void *data, size_t size )
+{
+	const std::string tmpPath = std::string( path ) + ".tmp";
+
+	{
+		std::ofstream file( tmpPath, std::ios::out | std::ios::binary | std::ios::trunc );
+		if ( !file.is_open() )
+		{
+			Error( "Could not open \"%s\" for writing.", tmpPath.c_str() );
+			return false;
+		}
+
+		file.write( static_cast< const char * >( data ), static_cast< std::streamsize >( size ) );
+		file.flush();
+		if ( file.fail() )
+		{
+			Error( "Could not write \"%s\".", tmpPath.c_str() );
+			file.close();
+			std::remove( tmpPath.c_str() );
+			return false;
+		}
+	}
+
+	// Replaces the destination on every platform, unlike std::rename on Windows
+	std::error_code ec;
+	std::filesystem::rename( tmpPath, path, ec );
+	if ( ec )
+	{
+		Error( "Could not rename \"%s\" to \"%s\": %s", tmpPath.c_str(), path, ec.message().c_str() );
+		std::remove( tmpPath.c_str() );
+		return false;
+	}
+
+	return true;
+}
+
 void Sys_ClearEvents()
 {
 	eventHead = eventTail = 0;
@@ -320,6 +406,7 @@ const char *KeyToString( keyNum_t key )
 
 bool ExecuteAndWait( char *cmdLine )
 {
+#ifdef _WIN32
 	STARTUPINFO			si;
 	PROCESS_INFORMATION pi;
 	DWORD				ex = 0;
@@ -363,12 +450,20 @@ bool ExecuteAndWait( char *cmdLine )
 	// Close process and thread handles.
 	::CloseHandle( pi.hProcess );
 	::CloseHandle( pi.hThread );
+#else
+	if ( std::system( cmdLine ) != 0 )
+	{
+		Error( "The following command failed:\n%s", cmdLine );
+		return false;
+	}
+#endif
 
 	return true;
 }
 
 int64_t ClockTicksFrequency()
 {
+#ifdef _WIN32
 	static LARGE_INTEGER Frequency { 0 };
 
 	if ( Frequency.QuadPart == 0 )
@@ -377,14 +472,21 @@ int64_t ClockTicksFrequency()
 	}
 
 	return Frequency.QuadPart;
+#else
+	return std::chrono::steady_clock::period::den / std::chrono::steady_clock::period::num;
+#endif
 }
 
 int64_t GetClockTicks()
 {
+#ifdef _WIN32
 	LARGE_INTEGER ticks;
 	QueryPerformanceCounter( &ticks );
 
 	return ticks.QuadPart;
+#else
+	return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
 }
 
 } // namespace sys
@@ -125,6 +125,8 @@ int64_t GetClockTicks();
 template< typename CharT >
 std::vector< CharT > ReadBinary( const char *relativePath );
 std::string			 ReadFile( const char *path );
+// Writes a temporary file next to path then renames it, readers never see a partially written file
+bool WriteFileAtomic( const char *path, const void *data, size_t size );
 
 #include "Sys.inl"
 
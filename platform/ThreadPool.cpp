@@ -0,0 +1,116 @@
+// Copyright (c) 2021 Arno Galvez
+
+#include "platform/ThreadPool.h"
+
+#include <algorithm>
+
+namespace vkRuna
+{
+namespace sys
+{
+ThreadPool::ThreadPool() {}
+
+ThreadPool::~ThreadPool()
+{
+	Shutdown();
+}
+
+void ThreadPool::Init( uint32_t threadCount )
+{
+	Shutdown();
+
+	m_quit = false;
+
+	for ( uint32_t i = 1; i < threadCount; ++i )
+	{
+		m_workers.emplace_back( &ThreadPool::WorkerMain, this, i );
+	}
+}
+
+void ThreadPool::Shutdown()
+{
+	{
+		std::lock_guard< std::mutex > lock( m_mutex );
+		m_quit = true;
+	}
+	m_startCv.notify_all();
+
+	for ( std::thread &worker : m_workers )
+	{
+		worker.join();
+	}
+	m_workers.clear();
+}
+
+void ThreadPool::ParallelFor( uint32_t count, uint32_t threadCount, const job_t &job )
+{
+	const uint32_t workerCount = std::min( { threadCount, count, GetThreadCount() } );
+	if ( workerCount <= 1 )
+	{
+		for ( uint32_t i = 0; i < count; ++i )
+		{
+			job( i, 0 );
+		}
+		return;
+	}
+
+	{
+		std::lock_guard< std::mutex > lock( m_mutex );
+		m_job		   = &job;
+		m_count		   = count;
+		m_next		   = 0;
+		m_workerCount  = workerCount - 1;
+		m_runningCount = workerCount - 1;
+		++m_generation;
+	}
+	m_startCv.notify_all();
+
+	RunJobs( 0 );
+
+	std::unique_lock< std::mutex > lock( m_mutex );
+	m_doneCv.wait( lock, [ this ]() { return m_runningCount == 0; } );
+	m_job = nullptr;
+}
+
+void ThreadPool::WorkerMain( uint32_t threadIndex )
+{
+	uint64_t generation = 0;
+
+	for ( ;; )
+	{
+		{
+			std::unique_lock< std::mutex > lock( m_mutex );
+			m_startCv.wait( lock, [ & ]() { return m_quit || m_generation != generation; } );
+
+			if ( m_quit )
+			{
+				return;
+			}
+
+			generation = m_generation;
+			if ( threadIndex > m_workerCount )
+			{
+				continue;
+			}
+		}
+
+		RunJobs( threadIndex );
+
+		std::lock_guard< std::mutex > lock( m_mutex );
+		if ( --m_runningCount == 0 )
+		{
+			m_doneCv.notify_one();
+		}
+	}
+}
+
+void ThreadPool::RunJobs( uint32_t threadIndex )
+{
+	for ( uint32_t i = m_next++; i < m_count; i = m_next++ )
+	{
+		( *m_job )( i, threadIndex );
+	}
+}
+
+} // namespace sys
+} // namespace vkRuna
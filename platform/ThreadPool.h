@@ -0,0 +1,61 @@
+// Copyright (c) 2021 Arno Galvez
+
+#pragma once
+
+#include "platform/defines.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace vkRuna
+{
+namespace sys
+{
+// Worker threads running the iterations of parallel loops. The calling thread takes part in every loop: threadIndex 0
+// is the caller, workers are numbered from 1. ParallelFor is not reentrant and must be called from a single thread.
+class ThreadPool
+{
+	NO_COPY_NO_ASSIGN( ThreadPool )
+
+   public:
+	using job_t = std::function< void( uint32_t index, uint32_t threadIndex ) >;
+
+	ThreadPool();
+	~ThreadPool();
+
+	void Init( uint32_t threadCount ); // Including the calling thread
+	void Shutdown();
+
+	uint32_t GetThreadCount() const { return static_cast< uint32_t >( m_workers.size() ) + 1; }
+
+	// Runs job for every index of [0, count) on at most threadCount threads, returns once all of them have run
+	void ParallelFor( uint32_t count, uint32_t threadCount, const job_t &job );
+
+   private:
+	void WorkerMain( uint32_t threadIndex );
+	void RunJobs( uint32_t threadIndex );
+
+   private:
+	std::vector< std::thread > m_workers;
+
+	std::mutex				m_mutex;
+	std::condition_variable m_startCv;
+	std::condition_variable m_doneCv;
+
+	const job_t * m_job			 = nullptr;
+	uint32_t	  m_count		 = 0;
+	uint32_t	  m_workerCount	 = 0; // Workers taking part in the current loop
+	uint32_t	  m_runningCount = 0;
+	uint64_t	  m_generation	 = 0;
+	bool		  m_quit		 = false;
+
+	std::atomic< uint32_t > m_next { 0 };
+};
+
+} // namespace sys
+} // namespace vkRuna
@@ -2,8 +2,17 @@
 
 #pragma once
 
-#define NO_DISCARD	  [[nodiscard]]
-#define DEBUG_BREAK() __debugbreak()
+#include <cstddef>
+
+#define NO_DISCARD [[nodiscard]]
+
+#if defined( _WIN32 )
+	#define DEBUG_BREAK() __debugbreak()
+#elif defined( RUNA_DEBUG )
+	#define DEBUG_BREAK() __builtin_trap()
+#else
+	#define DEBUG_BREAK() ( ( void )0 ) // Headless runs report fatal errors through their exit code
+#endif
 
 #define SWITCH_CASE_STRING( x ) \
 	case x:                     \
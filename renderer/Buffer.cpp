@@ -4,9 +4,12 @@
 
 #include "platform/Sys.h"
 #include "renderer/Check.h"
+#include "renderer/Defragmenter.h"
 #include "renderer/GPUMailManager.h"
 #include "renderer/VkBackend.h"
+#include "rnLib/Math.h"
 
+#include <algorithm>
 #include <cstring>
 
 namespace vkRuna
@@ -44,9 +47,33 @@ VkAccessFlags BufferFlagsToAccessFlags( VkBufferUsageFlags usageFlags )
 
 	accessFlags |= HasFlag( usageFlags, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT ) * VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
 
+	accessFlags |= HasFlag( usageFlags, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT ) * VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+
 	return accessFlags;
 }
 
+VkPipelineStageFlags BufferFlagsToStageFlags( VkBufferUsageFlags usageFlags )
+{
+	VkPipelineStageFlags stageFlags = 0;
+
+	// Every stage that may access the buffer according to BufferFlagsToAccessFlags
+	stageFlags |= HasFlag( usageFlags, VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT ) *
+				  VK_PIPELINE_STAGE_TRANSFER_BIT;
+
+	stageFlags |= HasFlag( usageFlags,
+						   VK_BUFFER_USAGE_UNIFORM_TEXEL_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_TEXEL_BUFFER_BIT |
+							   VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT ) *
+				  ( VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+					VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT );
+
+	stageFlags |= HasFlag( usageFlags, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT ) *
+				  VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+
+	stageFlags |= HasFlag( usageFlags, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT ) * VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT;
+
+	return stageFlags != 0 ? stageFlags : static_cast< VkPipelineStageFlags >( VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT );
+}
+
 Buffer::~Buffer()
 {
 	Free();
@@ -57,45 +84,83 @@ void Buffer::Alloc( VkBufferUsageFlags usage,
 					VkDeviceSize	   size,
 					const void *	   data /*= nullptr */ )
 {
+	// Slices are only written by GPU commands, see Fill
+	CHECK_PRED( memProp != BP_GPU_PER_FRAME || data == nullptr );
+
 	Free();
 
 	auto &device = GetVulkanContext().device;
 
-	if ( memProp == BP_STATIC )
+	if ( memProp == BP_STATIC || memProp == BP_GPU_PER_FRAME )
+	{
+		// Transfer source is needed by the defragmenter to move the buffer content, and to copy the slice of a frame to
+		// the next one
+		usage |= VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+	}
+
+	VkDeviceSize allocSize = size;
+	if ( memProp == BP_PER_FRAME || memProp == BP_GPU_PER_FRAME )
 	{
-		usage |= VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+		// One slice per frame region of the frame arena, each slice start is a valid descriptor offset
+		const VkPhysicalDeviceLimits &limits = GetVulkanContext().gpu.properties.limits;
+
+		const VkDeviceSize alignment =
+			std::max( limits.minStorageBufferOffsetAlignment, limits.minUniformBufferOffsetAlignment );
+
+		m_sliceSize = Align( size, alignment );
+		allocSize	= m_sliceSize * SWAPCHAIN_BUFFERING_LEVEL;
 	}
 
 	VkBufferCreateInfo bufferCI {};
 	bufferCI.sType				   = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
 	bufferCI.pNext				   = nullptr;
 	bufferCI.flags				   = 0;
-	bufferCI.size				   = size;
+	bufferCI.size				   = allocSize;
 	bufferCI.usage				   = usage;
 	bufferCI.sharingMode		   = VK_SHARING_MODE_EXCLUSIVE;
 	bufferCI.queueFamilyIndexCount = 0;
 	bufferCI.pQueueFamilyIndices   = nullptr;
 
+	if ( memProp != BP_STATIC )
+	{
+		// Static buffers are written by the transfer queue and only read by the graphics queue
+		SetConcurrentSharingMode( bufferCI );
+	}
+
 	VK_CHECK( vkCreateBuffer( device, &bufferCI, nullptr, &m_handle ) );
 
 	VkMemoryRequirements memRequirements;
 	vkGetBufferMemoryRequirements( device, m_handle, &memRequirements );
 
-	vulkanMemoryUsage_t memUsage = memProp == BP_STATIC ? VULKAN_MEMORY_USAGE_GPU_ONLY : VULKAN_MEMORY_USAGE_CPU_TO_GPU;
-	m_alloc						 = g_vulkanAllocator.Alloc( VULKAN_ALLOCATION_TYPE_BUFFER, memUsage, memRequirements );
+	const bool			deviceLocal = memProp == BP_STATIC || memProp == BP_GPU_PER_FRAME;
+	vulkanMemoryUsage_t memUsage	= deviceLocal ? VULKAN_MEMORY_USAGE_GPU_ONLY : VULKAN_MEMORY_USAGE_CPU_TO_GPU;
+
+	m_alloc = g_vulkanAllocator.Alloc( VULKAN_ALLOCATION_TYPE_BUFFER, memUsage, memRequirements );
 
 	VK_CHECK( vkBindBufferMemory( device, m_handle, m_alloc.deviceMemory, m_alloc.offset ) );
 
-	// m_size  = size;
+	m_size	= size;
 	m_usage = usage;
 	m_prop	= memProp;
 
+	if ( memProp == BP_STATIC )
+	{
+		g_bufferDefragmenter.Register( this );
+	}
+
 	if ( data != nullptr )
 	{
 		if ( memProp == BP_STATIC )
 		{
 			UploadStaticData( size, data );
 		}
+		else if ( memProp == BP_PER_FRAME )
+		{
+			for ( uint32_t i = 0; i < SWAPCHAIN_BUFFERING_LEVEL; ++i )
+			{
+				std::memcpy( static_cast< byte * >( m_alloc.data ) + GetFrameOffset( i ), data, size );
+			}
+		}
 		else
 		{
 			Update( size, data );
@@ -105,117 +170,73 @@ void Buffer::Alloc( VkBufferUsageFlags usage,
 
 void Buffer::Free()
 {
-	auto &device = GetVulkanContext().device;
+	if ( m_prop == BP_STATIC && m_handle != VK_NULL_HANDLE )
+	{
+		g_bufferDefragmenter.Unregister( this );
+	}
+
+	g_gpuMail.CancelUpload( m_upload );
+	m_upload = 0;
 
-	g_vulkanAllocator.Free( m_alloc );
+	// Frames in flight may still use the buffer, the allocator destroys it once they are done
+	g_vulkanAllocator.FreeBuffer( m_handle, m_alloc );
+
+	m_size		= 0;
+	m_sliceSize = 0;
+}
+
+void Buffer::Update( VkDeviceSize size, const void *data, VkDeviceSize writeOffset /*= 0 */ )
+{
+	CHECK_PRED( m_prop == BP_DYNAMIC || m_prop == BP_PER_FRAME );
+	CHECK_PRED( ( size + writeOffset ) <= ( m_prop == BP_PER_FRAME ? m_sliceSize : GetAllocSize() ) );
+	std::memcpy( static_cast< byte * >( GetPointer() ) + writeOffset, data, size );
+}
 
-	if ( m_handle != VK_NULL_HANDLE )
+void *Buffer::GetPointer()
+{
+	if ( m_prop != BP_PER_FRAME )
 	{
-		// Log( "Destroying buffer %p (alloc size: %lu)\n", m_handle, size );
-		vkDestroyBuffer( device, m_handle, nullptr );
-		m_handle = VK_NULL_HANDLE;
+		return m_alloc.data;
 	}
 
-	// m_size = 0;
+	// Frames that used the other slices may still be in flight
+	return static_cast< byte * >( m_alloc.data ) + GetFrameOffset( g_frameArena.GetFrameIndex() );
 }
 
-void Buffer::Update( VkDeviceSize size, const void *data, VkDeviceSize writeOffset /*= 0 */ )
+VkDeviceSize Buffer::GetFrameOffset( uint32_t frameIndex ) const
 {
-	CHECK_PRED( m_prop == BP_DYNAMIC );
-	CHECK_PRED( ( size + writeOffset ) <= GetAllocSize() );
-	std::memcpy( reinterpret_cast< byte * >( m_alloc.data ) + writeOffset, data, size );
+	return IsPerFrame() ? frameIndex * m_sliceSize : 0;
+}
+
+VkDeviceSize Buffer::GetFrameRange() const
+{
+	// The allocated size is greater than the size specified upon creation
+	return IsPerFrame() ? m_size : VK_WHOLE_SIZE;
 }
 
 void Buffer::Fill( uint32_t data )
 {
-	VkCommandBuffer mailCmdBuffer = g_gpuMail.GetCmdBuffer();
-	// Log( "Buffer::Fill m_handle %p, cmd buffer %p\n", m_handle, mailCmdBuffer );
-
-	VkBufferMemoryBarrier barrier {};
-	barrier.sType				= VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
-	barrier.pNext				= nullptr;
-	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-	barrier.buffer				= m_handle;
-	barrier.offset				= 0;
-	barrier.size				= VK_WHOLE_SIZE;
-
-	barrier.srcAccessMask = 0;
-	barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-	vkCmdPipelineBarrier( mailCmdBuffer,
-						  VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-						  VK_PIPELINE_STAGE_TRANSFER_BIT,
-						  0,
-						  0,
-						  nullptr,
-						  1,
-						  &barrier,
-						  0,
-						  nullptr );
-
-	vkCmdFillBuffer( mailCmdBuffer, m_handle, 0, VK_WHOLE_SIZE, data );
-
-	barrier.srcAccessMask = barrier.dstAccessMask;
-	barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
-	vkCmdPipelineBarrier( mailCmdBuffer,
-						  VK_PIPELINE_STAGE_TRANSFER_BIT,
-						  VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, // TODO: improve based on m_usage
-						  0,
-						  0,
-						  nullptr,
-						  1,
-						  &barrier,
-						  0,
-						  nullptr );
+	g_gpuMail.QueueFill( m_handle, m_usage, data );
 }
 
-void Buffer::UploadStaticData( VkDeviceSize size, const void *data )
+void Buffer::UploadStaticData( VkDeviceSize size, const void *data, VkDeviceSize writeOffset /*= 0 */ )
 {
-	VkBuffer		mailBuffer;
-	VkDeviceSize	mailOffset;
-	VkCommandBuffer mailCmdBuffer;
-	g_gpuMail.Submit( size, 1, data, mailBuffer, mailOffset, mailCmdBuffer );
-
-	VkBufferMemoryBarrier barrier {};
-	barrier.sType				= VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
-	barrier.pNext				= nullptr;
-	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-	barrier.buffer				= m_handle;
-	barrier.offset				= 0;
-	barrier.size				= size;
-
-	barrier.srcAccessMask = 0;
-	barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-	vkCmdPipelineBarrier( mailCmdBuffer,
-						  VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
-						  VK_PIPELINE_STAGE_TRANSFER_BIT,
-						  0,
-						  0,
-						  nullptr,
-						  1,
-						  &barrier,
-						  0,
-						  nullptr );
-
-	VkBufferCopy region {};
-	region.srcOffset = mailOffset;
-	region.dstOffset = 0;
-	region.size		 = size;
-	vkCmdCopyBuffer( mailCmdBuffer, mailBuffer, m_handle, 1, &region );
-
-	barrier.srcAccessMask = barrier.dstAccessMask;
-	barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
-	vkCmdPipelineBarrier( mailCmdBuffer,
-						  VK_PIPELINE_STAGE_TRANSFER_BIT,
-						  VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, // TODO: improve based on m_usage
-						  0,
-						  0,
-						  nullptr,
-						  1,
-						  &barrier,
-						  0,
-						  nullptr );
+	CHECK_PRED( ( size + writeOffset ) <= GetAllocSize() );
+
+	if ( size > g_gpuMail.GetRingSize() )
+	{
+		CHECK_PRED( writeOffset == 0 );
+
+		m_upload = g_gpuMail.StreamBuffer( m_handle,
+										   size,
+										   data,
+										   SDM_COPY,
+										   BufferFlagsToStageFlags( m_usage ),
+										   BufferFlagsToAccessFlags( m_usage ) );
+		return;
+	}
+
+	g_gpuMail.QueueCopy( m_handle, m_usage, writeOffset, size, data );
 }
 
 } // namespace render
@@ -5,6 +5,7 @@
 #include "VkAllocator.h"
 #include "external/vulkan/vulkan.hpp"
 #include "platform/defines.h"
+#include "renderer/GPUMailManager.h"
 
 namespace vkRuna
 {
@@ -12,20 +13,27 @@ namespace render
 {
 enum bufferProps_t
 {
-	BP_STATIC, // Will not be updated after initialisation
-	BP_DYNAMIC // Will be updated
+	BP_STATIC,		 // Will not be updated after initialisation
+	BP_DYNAMIC,		 // Will be updated
+	BP_PER_FRAME,	 // Will be updated every frame, each frame in flight reads and writes its own slice
+	BP_GPU_PER_FRAME // Same as BP_PER_FRAME in device local memory, only written by GPU commands
 };
 
-VkAccessFlags BufferFlagsToAccessFlags( VkBufferUsageFlags usageFlags );
+VkAccessFlags		 BufferFlagsToAccessFlags( VkBufferUsageFlags usageFlags );
+VkPipelineStageFlags BufferFlagsToStageFlags( VkBufferUsageFlags usageFlags ); // Never 0
 
 class Buffer
 {
 	NO_COPY_NO_ASSIGN( Buffer );
 
+	friend class BufferDefragmenter;
+	friend class BufferPool;
+
    public:
 	Buffer() = default;
 	~Buffer();
 
+	// Static data larger than the GPU mail ring is streamed, the buffer must not be used before IsUploadComplete
 	void Alloc( VkBufferUsageFlags usage, bufferProps_t memProp, VkDeviceSize size, const void *data = nullptr );
 	void Free();
 
@@ -34,18 +42,28 @@ class Buffer
 
 	VkBuffer	 GetHandle() const { return m_handle; };
 	VkDeviceSize GetAllocSize() const { return m_alloc.size; }
-	void *		 GetPointer() { return m_alloc.data; }
+	void *		 GetPointer(); // BP_PER_FRAME: slice of the current frame
+	bool		 IsUploadComplete() const { return g_gpuMail.IsUploadComplete( m_upload ); }
+
+	// Range that descriptors used by frameIndex must point at
+	VkDeviceSize GetFrameOffset( uint32_t frameIndex ) const;
+	VkDeviceSize GetFrameRange() const;
 
    private:
-	void UploadStaticData( VkDeviceSize size, const void *data );
+	void UploadStaticData( VkDeviceSize size, const void *data, VkDeviceSize writeOffset = 0 );
+	bool IsPerFrame() const { return m_prop == BP_PER_FRAME || m_prop == BP_GPU_PER_FRAME; }
 
    private:
-	// VkDeviceSize       m_size  = 0;
+	VkDeviceSize	   m_size  = 0;
 	VkBufferUsageFlags m_usage = 0;
 	bufferProps_t	   m_prop  = BP_STATIC;
 
 	VkBuffer		   m_handle = VK_NULL_HANDLE;
 	vulkanAllocation_t m_alloc;
+
+	VkDeviceSize m_sliceSize = 0; // BP_PER_FRAME and BP_GPU_PER_FRAME
+
+	uploadHandle_t m_upload = 0;
 };
 
 } // namespace render
@@ -0,0 +1,320 @@
+// Copyright (c) 2021 Arno Galvez
+
+#include "renderer/BufferPool.h"
+
+#include "renderer/Check.h"
+#include "renderer/VkBackend.h"
+#include "rnLib/Math.h"
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <string_view>
+
+namespace vkRuna
+{
+namespace render
+{
+BufferPool g_staticBufferPool;
+BufferPool g_perFrameBufferPool;
+
+BufferPool::BufferPool() {}
+
+BufferPool::~BufferPool()
+{
+	Shutdown();
+}
+
+void BufferPool::Init( VkBufferUsageFlags usage, bufferProps_t memProp, VkDeviceSize blockSize )
+{
+	CHECK_PRED( memProp == BP_STATIC || memProp == BP_PER_FRAME );
+
+	Shutdown();
+
+	const VkPhysicalDeviceLimits &limits = GetVulkanContext().gpu.properties.limits;
+
+	// Every range start is a valid descriptor offset, index offset and fill offset
+	m_alignment = std::max( limits.minStorageBufferOffsetAlignment, limits.minUniformBufferOffsetAlignment );
+	m_alignment = std::max< VkDeviceSize >( m_alignment, VULKAN_FILL_BUFFER_ALIGNMENT );
+
+	m_usage		= usage;
+	m_memProp	= memProp;
+	m_blockSize = Align( blockSize, m_alignment );
+}
+
+void BufferPool::Shutdown()
+{
+	// Views still held are dangling, Free ignores them
+	m_blocks.clear();
+	m_blockRanges.clear();
+	m_freeRanges.clear();
+	m_allocations.clear();
+	m_garbage.clear();
+	m_contentIndices.clear();
+	m_viewIndices.clear();
+}
+
+size_t BufferPool::GetBlockCount() const
+{
+	return m_blocks.size() - std::count( m_blocks.cbegin(), m_blocks.cend(), nullptr );
+}
+
+bufferView_t BufferPool::Alloc( VkDeviceSize size, const void *data )
+{
+	CHECK_PRED_MSG( size > 0 && size <= m_blockSize, "Buffer pools only serve buffers smaller than a block." );
+	CHECK_PRED( data != nullptr || m_memProp == BP_PER_FRAME );
+
+	size_t hash = 0;
+	if ( m_memProp == BP_STATIC )
+	{
+		hash = std::hash< std::string_view >()( std::string_view( static_cast< const char * >( data ), size ) );
+
+		const auto candidates = m_contentIndices.equal_range( hash );
+		for ( auto it = candidates.first; it != candidates.second; ++it )
+		{
+			allocation_t &allocation = m_allocations[ it->second ];
+			if ( allocation.size == size && std::memcmp( allocation.content.data(), data, size ) == 0 )
+			{
+				++allocation.refCount;
+				return MakeView( allocation );
+			}
+		}
+	}
+
+	allocation_t allocation;
+	allocation.range	= AllocRange( Align( size, m_alignment ) );
+	allocation.size		= size;
+	allocation.refCount = 1;
+
+	Buffer &block = *m_blocks[ allocation.range.block ];
+	if ( m_memProp == BP_STATIC )
+	{
+		allocation.hash = hash;
+		allocation.content.assign( static_cast< const byte * >( data ), static_cast< const byte * >( data ) + size );
+
+		block.UploadStaticData( size, data, allocation.range.offset );
+	}
+	else
+	{
+		for ( uint32_t i = 0; i < SWAPCHAIN_BUFFERING_LEVEL; ++i )
+		{
+			byte *slice = static_cast< byte * >( block.m_alloc.data ) + block.GetFrameOffset( i );
+			if ( data != nullptr )
+			{
+				std::memcpy( slice + allocation.range.offset, data, size );
+			}
+			else
+			{
+				std::memset( slice + allocation.range.offset, 0, size );
+			}
+		}
+	}
+
+	const uint32_t index = static_cast< uint32_t >( m_allocations.size() );
+	if ( m_memProp == BP_STATIC )
+	{
+		m_contentIndices.emplace( hash, index );
+	}
+	m_viewIndices.emplace( MakeKey( allocation.range ), index );
+
+	m_allocations.emplace_back( std::move( allocation ) );
+
+	return MakeView( m_allocations.back() );
+}
+
+void BufferPool::Free( bufferView_t &view )
+{
+	viewKey_t key;
+	key.buffer = view.buffer;
+	key.offset = view.offset;
+
+	view = bufferView_t();
+
+	auto pos = m_viewIndices.find( key );
+	if ( pos == m_viewIndices.end() )
+	{
+		return;
+	}
+
+	const uint32_t index	  = pos->second;
+	allocation_t & allocation = m_allocations[ index ];
+	if ( --allocation.refCount > 0 )
+	{
+		return;
+	}
+
+	garbage_t garbage;
+	garbage.range	= allocation.range;
+	garbage.frameId = m_frameId;
+	m_garbage.emplace_back( garbage );
+
+	RemoveAllocation( index );
+}
+
+void BufferPool::EmptyGarbage( uint64_t completedFrameCount )
+{
+	size_t kept = 0;
+	for ( garbage_t &garbage : m_garbage )
+	{
+		if ( garbage.frameId < completedFrameCount )
+		{
+			ReleaseRange( garbage.range );
+		}
+		else
+		{
+			m_garbage[ kept++ ] = garbage;
+		}
+	}
+
+	m_garbage.resize( kept );
+}
+
+BufferPool::range_t BufferPool::AllocRange( VkDeviceSize size )
+{
+	// First fit, allocations are small compared to blocks
+	auto freeRange = std::find_if(
+		m_freeRanges.begin(), m_freeRanges.end(), [ size ]( const range_t &range ) { return range.size >= size; } );
+	if ( freeRange == m_freeRanges.end() )
+	{
+		freeRange = AddBlock();
+	}
+
+	range_t range;
+	range.block	 = freeRange->block;
+	range.offset = freeRange->offset;
+	range.size	 = size;
+
+	freeRange->offset += size;
+	freeRange->size -= size;
+	if ( freeRange->size == 0 )
+	{
+		m_freeRanges.erase( freeRange );
+	}
+
+	++m_blockRanges[ range.block ];
+
+	return range;
+}
+
+std::vector< BufferPool::range_t >::iterator BufferPool::AddBlock()
+{
+	auto slot = std::find( m_blocks.begin(), m_blocks.end(), nullptr );
+	if ( slot == m_blocks.end() )
+	{
+		m_blockRanges.emplace_back( 0 );
+		slot = m_blocks.emplace( slot );
+	}
+
+	*slot = std::make_unique< Buffer >();
+	( *slot )->Alloc( m_usage, m_memProp, m_blockSize );
+
+	range_t freeRange;
+	freeRange.block	 = static_cast< uint32_t >( slot - m_blocks.begin() );
+	freeRange.offset = 0;
+	freeRange.size	 = m_blockSize;
+
+	return m_freeRanges.insert(
+		std::lower_bound( m_freeRanges.begin(), m_freeRanges.end(), freeRange, RangeLess ), freeRange );
+}
+
+void BufferPool::ReleaseRange( const range_t &range )
+{
+	auto pos = std::lower_bound( m_freeRanges.begin(), m_freeRanges.end(), range, RangeLess );
+	pos		 = m_freeRanges.insert( pos, range );
+
+	auto next = pos + 1;
+	if ( next != m_freeRanges.end() && next->block == pos->block && pos->offset + pos->size == next->offset )
+	{
+		pos->size += next->size;
+		m_freeRanges.erase( next );
+	}
+
+	if ( pos != m_freeRanges.begin() )
+	{
+		auto prev = pos - 1;
+		if ( prev->block == pos->block && prev->offset + prev->size == pos->offset )
+		{
+			prev->size += pos->size;
+			m_freeRanges.erase( pos );
+			pos = prev;
+		}
+	}
+
+	// The merged free range now covers the whole block
+	if ( --m_blockRanges[ range.block ] == 0 )
+	{
+		CHECK_PRED( pos->offset == 0 && pos->size == m_blockSize );
+
+		m_freeRanges.erase( pos );
+		m_blocks[ range.block ].reset();
+	}
+}
+
+bufferView_t BufferPool::MakeView( const allocation_t &allocation ) const
+{
+	bufferView_t view;
+	view.buffer = m_blocks[ allocation.range.block ].get();
+	view.offset = allocation.range.offset;
+	view.range	= allocation.size;
+
+	return view;
+}
+
+BufferPool::viewKey_t BufferPool::MakeKey( const range_t &range ) const
+{
+	viewKey_t key;
+	key.buffer = m_blocks[ range.block ].get();
+	key.offset = range.offset;
+
+	return key;
+}
+
+void BufferPool::RemoveAllocation( uint32_t index )
+{
+	const auto findContentIndex = [ this ]( size_t hash, uint32_t allocationIndex ) {
+		const auto candidates = m_contentIndices.equal_range( hash );
+		const auto isIndex	  = [ allocationIndex ]( const auto &entry ) { return entry.second == allocationIndex; };
+		const auto it		  = std::find_if( candidates.first, candidates.second, isIndex );
+		CHECK_PRED( it != candidates.second );
+
+		return it;
+	};
+
+	allocation_t &allocation = m_allocations[ index ];
+
+	m_viewIndices.erase( MakeKey( allocation.range ) );
+	if ( m_memProp == BP_STATIC )
+	{
+		m_contentIndices.erase( findContentIndex( allocation.hash, index ) );
+	}
+
+	// The last allocation takes the free slot
+	const uint32_t lastIndex = static_cast< uint32_t >( m_allocations.size() - 1 );
+	if ( index != lastIndex )
+	{
+		allocation_t &last = m_allocations[ lastIndex ];
+
+		m_viewIndices[ MakeKey( last.range ) ] = index;
+		if ( m_memProp == BP_STATIC )
+		{
+			findContentIndex( last.hash, lastIndex )->second = index;
+		}
+
+		allocation = std::move( last );
+	}
+
+	m_allocations.pop_back();
+}
+
+size_t BufferPool::viewKeyHash_t::operator()( const viewKey_t &key ) const
+{
+	return std::hash< const Buffer * >()( key.buffer ) ^ std::hash< VkDeviceSize >()( key.offset ) * 31;
+}
+
+bool BufferPool::RangeLess( const range_t &a, const range_t &b )
+{
+	return a.block < b.block || ( a.block == b.block && a.offset < b.offset );
+}
+
+} // namespace render
+} // namespace vkRuna
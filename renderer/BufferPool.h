@@ -0,0 +1,127 @@
+// Copyright (c) 2021 Arno Galvez
+
+#pragma once
+
+#include "external/vulkan/vulkan.hpp"
+#include "platform/defines.h"
+#include "renderer/Buffer.h"
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace vkRuna
+{
+namespace render
+{
+// Range of a buffer, usable in descriptors and draws. Views of BP_PER_FRAME buffers have one range per frame slice.
+struct bufferView_t
+{
+	Buffer *	 buffer = nullptr;
+	VkDeviceSize offset = 0;
+	VkDeviceSize range	= VK_WHOLE_SIZE;
+
+	bool IsValid() const { return buffer != nullptr; }
+
+	VkDeviceSize GetOffset( uint32_t frameIndex ) const { return buffer->GetFrameOffset( frameIndex ) + offset; }
+	VkDeviceSize GetRange() const { return range == VK_WHOLE_SIZE ? buffer->GetFrameRange() : range; }
+	void *		 GetPointer() const { return static_cast< byte * >( buffer->GetPointer() ) + offset; }
+};
+
+// Sub-allocates small buffers from large blocks, so that they share one VkBuffer and one memory binding per block.
+// BP_STATIC content is deduplicated: allocating bytes that are already in the pool returns the same range, ranges are
+// reference counted. Freed ranges are reused once the frames that may read them have completed, a block is released
+// along with its last range.
+// Blocks are regular Buffers: the defragmenter may relocate BP_STATIC blocks.
+class BufferPool
+{
+	NO_COPY_NO_ASSIGN( BufferPool )
+
+   public:
+	BufferPool();
+	~BufferPool();
+
+	void Init( VkBufferUsageFlags usage, bufferProps_t memProp, VkDeviceSize blockSize );
+	void Shutdown();
+
+	// data may only be nullptr for BP_PER_FRAME pools, the range is then zeroed in every slice
+	bufferView_t Alloc( VkDeviceSize size, const void *data );
+	void		 Free( bufferView_t &view );
+
+	// frameId is the frame being recorded, completedFrameCount the number of frames whose fence has signaled
+	void BeginFrame( uint64_t frameId ) { m_frameId = frameId; }
+	void EmptyGarbage( uint64_t completedFrameCount );
+
+	size_t GetBlockCount() const;
+	size_t GetAllocationCount() const { return m_allocations.size(); }
+
+   private:
+	struct range_t
+	{
+		uint32_t	 block	= 0;
+		VkDeviceSize offset = 0;
+		VkDeviceSize size	= 0; // Aligned
+	};
+
+	struct allocation_t
+	{
+		range_t		 range;
+		VkDeviceSize size	  = 0;
+		uint32_t	 refCount = 0;
+
+		size_t				hash = 0; // BP_STATIC
+		std::vector< byte > content;
+	};
+
+	struct garbage_t
+	{
+		range_t	 range;
+		uint64_t frameId = 0;
+	};
+
+	struct viewKey_t
+	{
+		const Buffer *buffer = nullptr;
+		VkDeviceSize  offset = 0;
+
+		bool operator==( const viewKey_t &other ) const { return buffer == other.buffer && offset == other.offset; }
+	};
+
+	struct viewKeyHash_t
+	{
+		size_t operator()( const viewKey_t &key ) const;
+	};
+
+	static bool RangeLess( const range_t &a, const range_t &b ); // By block then offset
+
+	range_t							 AllocRange( VkDeviceSize size );
+	std::vector< range_t >::iterator AddBlock(); // Returns the free range covering the new block
+	void							 ReleaseRange( const range_t &range );
+	bufferView_t					 MakeView( const allocation_t &allocation ) const;
+	viewKey_t						 MakeKey( const range_t &range ) const;
+	void							 RemoveAllocation( uint32_t index ); // Unreferenced, its range is garbage
+
+   private:
+	VkBufferUsageFlags m_usage	   = 0;
+	bufferProps_t	   m_memProp   = BP_STATIC;
+	VkDeviceSize	   m_blockSize = 0;
+	VkDeviceSize	   m_alignment = 1;
+
+	std::vector< std::unique_ptr< Buffer > > m_blocks;		// Released blocks leave a null slot, reused first
+	std::vector< uint32_t >					 m_blockRanges; // Allocated and garbage ranges per block
+	std::vector< range_t >					 m_freeRanges;	// Sorted by block then offset, adjacent ranges are merged
+	std::vector< allocation_t >				 m_allocations;
+	std::vector< garbage_t >				 m_garbage;
+
+	// Indices in m_allocations, by content hash for BP_STATIC deduplication and by view for Free
+	std::unordered_multimap< size_t, uint32_t >				m_contentIndices;
+	std::unordered_map< viewKey_t, uint32_t, viewKeyHash_t > m_viewIndices;
+
+	uint64_t m_frameId = 0;
+};
+
+extern BufferPool g_staticBufferPool;	// Index, vertex, storage and uniform data written once
+extern BufferPool g_perFrameBufferPool; // Storage and uniform data written by the CPU every frame
+
+} // namespace render
+} // namespace vkRuna
@@ -0,0 +1,246 @@
+// Copyright (c) 2021 Arno Galvez
+
+#include "renderer/Defragmenter.h"
+
+#include "platform/Sys.h"
+#include "renderer/Buffer.h"
+#include "renderer/Check.h"
+#include "renderer/GPUMailManager.h"
+#include "renderer/RenderConfig.h"
+#include "renderer/VkBackend.h"
+
+#include <algorithm>
+#include <array>
+#include <utility>
+
+namespace vkRuna
+{
+namespace render
+{
+BufferDefragmenter g_bufferDefragmenter;
+
+BufferDefragmenter::BufferDefragmenter() {}
+
+BufferDefragmenter::~BufferDefragmenter()
+{
+	Shutdown();
+}
+
+void BufferDefragmenter::Shutdown()
+{
+	m_buffers.clear();
+	m_callbacks.clear();
+}
+
+void BufferDefragmenter::Register( Buffer *buffer )
+{
+	m_buffers.emplace_back( buffer );
+}
+
+void BufferDefragmenter::Unregister( Buffer *buffer )
+{
+	auto pos = std::find( m_buffers.begin(), m_buffers.end(), buffer );
+	if ( pos != m_buffers.end() )
+	{
+		*pos = m_buffers.back();
+		m_buffers.pop_back();
+	}
+}
+
+void BufferDefragmenter::AddRelocationCallback( const bufferRelocationCallback_t &callback )
+{
+	m_callbacks.emplace_back( callback );
+}
+
+void BufferDefragmenter::Update( double budgetMs, VkDeviceSize budgetBytes )
+{
+	VulkanBlock *block = FindSourceBlock();
+	if ( block == nullptr )
+	{
+		return;
+	}
+
+	const int64_t startTicks  = sys::GetClockTicks();
+	const int64_t budgetTicks = static_cast< int64_t >( budgetMs * 1e-3 * double( sys::ClockTicksFrequency() ) );
+
+	VkCommandBuffer cmdBuffer  = VK_NULL_HANDLE;
+	VkDeviceSize	movedBytes = 0;
+
+	// Relocation callbacks may allocate or free buffers, iterate on a copy
+	const std::vector< Buffer * > buffers = m_buffers;
+	for ( Buffer *buffer : buffers )
+	{
+		if ( buffer->m_alloc.block != block )
+		{
+			continue;
+		}
+
+		if ( movedBytes > 0 && ( movedBytes + buffer->m_size > budgetBytes ||
+								 sys::GetClockTicks() - startTicks > budgetTicks ) )
+		{
+			break;
+		}
+
+		if ( cmdBuffer == VK_NULL_HANDLE )
+		{
+			cmdBuffer = g_gpuMail.GetCmdBuffer();
+		}
+
+		if ( !Relocate( *buffer, cmdBuffer ) )
+		{
+			// Other blocks are too fragmented for this buffer, try again next frame
+			break;
+		}
+
+		movedBytes += buffer->m_size;
+	}
+}
+
+VulkanBlock *BufferDefragmenter::FindSourceBlock() const
+{
+	// Only blocks whose allocations all belong to registered buffers can be drained. Chunks of a streamed upload
+	// still target the current handle, such buffers do not move.
+	std::vector< std::pair< VulkanBlock *, uint32_t > > relocatableCounts;
+	for ( const Buffer *buffer : m_buffers )
+	{
+		if ( !buffer->IsUploadComplete() )
+		{
+			continue;
+		}
+
+		VulkanBlock *block = buffer->m_alloc.block;
+
+		auto pos = std::find_if( relocatableCounts.begin(), relocatableCounts.end(), [ & ]( const auto &entry ) {
+			return entry.first == block;
+		} );
+		if ( pos == relocatableCounts.end() )
+		{
+			relocatableCounts.emplace_back( block, 1 );
+		}
+		else
+		{
+			++pos->second;
+		}
+	}
+
+	VulkanBlock *bestBlock = nullptr;
+	double		 bestUsage = DEFRAG_MAX_BLOCK_USAGE;
+	for ( const auto &entry : relocatableCounts )
+	{
+		VulkanBlock *block = entry.first;
+		// Allocations freed by a previous Update are on their way out too
+		const uint32_t pendingCount = g_vulkanAllocator.GetGarbageCount( block );
+		if ( block->GetUsage() != VULKAN_MEMORY_USAGE_GPU_ONLY ||
+			 block->GetAllocationCount() != entry.second + pendingCount )
+		{
+			continue;
+		}
+
+		double usage = double( block->GetAllocatedSize() ) / double( block->GetSize() );
+		if ( usage < bestUsage && g_vulkanAllocator.CanEvacuate( block ) )
+		{
+			bestBlock = block;
+			bestUsage = usage;
+		}
+	}
+
+	return bestBlock;
+}
+
+bool BufferDefragmenter::Relocate( Buffer &buffer, VkCommandBuffer cmdBuffer )
+{
+	auto &device = GetVulkanContext().device;
+
+	VkBufferCreateInfo bufferCI {};
+	bufferCI.sType				   = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferCI.pNext				   = nullptr;
+	bufferCI.flags				   = 0;
+	bufferCI.size				   = buffer.m_size;
+	bufferCI.usage				   = buffer.m_usage;
+	bufferCI.sharingMode		   = VK_SHARING_MODE_EXCLUSIVE;
+	bufferCI.queueFamilyIndexCount = 0;
+	bufferCI.pQueueFamilyIndices   = nullptr;
+
+	VkBuffer handle = VK_NULL_HANDLE;
+	VK_CHECK( vkCreateBuffer( device, &bufferCI, nullptr, &handle ) );
+
+	VkMemoryRequirements memRequirements;
+	vkGetBufferMemoryRequirements( device, handle, &memRequirements );
+
+	vulkanAllocation_t alloc;
+	if ( !g_vulkanAllocator.AllocOutsideBlock( VULKAN_ALLOCATION_TYPE_BUFFER,
+											   VULKAN_MEMORY_USAGE_GPU_ONLY,
+											   memRequirements,
+											   buffer.m_alloc.block,
+											   alloc ) )
+	{
+		vkDestroyBuffer( device, handle, nullptr );
+		return false;
+	}
+
+	VK_CHECK( vkBindBufferMemory( device, handle, alloc.deviceMemory, alloc.offset ) );
+
+	std::array< VkBufferMemoryBarrier, 2 > barriers {};
+	for ( VkBufferMemoryBarrier &barrier : barriers )
+	{
+		barrier.sType				= VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		barrier.pNext				= nullptr;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.offset				= 0;
+		barrier.size				= VK_WHOLE_SIZE;
+	}
+
+	barriers[ 0 ].buffer		= buffer.m_handle;
+	barriers[ 0 ].srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+	barriers[ 0 ].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	barriers[ 1 ].buffer		= handle;
+	barriers[ 1 ].srcAccessMask = 0;
+	barriers[ 1 ].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	vkCmdPipelineBarrier( cmdBuffer,
+						  VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+						  VK_PIPELINE_STAGE_TRANSFER_BIT,
+						  0,
+						  0,
+						  nullptr,
+						  static_cast< uint32_t >( barriers.size() ),
+						  barriers.data(),
+						  0,
+						  nullptr );
+
+	VkBufferCopy region {};
+	region.srcOffset = 0;
+	region.dstOffset = 0;
+	region.size		 = buffer.m_size;
+	vkCmdCopyBuffer( cmdBuffer, buffer.m_handle, handle, 1, &region );
+
+	barriers[ 1 ].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barriers[ 1 ].dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+	vkCmdPipelineBarrier( cmdBuffer,
+						  VK_PIPELINE_STAGE_TRANSFER_BIT,
+						  VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+						  0,
+						  0,
+						  nullptr,
+						  1,
+						  &barriers[ 1 ],
+						  0,
+						  nullptr );
+
+	// The copy and frames still in flight read the old buffer, the allocator defers its destruction. The descriptor
+	// sets of their slots keep pointing to it until the slots are recycled, they are not bound meanwhile.
+	g_vulkanAllocator.FreeBuffer( buffer.m_handle, buffer.m_alloc );
+
+	buffer.m_handle = handle;
+	buffer.m_alloc	= alloc;
+
+	for ( const bufferRelocationCallback_t &callback : m_callbacks )
+	{
+		callback( buffer );
+	}
+
+	return true;
+}
+
+} // namespace render
+} // namespace vkRuna
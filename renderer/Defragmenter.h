@@ -0,0 +1,58 @@
+// Copyright (c) 2021 Arno Galvez
+
+#pragma once
+
+#include "external/vulkan/vulkan.hpp"
+#include "platform/defines.h"
+#include "renderer/VkAllocator.h"
+
+#include <functional>
+#include <vector>
+
+namespace vkRuna
+{
+namespace render
+{
+class Buffer;
+
+using bufferRelocationCallback_t = std::function< void( const Buffer &buffer ) >;
+
+// Incrementally moves static buffers out of sparsely used memory blocks, so that VulkanAllocator can release them.
+// Contents are copied on the GPU mail command buffer: Update must be called before GPUMailManager::Flush, so that
+// the copies are submitted ahead of the frame that uses the new handles.
+// A relocated buffer gets a new VkBuffer: code caching the handle (descriptor sets, barriers) must register a
+// relocation callback and patch it.
+class BufferDefragmenter
+{
+	NO_COPY_NO_ASSIGN( BufferDefragmenter )
+
+   public:
+	BufferDefragmenter();
+	~BufferDefragmenter();
+
+	void Shutdown();
+
+	void Register( Buffer *buffer );
+	void Unregister( Buffer *buffer );
+
+	// Callbacks update the descriptors of the moved buffer, with PipelineManager::UpdateBuffers which leaves the
+	// descriptor sets of the frames in flight untouched
+	void AddRelocationCallback( const bufferRelocationCallback_t &callback );
+
+	// Moves buffers until budgetMs or budgetBytes is spent, at least one buffer is moved if a block can be drained.
+	// Called before the frame records any command, its descriptor sets can be written.
+	void Update( double budgetMs, VkDeviceSize budgetBytes );
+
+   private:
+	VulkanBlock *FindSourceBlock() const;
+	bool		 Relocate( Buffer &buffer, VkCommandBuffer cmdBuffer );
+
+   private:
+	std::vector< Buffer * >					  m_buffers;
+	std::vector< bufferRelocationCallback_t > m_callbacks;
+};
+
+extern BufferDefragmenter g_bufferDefragmenter;
+
+} // namespace render
+} // namespace vkRuna
@@ -3,11 +3,13 @@
 #include "GPUMailManager.h"
 
 #include "platform/Sys.h"
+#include "renderer/Buffer.h"
 #include "renderer/Check.h"
 #include "renderer/VkAllocator.h"
 #include "renderer/VkBackend.h"
 #include "rnLib/Math.h"
 
+#include <algorithm>
 #include <cstring>
 
 namespace vkRuna
@@ -16,11 +18,54 @@ namespace render
 {
 GPUMailManager g_gpuMail;
 
+static void BeginMailCmdBuffer( VkCommandBuffer cmdBuffer )
+{
+	VkCommandBufferBeginInfo cmdBufferBeginInfo {};
+	cmdBufferBeginInfo.sType			= VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	cmdBufferBeginInfo.pNext			= nullptr;
+	cmdBufferBeginInfo.flags			= VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	cmdBufferBeginInfo.pInheritanceInfo = nullptr;
+	VK_CHECK( vkBeginCommandBuffer( cmdBuffer, &cmdBufferBeginInfo ) );
+}
+
+template< typename T >
+static VkBufferMemoryBarrier
+PendingWriteBarrier( const T &pendingWrite, VkAccessFlags srcAccessMask, VkAccessFlags dstAccessMask )
+{
+	VkBufferMemoryBarrier barrier {};
+	barrier.sType				= VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	barrier.pNext				= nullptr;
+	barrier.srcAccessMask		= srcAccessMask;
+	barrier.dstAccessMask		= dstAccessMask;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.buffer				= pendingWrite.buffer;
+	barrier.offset				= pendingWrite.dstOffset;
+	barrier.size				= pendingWrite.size;
+
+	return barrier;
+}
+
+// Fills cover the whole buffer, their size is VK_WHOLE_SIZE and their offset 0
+template< typename T >
+static bool HasPendingWrite( const T &pendingWrites, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size )
+{
+	return std::any_of( pendingWrites.begin(), pendingWrites.end(), [ & ]( const auto &pendingWrite ) {
+		return pendingWrite.buffer == buffer && offset < pendingWrite.dstOffset + pendingWrite.size &&
+			   pendingWrite.dstOffset < offset + size;
+	} );
+}
+
 GPUMailManager::GPUMailManager() {}
 
-void GPUMailManager::Init()
+void GPUMailManager::Init( VkDeviceSize ringSize )
 {
-	const VkDeviceSize bufferSize = 2 * 4 * 1920 * 1080;
+	auto &vkContext = GetVulkanContext();
+
+	m_transferQueue	   = vkContext.transferQueue;
+	m_graphicsQueue	   = vkContext.graphicsQueue;
+	m_transferFamilyId = vkContext.transferFamilyId;
+	m_graphicsFamilyId = vkContext.graphicsFamilyId;
 
 	VkBufferCreateInfo bufferCI {};
 	bufferCI.sType				   = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -30,17 +75,12 @@ void GPUMailManager::Init()
 	bufferCI.sharingMode		   = VK_SHARING_MODE_EXCLUSIVE;
 	bufferCI.queueFamilyIndexCount = 0;
 	bufferCI.pQueueFamilyIndices   = nullptr;
-	bufferCI.size				   = bufferSize;
+	bufferCI.size				   = ringSize;
 
-	auto &vkContext = GetVulkanContext();
-	for ( auto &mail : m_mails )
-	{
-		VK_CHECK( vkCreateBuffer( vkContext.device, &bufferCI, nullptr, &mail.buffer ) );
-		mail.occupiedSize = 0;
-	}
+	VK_CHECK( vkCreateBuffer( vkContext.device, &bufferCI, nullptr, &m_ringBuffer ) );
 
 	VkMemoryRequirements memRequirements;
-	vkGetBufferMemoryRequirements( vkContext.device, m_mails[ 0 ].buffer, &memRequirements );
+	vkGetBufferMemoryRequirements( vkContext.device, m_ringBuffer, &memRequirements );
 
 	VkMemoryPropertyFlags requiredProps, preferredProps;
 	UsageToMemPropsFlags( VULKAN_MEMORY_USAGE_CPU_TO_GPU, requiredProps, preferredProps );
@@ -51,59 +91,76 @@ void GPUMailManager::Init()
 	}
 	CHECK_PRED( memTypeIndex != -1 );
 
-	m_bufferSize = Align( memRequirements.size, memRequirements.alignment );
+	m_ringSize = ringSize;
+	m_ringHead = 0;
+	m_ringTail = 0;
 
 	VkMemoryAllocateInfo allocateInfo {};
 	allocateInfo.sType			 = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
 	allocateInfo.pNext			 = nullptr;
 	allocateInfo.memoryTypeIndex = memTypeIndex;
-	allocateInfo.allocationSize	 = GPU_MAIL_BUFFERING_LEVEL * m_bufferSize;
+	allocateInfo.allocationSize	 = memRequirements.size;
 	VK_CHECK( vkAllocateMemory( vkContext.device, &allocateInfo, nullptr, &m_memory ) );
 
-	for ( size_t i = 0; i < m_mails.size(); ++i )
-	{
-		VK_CHECK( vkBindBufferMemory( vkContext.device, m_mails[ i ].buffer, m_memory, i * m_bufferSize ) );
-	}
+	VK_CHECK( vkBindBufferMemory( vkContext.device, m_ringBuffer, m_memory, 0 ) );
 
 	VK_CHECK( vkMapMemory( vkContext.device,
 						   m_memory,
 						   0,
-						   GPU_MAIL_BUFFERING_LEVEL * m_bufferSize,
+						   VK_WHOLE_SIZE,
 						   0,
 						   reinterpret_cast< void ** >( &m_mappedData ) ) );
 
+	VkSemaphoreTypeCreateInfo semaphoreTypeCI {};
+	semaphoreTypeCI.sType		  = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+	semaphoreTypeCI.pNext		  = nullptr;
+	semaphoreTypeCI.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+	semaphoreTypeCI.initialValue  = 0;
+
+	VkSemaphoreCreateInfo semaphoreCI {};
+	semaphoreCI.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	semaphoreCI.pNext = &semaphoreTypeCI;
+	semaphoreCI.flags = 0;
+	VK_CHECK( vkCreateSemaphore( vkContext.device, &semaphoreCI, nullptr, &m_timeline ) );
+
+	m_timelineValue = 0;
+
 	VkCommandPoolCreateInfo commandPoolCI {};
 	commandPoolCI.sType			   = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
 	commandPoolCI.pNext			   = nullptr;
-	commandPoolCI.flags			   = 0;
-	commandPoolCI.queueFamilyIndex = vkContext.graphicsFamilyId;
-	VK_CHECK( vkCreateCommandPool( vkContext.device, &commandPoolCI, nullptr, &m_commandPool ) );
+	commandPoolCI.flags			   = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+	commandPoolCI.queueFamilyIndex = m_transferFamilyId;
+	VK_CHECK( vkCreateCommandPool( vkContext.device, &commandPoolCI, nullptr, &m_transferCommandPool ) );
+
+	commandPoolCI.queueFamilyIndex = m_graphicsFamilyId;
+	VK_CHECK( vkCreateCommandPool( vkContext.device, &commandPoolCI, nullptr, &m_graphicsCommandPool ) );
 
 	VkCommandBufferAllocateInfo cmdBufferAllocateInfo {};
 	cmdBufferAllocateInfo.sType				 = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
 	cmdBufferAllocateInfo.pNext				 = nullptr;
-	cmdBufferAllocateInfo.commandPool		 = m_commandPool;
 	cmdBufferAllocateInfo.level				 = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
 	cmdBufferAllocateInfo.commandBufferCount = 1;
 
-	VkFenceCreateInfo fenceCI {};
-	fenceCI.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-	fenceCI.pNext = nullptr;
-	fenceCI.flags = 0;
+	for ( auto &mail : m_mails )
+	{
+		cmdBufferAllocateInfo.commandPool = m_transferCommandPool;
+		VK_CHECK( vkAllocateCommandBuffers( vkContext.device, &cmdBufferAllocateInfo, &mail.transferCmdBuffer ) );
 
-	VkCommandBufferBeginInfo cmdBufferBeginInfo {};
-	cmdBufferBeginInfo.sType			= VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-	cmdBufferBeginInfo.pNext			= nullptr;
-	cmdBufferBeginInfo.flags			= VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-	cmdBufferBeginInfo.pInheritanceInfo = nullptr;
+		cmdBufferAllocateInfo.commandPool = m_graphicsCommandPool;
+		VK_CHECK( vkAllocateCommandBuffers( vkContext.device, &cmdBufferAllocateInfo, &mail.acquireCmdBuffer ) );
+		VK_CHECK( vkAllocateCommandBuffers( vkContext.device, &cmdBufferAllocateInfo, &mail.cmdBuffer ) );
 
-	for ( size_t i = 0; i < m_mails.size(); ++i )
-	{
-		m_mails[ i ].data = m_mappedData + i * m_bufferSize;
-		VK_CHECK( vkAllocateCommandBuffers( vkContext.device, &cmdBufferAllocateInfo, &m_mails[ i ].cmdBuffer ) );
-		VK_CHECK( vkCreateFence( vkContext.device, &fenceCI, nullptr, &m_mails[ i ].fence ) );
-		VK_CHECK( vkBeginCommandBuffer( m_mails[ i ].cmdBuffer, &cmdBufferBeginInfo ) );
+		BeginMailCmdBuffer( mail.transferCmdBuffer );
+		BeginMailCmdBuffer( mail.acquireCmdBuffer );
+		BeginMailCmdBuffer( mail.cmdBuffer );
+
+		mail.timelineValue = 0;
+		mail.ringEnd	   = 0;
+		mail.recorded	   = false;
+		mail.submitted	   = false;
 	}
+
+	m_currentMail = 0;
 }
 
 void GPUMailManager::Shutdown()
@@ -112,15 +169,38 @@ void GPUMailManager::Shutdown()
 
 	for ( auto &mail : m_mails )
 	{
-		vkFreeCommandBuffers( device, m_commandPool, 1, &mail.cmdBuffer );
-		vkDestroyFence( device, mail.fence, nullptr );
-		vkDestroyBuffer( device, mail.buffer, nullptr );
+		if ( mail.transferCmdBuffer != VK_NULL_HANDLE )
+		{
+			vkFreeCommandBuffers( device, m_transferCommandPool, 1, &mail.transferCmdBuffer );
+			vkFreeCommandBuffers( device, m_graphicsCommandPool, 1, &mail.acquireCmdBuffer );
+			vkFreeCommandBuffers( device, m_graphicsCommandPool, 1, &mail.cmdBuffer );
+		}
+
+		mail = GPUMail_t();
+	}
+
+	if ( m_transferCommandPool != VK_NULL_HANDLE )
+	{
+		vkDestroyCommandPool( device, m_transferCommandPool, nullptr );
+		m_transferCommandPool = VK_NULL_HANDLE;
 	}
 
-	if ( m_commandPool != VK_NULL_HANDLE )
+	if ( m_graphicsCommandPool != VK_NULL_HANDLE )
 	{
-		vkDestroyCommandPool( device, m_commandPool, nullptr );
-		m_commandPool = VK_NULL_HANDLE;
+		vkDestroyCommandPool( device, m_graphicsCommandPool, nullptr );
+		m_graphicsCommandPool = VK_NULL_HANDLE;
+	}
+
+	if ( m_timeline != VK_NULL_HANDLE )
+	{
+		vkDestroySemaphore( device, m_timeline, nullptr );
+		m_timeline = VK_NULL_HANDLE;
+	}
+
+	if ( m_ringBuffer != VK_NULL_HANDLE )
+	{
+		vkDestroyBuffer( device, m_ringBuffer, nullptr );
+		m_ringBuffer = VK_NULL_HANDLE;
 	}
 
 	if ( m_memory != VK_NULL_HANDLE )
@@ -130,7 +210,21 @@ void GPUMailManager::Shutdown()
 		m_memory = VK_NULL_HANDLE;
 	}
 
-	std::memset( this, 0, sizeof( *this ) ); // risky ?
+	m_mappedData	= nullptr;
+	m_ringSize		= 0;
+	m_ringHead		= 0;
+	m_ringTail		= 0;
+	m_timelineValue = 0;
+	m_currentMail	= 0;
+
+	m_acquireBufferBarriers.clear();
+	m_acquireImageBarriers.clear();
+	m_acquireStageMask = 0;
+
+	m_pendingCopies.clear();
+	m_pendingFills.clear();
+
+	m_streams.clear();
 }
 
 void GPUMailManager::Submit( VkDeviceSize	  size,
@@ -140,118 +234,833 @@ void GPUMailManager::Submit( VkDeviceSize	  size,
 							 VkDeviceSize &	  offset,
 							 VkCommandBuffer &cmdBuffer )
 {
-	CHECK_PRED( size <= m_bufferSize );
+	CHECK_PRED( size <= m_ringSize );
+
+	offset = AllocStaging( size, alignment );
 
-	GPUMail_t *gpuMail = &m_mails[ m_currentMail ];
+	std::memcpy( m_mappedData + offset, data, size );
 
-	gpuMail->occupiedSize = Align( gpuMail->occupiedSize, alignment );
+	RecordPendingCopies();
 
-	if ( gpuMail->occupiedSize + size > m_bufferSize )
+	GPUMail_t &gpuMail = m_mails[ m_currentMail ];
+	gpuMail.recorded   = true;
+
+	buffer	  = m_ringBuffer;
+	cmdBuffer = gpuMail.transferCmdBuffer;
+}
+
+void GPUMailManager::Release( const VkBufferMemoryBarrier &barrier, VkPipelineStageFlags dstStageMask )
+{
+	Release( 1, &barrier, dstStageMask );
+}
+
+void GPUMailManager::Release( const VkImageMemoryBarrier &barrier, VkPipelineStageFlags dstStageMask )
+{
+	GPUMail_t &gpuMail = m_mails[ m_currentMail ];
+
+	if ( !HasTransferQueue() )
+	{
+		vkCmdPipelineBarrier( gpuMail.transferCmdBuffer,
+							  VK_PIPELINE_STAGE_TRANSFER_BIT,
+							  dstStageMask,
+							  0,
+							  0,
+							  nullptr,
+							  0,
+							  nullptr,
+							  1,
+							  &barrier );
+		return;
+	}
+
+	// The layout transition happens once, between the release and the acquire
+	VkImageMemoryBarrier release = barrier;
+	release.srcQueueFamilyIndex	 = m_transferFamilyId;
+	release.dstQueueFamilyIndex	 = m_graphicsFamilyId;
+	release.dstAccessMask		 = 0;
+	vkCmdPipelineBarrier( gpuMail.transferCmdBuffer,
+						  VK_PIPELINE_STAGE_TRANSFER_BIT,
+						  VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+						  0,
+						  0,
+						  nullptr,
+						  0,
+						  nullptr,
+						  1,
+						  &release );
+
+	VkImageMemoryBarrier acquire = barrier;
+	acquire.srcQueueFamilyIndex	 = m_transferFamilyId;
+	acquire.dstQueueFamilyIndex	 = m_graphicsFamilyId;
+	acquire.srcAccessMask		 = 0;
+	m_acquireImageBarriers.emplace_back( acquire );
+	m_acquireStageMask |= dstStageMask;
+}
+
+void GPUMailManager::Release( uint32_t					   barrierCount,
+							  const VkBufferMemoryBarrier *barriers,
+							  VkPipelineStageFlags		   dstStageMask )
+{
+	GPUMail_t &gpuMail = m_mails[ m_currentMail ];
+
+	if ( !HasTransferQueue() )
 	{
-		Flush();
-		gpuMail = &m_mails[ m_currentMail ];
-		// CHECK_PRED( gpuMail->occupiedSize == 0 ); // occupiedSize could be > 0, if mail is in flight
+		vkCmdPipelineBarrier( gpuMail.transferCmdBuffer,
+							  VK_PIPELINE_STAGE_TRANSFER_BIT,
+							  dstStageMask,
+							  0,
+							  0,
+							  nullptr,
+							  barrierCount,
+							  barriers,
+							  0,
+							  nullptr );
+		return;
 	}
 
-	if ( gpuMail->submitted == true )
+	std::vector< VkBufferMemoryBarrier > releases( barriers, barriers + barrierCount );
+	for ( VkBufferMemoryBarrier &release : releases )
 	{
-		Wait( m_currentMail );
+		release.srcQueueFamilyIndex = m_transferFamilyId;
+		release.dstQueueFamilyIndex = m_graphicsFamilyId;
+		release.dstAccessMask		= 0;
 	}
+	vkCmdPipelineBarrier( gpuMail.transferCmdBuffer,
+						  VK_PIPELINE_STAGE_TRANSFER_BIT,
+						  VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+						  0,
+						  0,
+						  nullptr,
+						  barrierCount,
+						  releases.data(),
+						  0,
+						  nullptr );
 
-	std::memcpy( gpuMail->data + gpuMail->occupiedSize, data, size );
+	for ( uint32_t i = 0; i < barrierCount; ++i )
+	{
+		VkBufferMemoryBarrier acquire = barriers[ i ];
+		acquire.srcQueueFamilyIndex	  = m_transferFamilyId;
+		acquire.dstQueueFamilyIndex	  = m_graphicsFamilyId;
+		acquire.srcAccessMask		  = 0;
+		m_acquireBufferBarriers.emplace_back( acquire );
+	}
+	m_acquireStageMask |= dstStageMask;
+}
 
-	buffer	  = gpuMail->buffer;
-	offset	  = gpuMail->occupiedSize;
-	cmdBuffer = gpuMail->cmdBuffer;
+void GPUMailManager::QueueCopy( VkBuffer		   buffer,
+								VkBufferUsageFlags usage,
+								VkDeviceSize	   dstOffset,
+								VkDeviceSize	   size,
+								const void *	   data )
+{
+	CHECK_PRED( size <= m_ringSize );
 
-	gpuMail->occupiedSize += size;
+	const VkDeviceSize srcOffset = AllocStaging( size, 1 );
+	std::memcpy( m_mappedData + srcOffset, data, size );
+
+	// Copies of a batch are not ordered with each other
+	if ( HasPendingWrite( m_pendingCopies, buffer, dstOffset, size ) )
+	{
+		RecordPendingCopies();
+	}
+
+	pendingWrite_t copy;
+	copy.buffer	   = buffer;
+	copy.usage	   = usage;
+	copy.srcOffset = srcOffset;
+	copy.dstOffset = dstOffset;
+	copy.size	   = size;
+	m_pendingCopies.emplace_back( copy );
+
+	m_mails[ m_currentMail ].recorded = true;
+}
+
+void GPUMailManager::QueueFill( VkBuffer buffer, VkBufferUsageFlags usage, uint32_t data )
+{
+	if ( HasPendingWrite( m_pendingFills, buffer, 0, VK_WHOLE_SIZE ) )
+	{
+		RecordPendingFills();
+	}
+
+	pendingWrite_t fill;
+	fill.buffer = buffer;
+	fill.usage	= usage;
+	fill.size	= VK_WHOLE_SIZE;
+	fill.data	= data;
+	m_pendingFills.emplace_back( fill );
+
+	m_mails[ m_currentMail ].recorded = true;
 }
 
 VkCommandBuffer GPUMailManager::GetCmdBuffer()
 {
-	Wait( m_currentMail );
-	return m_mails[ m_currentMail ].cmdBuffer;
+	RecordPendingFills();
+
+	GPUMail_t &gpuMail = m_mails[ m_currentMail ];
+	gpuMail.recorded   = true;
+
+	return gpuMail.cmdBuffer;
 }
 
 void GPUMailManager::Flush()
 {
-	auto &gpuMail = m_mails[ m_currentMail ];
-	if ( gpuMail.submitted == true /*|| gpuMail.occupiedSize == 0*/ )
+	GPUMail_t &gpuMail = m_mails[ m_currentMail ];
+	if ( gpuMail.submitted || !gpuMail.recorded )
 	{
 		return;
 	}
 
 	auto &vkContext = GetVulkanContext();
 
+	RecordPendingCopies();
+	RecordPendingFills();
+
+	if ( !m_acquireBufferBarriers.empty() || !m_acquireImageBarriers.empty() )
+	{
+		vkCmdPipelineBarrier( gpuMail.acquireCmdBuffer,
+							  VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+							  m_acquireStageMask,
+							  0,
+							  0,
+							  nullptr,
+							  static_cast< uint32_t >( m_acquireBufferBarriers.size() ),
+							  m_acquireBufferBarriers.data(),
+							  static_cast< uint32_t >( m_acquireImageBarriers.size() ),
+							  m_acquireImageBarriers.data() );
+
+		m_acquireBufferBarriers.clear();
+		m_acquireImageBarriers.clear();
+		m_acquireStageMask = 0;
+	}
+
+	VK_CHECK( vkEndCommandBuffer( gpuMail.transferCmdBuffer ) );
+	VK_CHECK( vkEndCommandBuffer( gpuMail.acquireCmdBuffer ) );
+	VK_CHECK( vkEndCommandBuffer( gpuMail.cmdBuffer ) );
+
 	VkMappedMemoryRange memRange {};
 	memRange.sType	= VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
 	memRange.pNext	= nullptr;
 	memRange.memory = m_memory;
 	memRange.offset = 0;
 	memRange.size	= VK_WHOLE_SIZE;
+	VK_CHECK( vkFlushMappedMemoryRanges( vkContext.device, 1, &memRange ) );
 
-	VK_CHECK( vkEndCommandBuffer( gpuMail.cmdBuffer ) );
+	// Transfers signal the odd value, the graphics queue waits on it and signals the even value
+	const uint64_t transferValue = m_timelineValue + 1;
+	const uint64_t mailValue	 = m_timelineValue + 2;
 
-	VK_CHECK( vkFlushMappedMemoryRanges( vkContext.device, 1, &memRange ) );
+	const VkPipelineStageFlags waitStageMask = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+
+	VkTimelineSemaphoreSubmitInfo transferTimelineInfo {};
+	transferTimelineInfo.sType					   = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+	transferTimelineInfo.pNext					   = nullptr;
+	transferTimelineInfo.waitSemaphoreValueCount   = 0;
+	transferTimelineInfo.pWaitSemaphoreValues	   = nullptr;
+	transferTimelineInfo.signalSemaphoreValueCount = 1;
+	transferTimelineInfo.pSignalSemaphoreValues	   = &transferValue;
+
+	VkTimelineSemaphoreSubmitInfo graphicsTimelineInfo {};
+	graphicsTimelineInfo.sType					   = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+	graphicsTimelineInfo.pNext					   = nullptr;
+	graphicsTimelineInfo.waitSemaphoreValueCount   = 1;
+	graphicsTimelineInfo.pWaitSemaphoreValues	   = &transferValue;
+	graphicsTimelineInfo.signalSemaphoreValueCount = 1;
+	graphicsTimelineInfo.pSignalSemaphoreValues	   = &mailValue;
+
+	if ( HasTransferQueue() )
+	{
+		VkSubmitInfo transferSubmitInfo {};
+		transferSubmitInfo.sType				= VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		transferSubmitInfo.pNext				= &transferTimelineInfo;
+		transferSubmitInfo.waitSemaphoreCount	= 0;
+		transferSubmitInfo.pWaitSemaphores		= nullptr;
+		transferSubmitInfo.pWaitDstStageMask	= nullptr;
+		transferSubmitInfo.commandBufferCount	= 1;
+		transferSubmitInfo.pCommandBuffers		= &gpuMail.transferCmdBuffer;
+		transferSubmitInfo.signalSemaphoreCount = 1;
+		transferSubmitInfo.pSignalSemaphores	= &m_timeline;
+		VK_CHECK( vkQueueSubmit( m_transferQueue, 1, &transferSubmitInfo, VK_NULL_HANDLE ) );
+
+		const std::array< VkCommandBuffer, 2 > cmdBuffers = { gpuMail.acquireCmdBuffer, gpuMail.cmdBuffer };
+
+		VkSubmitInfo submitInfo {};
+		submitInfo.sType				= VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.pNext				= &graphicsTimelineInfo;
+		submitInfo.waitSemaphoreCount	= 1;
+		submitInfo.pWaitSemaphores		= &m_timeline;
+		submitInfo.pWaitDstStageMask	= &waitStageMask;
+		submitInfo.commandBufferCount	= static_cast< uint32_t >( cmdBuffers.size() );
+		submitInfo.pCommandBuffers		= cmdBuffers.data();
+		submitInfo.signalSemaphoreCount = 1;
+		submitInfo.pSignalSemaphores	= &m_timeline;
+		VK_CHECK( vkQueueSubmit( m_graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE ) );
+	}
+	else
+	{
+		graphicsTimelineInfo.waitSemaphoreValueCount = 0;
+		graphicsTimelineInfo.pWaitSemaphoreValues	 = nullptr;
+
+		const std::array< VkCommandBuffer, 2 > cmdBuffers = { gpuMail.transferCmdBuffer, gpuMail.cmdBuffer };
+
+		VkSubmitInfo submitInfo {};
+		submitInfo.sType				= VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.pNext				= &graphicsTimelineInfo;
+		submitInfo.waitSemaphoreCount	= 0;
+		submitInfo.pWaitSemaphores		= nullptr;
+		submitInfo.pWaitDstStageMask	= nullptr;
+		submitInfo.commandBufferCount	= static_cast< uint32_t >( cmdBuffers.size() );
+		submitInfo.pCommandBuffers		= cmdBuffers.data();
+		submitInfo.signalSemaphoreCount = 1;
+		submitInfo.pSignalSemaphores	= &m_timeline;
+		VK_CHECK( vkQueueSubmit( m_graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE ) );
+	}
+
+	m_timelineValue = mailValue;
 
-	VkSubmitInfo submitInfo {};
-	submitInfo.sType				= VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	submitInfo.pNext				= nullptr;
-	submitInfo.commandBufferCount	= 1;
-	submitInfo.pCommandBuffers		= &gpuMail.cmdBuffer;
-	submitInfo.signalSemaphoreCount = 0;
-	submitInfo.waitSemaphoreCount	= 0;
+	gpuMail.timelineValue = mailValue;
+	gpuMail.ringEnd		  = m_ringHead;
+	gpuMail.submitted	  = true;
 
-	// Log( "Submitting cmd buffer %p\n", gpuMail.cmdBuffer );
-	VK_CHECK( vkQueueSubmit( vkContext.graphicsQueue, 1, &submitInfo, gpuMail.fence ) );
+	m_currentMail = ( m_currentMail + 1 ) % m_mails.size();
 
-	gpuMail.submitted = true;
+	Reclaim();
 
-	for ( size_t i = 0; i < m_mails.size(); ++i )
+	// Every mail is in flight
+	Wait( m_currentMail );
+}
+
+void GPUMailManager::WaitAll()
+{
+	for ( uint32_t i = 0; i < m_mails.size(); ++i )
 	{
-		m_currentMail = ( m_currentMail + 1 ) % m_mails.size();
-		if ( m_mails[ m_currentMail ].submitted == false )
+		Wait( i );
+	}
+}
+
+VkDeviceSize GPUMailManager::AllocStaging( VkDeviceSize size, VkDeviceSize alignment )
+{
+	VkDeviceSize offset = 0;
+	while ( !TryAllocStaging( size, alignment, offset ) )
+	{
+		// The ring is full: wait for the oldest mail in flight, or submit the current one if it holds the space
+		uint32_t oldestMail = ~0u;
+		for ( uint32_t i = 0; i < m_mails.size(); ++i )
+		{
+			const GPUMail_t &mail = m_mails[ i ];
+			if ( mail.submitted && ( oldestMail == ~0u || mail.timelineValue < m_mails[ oldestMail ].timelineValue ) )
+			{
+				oldestMail = i;
+			}
+		}
+
+		if ( oldestMail == ~0u )
 		{
-			break;
+			Flush();
+		}
+		else
+		{
+			Wait( oldestMail );
 		}
 	}
+
+	return offset;
 }
 
-void GPUMailManager::Wait( uint32_t gpuMaiId )
+bool GPUMailManager::TryAllocStaging( VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize &offset )
 {
-	auto &gpuMail = m_mails[ gpuMaiId ];
-	if ( gpuMail.submitted == false )
+	for ( int attempt = 0; attempt < 2; ++attempt )
+	{
+		if ( m_ringTail == m_ringHead && m_ringHead % m_ringSize != 0 )
+		{
+			// The ring is empty, restart at its beginning so that any size up to m_ringSize fits
+			m_ringHead = m_ringHead - m_ringHead % m_ringSize + m_ringSize;
+			m_ringTail = m_ringHead;
+		}
+
+		const VkDeviceSize lapStart = m_ringHead - m_ringHead % m_ringSize;
+
+		VkDeviceSize start = lapStart + Align( m_ringHead - lapStart, alignment );
+		if ( start + size > lapStart + m_ringSize )
+		{
+			// Does not fit before the end of the ring, the remaining bytes are skipped
+			start = lapStart + m_ringSize;
+		}
+
+		const VkDeviceSize end = start + size;
+		if ( end - m_ringTail <= m_ringSize )
+		{
+			m_ringHead = end;
+			offset	   = start % m_ringSize;
+			return true;
+		}
+
+		Reclaim();
+	}
+
+	return false;
+}
+
+uploadHandle_t GPUMailManager::StreamBuffer( VkBuffer			  buffer,
+											 VkDeviceSize		  size,
+											 const void *		  data,
+											 streamDataMode_t	  mode,
+											 VkPipelineStageFlags dstStageMask,
+											 VkAccessFlags		  dstAccessMask )
+{
+	streamJob_t job;
+	job.buffer		  = buffer;
+	job.dstStageMask  = dstStageMask;
+	job.dstAccessMask = dstAccessMask;
+	job.size		  = size;
+
+	return QueueStream( std::move( job ), data, size, mode );
+}
+
+uploadHandle_t GPUMailManager::StreamImage( VkImage			   image,
+											VkImageAspectFlags aspectMask,
+											uint32_t		   mipLevel,
+											const VkOffset3D & offset,
+											const VkExtent3D & extent,
+											uint32_t		   rowLength,
+											uint32_t		   imageHeight,
+											uint32_t		   bytesPerTexel,
+											const void *	   data,
+											streamDataMode_t   mode )
+{
+	// Zero means tightly packed, as in VkBufferImageCopy
+	rowLength	= rowLength == 0 ? extent.width : rowLength;
+	imageHeight = imageHeight == 0 ? extent.height : imageHeight;
+	CHECK_PRED( rowLength >= extent.width && imageHeight >= extent.height );
+
+	streamJob_t job;
+	job.image		  = image;
+	job.aspectMask	  = aspectMask;
+	job.mipLevel	  = mipLevel;
+	job.imageOffset	  = offset;
+	job.imageExtent	  = extent;
+	job.rowLength	  = rowLength;
+	job.imageHeight	  = imageHeight;
+	job.bytesPerTexel = bytesPerTexel;
+	job.rowPitch	  = VkDeviceSize( rowLength ) * bytesPerTexel;
+	job.dstStageMask  = VK_PIPELINE_STAGE_VERTEX_SHADER_BIT;
+	job.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	// Whole rows are staged, padding included
+	job.size = job.rowPitch * extent.height * extent.depth;
+
+	CHECK_PRED( job.rowPitch <= GPU_MAIL_STREAM_CHUNK_SIZE );
+
+	const VkDeviceSize dataSize = job.rowPitch * ( VkDeviceSize( imageHeight ) * ( extent.depth - 1 ) + extent.height );
+
+	return QueueStream( std::move( job ), data, dataSize, mode );
+}
+
+void GPUMailManager::UpdateStreams( VkDeviceSize budget )
+{
+	// Retire does not erase jobs, it can run while a job is recorded
+	auto last = std::remove_if( m_streams.begin(), m_streams.end(), []( const streamJob_t &job ) {
+		return job.completedBytes == job.size;
+	} );
+	m_streams.erase( last, m_streams.end() );
+
+	VkDeviceSize staged = 0;
+	for ( streamJob_t &job : m_streams )
+	{
+		while ( job.recordedBytes < job.size && staged < budget )
+		{
+			const VkDeviceSize before = job.recordedBytes;
+			if ( !RecordStreamChunk( job, std::min< VkDeviceSize >( GPU_MAIL_STREAM_CHUNK_SIZE, budget - staged ) ) )
+			{
+				// Ring is full, the next frames will resume
+				return;
+			}
+			staged += job.recordedBytes - before;
+		}
+
+		if ( staged >= budget )
+		{
+			return;
+		}
+	}
+}
+
+bool GPUMailManager::IsUploadComplete( uploadHandle_t handle ) const
+{
+	const streamJob_t *job = FindStream( handle );
+	return job == nullptr || job->completedBytes == job->size;
+}
+
+float GPUMailManager::GetUploadProgress( uploadHandle_t handle ) const
+{
+	const streamJob_t *job = FindStream( handle );
+	return job == nullptr ? 1.0f : float( double( job->completedBytes ) / double( job->size ) );
+}
+
+void GPUMailManager::CancelUpload( uploadHandle_t handle )
+{
+	// Chunks already recorded still execute, their completion is ignored
+	auto pos = std::find_if( m_streams.begin(), m_streams.end(), [ handle ]( const streamJob_t &job ) {
+		return job.handle == handle;
+	} );
+	if ( pos != m_streams.end() )
+	{
+		m_streams.erase( pos );
+	}
+}
+
+uploadHandle_t GPUMailManager::QueueStream( streamJob_t &&	 job,
+											const void *	 data,
+											VkDeviceSize	 dataSize,
+											streamDataMode_t mode )
+{
+	if ( job.size == 0 )
+	{
+		return 0;
+	}
+
+	if ( mode == SDM_COPY )
+	{
+		job.storage.resize( static_cast< size_t >( dataSize ) );
+		std::memcpy( job.storage.data(), data, static_cast< size_t >( dataSize ) );
+		job.data = job.storage.data();
+	}
+	else
+	{
+		job.data = static_cast< const byte * >( data );
+	}
+
+	job.handle = m_nextUploadHandle++;
+	m_streams.emplace_back( std::move( job ) );
+
+	return m_streams.back().handle;
+}
+
+bool GPUMailManager::RecordStreamChunk( streamJob_t &job, VkDeviceSize maxSize )
+{
+	GPUMail_t &		gpuMail	  = m_mails[ m_currentMail ];
+	VkCommandBuffer cmdBuffer = gpuMail.transferCmdBuffer;
+
+	const bool firstChunk = job.recordedBytes == 0;
+
+	VkDeviceSize		  chunkSize		= 0;
+	VkDeviceSize		  stagingOffset = 0;
+	VkBufferMemoryBarrier bufferBarrier {};
+	VkImageMemoryBarrier  imageBarrier {};
+
+	if ( job.buffer != VK_NULL_HANDLE )
+	{
+		chunkSize = std::min( maxSize, job.size - job.recordedBytes );
+		if ( !TryAllocStaging( chunkSize, 16, stagingOffset ) )
+		{
+			return false;
+		}
+
+		std::memcpy( m_mappedData + stagingOffset, job.data + job.recordedBytes, static_cast< size_t >( chunkSize ) );
+
+		bufferBarrier.sType				  = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		bufferBarrier.pNext				  = nullptr;
+		bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		bufferBarrier.buffer			  = job.buffer;
+		bufferBarrier.offset			  = 0;
+		bufferBarrier.size				  = job.size;
+
+		if ( firstChunk )
+		{
+			bufferBarrier.srcAccessMask = 0;
+			bufferBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			vkCmdPipelineBarrier( cmdBuffer,
+								  VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+								  VK_PIPELINE_STAGE_TRANSFER_BIT,
+								  0,
+								  0,
+								  nullptr,
+								  1,
+								  &bufferBarrier,
+								  0,
+								  nullptr );
+		}
+
+		VkBufferCopy region {};
+		region.srcOffset = stagingOffset;
+		region.dstOffset = job.recordedBytes;
+		region.size		 = chunkSize;
+		vkCmdCopyBuffer( cmdBuffer, m_ringBuffer, job.buffer, 1, &region );
+	}
+	else
+	{
+		// Chunks are whole rows of one slice
+		const uint32_t maxRows = static_cast< uint32_t >( std::max< VkDeviceSize >( maxSize / job.rowPitch, 1 ) );
+
+		const VkDeviceSize firstRow	   = job.recordedBytes / job.rowPitch;
+		const uint32_t	   slice	   = static_cast< uint32_t >( firstRow / job.imageExtent.height );
+		const uint32_t	   row		   = static_cast< uint32_t >( firstRow % job.imageExtent.height );
+		const uint32_t	   rowCount	   = std::min( maxRows, job.imageExtent.height - row );
+		const VkDeviceSize sourceStart = ( VkDeviceSize( slice ) * job.imageHeight + row ) * job.rowPitch;
+
+		chunkSize = rowCount * job.rowPitch;
+
+		// Last row of the source may not be padded
+		const VkDeviceSize copySize =
+			( rowCount - 1 ) * job.rowPitch + VkDeviceSize( job.imageExtent.width ) * job.bytesPerTexel;
+
+		if ( !TryAllocStaging( chunkSize, std::max< VkDeviceSize >( 16, job.bytesPerTexel ), stagingOffset ) )
+		{
+			return false;
+		}
+
+		std::memcpy( m_mappedData + stagingOffset, job.data + sourceStart, static_cast< size_t >( copySize ) );
+
+		imageBarrier.sType							 = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		imageBarrier.pNext							 = nullptr;
+		imageBarrier.srcAccessMask					 = 0;
+		imageBarrier.dstAccessMask					 = VK_ACCESS_TRANSFER_WRITE_BIT;
+		imageBarrier.oldLayout						 = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageBarrier.newLayout						 = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		imageBarrier.srcQueueFamilyIndex			 = VK_QUEUE_FAMILY_IGNORED;
+		imageBarrier.dstQueueFamilyIndex			 = VK_QUEUE_FAMILY_IGNORED;
+		imageBarrier.image							 = job.image;
+		imageBarrier.subresourceRange.aspectMask	 = job.aspectMask;
+		imageBarrier.subresourceRange.baseMipLevel	 = job.mipLevel;
+		imageBarrier.subresourceRange.levelCount	 = 1;
+		imageBarrier.subresourceRange.baseArrayLayer = 0;
+		imageBarrier.subresourceRange.layerCount	 = VK_REMAINING_ARRAY_LAYERS;
+
+		if ( firstChunk )
+		{
+			vkCmdPipelineBarrier( cmdBuffer,
+								  VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+								  VK_PIPELINE_STAGE_TRANSFER_BIT,
+								  0,
+								  0,
+								  nullptr,
+								  0,
+								  nullptr,
+								  1,
+								  &imageBarrier );
+		}
+
+		VkBufferImageCopy region {};
+		region.bufferOffset					   = stagingOffset;
+		region.bufferRowLength				   = job.rowLength;
+		region.bufferImageHeight			   = 0;
+		region.imageSubresource.aspectMask	   = job.aspectMask;
+		region.imageSubresource.mipLevel	   = job.mipLevel;
+		region.imageSubresource.baseArrayLayer = 0;
+		region.imageSubresource.layerCount	   = 1;
+		region.imageOffset.x				   = job.imageOffset.x;
+		region.imageOffset.y				   = job.imageOffset.y + static_cast< int32_t >( row );
+		region.imageOffset.z				   = job.imageOffset.z + static_cast< int32_t >( slice );
+		region.imageExtent.width			   = job.imageExtent.width;
+		region.imageExtent.height			   = rowCount;
+		region.imageExtent.depth			   = 1;
+		vkCmdCopyBufferToImage( cmdBuffer,
+								m_ringBuffer,
+								job.image,
+								VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+								1,
+								&region );
+	}
+
+	job.recordedBytes += chunkSize;
+
+	gpuMail.recorded = true;
+	gpuMail.streamedBytes.emplace_back( job.handle, chunkSize );
+
+	if ( job.recordedBytes == job.size )
+	{
+		if ( job.buffer != VK_NULL_HANDLE )
+		{
+			bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			bufferBarrier.dstAccessMask = job.dstAccessMask;
+			Release( bufferBarrier, job.dstStageMask );
+		}
+		else
+		{
+			imageBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			imageBarrier.dstAccessMask = job.dstAccessMask;
+			imageBarrier.oldLayout	   = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			imageBarrier.newLayout	   = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			Release( imageBarrier, job.dstStageMask );
+		}
+	}
+
+	return true;
+}
+
+const GPUMailManager::streamJob_t *GPUMailManager::FindStream( uploadHandle_t handle ) const
+{
+	for ( const streamJob_t &job : m_streams )
+	{
+		if ( job.handle == handle )
+		{
+			return &job;
+		}
+	}
+
+	return nullptr;
+}
+
+void GPUMailManager::RecordPendingCopies()
+{
+	if ( m_pendingCopies.empty() )
 	{
 		return;
 	}
 
-	auto &device = GetVulkanContext().device;
+	VkCommandBuffer cmdBuffer = m_mails[ m_currentMail ].transferCmdBuffer;
 
-	VK_CHECK( vkWaitForFences( device, 1, &gpuMail.fence, VK_TRUE, UINT64_MAX ) );
+	m_batchBarriers.clear();
+	for ( const pendingWrite_t &copy : m_pendingCopies )
+	{
+		m_batchBarriers.emplace_back( PendingWriteBarrier( copy, 0, VK_ACCESS_TRANSFER_WRITE_BIT ) );
+	}
+	vkCmdPipelineBarrier( cmdBuffer,
+						  VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+						  VK_PIPELINE_STAGE_TRANSFER_BIT,
+						  0,
+						  0,
+						  nullptr,
+						  static_cast< uint32_t >( m_batchBarriers.size() ),
+						  m_batchBarriers.data(),
+						  0,
+						  nullptr );
 
-	VK_CHECK( vkResetFences( device, 1, &gpuMail.fence ) );
+	VkPipelineStageFlags dstStageMask = 0;
+	for ( size_t i = 0; i < m_pendingCopies.size(); ++i )
+	{
+		const pendingWrite_t &copy = m_pendingCopies[ i ];
 
-	VK_CHECK( vkResetCommandPool( device, m_commandPool, 0 ) );
+		VkBufferCopy region {};
+		region.srcOffset = copy.srcOffset;
+		region.dstOffset = copy.dstOffset;
+		region.size		 = copy.size;
+		vkCmdCopyBuffer( cmdBuffer, m_ringBuffer, copy.buffer, 1, &region );
 
-	gpuMail.submitted	 = false;
-	gpuMail.occupiedSize = 0;
+		m_batchBarriers[ i ].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		m_batchBarriers[ i ].dstAccessMask = BufferFlagsToAccessFlags( copy.usage );
+		dstStageMask |= BufferFlagsToStageFlags( copy.usage );
+	}
 
-	VkCommandBufferBeginInfo cmdBufferBeginInfo {};
-	cmdBufferBeginInfo.sType			= VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-	cmdBufferBeginInfo.pNext			= nullptr;
-	cmdBufferBeginInfo.flags			= VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-	cmdBufferBeginInfo.pInheritanceInfo = nullptr;
-	VK_CHECK( vkBeginCommandBuffer( gpuMail.cmdBuffer, &cmdBufferBeginInfo ) );
-	// Log( "Began cmd buffer %p\n", gpuMail.cmdBuffer );
+	Release( static_cast< uint32_t >( m_batchBarriers.size() ), m_batchBarriers.data(), dstStageMask );
+
+	m_pendingCopies.clear();
 }
 
-void GPUMailManager::WaitAll()
+void GPUMailManager::RecordPendingFills()
+{
+	if ( m_pendingFills.empty() )
+	{
+		return;
+	}
+
+	VkCommandBuffer cmdBuffer = m_mails[ m_currentMail ].cmdBuffer;
+
+	// Previous frames may still read or write the buffers
+	VkPipelineStageFlags stageMask = 0;
+	m_batchBarriers.clear();
+	for ( const pendingWrite_t &fill : m_pendingFills )
+	{
+		const VkAccessFlags srcAccessMask =
+			BufferFlagsToAccessFlags( fill.usage ) & ( VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT );
+		m_batchBarriers.emplace_back( PendingWriteBarrier( fill, srcAccessMask, VK_ACCESS_TRANSFER_WRITE_BIT ) );
+		stageMask |= BufferFlagsToStageFlags( fill.usage );
+	}
+	vkCmdPipelineBarrier( cmdBuffer,
+						  stageMask,
+						  VK_PIPELINE_STAGE_TRANSFER_BIT,
+						  0,
+						  0,
+						  nullptr,
+						  static_cast< uint32_t >( m_batchBarriers.size() ),
+						  m_batchBarriers.data(),
+						  0,
+						  nullptr );
+
+	for ( size_t i = 0; i < m_pendingFills.size(); ++i )
+	{
+		const pendingWrite_t &fill = m_pendingFills[ i ];
+
+		vkCmdFillBuffer( cmdBuffer, fill.buffer, 0, fill.size, fill.data );
+
+		m_batchBarriers[ i ].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		m_batchBarriers[ i ].dstAccessMask = BufferFlagsToAccessFlags( fill.usage );
+	}
+	vkCmdPipelineBarrier( cmdBuffer,
+						  VK_PIPELINE_STAGE_TRANSFER_BIT,
+						  stageMask,
+						  0,
+						  0,
+						  nullptr,
+						  static_cast< uint32_t >( m_batchBarriers.size() ),
+						  m_batchBarriers.data(),
+						  0,
+						  nullptr );
+
+	m_pendingFills.clear();
+}
+
+void GPUMailManager::Reclaim()
 {
+	uint64_t completedValue = 0;
+	VK_CHECK( vkGetSemaphoreCounterValue( GetVulkanContext().device, m_timeline, &completedValue ) );
+
 	for ( uint32_t i = 0; i < m_mails.size(); ++i )
 	{
-		Wait( i );
+		if ( m_mails[ i ].submitted && m_mails[ i ].timelineValue <= completedValue )
+		{
+			Retire( i );
+		}
 	}
 }
 
+void GPUMailManager::Wait( uint32_t gpuMaiId )
+{
+	auto &gpuMail = m_mails[ gpuMaiId ];
+	if ( gpuMail.submitted == false )
+	{
+		return;
+	}
+
+	VkSemaphoreWaitInfo waitInfo {};
+	waitInfo.sType			= VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+	waitInfo.pNext			= nullptr;
+	waitInfo.flags			= 0;
+	waitInfo.semaphoreCount = 1;
+	waitInfo.pSemaphores	= &m_timeline;
+	waitInfo.pValues		= &gpuMail.timelineValue;
+	VK_CHECK( vkWaitSemaphores( GetVulkanContext().device, &waitInfo, UINT64_MAX ) );
+
+	Retire( gpuMaiId );
+}
+
+void GPUMailManager::Retire( uint32_t gpuMaiId )
+{
+	auto &gpuMail = m_mails[ gpuMaiId ];
+
+	// Mails complete in submission order
+	m_ringTail = std::max( m_ringTail, gpuMail.ringEnd );
+
+	gpuMail.submitted = false;
+	gpuMail.recorded  = false;
+
+	// Cancelled jobs are not found
+	for ( const auto &chunk : gpuMail.streamedBytes )
+	{
+		for ( streamJob_t &job : m_streams )
+		{
+			if ( job.handle == chunk.first )
+			{
+				job.completedBytes += chunk.second;
+				break;
+			}
+		}
+	}
+	gpuMail.streamedBytes.clear();
+
+	BeginMailCmdBuffer( gpuMail.transferCmdBuffer );
+	BeginMailCmdBuffer( gpuMail.acquireCmdBuffer );
+	BeginMailCmdBuffer( gpuMail.cmdBuffer );
+}
+
 } // namespace render
 } // namespace vkRuna
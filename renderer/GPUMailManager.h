@@ -7,11 +7,28 @@
 #include "renderer/RenderConfig.h"
 
 #include <array>
+#include <utility>
+#include <vector>
 
 namespace vkRuna
 {
 namespace render
 {
+using uploadHandle_t = uint64_t; // 0 is an upload that already completed
+
+enum streamDataMode_t
+{
+	SDM_COPY,  // The data is copied when the upload is queued
+	SDM_BORROW // The data must stay valid until the upload completes
+};
+
+// Uploads data to the GPU through one persistently mapped ring buffer. Each Submit sub-allocates its staging range
+// from the ring, ranges are recycled once the timeline semaphore reaches the value of the mail that used them.
+// Transfer commands go to a dedicated transfer queue when the device has one: resources written there must be handed
+// over to the graphics queue with Release, which records the queue family ownership transfer barriers.
+// The CPU only blocks when the ring or every mail is in flight.
+// Streamed uploads have no size limit: UpdateStreams records them in chunks of GPU_MAIL_STREAM_CHUNK_SIZE bytes, one
+// frame budget at a time, and never blocks. The destination must not be used before IsUploadComplete.
 class GPUMailManager
 {
 	NO_COPY_NO_ASSIGN( GPUMailManager )
@@ -22,44 +39,172 @@ class GPUMailManager
    public:
 	GPUMailManager();
 
-	void Init();
+	void Init( VkDeviceSize ringSize );
 	void Shutdown();
 
-	void			Submit( VkDeviceSize	 size,
-							VkDeviceSize	 alignment,
-							const void *	 data,
-							VkBuffer &		 buffer,
-							VkDeviceSize &	 offset,
-							VkCommandBuffer &cmdBuffer );
+	// cmdBuffer executes on the transfer queue
+	void Submit( VkDeviceSize	  size,
+				 VkDeviceSize	  alignment,
+				 const void *	  data,
+				 VkBuffer &		  buffer,
+				 VkDeviceSize &	  offset,
+				 VkCommandBuffer &cmdBuffer );
+	// Releases a resource written by a Submit command buffer to the graphics queue. srcAccessMask must be the
+	// transfer writes, dstStageMask and dstAccessMask the first graphics queue use.
+	void Release( const VkBufferMemoryBarrier &barrier, VkPipelineStageFlags dstStageMask );
+	void Release( const VkImageMemoryBarrier &barrier, VkPipelineStageFlags dstStageMask );
+	void Release( uint32_t barrierCount, const VkBufferMemoryBarrier *barriers, VkPipelineStageFlags dstStageMask );
+
+	// Batched buffer writes: copies go to the transfer queue, fills to the graphics queue and cover whole buffers.
+	// Queued writes are recorded together, behind one barrier before and one barrier after, when the mail is flushed
+	// or its command buffer is handed out. Stages and accesses waiting on the writes are derived from usage.
+	void QueueCopy( VkBuffer		   buffer,
+					VkBufferUsageFlags usage,
+					VkDeviceSize	   dstOffset,
+					VkDeviceSize	   size,
+					const void *	   data );
+	void QueueFill( VkBuffer buffer, VkBufferUsageFlags usage, uint32_t data );
+
+	// Executes on the graphics queue, after the mail transfers and queued fills
 	VkCommandBuffer GetCmdBuffer();
 
+	uploadHandle_t StreamBuffer( VkBuffer			  buffer,
+								 VkDeviceSize		  size,
+								 const void *		  data,
+								 streamDataMode_t	  mode,
+								 VkPipelineStageFlags dstStageMask,
+								 VkAccessFlags		  dstAccessMask );
+	// The image ends in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, rows of the source are rowLength texels apart and
+	// slices imageHeight rows apart
+	uploadHandle_t StreamImage( VkImage			   image,
+								VkImageAspectFlags aspectMask,
+								uint32_t		   mipLevel,
+								const VkOffset3D & offset,
+								const VkExtent3D & extent,
+								uint32_t		   rowLength,
+								uint32_t		   imageHeight,
+								uint32_t		   bytesPerTexel,
+								const void *	   data,
+								streamDataMode_t   mode );
+
+	// Records streamed chunks until budget bytes are staged or the ring is full, must be called before Flush
+	void  UpdateStreams( VkDeviceSize budget );
+	bool  IsUploadComplete( uploadHandle_t handle ) const;
+	float GetUploadProgress( uploadHandle_t handle ) const; // Ratio of the bytes copied by the GPU
+	void  CancelUpload( uploadHandle_t handle );
+
 	void Flush();
 	void WaitAll();
 
+	VkDeviceSize GetRingSize() const { return m_ringSize; }
+	bool		 HasTransferQueue() const { return m_transferQueue != m_graphicsQueue; }
+
+	// Other queues wait on GetTimelineValue to see the writes of every flushed mail
+	VkSemaphore GetTimeline() const { return m_timeline; }
+	uint64_t	GetTimelineValue() const { return m_timelineValue; }
+
    private:
+	struct streamJob_t;
+
+	VkDeviceSize AllocStaging( VkDeviceSize size, VkDeviceSize alignment );
+	bool		 TryAllocStaging( VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize &offset );
+
+	uploadHandle_t	   QueueStream( streamJob_t &&	   job,
+									const void *	   data,
+									VkDeviceSize	   dataSize,
+									streamDataMode_t   mode );
+	bool			   RecordStreamChunk( streamJob_t &job, VkDeviceSize maxSize );
+	const streamJob_t *FindStream( uploadHandle_t handle ) const;
+
+	void RecordPendingCopies();
+	void RecordPendingFills();
+
+	void Reclaim();
 	void Wait( uint32_t gpuMaiId );
+	void Retire( uint32_t gpuMaiId );
 
    private:
 	struct GPUMail_t
 	{
-		VkBuffer		buffer		 = VK_NULL_HANDLE;
-		VkCommandBuffer cmdBuffer	 = VK_NULL_HANDLE;
-		VkFence			fence		 = VK_NULL_HANDLE;
-		byte *			data		 = nullptr;
-		VkDeviceSize	occupiedSize = 0;
-		bool			submitted	 = false;
+		VkCommandBuffer transferCmdBuffer = VK_NULL_HANDLE;
+		VkCommandBuffer acquireCmdBuffer  = VK_NULL_HANDLE; // Ownership acquire barriers, graphics queue
+		VkCommandBuffer cmdBuffer		  = VK_NULL_HANDLE;
+		uint64_t		timelineValue	  = 0; // Signaled once every command buffer has executed
+		VkDeviceSize	ringEnd			  = 0; // Ring head when the mail was submitted
+		bool			recorded		  = false;
+		bool			submitted		  = false;
+
+		std::vector< std::pair< uploadHandle_t, VkDeviceSize > > streamedBytes; // Chunks recorded in this mail
 	};
 
-	VkCommandPool  m_commandPool = VK_NULL_HANDLE;
-	VkDeviceMemory m_memory		 = VK_NULL_HANDLE;
+	struct pendingWrite_t
+	{
+		VkBuffer		   buffer	 = VK_NULL_HANDLE;
+		VkBufferUsageFlags usage	 = 0;
+		VkDeviceSize	   srcOffset = 0; // Copies, in the ring
+		VkDeviceSize	   dstOffset = 0;
+		VkDeviceSize	   size		 = 0;
+		uint32_t		   data		 = 0; // Fills
+	};
 
-	VkDeviceSize m_bufferSize = 0;
+	struct streamJob_t
+	{
+		uploadHandle_t handle = 0;
+
+		VkBuffer buffer = VK_NULL_HANDLE;
+
+		VkImage			   image		 = VK_NULL_HANDLE;
+		VkImageAspectFlags aspectMask	 = 0;
+		uint32_t		   mipLevel		 = 0;
+		VkOffset3D		   imageOffset	 = {};
+		VkExtent3D		   imageExtent	 = {};
+		uint32_t		   rowLength	 = 0;
+		uint32_t		   imageHeight	 = 0;
+		VkDeviceSize	   rowPitch		 = 0;
+		VkDeviceSize	   bytesPerTexel = 0;
+
+		VkPipelineStageFlags dstStageMask  = 0;
+		VkAccessFlags		 dstAccessMask = 0;
+
+		const byte *		data = nullptr;
+		std::vector< byte > storage; // SDM_COPY
+
+		VkDeviceSize size			= 0; // Bytes written to the destination
+		VkDeviceSize recordedBytes	= 0;
+		VkDeviceSize completedBytes = 0;
+	};
+
+	VkQueue		  m_transferQueue		= VK_NULL_HANDLE;
+	VkQueue		  m_graphicsQueue		= VK_NULL_HANDLE;
+	uint32_t	  m_transferFamilyId	= ~0u;
+	uint32_t	  m_graphicsFamilyId	= ~0u;
+	VkCommandPool m_transferCommandPool = VK_NULL_HANDLE;
+	VkCommandPool m_graphicsCommandPool = VK_NULL_HANDLE;
+
+	VkSemaphore m_timeline		= VK_NULL_HANDLE;
+	uint64_t	m_timelineValue = 0;
 
-	byte *m_mappedData = nullptr;
+	VkBuffer	   m_ringBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory m_memory		= VK_NULL_HANDLE;
+	byte *		   m_mappedData = nullptr;
+	VkDeviceSize   m_ringSize	= 0;
+	VkDeviceSize   m_ringHead	= 0; // Monotonic, the ring offset is m_ringHead % m_ringSize
+	VkDeviceSize   m_ringTail	= 0; // Everything before was consumed by the GPU
 
 	std::array< GPUMail_t, GPU_MAIL_BUFFERING_LEVEL > m_mails;
 
-	int m_currentMail = 0;
+	uint32_t m_currentMail = 0;
+
+	std::vector< VkBufferMemoryBarrier > m_acquireBufferBarriers;
+	std::vector< VkImageMemoryBarrier >	 m_acquireImageBarriers;
+	VkPipelineStageFlags				 m_acquireStageMask = 0;
+
+	std::vector< pendingWrite_t >		 m_pendingCopies;
+	std::vector< pendingWrite_t >		 m_pendingFills;
+	std::vector< VkBufferMemoryBarrier > m_batchBarriers;
+
+	std::vector< streamJob_t > m_streams;
+	uploadHandle_t			   m_nextUploadHandle = 1;
 };
 
 extern GPUMailManager g_gpuMail;
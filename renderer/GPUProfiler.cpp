@@ -0,0 +1,558 @@
+// Copyright (c) 2021 Arno Galvez
+
+#include "renderer/GPUProfiler.h"
+
+#include "platform/Sys.h"
+#include "renderer/Check.h"
+#include "renderer/VkBackend.h"
+
+#include <algorithm>
+
+namespace vkRuna
+{
+namespace render
+{
+GPUProfiler g_gpuProfiler;
+
+static const uint32_t NO_QUERY = UINT32_MAX;
+
+// Graphics statistics may only be queried on queues supporting graphics, the pre-render list may execute on the async
+// compute queue. Results are written in the order of the bits.
+static const std::array< VkQueryPipelineStatisticFlags, GPL_COUNT > g_statisticFlags = {
+	VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT,
+	VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+		VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT
+};
+static const std::array< uint32_t, GPL_COUNT > g_statisticCounts = { 1, 2 };
+
+static bool IsTimed( gpuCmdType_t type )
+{
+	return type == CT_COMPUTE || type == CT_GRAPHIC || type == CT_UI;
+}
+
+static uint64_t GetTimestampMask( uint32_t familyId )
+{
+	const uint32_t validBits = GetVulkanContext().gpu.queueFamiliesProps[ familyId ].timestampValidBits;
+
+	return validBits >= 64 ? UINT64_MAX : ( uint64_t( 1 ) << validBits ) - 1;
+}
+
+GPUProfiler::GPUProfiler() {}
+
+GPUProfiler::~GPUProfiler()
+{
+	Shutdown();
+}
+
+#ifdef RUNA_TRACY_VULKAN
+// Tracy resets and re-records its calibration commands several times, all completed before TracyVkContext returns
+static tracyGpuContext_t CreateTracyContext( uint32_t familyId, VkQueue queue )
+{
+	const vulkanContext_t &context = GetVulkanContext();
+
+	VkCommandPoolCreateInfo commandPoolCI {};
+	commandPoolCI.sType			   = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	commandPoolCI.pNext			   = nullptr;
+	commandPoolCI.flags			   = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+	commandPoolCI.queueFamilyIndex = familyId;
+
+	VkCommandPool commandPool = VK_NULL_HANDLE;
+	VK_CHECK( vkCreateCommandPool( context.device, &commandPoolCI, nullptr, &commandPool ) );
+
+	VkCommandBufferAllocateInfo allocateInfo {};
+	allocateInfo.sType				= VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocateInfo.pNext				= nullptr;
+	allocateInfo.commandPool		= commandPool;
+	allocateInfo.level				= VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocateInfo.commandBufferCount = 1;
+
+	VkCommandBuffer cmdBuffer = VK_NULL_HANDLE;
+	VK_CHECK( vkAllocateCommandBuffers( context.device, &allocateInfo, &cmdBuffer ) );
+
+	tracyGpuContext_t tracyContext = TracyVkContext( context.gpu.device, context.device, queue, cmdBuffer );
+
+	vkDestroyCommandPool( context.device, commandPool, nullptr );
+
+	return tracyContext;
+}
+#endif
+
+void GPUProfiler::Init()
+{
+	if ( !GPU_PROFILER_ENABLE )
+	{
+		return;
+	}
+
+	const vulkanContext_t &context = GetVulkanContext();
+
+	m_timestampMasks[ GPL_PRE_RENDER ] = GetTimestampMask( context.computeFamilyId );
+	m_timestampMasks[ GPL_RENDER ]	   = GetTimestampMask( context.graphicsFamilyId );
+	m_timed[ GPL_PRE_RENDER ]		   = m_timestampMasks[ GPL_PRE_RENDER ] != 0;
+	m_timed[ GPL_RENDER ]			   = m_timestampMasks[ GPL_RENDER ] != 0;
+	m_nsPerTick						   = context.gpu.properties.limits.timestampPeriod;
+
+	m_pipelineStats = GPU_PROFILER_PIPELINE_STATISTICS && context.gpu.features.pipelineStatisticsQuery == VK_TRUE;
+
+	VkQueryPoolCreateInfo queryPoolCI {};
+	queryPoolCI.sType			   = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	queryPoolCI.pNext			   = nullptr;
+	queryPoolCI.flags			   = 0;
+	queryPoolCI.queryType		   = VK_QUERY_TYPE_TIMESTAMP;
+	queryPoolCI.queryCount		   = 2 * GPU_PROFILER_MAX_ZONES;
+	queryPoolCI.pipelineStatistics = 0;
+
+	for ( frameQueries_t &frame : m_frames )
+	{
+		VK_CHECK( vkCreateQueryPool( context.device, &queryPoolCI, nullptr, &frame.queryPool ) );
+	}
+
+	if ( m_pipelineStats )
+	{
+		queryPoolCI.queryType  = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+		queryPoolCI.queryCount = GPU_PROFILER_MAX_ZONES;
+
+		for ( frameQueries_t &frame : m_frames )
+		{
+			for ( int list = 0; list < GPL_COUNT; ++list )
+			{
+				queryPoolCI.pipelineStatistics = g_statisticFlags[ list ];
+				VK_CHECK( vkCreateQueryPool( context.device, &queryPoolCI, nullptr, &frame.statsPools[ list ] ) );
+			}
+		}
+	}
+
+#ifdef RUNA_TRACY_VULKAN
+	m_tracyContexts[ GPL_RENDER ]	  = CreateTracyContext( context.graphicsFamilyId, context.graphicsQueue );
+	m_tracyContexts[ GPL_PRE_RENDER ] = m_tracyContexts[ GPL_RENDER ];
+	if ( HasAsyncCompute() )
+	{
+		m_tracyContexts[ GPL_PRE_RENDER ] = CreateTracyContext( context.computeFamilyId, context.computeQueue );
+	}
+#endif
+
+	if ( GPU_PROFILER_CSV_PATH != nullptr )
+	{
+		SetCsvPath( GPU_PROFILER_CSV_PATH );
+	}
+}
+
+void GPUProfiler::Shutdown()
+{
+	SetCsvPath( nullptr );
+
+#ifdef RUNA_TRACY_VULKAN
+	if ( m_tracyContexts[ GPL_PRE_RENDER ] != m_tracyContexts[ GPL_RENDER ] )
+	{
+		TracyVkDestroy( m_tracyContexts[ GPL_PRE_RENDER ] );
+	}
+	if ( m_tracyContexts[ GPL_RENDER ] != nullptr )
+	{
+		TracyVkDestroy( m_tracyContexts[ GPL_RENDER ] );
+	}
+#endif
+	m_tracyContexts.fill( nullptr );
+
+	for ( frameQueries_t &frame : m_frames )
+	{
+		if ( frame.queryPool != VK_NULL_HANDLE )
+		{
+			vkDestroyQueryPool( GetVulkanContext().device, frame.queryPool, nullptr );
+		}
+		for ( VkQueryPool statsPool : frame.statsPools )
+		{
+			if ( statsPool != VK_NULL_HANDLE )
+			{
+				vkDestroyQueryPool( GetVulkanContext().device, statsPool, nullptr );
+			}
+		}
+		frame = frameQueries_t();
+	}
+
+	m_timed.fill( false );
+	m_pipelineStats = false;
+	m_cmdQueries[ GPL_PRE_RENDER ].clear();
+	m_cmdQueries[ GPL_RENDER ].clear();
+
+	m_names.clear();
+	m_nameIds.clear();
+	m_frameTimings.clear();
+	m_windowTimings.clear();
+	m_timings.clear();
+	m_framePipelineStats.clear();
+	m_windowPipelineStats.clear();
+	m_pipelineStatsAverages.clear();
+	m_windowFrames = 0;
+}
+
+void GPUProfiler::BeginFrame( uint32_t		  slot,
+							  uint64_t		  frameId,
+							  int			  preRenderCount,
+							  const gpuCmd_t *preRenderCmds,
+							  int			  renderCount,
+							  const gpuCmd_t *renderCmds )
+{
+	frameQueries_t &frame = m_frames[ slot ];
+
+	m_current = slot;
+
+	frame.frameId = frameId;
+	frame.pending = frame.queryPool != VK_NULL_HANDLE;
+	frame.zones.clear();
+
+	const std::array< int, GPL_COUNT >				counts = { preRenderCount, renderCount };
+	const std::array< const gpuCmd_t *, GPL_COUNT >	cmds   = { preRenderCmds, renderCmds };
+
+	uint32_t queryCount = 0;
+
+	for ( int list = 0; list < GPL_COUNT; ++list )
+	{
+		std::vector< uint32_t > &cmdQueries = m_cmdQueries[ list ];
+		cmdQueries.clear();
+
+		frame.firstQuery[ list ] = queryCount;
+
+		if ( !frame.pending || !m_timed[ list ] )
+		{
+			frame.queryCount[ list ] = 0;
+			continue;
+		}
+
+		cmdQueries.resize( counts[ list ], NO_QUERY );
+
+		for ( int i = 0; i < counts[ list ]; ++i )
+		{
+			const gpuCmd_t &cmd = cmds[ list ][ i ];
+
+			// Commands past the capacity of the pool are not timed
+			if ( !IsTimed( cmd.type ) || queryCount == 2 * GPU_PROFILER_MAX_ZONES )
+			{
+				continue;
+			}
+
+			zone_t zone;
+			zone.nameId		= GetNameId( GetZoneName( cmd ) );
+			zone.firstQuery = queryCount;
+			zone.type		= cmd.type;
+			zone.list		= static_cast< gpuProfileList_t >( list );
+			frame.zones.emplace_back( zone );
+
+			cmdQueries[ i ] = queryCount;
+			queryCount += 2;
+		}
+
+		frame.queryCount[ list ] = queryCount - frame.firstQuery[ list ];
+	}
+}
+
+void GPUProfiler::ResetQueries( VkCommandBuffer cmdBuffer, gpuProfileList_t list ) const
+{
+	const frameQueries_t &frame = m_frames[ m_current ];
+
+	if ( frame.queryCount[ list ] > 0 )
+	{
+		vkCmdResetQueryPool( cmdBuffer, frame.queryPool, frame.firstQuery[ list ], frame.queryCount[ list ] );
+	}
+
+	if ( frame.statsPools[ list ] != VK_NULL_HANDLE && frame.queryCount[ list ] > 0 )
+	{
+		vkCmdResetQueryPool( cmdBuffer, frame.statsPools[ list ], 0, frame.queryCount[ list ] / 2 );
+	}
+}
+
+void GPUProfiler::BeginZone( VkCommandBuffer cmdBuffer, gpuProfileList_t list, int cmdIndex ) const
+{
+	const std::vector< uint32_t > &cmdQueries = m_cmdQueries[ list ];
+
+	if ( size_t( cmdIndex ) >= cmdQueries.size() || cmdQueries[ cmdIndex ] == NO_QUERY )
+	{
+		return;
+	}
+
+	const frameQueries_t &frame = m_frames[ m_current ];
+	const uint32_t		  query = cmdQueries[ cmdIndex ];
+
+	vkCmdWriteTimestamp( cmdBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, frame.queryPool, query );
+
+	if ( frame.statsPools[ list ] != VK_NULL_HANDLE )
+	{
+		vkCmdBeginQuery( cmdBuffer, frame.statsPools[ list ], ( query - frame.firstQuery[ list ] ) / 2, 0 );
+	}
+}
+
+void GPUProfiler::EndZone( VkCommandBuffer cmdBuffer, gpuProfileList_t list, int cmdIndex ) const
+{
+	const std::vector< uint32_t > &cmdQueries = m_cmdQueries[ list ];
+
+	if ( size_t( cmdIndex ) >= cmdQueries.size() || cmdQueries[ cmdIndex ] == NO_QUERY )
+	{
+		return;
+	}
+
+	const frameQueries_t &frame = m_frames[ m_current ];
+	const uint32_t		  query = cmdQueries[ cmdIndex ];
+
+	if ( frame.statsPools[ list ] != VK_NULL_HANDLE )
+	{
+		vkCmdEndQuery( cmdBuffer, frame.statsPools[ list ], ( query - frame.firstQuery[ list ] ) / 2 );
+	}
+
+	vkCmdWriteTimestamp( cmdBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, frame.queryPool, query + 1 );
+}
+
+void GPUProfiler::RetireFrame( uint64_t frameId )
+{
+	auto pos = std::find_if( m_frames.begin(), m_frames.end(), [ frameId ]( const frameQueries_t &frame ) {
+		return frame.pending && frame.frameId == frameId;
+	} );
+
+	if ( pos == m_frames.end() )
+	{
+		return;
+	}
+
+	frameQueries_t &frame = *pos;
+	frame.pending		  = false;
+
+	const uint32_t queryCount = frame.queryCount[ GPL_PRE_RENDER ] + frame.queryCount[ GPL_RENDER ];
+	if ( queryCount == 0 )
+	{
+		return;
+	}
+
+	m_results.resize( queryCount );
+
+	// The fence of the frame has signaled, results are available. Without VK_QUERY_RESULT_WAIT_BIT, VK_NOT_READY
+	// drops the frame rather than stalling.
+	const VkResult result = vkGetQueryPoolResults( GetVulkanContext().device,
+												   frame.queryPool,
+												   0,
+												   queryCount,
+												   queryCount * sizeof( uint64_t ),
+												   m_results.data(),
+												   sizeof( uint64_t ),
+												   VK_QUERY_RESULT_64_BIT );
+	if ( result != VK_SUCCESS )
+	{
+		return;
+	}
+
+	bool hasStats = m_pipelineStats;
+	for ( int list = 0; hasStats && list < GPL_COUNT; ++list )
+	{
+		const uint32_t zoneCount = frame.queryCount[ list ] / 2;
+		if ( zoneCount == 0 )
+		{
+			continue;
+		}
+
+		const VkDeviceSize stride = g_statisticCounts[ list ] * sizeof( uint64_t );
+
+		m_statsResults[ list ].resize( zoneCount * g_statisticCounts[ list ] );
+		hasStats = vkGetQueryPoolResults( GetVulkanContext().device,
+										  frame.statsPools[ list ],
+										  0,
+										  zoneCount,
+										  zoneCount * stride,
+										  m_statsResults[ list ].data(),
+										  stride,
+										  VK_QUERY_RESULT_64_BIT ) == VK_SUCCESS;
+	}
+
+	m_frameTimings.assign( m_names.size(), gpuTimings_t() );
+	m_framePipelineStats.assign( m_names.size(), gpuPipelineStats_t() );
+
+	for ( const zone_t &zone : frame.zones )
+	{
+		const uint64_t begin = m_results[ zone.firstQuery ];
+		const uint64_t end	 = m_results[ zone.firstQuery + 1 ];
+		const uint64_t ticks = ( end - begin ) & m_timestampMasks[ zone.list ];
+		const double   ms	 = double( ticks ) * m_nsPerTick * 1e-6;
+
+		gpuTimings_t &timings = m_frameTimings[ zone.nameId ];
+		if ( zone.type == CT_COMPUTE )
+		{
+			timings.computeMs += ms;
+		}
+		else
+		{
+			timings.renderMs += ms;
+		}
+
+		if ( hasStats )
+		{
+			const uint32_t	zoneIndex = ( zone.firstQuery - frame.firstQuery[ zone.list ] ) / 2;
+			const uint64_t *values	  = &m_statsResults[ zone.list ][ zoneIndex * g_statisticCounts[ zone.list ] ];
+
+			gpuPipelineStats_t &stats = m_framePipelineStats[ zone.nameId ];
+			if ( zone.list == GPL_PRE_RENDER )
+			{
+				stats.computeInvocations += values[ 0 ];
+			}
+			else
+			{
+				stats.vertexInvocations += values[ 0 ];
+				stats.fragmentInvocations += values[ 1 ];
+			}
+		}
+	}
+
+	m_windowTimings.resize( m_names.size() );
+	m_windowPipelineStats.resize( m_names.size() );
+	for ( size_t i = 0; i < m_frameTimings.size(); ++i )
+	{
+		m_windowTimings[ i ].computeMs += m_frameTimings[ i ].computeMs;
+		m_windowTimings[ i ].renderMs += m_frameTimings[ i ].renderMs;
+		m_windowPipelineStats[ i ].computeInvocations += m_framePipelineStats[ i ].computeInvocations;
+		m_windowPipelineStats[ i ].vertexInvocations += m_framePipelineStats[ i ].vertexInvocations;
+		m_windowPipelineStats[ i ].fragmentInvocations += m_framePipelineStats[ i ].fragmentInvocations;
+	}
+
+	if ( ++m_windowFrames == GPU_PROFILER_AVERAGE_FRAMES )
+	{
+		PublishTimings();
+	}
+
+	if ( m_csv != nullptr )
+	{
+		for ( size_t i = 0; i < m_frameTimings.size(); ++i )
+		{
+			const gpuTimings_t &	  timings = m_frameTimings[ i ];
+			const gpuPipelineStats_t &stats	  = m_framePipelineStats[ i ];
+			if ( timings.computeMs > 0.0 || timings.renderMs > 0.0 )
+			{
+				std::fprintf( m_csv,
+							  "%llu,\"%s\",%.4f,%.4f,%llu,%llu,%llu\n",
+							  static_cast< unsigned long long >( frameId ),
+							  m_names[ i ].c_str(),
+							  timings.computeMs,
+							  timings.renderMs,
+							  static_cast< unsigned long long >( stats.computeInvocations ),
+							  static_cast< unsigned long long >( stats.vertexInvocations ),
+							  static_cast< unsigned long long >( stats.fragmentInvocations ) );
+			}
+		}
+	}
+}
+
+gpuTimings_t GPUProfiler::GetTimings( const char *profileName ) const
+{
+	auto pos = m_nameIds.find( profileName );
+	if ( pos == m_nameIds.end() || pos->second >= m_timings.size() )
+	{
+		return gpuTimings_t();
+	}
+
+	return m_timings[ pos->second ];
+}
+
+gpuPipelineStats_t GPUProfiler::GetPipelineStats( const char *profileName ) const
+{
+	auto pos = m_nameIds.find( profileName );
+	if ( pos == m_nameIds.end() || pos->second >= m_pipelineStatsAverages.size() )
+	{
+		return gpuPipelineStats_t();
+	}
+
+	return m_pipelineStatsAverages[ pos->second ];
+}
+
+bool GPUProfiler::SetCsvPath( const char *path )
+{
+	if ( m_csv != nullptr )
+	{
+		std::fclose( m_csv );
+		m_csv = nullptr;
+	}
+
+	if ( path == nullptr )
+	{
+		return true;
+	}
+
+	m_csv = std::fopen( path, "w" );
+	if ( m_csv == nullptr )
+	{
+		sys::Error( "Could not open %s to stream GPU timings.", path );
+		return false;
+	}
+
+	std::fprintf( m_csv, "frame,zone,computeMs,renderMs,computeInvocations,vertexInvocations,fragmentInvocations\n" );
+
+	return true;
+}
+
+tracyGpuContext_t GPUProfiler::GetTracyContext( gpuProfileList_t list ) const
+{
+	return m_tracyContexts[ list ];
+}
+
+void GPUProfiler::CollectTracyZones( VkCommandBuffer cmdBuffer, gpuProfileList_t list )
+{
+	if ( m_tracyContexts[ list ] != nullptr )
+	{
+		RUNA_PROFILE_GPU_COLLECT( m_tracyContexts[ list ], cmdBuffer );
+	}
+}
+
+const char *GPUProfiler::GetZoneName( const gpuCmd_t &cmd )
+{
+	if ( cmd.profileName != nullptr )
+	{
+		return cmd.profileName;
+	}
+
+	switch ( cmd.type )
+	{
+		case CT_COMPUTE: return "Dispatch";
+		case CT_GRAPHIC: return "Draw";
+		case CT_UI: return "UI";
+		default: return "Unknown";
+	}
+}
+
+uint32_t GPUProfiler::GetNameId( const char *name )
+{
+	auto pos = m_nameIds.find( name );
+	if ( pos != m_nameIds.end() )
+	{
+		return pos->second;
+	}
+
+	const uint32_t id = static_cast< uint32_t >( m_names.size() );
+
+	m_names.emplace_back( name );
+	m_nameIds.emplace( m_names.back(), id );
+
+	return id;
+}
+
+void GPUProfiler::PublishTimings()
+{
+	m_timings.resize( m_windowTimings.size() );
+
+	for ( size_t i = 0; i < m_windowTimings.size(); ++i )
+	{
+		m_timings[ i ].computeMs = m_windowTimings[ i ].computeMs / double( m_windowFrames );
+		m_timings[ i ].renderMs	 = m_windowTimings[ i ].renderMs / double( m_windowFrames );
+	}
+
+	m_pipelineStatsAverages.resize( m_windowPipelineStats.size() );
+
+	for ( size_t i = 0; i < m_windowPipelineStats.size(); ++i )
+	{
+		const gpuPipelineStats_t &window  = m_windowPipelineStats[ i ];
+		gpuPipelineStats_t &	  average = m_pipelineStatsAverages[ i ];
+
+		average.computeInvocations	= window.computeInvocations / m_windowFrames;
+		average.vertexInvocations	= window.vertexInvocations / m_windowFrames;
+		average.fragmentInvocations = window.fragmentInvocations / m_windowFrames;
+	}
+
+	m_windowTimings.assign( m_windowTimings.size(), gpuTimings_t() );
+	m_windowPipelineStats.assign( m_windowPipelineStats.size(), gpuPipelineStats_t() );
+	m_windowFrames = 0;
+}
+
+} // namespace render
+} // namespace vkRuna
@@ -0,0 +1,166 @@
+// Copyright (c) 2021 Arno Galvez
+
+#pragma once
+
+#include "external/vulkan/vulkan.hpp"
+#include "platform/defines.h"
+#include "renderer/RenderConfig.h"
+#include "renderer/VkRenderCommon.h"
+
+#include <array>
+#include <cstdio>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Tracy GPU zones are only compiled in when its Vulkan client is available, see platform/Profiler.h.
+// Zones must be declared in the scope of the commands they time.
+#if defined( TRACY_ENABLE ) && __has_include( "external/tracy/TracyVulkan.hpp" )
+	#include "external/tracy/TracyVulkan.hpp"
+
+	#define RUNA_TRACY_VULKAN
+	#define RUNA_PROFILE_GPU_ZONE( ctx, cmdBuffer, name, active ) \
+		TracyVkZoneTransient( ctx, runaGpuZone, cmdBuffer, name, ( active ) && ( ctx ) != nullptr )
+	#define RUNA_PROFILE_GPU_COLLECT( ctx, cmdBuffer ) TracyVkCollect( ctx, cmdBuffer )
+#else
+	#define RUNA_PROFILE_GPU_ZONE( ctx, cmdBuffer, name, active ) ( void )( active )
+	#define RUNA_PROFILE_GPU_COLLECT( ctx, cmdBuffer ) ( void )( cmdBuffer )
+#endif
+
+namespace vkRuna
+{
+namespace render
+{
+#ifdef RUNA_TRACY_VULKAN
+using tracyGpuContext_t = TracyVkCtx;
+#else
+using tracyGpuContext_t = void *;
+#endif
+
+enum gpuProfileList_t
+{
+	GPL_PRE_RENDER, // Executed on the compute queue when VFXs simulate on the async compute queue
+	GPL_RENDER,
+	GPL_COUNT
+};
+
+// GPU time of the commands sharing a profile name, averaged over GPU_PROFILER_AVERAGE_FRAMES completed frames
+struct gpuTimings_t
+{
+	double computeMs = 0.0; // CT_COMPUTE dispatches
+	double renderMs	 = 0.0; // CT_GRAPHIC draws and CT_UI passes
+};
+
+// Shader invocations of the commands sharing a profile name, averaged like gpuTimings_t
+struct gpuPipelineStats_t
+{
+	uint64_t computeInvocations	 = 0;
+	uint64_t vertexInvocations	 = 0;
+	uint64_t fragmentInvocations = 0; // Grows with overdraw
+};
+
+// Times every CT_COMPUTE, CT_GRAPHIC and CT_UI command with a pair of timestamps. Each frame slot owns a query pool,
+// read once the fence of the frame it recorded has signaled: reading never waits on the GPU.
+// Commands are grouped by gpuCmd_t::profileName, the path of the VFX that issued them.
+// When GPU_PROFILER_PIPELINE_STATISTICS is set and the device supports it, a pipeline statistics query also counts the
+// shader invocations of every timed command.
+class GPUProfiler
+{
+	NO_COPY_NO_ASSIGN( GPUProfiler )
+
+   public:
+	GPUProfiler();
+	~GPUProfiler();
+
+	void Init();
+	void Shutdown();
+
+	// Assigns the queries of the frame recorded in slot, before any of its commands is recorded
+	void BeginFrame( uint32_t		 slot,
+					 uint64_t		 frameId,
+					 int			 preRenderCount,
+					 const gpuCmd_t *preRenderCmds,
+					 int			 renderCount,
+					 const gpuCmd_t *renderCmds );
+	// Recorded outside of a render pass, in the command buffer executing the list, before its first zone
+	void ResetQueries( VkCommandBuffer cmdBuffer, gpuProfileList_t list ) const;
+	// Safe to call from recording threads, commands that are not timed are ignored
+	void BeginZone( VkCommandBuffer cmdBuffer, gpuProfileList_t list, int cmdIndex ) const;
+	void EndZone( VkCommandBuffer cmdBuffer, gpuProfileList_t list, int cmdIndex ) const;
+	// frameId must have completed
+	void RetireFrame( uint64_t frameId );
+
+	gpuTimings_t	   GetTimings( const char *profileName ) const;
+	gpuPipelineStats_t GetPipelineStats( const char *profileName ) const;
+	bool			   HasPipelineStats() const { return m_pipelineStats; }
+
+	// Appends the timings of every completed frame to a CSV file, nullptr closes it
+	bool SetCsvPath( const char *path );
+
+	tracyGpuContext_t GetTracyContext( gpuProfileList_t list ) const;
+	// Outside of a render pass, once per frame and queue
+	void CollectTracyZones( VkCommandBuffer cmdBuffer, gpuProfileList_t list );
+
+	static const char *GetZoneName( const gpuCmd_t &cmd );
+
+   private:
+	struct zone_t
+	{
+		uint32_t		 nameId		= 0;
+		uint32_t		 firstQuery = 0; // Begin timestamp, followed by the end timestamp
+		gpuCmdType_t	 type		= CT_UNKNOWN;
+		gpuProfileList_t list		= GPL_RENDER;
+	};
+
+	struct frameQueries_t
+	{
+		VkQueryPool							 queryPool = VK_NULL_HANDLE; // Timestamps
+		uint64_t							 frameId   = 0;
+		bool								 pending   = false; // Recorded and not retired yet
+		std::array< uint32_t, GPL_COUNT >	 firstQuery {};
+		std::array< uint32_t, GPL_COUNT >	 queryCount {};
+		std::array< VkQueryPool, GPL_COUNT > statsPools {}; // One query per zone of the list
+		std::vector< zone_t >				 zones;
+	};
+
+	uint32_t GetNameId( const char *name );
+	void	 PublishTimings();
+
+   private:
+	std::array< frameQueries_t, SWAPCHAIN_BUFFERING_LEVEL > m_frames {};
+	uint32_t												m_current = 0;
+
+	// First query of each command of the frame being recorded, NO_QUERY when not timed
+	std::array< std::vector< uint32_t >, GPL_COUNT > m_cmdQueries;
+
+	std::array< bool, GPL_COUNT >	  m_timed {}; // The queue family executing the list writes timestamps
+	std::array< uint64_t, GPL_COUNT > m_timestampMasks {};
+	double							  m_nsPerTick	  = 1.0;
+	bool							  m_pipelineStats = false;
+
+	std::deque< std::string >						 m_names; // Stable storage for the keys of m_nameIds
+	std::unordered_map< std::string_view, uint32_t > m_nameIds;
+
+	std::vector< uint64_t >							m_results;
+	std::array< std::vector< uint64_t >, GPL_COUNT > m_statsResults;
+
+	// Per name
+	std::vector< gpuTimings_t >		  m_frameTimings;  // Of the frame being retired
+	std::vector< gpuTimings_t >		  m_windowTimings; // Summed over m_windowFrames
+	std::vector< gpuTimings_t >		  m_timings;	   // Published averages
+	std::vector< gpuPipelineStats_t > m_framePipelineStats;
+	std::vector< gpuPipelineStats_t > m_windowPipelineStats;
+	std::vector< gpuPipelineStats_t > m_pipelineStatsAverages;
+	uint32_t						  m_windowFrames = 0;
+
+	FILE *m_csv = nullptr;
+
+	std::array< tracyGpuContext_t, GPL_COUNT > m_tracyContexts {};
+};
+
+extern GPUProfiler g_gpuProfiler;
+
+} // namespace render
+} // namespace vkRuna
@@ -114,44 +114,41 @@ void Image::AllocImage( const imageOpts_t &imageOpts, const samplerOpts_t &sampl
 
 void Image::ClearVulkanResources()
 {
-	auto &device = GetVulkanContext().device;
-
-	if ( m_view != VK_NULL_HANDLE )
-	{
-		vkDestroyImageView( device, m_view, nullptr );
-		m_view = VK_NULL_HANDLE;
-	}
-
-	m_allocation.block->Free( m_allocation );
-
-	if ( m_image != VK_NULL_HANDLE )
-	{
-		vkDestroyImage( device, m_image, nullptr );
-		m_image = VK_NULL_HANDLE;
-	}
-
-	if ( m_sampler != VK_NULL_HANDLE )
-	{
-		vkDestroySampler( device, m_sampler, nullptr );
-		m_sampler = VK_NULL_HANDLE;
-	}
+	// Frames in flight may still use the image, the allocator destroys it once they are done
+	g_vulkanAllocator.FreeImage( m_image, m_view, m_sampler, m_allocation );
 }
 
-void Image::Upload( const VkOffset3D &offset,
-					const VkExtent3D &dimensions,
-					uint32_t		  mipLevel,
-					uint32_t		  firstDimLength,
-					uint32_t		  secondDimLength,
-					uint32_t		  bytesPerTexel,
-					byte *			  img )
+uploadHandle_t Image::Upload( const VkOffset3D &offset,
+							  const VkExtent3D &dimensions,
+							  uint32_t			mipLevel,
+							  uint32_t			firstDimLength,
+							  uint32_t			secondDimLength,
+							  uint32_t			bytesPerTexel,
+							  byte *			img )
 {
 	CHECK_PRED( m_opts.type == TT_1D || m_opts.type == TT_2D || m_opts.type == TT_3D );
 	CHECK_PRED( dimensions.width > 0 && dimensions.height > 0 && dimensions.depth > 0 && firstDimLength > 0 );
 
+	const VkDeviceSize size = VkDeviceSize( bytesPerTexel ) * dimensions.width * dimensions.height * dimensions.depth;
+	if ( size > g_gpuMail.GetRingSize() )
+	{
+		m_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		return g_gpuMail.StreamImage( m_image,
+									  VK_IMAGE_ASPECT_COLOR_BIT,
+									  mipLevel,
+									  offset,
+									  dimensions,
+									  firstDimLength,
+									  secondDimLength,
+									  bytesPerTexel,
+									  img,
+									  SDM_COPY );
+	}
+
 	VkBuffer		mailBuffer		 = VK_NULL_HANDLE;
 	VkDeviceSize	mailBufferOffset = UINT64_MAX;
 	VkCommandBuffer mailCmdBuffer	 = VK_NULL_HANDLE;
-	g_gpuMail.Submit( bytesPerTexel * dimensions.width * dimensions.height * dimensions.depth,
+	g_gpuMail.Submit( size,
 					  16,
 					  img,
 					  mailBuffer,
@@ -186,8 +183,9 @@ void Image::Upload( const VkOffset3D &offset,
 	imgBarrier.subresourceRange.baseArrayLayer = 0;
 	imgBarrier.subresourceRange.layerCount	   = VK_REMAINING_ARRAY_LAYERS;
 
+	// The mail command buffer may execute on a transfer only queue, the previous contents are discarded
 	vkCmdPipelineBarrier( mailCmdBuffer,
-						  VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+						  VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
 						  VK_PIPELINE_STAGE_TRANSFER_BIT,
 						  0,
 						  0,
@@ -209,18 +207,11 @@ void Image::Upload( const VkOffset3D &offset,
 	imgBarrier.srcAccessMask = imgBarrier.dstAccessMask;
 	imgBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
 
-	vkCmdPipelineBarrier( mailCmdBuffer,
-						  VK_PIPELINE_STAGE_TRANSFER_BIT,
-						  VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
-						  0,
-						  0,
-						  nullptr,
-						  0,
-						  nullptr,
-						  1,
-						  &imgBarrier );
+	g_gpuMail.Release( imgBarrier, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT );
 
 	m_layout = imgBarrier.newLayout;
+
+	return 0;
 }
 
 void Image::CreateSampler()
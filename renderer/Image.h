@@ -4,6 +4,7 @@
 
 #include "external/vulkan/vulkan.hpp"
 #include "platform/defines.h"
+#include "renderer/GPUMailManager.h"
 #include "renderer/VkAllocator.h"
 
 #include <string>
@@ -33,6 +34,9 @@ struct imageOpts_t
 	VkImageUsageFlags usageFlags = 0;
 };
 
+VkImageType		GetImageType( textureType_t textureType );
+VkImageViewType GetViewType( textureType_t textureType );
+
 struct samplerOpts_t
 {
 	VkFilter			 filter		 = VK_FILTER_LINEAR;
@@ -52,13 +56,14 @@ class Image
 	void AllocImage( const imageOpts_t &imageOpts, const samplerOpts_t &samplerOpts );
 	void ClearVulkanResources();
 
-	void Upload( const VkOffset3D &offset,
-				 const VkExtent3D &dimensions,
-				 uint32_t		   mipLevel,
-				 uint32_t		   firstDimLength,
-				 uint32_t		   secondDimLength,
-				 uint32_t		   bytesPerTexel,
-				 byte *			   img );
+	// Regions larger than the GPU mail ring are streamed, the image must not be sampled before the upload completes
+	uploadHandle_t Upload( const VkOffset3D &offset,
+						   const VkExtent3D &dimensions,
+						   uint32_t			 mipLevel,
+						   uint32_t			 firstDimLength,
+						   uint32_t			 secondDimLength,
+						   uint32_t			 bytesPerTexel,
+						   byte *			 img );
 
    public:
 	const std::string &GetName() const { return m_name; }
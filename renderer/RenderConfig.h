@@ -7,14 +7,45 @@ namespace vkRuna
 namespace render
 {
 static const int SWAPCHAIN_BUFFERING_LEVEL	   = 3;
+static const int FRAMES_IN_FLIGHT			   = 2; // Max frames submitted and not yet completed by the GPU
 static const int COMPUTE_CHAIN_BUFFERING_LEVEL = 3;
-static const int GPU_MAIL_BUFFERING_LEVEL	   = 3;
+static const int GPU_MAIL_BUFFERING_LEVEL	   = 8; // Mails in flight before GPUMailManager::Flush blocks
+
+static const int FRAME_ARENA_SIZE			  = 1 << 20;  // Bytes per frame region
+static const int GPU_MAIL_RING_SIZE			  = 64 << 20; // Staging bytes shared by all mails
+static const int GPU_MAIL_STREAM_CHUNK_SIZE	  = 4 << 20;
+static const int GPU_MAIL_STREAM_FRAME_BUDGET = 16 << 20; // Streamed bytes staged per frame
+
+static const double DEFRAG_FRAME_BUDGET_MS		= 0.5;
+static const int	DEFRAG_FRAME_BUDGET_BYTES	= 16 << 20;
+static const double DEFRAG_MAX_BLOCK_USAGE		= 0.25; // Blocks used above this ratio are not drained
+
+static const int BUFFER_POOL_BLOCK_SIZE = 256 << 10; // Bytes per block of g_staticBufferPool and g_perFrameBufferPool
+
+static const int RECORDING_MAX_THREADS	  = 8;  // Render thread included
+static const int RECORDING_THREAD_COUNT	  = 4;  // 1 records every command in the primary command buffer
+static const int RECORDING_MIN_RANGE_SIZE = 64; // Commands recorded by a thread at least
+
+static const bool		 GPU_PROFILER_ENABLE			  = true;
+static const bool		 GPU_PROFILER_PIPELINE_STATISTICS = true;	 // Counts shader invocations when supported
+static const int		 GPU_PROFILER_MAX_ZONES			  = 1024;	 // Timed commands per frame, others are skipped
+static const int		 GPU_PROFILER_AVERAGE_FRAMES	  = 32;		 // Completed frames averaged by GetTimings
+static const char *const GPU_PROFILER_CSV_PATH			  = nullptr; // Streams the timings of every frame when set
 
 static const int RENDERPROGS_SHARED_BLOCKS_POOL_SIZE = 512;
+static const int RENDERPROGS_MAX_DYNAMIC_UBOS		 = 16;
+
+static const double PIPELINE_CACHE_SAVE_INTERVAL_S = 30.0; // Min delay between two saves triggered by hot reloads
+
+static const int  SHADER_CACHE_MAX_SIZE		 = 64 << 20; // Bytes of SPIR-V on disk, the least recently used is evicted
+static const bool SHADER_DEBUG_DUMP			 = false;	 // Writes the generated GLSL and its SPIR-V next to the caches
+static const int  SHADER_COMPILE_MAX_THREADS = 8;		 // Loading thread included, capped by the core count
 
 static const int VFX_MAX_BUFFERS			= 8;
 static const int VFX_MAX_BUFFER_NAME_LENGTH = 61;
 
+static const bool VFX_ASYNC_COMPUTE = true; // Simulate on a compute only queue family when the device has one
+
 static const int VULKAN_FILL_BUFFER_ALIGNMENT = 4;
 
 static const int COMPUTE_GROUP_SIZE_X = 32;
@@ -0,0 +1,1148 @@
+// Copyright (c) 2021 Arno Galvez
+
+#include "renderer/RenderGraph.h"
+
+#include "renderer/Check.h"
+#include "renderer/RenderConfig.h"
+#include "renderer/VkBackend.h"
+#include "rnLib/Hash.h"
+#include "rnLib/Math.h"
+
+#include <algorithm>
+#include <numeric>
+
+namespace vkRuna
+{
+namespace render
+{
+RenderGraph g_renderGraph;
+
+static const VkAccessFlags WRITE_ACCESS_MASK = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+											   VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+											   VK_ACCESS_TRANSFER_WRITE_BIT;
+
+// Render passes share a group while the groups are assigned, pre-render passes must not depend on them
+static const int32_t RENDER_GROUP = INT32_MAX / 2;
+
+struct usageInfo_t
+{
+	VkPipelineStageFlags stages		= 0;
+	VkAccessFlags		 access		= 0;
+	VkImageLayout		 layout		= VK_IMAGE_LAYOUT_UNDEFINED; // Of images only
+	bool				 write		= false;
+	bool				 attachment = false;
+};
+
+static usageInfo_t GetUsageInfo( rgUsage_t usage )
+{
+	usageInfo_t info;
+
+	switch ( usage )
+	{
+		case RGU_TRANSFER_SRC:
+		{
+			info.stages = VK_PIPELINE_STAGE_TRANSFER_BIT;
+			info.access = VK_ACCESS_TRANSFER_READ_BIT;
+			info.layout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+			break;
+		}
+		case RGU_TRANSFER_DST:
+		{
+			info.stages = VK_PIPELINE_STAGE_TRANSFER_BIT;
+			info.access = VK_ACCESS_TRANSFER_WRITE_BIT;
+			info.layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			break;
+		}
+		case RGU_COMPUTE_READ:
+		{
+			info.stages = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+			info.access = VK_ACCESS_SHADER_READ_BIT;
+			info.layout = VK_IMAGE_LAYOUT_GENERAL;
+			break;
+		}
+		case RGU_COMPUTE_WRITE:
+		{
+			info.stages = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+			info.access = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+			info.layout = VK_IMAGE_LAYOUT_GENERAL;
+			break;
+		}
+		case RGU_GRAPHICS_READ:
+		{
+			info.stages = VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+			info.access = VK_ACCESS_SHADER_READ_BIT;
+			info.layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			break;
+		}
+		case RGU_COLOR_ATTACHMENT:
+		{
+			info.stages		= VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+			info.access		= VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+			info.layout		= VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+			info.attachment = true;
+			break;
+		}
+		case RGU_DEPTH_ATTACHMENT:
+		{
+			info.stages = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+			info.access = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+			info.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+			info.attachment = true;
+			break;
+		}
+		case RGU_COUNT:
+		default: CHECK_PRED( false ); break;
+	}
+
+	info.write = ( info.access & WRITE_ACCESS_MASK ) != 0;
+
+	return info;
+}
+
+static VkImageAspectFlags GetAspectMask( textureType_t type )
+{
+	return type == TT_DEPTH ? VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+}
+
+static void GetImageCreateInfo( const imageOpts_t &opts, VkImageCreateInfo &imageCI )
+{
+	imageCI						  = {};
+	imageCI.sType				  = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageCI.pNext				  = nullptr;
+	imageCI.flags				  = opts.type == TT_CUBE ? VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT : 0;
+	imageCI.imageType			  = GetImageType( opts.type );
+	imageCI.format				  = opts.format;
+	imageCI.extent.width		  = opts.width;
+	imageCI.extent.height		  = opts.height;
+	imageCI.extent.depth		  = opts.depth;
+	imageCI.mipLevels			  = opts.mipLevels;
+	imageCI.arrayLayers			  = opts.type == TT_CUBE ? 6 : 1;
+	imageCI.samples				  = VK_SAMPLE_COUNT_1_BIT;
+	imageCI.tiling				  = VK_IMAGE_TILING_OPTIMAL;
+	imageCI.usage				  = opts.usageFlags;
+	imageCI.sharingMode			  = VK_SHARING_MODE_EXCLUSIVE;
+	imageCI.queueFamilyIndexCount = 0;
+	imageCI.pQueueFamilyIndices	  = nullptr;
+	imageCI.initialLayout		  = VK_IMAGE_LAYOUT_UNDEFINED;
+}
+
+// Keeps the capacity of the vectors from frame to frame
+static void ClearBarrier( gpuBarrier_t &barrier )
+{
+	barrier.srcStageMask = 0;
+	barrier.dstStageMask = 0;
+	barrier.bufferBarriers.clear();
+	barrier.imageBarriers.clear();
+}
+
+void RenderGraph::state_t::ResetSync()
+{
+	writeStages	  = 0;
+	writeAccess	  = 0;
+	readStages	  = 0;
+	visibleStages = 0;
+	visibleAccess = 0;
+	writeGroup	  = UINT32_MAX;
+	writeFrame	  = 0;
+}
+
+bool RenderGraph::state_t::SameSync( const state_t &other ) const
+{
+	// The frame fields only matter within the frame that set them
+	return writeStages == other.writeStages && writeAccess == other.writeAccess && readStages == other.readStages &&
+		   visibleStages == other.visibleStages && visibleAccess == other.visibleAccess && layout == other.layout &&
+		   familyId == other.familyId;
+}
+
+size_t RenderGraph::bufferKeyHash_t::operator()( const bufferKey_t &key ) const
+{
+	return std::hash< VkBuffer >()( key.buffer ) ^ std::hash< VkDeviceSize >()( key.offset ) * 31;
+}
+
+RenderGraph::RenderGraph() {}
+
+RenderGraph::~RenderGraph() {}
+
+void RenderGraph::Init( VkImageLayout presentLayout )
+{
+	m_presentLayout = presentLayout;
+}
+
+void RenderGraph::Shutdown()
+{
+	FreeTransients();
+
+	m_transients.clear();
+	m_transientHeapSize = 0;
+	++m_transientsVersion;
+
+	m_depthBuffer = RG_NULL_RESOURCE;
+
+	m_resources.clear();
+	m_uses.clear();
+	m_passes.clear();
+	m_passCmds.clear();
+	m_tracks.clear();
+	m_order.clear();
+	m_bufferStates.clear();
+	m_groupBarriers.clear();
+	m_preRenderCmds.clear();
+	m_renderCmds.clear();
+	m_renderPassBarrier = gpuBarrier_t();
+	m_postRenderBarrier = gpuBarrier_t();
+	m_compiled.fill( compiled_t() );
+}
+
+rgResource_t RenderGraph::CreateTransientImage( const char *name, const imageOpts_t &opts )
+{
+	auto &vulkanContext = GetVulkanContext();
+
+	auto it = std::find_if( m_transients.begin(),
+							m_transients.end(),
+							[]( const transient_t &transient ) { return !transient.alive; } );
+	if ( it == m_transients.end() )
+	{
+		it = m_transients.emplace( m_transients.end() );
+	}
+
+	transient_t &transient = *it;
+	transient			   = transient_t();
+	transient.name		   = name;
+	transient.opts		   = opts;
+	transient.alive		   = true;
+
+	// The requirements only depend on the creation parameters, the image bound to the heap is created on repacking
+	VkImageCreateInfo imageCI;
+	GetImageCreateInfo( opts, imageCI );
+
+	VkImage image = VK_NULL_HANDLE;
+	VK_CHECK( vkCreateImage( vulkanContext.device, &imageCI, nullptr, &image ) );
+	vkGetImageMemoryRequirements( vulkanContext.device, image, &transient.requirements );
+	vkDestroyImage( vulkanContext.device, image, nullptr );
+
+	RepackTransients();
+
+	return BACKBUFFER + 1 + static_cast< rgResource_t >( it - m_transients.begin() );
+}
+
+void RenderGraph::DestroyTransientImage( rgResource_t image )
+{
+	const uint32_t index = GetTransientIndex( image );
+	CHECK_PRED( index != UINT32_MAX && m_transients[ index ].alive );
+
+	transient_t &transient = m_transients[ index ];
+
+	// Other images keep their place in the heap, it is packed again when a frame uses them
+	vulkanAllocation_t noAllocation;
+	VkSampler		   noSampler = VK_NULL_HANDLE;
+	g_vulkanAllocator.FreeImage( transient.image, transient.view, noSampler, noAllocation );
+
+	transient.alive = false;
+
+	if ( m_depthBuffer == image )
+	{
+		m_depthBuffer = RG_NULL_RESOURCE;
+	}
+}
+
+VkImageView RenderGraph::GetImageView( rgResource_t image ) const
+{
+	const uint32_t index = GetTransientIndex( image );
+	CHECK_PRED( index != UINT32_MAX && m_transients[ index ].alive );
+
+	return m_transients[ index ].view;
+}
+
+void RenderGraph::BeginFrame()
+{
+	++m_frameId;
+
+	m_resources.clear();
+	m_uses.clear();
+	m_passes.clear();
+	m_passCmds.clear();
+
+	// Acquiring the backbuffer waits on the presentation engine at the color attachment output stage, its previous
+	// contents are discarded
+	m_backbufferState.ResetSync();
+	m_backbufferState.writeStages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	m_backbufferState.layout	  = VK_IMAGE_LAYOUT_UNDEFINED;
+	m_backbufferState.familyId	  = GetVulkanContext().graphicsFamilyId;
+	m_backbufferState.frameId	  = m_frameId;
+
+	resource_t backbuffer;
+	backbuffer.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	backbuffer.state	  = &m_backbufferState;
+	m_resources.emplace_back( backbuffer );
+
+	for ( transient_t &transient : m_transients )
+	{
+		resource_t resource;
+		resource.image		= transient.image;
+		resource.aspectMask = GetAspectMask( transient.opts.type );
+		resource.state		= &transient.state;
+		m_resources.emplace_back( resource );
+	}
+
+	// Every render pass draws after the clears of the attachments
+	AddPass( "Clear", RGP_RENDER );
+	Use( BACKBUFFER, RGU_COLOR_ATTACHMENT );
+	if ( m_depthBuffer != RG_NULL_RESOURCE )
+	{
+		Use( m_depthBuffer, RGU_DEPTH_ATTACHMENT );
+	}
+}
+
+rgResource_t RenderGraph::ImportBuffer( VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size )
+{
+	bufferKey_t key;
+	key.buffer = buffer;
+	key.offset = offset;
+
+	// A range imported several times is a single resource
+	state_t &state = m_bufferStates[ key ];
+	if ( state.frameId == m_frameId )
+	{
+		return state.resource;
+	}
+
+	state.frameId  = m_frameId;
+	state.resource = static_cast< rgResource_t >( m_resources.size() );
+
+	resource_t resource;
+	resource.buffer = buffer;
+	resource.offset = offset;
+	resource.size	= size;
+	resource.state	= &state;
+	m_resources.emplace_back( resource );
+
+	return state.resource;
+}
+
+void RenderGraph::AddPass( const char *name, rgPassType_t type )
+{
+	pass_t pass;
+	pass.name	  = name;
+	pass.type	  = type;
+	pass.firstUse = static_cast< uint32_t >( m_uses.size() );
+	pass.firstCmd = static_cast< uint32_t >( m_passCmds.size() );
+	m_passes.emplace_back( pass );
+}
+
+void RenderGraph::Use( rgResource_t resource, rgUsage_t usage )
+{
+	CHECK_PRED( !m_passes.empty() );
+	CHECK_PRED( resource < m_resources.size() && usage < RGU_COUNT );
+
+	const uint32_t transient = GetTransientIndex( resource );
+	CHECK_PRED( transient == UINT32_MAX || m_transients[ transient ].alive );
+
+	use_t use;
+	use.resource = resource;
+	use.usage	 = usage;
+	m_uses.emplace_back( use );
+
+	++m_passes.back().useCount;
+}
+
+void RenderGraph::AddCmd( const gpuCmd_t &cmd )
+{
+	CHECK_PRED( !m_passes.empty() );
+
+	m_passCmds.emplace_back( cmd );
+
+	++m_passes.back().cmdCount;
+}
+
+void RenderGraph::Compile()
+{
+	// Frames in flight import different ranges of the same buffers, each frame index reuses its own compilation
+	compiled_t &   compiled = m_compiled[ g_frameArena.GetFrameIndex() ];
+	const uint64_t hash		= HashDeclarations();
+
+	if ( Reuse( compiled, hash ) )
+	{
+		++m_reusedCount;
+	}
+	else
+	{
+		AssignGroups();
+		UpdateLifetimes();
+		RepackTransients();
+
+		for ( size_t i = 0; i < m_transients.size(); ++i )
+		{
+			m_resources[ BACKBUFFER + 1 + i ].image = m_transients[ i ].image;
+		}
+
+		compiled.entryStates.resize( m_resources.size() );
+		for ( size_t i = 0; i < m_resources.size(); ++i )
+		{
+			compiled.entryStates[ i ] = *m_resources[ i ].state;
+		}
+
+		m_groupBarriers.resize( m_groupCount );
+		for ( gpuBarrier_t &barrier : m_groupBarriers )
+		{
+			ClearBarrier( barrier );
+		}
+		ClearBarrier( m_renderPassBarrier );
+		ClearBarrier( m_postRenderBarrier );
+
+		const auto &vulkanContext = GetVulkanContext();
+
+		for ( uint32_t passIndex : m_order )
+		{
+			const pass_t &pass		 = m_passes[ passIndex ];
+			const bool	  renderPass = pass.type == RGP_RENDER;
+
+			const uint32_t familyId = renderPass ? vulkanContext.graphicsFamilyId : vulkanContext.computeFamilyId;
+			gpuBarrier_t & barrier	= renderPass ? m_renderPassBarrier : m_groupBarriers[ pass.group ];
+
+			for ( uint32_t i = pass.firstUse; i < pass.firstUse + pass.useCount; ++i )
+			{
+				Access( m_uses[ i ].resource, m_uses[ i ].usage, familyId, pass.group, barrier );
+			}
+		}
+
+		Present();
+
+		Store( compiled, hash );
+		++m_compiledCount;
+	}
+
+	// Commands change every frame, only the barriers they wait on are reused
+	m_preRenderCmds.clear();
+	m_renderCmds.clear();
+
+	uint32_t group = UINT32_MAX;
+	for ( uint32_t passIndex : m_order )
+	{
+		const pass_t &pass = m_passes[ passIndex ];
+
+		if ( pass.type == RGP_PRE_RENDER && pass.group != group )
+		{
+			group = pass.group;
+
+			if ( m_groupBarriers[ group ].srcStageMask != 0 )
+			{
+				gpuCmd_t barrierCmd;
+				barrierCmd.type = CT_BARRIER;
+				barrierCmd.obj	= &m_groupBarriers[ group ];
+				m_preRenderCmds.emplace_back( barrierCmd );
+			}
+		}
+
+		std::vector< gpuCmd_t > &cmds = pass.type == RGP_RENDER ? m_renderCmds : m_preRenderCmds;
+		cmds.insert( cmds.end(),
+					 m_passCmds.begin() + pass.firstCmd,
+					 m_passCmds.begin() + pass.firstCmd + pass.cmdCount );
+	}
+
+	PruneBufferStates();
+}
+
+int RenderGraph::GetPreRenderCmds( gpuCmd_t **cmds )
+{
+	*cmds = m_preRenderCmds.data();
+
+	return static_cast< int >( m_preRenderCmds.size() );
+}
+
+int RenderGraph::GetRenderCmds( gpuCmd_t **cmds )
+{
+	*cmds = m_renderCmds.data();
+
+	return static_cast< int >( m_renderCmds.size() );
+}
+
+void RenderGraph::BindBackbuffer( VkImage image )
+{
+	// The barriers were compiled with the image bound before, or VK_NULL_HANDLE
+	const VkImage previous = m_resources.empty() ? VK_NULL_HANDLE : m_resources[ BACKBUFFER ].image;
+
+	auto patch = [ previous, image ]( gpuBarrier_t &barrier ) {
+		for ( VkImageMemoryBarrier &imageBarrier : barrier.imageBarriers )
+		{
+			if ( imageBarrier.image == previous )
+			{
+				imageBarrier.image = image;
+			}
+		}
+	};
+
+	for ( gpuBarrier_t &barrier : m_groupBarriers )
+	{
+		patch( barrier );
+	}
+	patch( m_renderPassBarrier );
+	patch( m_postRenderBarrier );
+
+	if ( !m_resources.empty() )
+	{
+		m_resources[ BACKBUFFER ].image = image;
+	}
+}
+
+rgStats_t RenderGraph::GetStats() const
+{
+	rgStats_t stats;
+	stats.passCount	 = static_cast< uint32_t >( m_passes.size() );
+	stats.groupCount = m_groupCount;
+
+	auto count = [ &stats ]( const gpuBarrier_t &barrier ) {
+		if ( barrier.srcStageMask == 0 )
+		{
+			return;
+		}
+
+		++stats.barrierCount;
+		stats.bufferBarrierCount += static_cast< uint32_t >( barrier.bufferBarriers.size() );
+		stats.imageBarrierCount += static_cast< uint32_t >( barrier.imageBarriers.size() );
+	};
+
+	for ( const gpuBarrier_t &barrier : m_groupBarriers )
+	{
+		count( barrier );
+	}
+	count( m_renderPassBarrier );
+	count( m_postRenderBarrier );
+
+	for ( const transient_t &transient : m_transients )
+	{
+		if ( transient.alive )
+		{
+			stats.transientSize += transient.requirements.size;
+		}
+	}
+	stats.transientHeapSize = m_transientHeapSize;
+	stats.compiledCount		= m_compiledCount;
+	stats.reusedCount		= m_reusedCount;
+
+	return stats;
+}
+
+uint32_t RenderGraph::GetTransientIndex( rgResource_t resource ) const
+{
+	if ( resource == BACKBUFFER || resource > m_transients.size() )
+	{
+		return UINT32_MAX;
+	}
+
+	return resource - BACKBUFFER - 1;
+}
+
+uint64_t RenderGraph::HashDeclarations() const
+{
+	// Resource handles follow the import order, the ranges they stand for are hashed along with their usages
+	uint64_t hash = FNV1A_OFFSET_BASIS;
+	auto	 add  = [ &hash ]( const auto &value ) { hash = HashFNV1a( &value, sizeof( value ), hash ); };
+
+	add( HasAsyncCompute() );
+
+	for ( const resource_t &resource : m_resources )
+	{
+		add( resource.buffer );
+		add( resource.offset );
+		add( resource.size );
+		add( resource.aspectMask );
+	}
+
+	for ( const transient_t &transient : m_transients )
+	{
+		add( transient.alive );
+	}
+
+	for ( const pass_t &pass : m_passes )
+	{
+		add( pass.type );
+		add( pass.useCount );
+	}
+
+	for ( const use_t &use : m_uses )
+	{
+		add( use.resource );
+		add( use.usage );
+	}
+
+	return hash;
+}
+
+bool RenderGraph::Reuse( compiled_t &compiled, uint64_t hash )
+{
+	// Transient images are repacked for the groups of other frames, and their handles change
+	if ( compiled.hash != hash || compiled.transientsVersion != m_transientsVersion ||
+		 compiled.entryStates.size() != m_resources.size() || compiled.lifetimes.size() != m_transients.size() )
+	{
+		return false;
+	}
+
+	for ( size_t i = 0; i < m_transients.size(); ++i )
+	{
+		const transient_t &transient = m_transients[ i ];
+		const lifetime_t & lifetime	 = compiled.lifetimes[ i ];
+		if ( transient.firstGroup != lifetime.firstGroup || transient.lastGroup != lifetime.lastGroup )
+		{
+			return false;
+		}
+	}
+
+	// The first frames wait on nothing, or on the frames declared before a change
+	for ( size_t i = 0; i < m_resources.size(); ++i )
+	{
+		if ( !m_resources[ i ].state->SameSync( compiled.entryStates[ i ] ) )
+		{
+			return false;
+		}
+	}
+
+	for ( size_t i = 0; i < m_passes.size(); ++i )
+	{
+		m_passes[ i ].group = compiled.groups[ i ];
+	}
+	m_groupCount = compiled.groupCount;
+
+	// Copies keep the capacity of the vectors. The barriers were compiled before the backbuffer was bound.
+	m_order				= compiled.order;
+	m_groupBarriers		= compiled.groupBarriers;
+	m_renderPassBarrier = compiled.renderPassBarrier;
+	m_postRenderBarrier = compiled.postRenderBarrier;
+
+	for ( size_t i = 0; i < m_resources.size(); ++i )
+	{
+		// Shifted to this frame, the states stored are those of the frame compiled
+		state_t &		   state	= *m_resources[ i ].state;
+		const rgResource_t resource = state.resource;
+
+		state		   = compiled.exitStates[ i ];
+		state.resource = resource;
+		if ( state.frameId == compiled.frameId )
+		{
+			state.frameId = m_frameId;
+		}
+		if ( state.writeFrame == compiled.frameId )
+		{
+			state.writeFrame = m_frameId;
+		}
+	}
+
+	return true;
+}
+
+void RenderGraph::Store( compiled_t &compiled, uint64_t hash ) const
+{
+	compiled.hash			   = hash;
+	compiled.transientsVersion = m_transientsVersion;
+	compiled.frameId		   = m_frameId;
+
+	compiled.lifetimes.resize( m_transients.size() );
+	for ( size_t i = 0; i < m_transients.size(); ++i )
+	{
+		compiled.lifetimes[ i ].firstGroup = m_transients[ i ].firstGroup;
+		compiled.lifetimes[ i ].lastGroup  = m_transients[ i ].lastGroup;
+	}
+
+	compiled.exitStates.resize( m_resources.size() );
+	for ( size_t i = 0; i < m_resources.size(); ++i )
+	{
+		compiled.exitStates[ i ] = *m_resources[ i ].state;
+	}
+
+	compiled.groups.resize( m_passes.size() );
+	for ( size_t i = 0; i < m_passes.size(); ++i )
+	{
+		compiled.groups[ i ] = m_passes[ i ].group;
+	}
+	compiled.groupCount = m_groupCount;
+
+	compiled.order			   = m_order;
+	compiled.groupBarriers	   = m_groupBarriers;
+	compiled.renderPassBarrier = m_renderPassBarrier;
+	compiled.postRenderBarrier = m_postRenderBarrier;
+}
+
+void RenderGraph::AssignGroups()
+{
+	m_tracks.assign( m_resources.size(), track_t() );
+	m_groupCount = 0;
+
+	for ( pass_t &pass : m_passes )
+	{
+		// A pass runs after the last write of the resources it uses, and after the reads of those it writes. Images
+		// changing layout are written by the transition.
+		int32_t group = 0;
+		for ( uint32_t i = pass.firstUse; i < pass.firstUse + pass.useCount; ++i )
+		{
+			const use_t &		use	  = m_uses[ i ];
+			const track_t &		track = m_tracks[ use.resource ];
+			const usageInfo_t	info  = GetUsageInfo( use.usage );
+			const bool			write = info.write || ( m_resources[ use.resource ].aspectMask != 0 &&
+														track.layout != info.layout );
+
+			group = std::max( group, track.writeGroup + 1 );
+			if ( write )
+			{
+				group = std::max( group, track.readGroup + 1 );
+			}
+		}
+
+		if ( pass.type == RGP_RENDER )
+		{
+			group = RENDER_GROUP;
+		}
+		else
+		{
+			CHECK_PRED( group < RENDER_GROUP ); // Depends on a render pass of the frame
+			m_groupCount = std::max( m_groupCount, static_cast< uint32_t >( group + 1 ) );
+		}
+
+		pass.group = static_cast< uint32_t >( group );
+
+		for ( uint32_t i = pass.firstUse; i < pass.firstUse + pass.useCount; ++i )
+		{
+			const use_t &	  use	= m_uses[ i ];
+			track_t &		  track = m_tracks[ use.resource ];
+			const usageInfo_t info	= GetUsageInfo( use.usage );
+			const bool		  image = m_resources[ use.resource ].aspectMask != 0;
+
+			if ( info.write || ( image && track.layout != info.layout ) )
+			{
+				track.writeGroup = group;
+				track.readGroup	 = -1;
+			}
+			else
+			{
+				track.readGroup = std::max( track.readGroup, group );
+			}
+
+			if ( image )
+			{
+				track.layout = info.layout;
+			}
+		}
+	}
+
+	// Render passes follow every pre-render group
+	for ( pass_t &pass : m_passes )
+	{
+		if ( pass.type == RGP_RENDER )
+		{
+			pass.group = m_groupCount;
+		}
+	}
+
+	m_order.resize( m_passes.size() );
+	std::iota( m_order.begin(), m_order.end(), 0 );
+	std::stable_sort( m_order.begin(), m_order.end(), [ this ]( uint32_t a, uint32_t b ) {
+		return m_passes[ a ].group < m_passes[ b ].group;
+	} );
+}
+
+void RenderGraph::UpdateLifetimes()
+{
+	for ( const pass_t &pass : m_passes )
+	{
+		for ( uint32_t i = pass.firstUse; i < pass.firstUse + pass.useCount; ++i )
+		{
+			resource_t &resource = m_resources[ m_uses[ i ].resource ];
+			resource.firstGroup	 = std::min( resource.firstGroup, pass.group );
+			resource.lastGroup	 = std::max( resource.lastGroup, pass.group );
+		}
+	}
+
+	for ( size_t i = 0; i < m_transients.size(); ++i )
+	{
+		const resource_t &resource	= m_resources[ BACKBUFFER + 1 + i ];
+		transient_t &	  transient = m_transients[ i ];
+
+		if ( resource.firstGroup == UINT32_MAX )
+		{
+			continue; // Unused by the frame, keeps the groups it was packed with
+		}
+
+		transient.firstGroup = resource.firstGroup;
+		transient.lastGroup	 = resource.lastGroup;
+
+		// The async compute queue runs the pre-render groups of a frame alongside the render pass of the previous
+		// one, their images never share memory with the render pass ones
+		if ( HasAsyncCompute() && transient.firstGroup < m_groupCount )
+		{
+			transient.lastGroup = UINT32_MAX;
+		}
+	}
+}
+
+void RenderGraph::PackTransients( std::vector< VkDeviceSize > &offsets, VkDeviceSize &heapSize ) const
+{
+	offsets.assign( m_transients.size(), 0 );
+	heapSize = 0;
+
+	std::vector< uint32_t > order;
+	for ( uint32_t i = 0; i < m_transients.size(); ++i )
+	{
+		if ( m_transients[ i ].alive )
+		{
+			order.emplace_back( i );
+		}
+	}
+
+	// Largest first, each image is placed at the lowest offset free of the images it overlaps in time
+	std::stable_sort( order.begin(), order.end(), [ this ]( uint32_t a, uint32_t b ) {
+		return m_transients[ a ].requirements.size > m_transients[ b ].requirements.size;
+	} );
+
+	for ( size_t i = 0; i < order.size(); ++i )
+	{
+		const transient_t &transient = m_transients[ order[ i ] ];
+		const VkDeviceSize size		 = transient.requirements.size;
+
+		VkDeviceSize offset = 0;
+		bool		 moved	= true;
+		while ( moved )
+		{
+			moved  = false;
+			offset = Align( offset, transient.requirements.alignment );
+
+			for ( size_t j = 0; j < i; ++j )
+			{
+				const transient_t &placed		= m_transients[ order[ j ] ];
+				const VkDeviceSize placedOffset = offsets[ order[ j ] ];
+				const VkDeviceSize placedEnd	= placedOffset + placed.requirements.size;
+
+				const bool timeOverlap =
+					transient.firstGroup <= placed.lastGroup && placed.firstGroup <= transient.lastGroup;
+
+				if ( timeOverlap && offset < placedEnd && placedOffset < offset + size )
+				{
+					offset = placedEnd;
+					moved  = true;
+				}
+			}
+		}
+
+		offsets[ order[ i ] ] = offset;
+		heapSize			  = std::max( heapSize, offset + size );
+	}
+}
+
+void RenderGraph::RepackTransients()
+{
+	std::vector< VkDeviceSize > offsets;
+	VkDeviceSize				heapSize;
+	PackTransients( offsets, heapSize );
+
+	bool changed = heapSize != m_transientHeapSize;
+	for ( size_t i = 0; i < m_transients.size() && !changed; ++i )
+	{
+		const transient_t &transient = m_transients[ i ];
+		changed = transient.alive && ( transient.image == VK_NULL_HANDLE || transient.offset != offsets[ i ] );
+	}
+
+	if ( !changed )
+	{
+		return;
+	}
+
+	FreeTransients();
+
+	for ( size_t i = 0; i < m_transients.size(); ++i )
+	{
+		m_transients[ i ].offset = offsets[ i ];
+	}
+	m_transientHeapSize = heapSize;
+
+	AllocTransients();
+
+	++m_transientsVersion;
+}
+
+void RenderGraph::AllocTransients()
+{
+	auto &vulkanContext = GetVulkanContext();
+
+	// A single allocation holds every image, any memory type it uses must suit all of them
+	VkMemoryRequirements requirements {};
+	requirements.size			= m_transientHeapSize;
+	requirements.alignment		= 1;
+	requirements.memoryTypeBits = UINT32_MAX;
+
+	bool empty = true;
+	for ( const transient_t &transient : m_transients )
+	{
+		if ( transient.alive )
+		{
+			requirements.alignment = std::max( requirements.alignment, transient.requirements.alignment );
+			requirements.memoryTypeBits &= transient.requirements.memoryTypeBits;
+			empty = false;
+		}
+	}
+
+	if ( empty )
+	{
+		return;
+	}
+
+	CHECK_PRED( requirements.memoryTypeBits != 0 );
+
+	m_transientHeap =
+		g_vulkanAllocator.Alloc( VULKAN_ALLOCATION_TYPE_IMAGE_OPTIMAL, VULKAN_MEMORY_USAGE_GPU_ONLY, requirements );
+
+	for ( transient_t &transient : m_transients )
+	{
+		if ( !transient.alive )
+		{
+			continue;
+		}
+
+		VkImageCreateInfo imageCI;
+		GetImageCreateInfo( transient.opts, imageCI );
+
+		VK_CHECK( vkCreateImage( vulkanContext.device, &imageCI, nullptr, &transient.image ) );
+		VK_CHECK( vkBindImageMemory( vulkanContext.device,
+									 transient.image,
+									 m_transientHeap.deviceMemory,
+									 m_transientHeap.offset + transient.offset ) );
+
+		const VkComponentMapping componentMapping = { VK_COMPONENT_SWIZZLE_R,
+													  VK_COMPONENT_SWIZZLE_G,
+													  VK_COMPONENT_SWIZZLE_B,
+													  VK_COMPONENT_SWIZZLE_A };
+		VkImageViewCreateInfo	 imageViewCI {};
+		imageViewCI.sType							= VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		imageViewCI.pNext							= nullptr;
+		imageViewCI.flags							= 0;
+		imageViewCI.image							= transient.image;
+		imageViewCI.viewType						= GetViewType( transient.opts.type );
+		imageViewCI.format							= transient.opts.format;
+		imageViewCI.components						= componentMapping;
+		imageViewCI.subresourceRange.aspectMask		= GetAspectMask( transient.opts.type );
+		imageViewCI.subresourceRange.baseMipLevel	= 0;
+		imageViewCI.subresourceRange.levelCount		= transient.opts.mipLevels;
+		imageViewCI.subresourceRange.baseArrayLayer = 0;
+		imageViewCI.subresourceRange.layerCount		= imageCI.arrayLayers;
+
+		VK_CHECK( vkCreateImageView( vulkanContext.device, &imageViewCI, nullptr, &transient.view ) );
+
+		// New memory, the contents are undefined
+		transient.state.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+	}
+}
+
+void RenderGraph::FreeTransients()
+{
+	// Frames in flight may still use the images, the allocator destroys them once they are done
+	for ( transient_t &transient : m_transients )
+	{
+		vulkanAllocation_t noAllocation;
+		VkSampler		   noSampler = VK_NULL_HANDLE;
+		g_vulkanAllocator.FreeImage( transient.image, transient.view, noSampler, noAllocation );
+	}
+
+	g_vulkanAllocator.Free( m_transientHeap );
+}
+
+bool RenderGraph::Alias( const transient_t &a, const transient_t &b )
+{
+	return a.offset < b.offset + b.requirements.size && b.offset < a.offset + a.requirements.size;
+}
+
+void RenderGraph::DiscardTransient( transient_t &transient, uint32_t familyId )
+{
+	// The first usage of the frame waits on the last usages of the images sharing its memory, itself included
+	VkPipelineStageFlags stages = 0;
+	VkAccessFlags		 access = 0;
+	for ( const transient_t &other : m_transients )
+	{
+		if ( other.alive && other.state.familyId == familyId && Alias( transient, other ) )
+		{
+			stages |= other.state.writeStages | other.state.readStages;
+			access |= other.state.writeAccess;
+		}
+	}
+
+	state_t &state = transient.state;
+	state.ResetSync();
+	state.writeStages = stages;
+	state.writeAccess = access;
+	state.layout	  = VK_IMAGE_LAYOUT_UNDEFINED;
+	state.familyId	  = familyId;
+}
+
+void RenderGraph::Access( rgResource_t	resourceHandle,
+						  rgUsage_t		usage,
+						  uint32_t		familyId,
+						  uint32_t		group,
+						  gpuBarrier_t &barrier )
+{
+	const resource_t &resource = m_resources[ resourceHandle ];
+	state_t &		  state	   = *resource.state;
+	const usageInfo_t info	   = GetUsageInfo( usage );
+
+	const uint32_t transient = GetTransientIndex( resourceHandle );
+	if ( transient != UINT32_MAX && state.frameId != m_frameId )
+	{
+		DiscardTransient( m_transients[ transient ], familyId );
+	}
+	state.frameId = m_frameId;
+
+	const bool image	  = resource.aspectMask != 0;
+	const bool transition = image && state.layout != info.layout;
+	const bool write	  = info.write || transition;
+
+	// Semaphores order the usages of different queue families. The state keeps tracking the family that last wrote,
+	// whose next usages still wait on its last write.
+	if ( state.familyId != familyId )
+	{
+		if ( !write && state.familyId != UINT32_MAX )
+		{
+			CHECK_PRED( !image ); // Images are not shared by queue families
+			return;
+		}
+
+		state.ResetSync();
+		state.familyId = familyId;
+	}
+
+	VkPipelineStageFlags srcStages = 0;
+	VkAccessFlags		 srcAccess = 0;
+	bool				 dependency;
+	if ( write )
+	{
+		// Reads since the last write already made it available, only their execution is waited on
+		srcStages  = state.writeStages | state.readStages;
+		srcAccess  = state.readStages != 0 ? 0 : state.writeAccess;
+		dependency = srcStages != 0 || transition;
+	}
+	else
+	{
+		const bool visible = ( state.visibleStages & info.stages ) == info.stages &&
+							 ( state.visibleAccess & info.access ) == info.access;
+
+		srcStages  = state.writeStages;
+		srcAccess  = state.writeAccess;
+		dependency = !visible && srcStages != 0;
+	}
+
+	if ( state.writeFrame == m_frameId && state.writeGroup == group )
+	{
+		// Only attachments are used again within a group, rasterization order covers them
+		CHECK_PRED( info.attachment && !transition );
+		dependency = false;
+	}
+
+	if ( dependency )
+	{
+		barrier.srcStageMask |=
+			srcStages != 0 ? srcStages : static_cast< VkPipelineStageFlags >( VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT );
+		barrier.dstStageMask |= info.stages;
+
+		if ( image && ( transition || srcAccess != 0 ) )
+		{
+			VkImageMemoryBarrier imageBarrier {};
+			imageBarrier.sType							 = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			imageBarrier.pNext							 = nullptr;
+			imageBarrier.srcAccessMask					 = srcAccess;
+			imageBarrier.dstAccessMask					 = info.access;
+			imageBarrier.oldLayout						 = state.layout;
+			imageBarrier.newLayout						 = info.layout;
+			imageBarrier.srcQueueFamilyIndex			 = VK_QUEUE_FAMILY_IGNORED;
+			imageBarrier.dstQueueFamilyIndex			 = VK_QUEUE_FAMILY_IGNORED;
+			imageBarrier.image							 = resource.image;
+			imageBarrier.subresourceRange.aspectMask	 = resource.aspectMask;
+			imageBarrier.subresourceRange.baseMipLevel	 = 0;
+			imageBarrier.subresourceRange.levelCount	 = VK_REMAINING_MIP_LEVELS;
+			imageBarrier.subresourceRange.baseArrayLayer = 0;
+			imageBarrier.subresourceRange.layerCount	 = VK_REMAINING_ARRAY_LAYERS;
+			barrier.imageBarriers.emplace_back( imageBarrier );
+		}
+		else if ( !image && srcAccess != 0 )
+		{
+			VkBufferMemoryBarrier bufferBarrier {};
+			bufferBarrier.sType				  = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+			bufferBarrier.pNext				  = nullptr;
+			bufferBarrier.srcAccessMask		  = srcAccess;
+			bufferBarrier.dstAccessMask		  = info.access;
+			bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			bufferBarrier.buffer			  = resource.buffer;
+			bufferBarrier.offset			  = resource.offset;
+			bufferBarrier.size				  = resource.size;
+			barrier.bufferBarriers.emplace_back( bufferBarrier );
+		}
+	}
+
+	if ( write )
+	{
+		// Nothing waited on the write yet, but a layout transition is visible to the usage that required it
+		state.writeStages	= info.stages;
+		state.writeAccess	= info.access & WRITE_ACCESS_MASK;
+		state.readStages	= info.write ? 0 : info.stages;
+		state.visibleStages = info.write ? 0 : info.stages;
+		state.visibleAccess = info.write ? 0 : info.access;
+		state.writeGroup	= group;
+		state.writeFrame	= m_frameId;
+	}
+	else
+	{
+		state.readStages |= info.stages;
+		if ( dependency )
+		{
+			state.visibleStages |= info.stages;
+			state.visibleAccess |= info.access;
+		}
+	}
+
+	if ( image )
+	{
+		state.layout = info.layout;
+	}
+}
+
+void RenderGraph::Present()
+{
+	const state_t &state = m_backbufferState;
+	if ( state.layout == m_presentLayout )
+	{
+		return;
+	}
+
+	// The presentation engine reads the backbuffer after the semaphore signaled by the submission
+	VkImageMemoryBarrier imageBarrier {};
+	imageBarrier.sType							 = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	imageBarrier.pNext							 = nullptr;
+	imageBarrier.srcAccessMask					 = state.writeAccess;
+	imageBarrier.dstAccessMask					 = 0;
+	imageBarrier.oldLayout						 = state.layout;
+	imageBarrier.newLayout						 = m_presentLayout;
+	imageBarrier.srcQueueFamilyIndex			 = VK_QUEUE_FAMILY_IGNORED;
+	imageBarrier.dstQueueFamilyIndex			 = VK_QUEUE_FAMILY_IGNORED;
+	imageBarrier.image							 = m_resources[ BACKBUFFER ].image;
+	imageBarrier.subresourceRange.aspectMask	 = VK_IMAGE_ASPECT_COLOR_BIT;
+	imageBarrier.subresourceRange.baseMipLevel	 = 0;
+	imageBarrier.subresourceRange.levelCount	 = VK_REMAINING_MIP_LEVELS;
+	imageBarrier.subresourceRange.baseArrayLayer = 0;
+	imageBarrier.subresourceRange.layerCount	 = VK_REMAINING_ARRAY_LAYERS;
+
+	m_postRenderBarrier.srcStageMask = state.writeStages | state.readStages;
+	m_postRenderBarrier.dstStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+	m_postRenderBarrier.imageBarriers.emplace_back( imageBarrier );
+}
+
+void RenderGraph::PruneBufferStates()
+{
+	// Ranges not imported for a while were freed or are no longer simulated
+	for ( auto it = m_bufferStates.begin(); it != m_bufferStates.end(); )
+	{
+		if ( it->second.frameId + SWAPCHAIN_BUFFERING_LEVEL < m_frameId )
+		{
+			it = m_bufferStates.erase( it );
+		}
+		else
+		{
+			++it;
+		}
+	}
+}
+
+} // namespace render
+} // namespace vkRuna
@@ -0,0 +1,288 @@
+// Copyright (c) 2021 Arno Galvez
+
+#pragma once
+
+#include "external/vulkan/vulkan.hpp"
+#include "platform/defines.h"
+#include "renderer/Image.h"
+#include "renderer/RenderConfig.h"
+#include "renderer/VkAllocator.h"
+#include "renderer/VkRenderCommon.h"
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace vkRuna
+{
+namespace render
+{
+using rgResource_t = uint32_t;
+
+static const rgResource_t RG_NULL_RESOURCE = UINT32_MAX;
+
+// How a pass uses a resource. Each usage maps to the stages, accesses and image layout of its barriers.
+enum rgUsage_t : uint8_t
+{
+	RGU_TRANSFER_SRC,
+	RGU_TRANSFER_DST,
+	RGU_COMPUTE_READ,
+	RGU_COMPUTE_WRITE, // Read and written by a compute shader
+	RGU_GRAPHICS_READ, // Storage buffer or sampled image read by the vertex and fragment shaders
+	RGU_COLOR_ATTACHMENT,
+	RGU_DEPTH_ATTACHMENT,
+	RGU_COUNT
+};
+
+enum rgPassType_t : uint8_t
+{
+	RGP_PRE_RENDER, // Outside of the render pass, on the async compute queue when VFXs simulate on it
+	RGP_RENDER		// Inside the render pass, which begins once every pre-render pass has been recorded
+};
+
+// Barriers of the last compiled frame and memory of the transient images
+struct rgStats_t
+{
+	uint32_t	 passCount			= 0;
+	uint32_t	 groupCount			= 0; // Pre-render groups, each one waits on a single barrier
+	uint32_t	 barrierCount		= 0; // vkCmdPipelineBarrier calls, the render pass ones included
+	uint32_t	 bufferBarrierCount = 0;
+	uint32_t	 imageBarrierCount	= 0;
+	VkDeviceSize transientSize		= 0; // Sum of the sizes of the transient images
+	VkDeviceSize transientHeapSize	= 0; // Memory they actually use once aliased
+	uint32_t	 compiledCount		= 0; // Frames compiled since Init, and frames that reused a compilation
+	uint32_t	 reusedCount		= 0;
+};
+
+// Frame graph: passes declare how they use buffers and images, Compile orders them and infers the barriers between
+// them from the usages.
+//
+// Pre-render passes are scheduled as soon as the passes they depend on have run: passes that do not depend on each
+// other form a group, waiting on a single barrier. Render passes keep their declaration order, their dependencies on
+// earlier passes are merged into the barrier recorded before the render pass. Inside the render pass, only attachments
+// may be written again without a barrier, rasterization order covers them.
+//
+// Resources carry their state over from frame to frame: the first usage of a frame only waits on the last usages of
+// the previous frames. Usages on different queue families are ordered by the semaphores and fences of the frames,
+// buffers written on one family may be read on the other, images stay on a single family.
+//
+// Transient images only live within a frame. Images whose groups do not overlap share memory, the graph repacks them
+// when the groups of a frame no longer fit their packing.
+//
+// Compiling is skipped when a frame declares the same passes and resources as the last one compiled for its frame
+// index, starting from the same states: its groups, barriers and transient images are reused.
+class RenderGraph
+{
+	NO_COPY_NO_ASSIGN( RenderGraph )
+
+   public:
+	RenderGraph();
+	~RenderGraph();
+
+	// presentLayout: layout of the backbuffer once the frame has rendered
+	void Init( VkImageLayout presentLayout );
+	void Shutdown();
+
+	// Allocated right away, the image and view of a handle change whenever the transient images are repacked
+	rgResource_t CreateTransientImage( const char *name, const imageOpts_t &opts );
+	void		 DestroyTransientImage( rgResource_t image );
+	VkImageView	 GetImageView( rgResource_t image ) const;
+	uint64_t	 GetTransientsVersion() const { return m_transientsVersion; } // Incremented by every repacking
+
+	// Attachments of the render pass, it clears them when it begins
+	rgResource_t GetBackbuffer() const { return BACKBUFFER; }
+	void		 SetDepthBuffer( rgResource_t depth ) { m_depthBuffer = depth; }
+	rgResource_t GetDepthBuffer() const { return m_depthBuffer; }
+
+	// Declaration of a frame. Use and AddCmd apply to the last added pass.
+	void		 BeginFrame();
+	rgResource_t ImportBuffer( VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size );
+	void		 AddPass( const char *name, rgPassType_t type );
+	void		 Use( rgResource_t resource, rgUsage_t usage );
+	void		 AddCmd( const gpuCmd_t &cmd );
+	void		 Compile();
+
+	// Commands of the compiled frame, barriers included
+	int GetPreRenderCmds( gpuCmd_t **cmds );
+	int GetRenderCmds( gpuCmd_t **cmds );
+
+	// Recorded on the graphics queue, right before the render pass begins and right after it ends. The backbuffer is
+	// only known once acquired, it is bound before recording.
+	void				BindBackbuffer( VkImage image );
+	const gpuBarrier_t &GetRenderPassBarrier() const { return m_renderPassBarrier; }
+	const gpuBarrier_t &GetPostRenderBarrier() const { return m_postRenderBarrier; }
+
+	rgStats_t GetStats() const;
+
+   private:
+	static const rgResource_t BACKBUFFER = 0; // Transient images follow, their handles are stable across frames
+
+	// Synchronization state of a resource, carried over from the frames that used it before
+	struct state_t
+	{
+		VkPipelineStageFlags writeStages   = 0; // Last write or layout transition
+		VkAccessFlags		 writeAccess   = 0;
+		VkPipelineStageFlags readStages	   = 0; // Reads since the last write
+		VkPipelineStageFlags visibleStages = 0; // Usages already waiting on the last write
+		VkAccessFlags		 visibleAccess = 0;
+		VkImageLayout		 layout		   = VK_IMAGE_LAYOUT_UNDEFINED;
+		uint32_t			 familyId	   = UINT32_MAX; // Of the last usage
+		uint32_t			 writeGroup	   = UINT32_MAX; // Group of writeFrame that last wrote
+		uint64_t			 writeFrame	   = 0;
+		uint64_t			 frameId	   = 0; // Last frame that imported or used the resource
+		rgResource_t		 resource	   = RG_NULL_RESOURCE; // Handle of the range imported by frameId
+
+		void ResetSync();
+		bool SameSync( const state_t &other ) const; // The first usage of a frame waits on the same barriers
+	};
+
+	struct transient_t
+	{
+		std::string			 name;
+		imageOpts_t			 opts;
+		VkMemoryRequirements requirements {};
+		VkImage				 image		= VK_NULL_HANDLE;
+		VkImageView			 view		= VK_NULL_HANDLE;
+		VkDeviceSize		 offset		= 0; // In m_transientHeap
+		uint32_t			 firstGroup = 0; // Groups of the last frame that used the image
+		uint32_t			 lastGroup	= UINT32_MAX;
+		state_t				 state;
+		bool				 alive = false;
+	};
+
+	struct resource_t
+	{
+		VkBuffer		   buffer	  = VK_NULL_HANDLE; // Imported range
+		VkDeviceSize	   offset	  = 0;
+		VkDeviceSize	   size		  = 0;
+		VkImage			   image	  = VK_NULL_HANDLE; // Backbuffer and transient images
+		VkImageAspectFlags aspectMask = 0;
+		state_t *		   state	  = nullptr;
+		uint32_t		   firstGroup = UINT32_MAX; // Groups of the compiled frame using the resource
+		uint32_t		   lastGroup  = 0;
+	};
+
+	struct use_t
+	{
+		rgResource_t resource = RG_NULL_RESOURCE;
+		rgUsage_t	 usage	  = RGU_COUNT;
+	};
+
+	struct pass_t
+	{
+		const char * name	  = nullptr;
+		rgPassType_t type	  = RGP_PRE_RENDER;
+		uint32_t	 firstUse = 0; // In m_uses
+		uint32_t	 useCount = 0;
+		uint32_t	 firstCmd = 0; // In m_passCmds
+		uint32_t	 cmdCount = 0;
+		uint32_t	 group	  = 0;
+	};
+
+	// Groups of the passes using a resource, while they are assigned
+	struct track_t
+	{
+		int32_t		  writeGroup = -1;
+		int32_t		  readGroup	 = -1; // Reads since the last write
+		VkImageLayout layout	 = VK_IMAGE_LAYOUT_MAX_ENUM;
+	};
+
+	struct bufferKey_t
+	{
+		VkBuffer	 buffer = VK_NULL_HANDLE;
+		VkDeviceSize offset = 0;
+
+		bool operator==( const bufferKey_t &other ) const
+		{
+			return buffer == other.buffer && offset == other.offset;
+		}
+	};
+
+	struct bufferKeyHash_t
+	{
+		size_t operator()( const bufferKey_t &key ) const;
+	};
+
+	struct lifetime_t
+	{
+		uint32_t firstGroup = 0;
+		uint32_t lastGroup	= UINT32_MAX;
+	};
+
+	// Last frame compiled for a frame index, along with what it was compiled from
+	struct compiled_t
+	{
+		uint64_t				  hash				= 0; // Of the declarations
+		uint64_t				  transientsVersion = 0;
+		uint64_t				  frameId			= 0;
+		std::vector< lifetime_t > lifetimes; // Of the transient images, their packing is only valid for them
+		std::vector< state_t >	  entryStates; // Of m_resources, before the first usage
+		std::vector< state_t >	  exitStates;
+
+		uint32_t					groupCount = 0;
+		std::vector< uint32_t >		groups; // Of m_passes
+		std::vector< uint32_t >		order;
+		std::vector< gpuBarrier_t > groupBarriers;
+		gpuBarrier_t				renderPassBarrier;
+		gpuBarrier_t				postRenderBarrier;
+	};
+
+	uint32_t	GetTransientIndex( rgResource_t resource ) const;
+	uint64_t	HashDeclarations() const;
+	bool		Reuse( compiled_t &compiled, uint64_t hash );
+	void		Store( compiled_t &compiled, uint64_t hash ) const;
+	void		AssignGroups();
+	void		UpdateLifetimes();
+	void		PackTransients( std::vector< VkDeviceSize > &offsets, VkDeviceSize &heapSize ) const;
+	void		RepackTransients();
+	void		AllocTransients();
+	void		FreeTransients();
+	static bool Alias( const transient_t &a, const transient_t &b );
+	void		DiscardTransient( transient_t &transient, uint32_t familyId );
+	void		Access( rgResource_t  resource,
+						rgUsage_t	  usage,
+						uint32_t	  familyId,
+						uint32_t	  group,
+						gpuBarrier_t &barrier );
+	void		Present();
+	void		PruneBufferStates();
+
+   private:
+	VkImageLayout m_presentLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	rgResource_t  m_depthBuffer	  = RG_NULL_RESOURCE;
+	uint64_t	  m_frameId		  = 0;
+
+	std::vector< resource_t > m_resources;
+	std::vector< use_t >	  m_uses;
+	std::vector< pass_t >	  m_passes;
+	std::vector< gpuCmd_t >	  m_passCmds;
+	std::vector< track_t >	  m_tracks;
+	uint32_t				  m_groupCount = 0; // Pre-render groups of the compiled frame
+
+	state_t														m_backbufferState;
+	std::unordered_map< bufferKey_t, state_t, bufferKeyHash_t > m_bufferStates;
+
+	std::vector< transient_t > m_transients;
+	vulkanAllocation_t		   m_transientHeap;
+	VkDeviceSize			   m_transientHeapSize = 0;
+	uint64_t				   m_transientsVersion = 0;
+
+	// Compiled frame
+	std::vector< gpuBarrier_t > m_groupBarriers;
+	gpuBarrier_t				m_renderPassBarrier;
+	gpuBarrier_t				m_postRenderBarrier;
+	std::vector< gpuCmd_t >		m_preRenderCmds;
+	std::vector< gpuCmd_t >		m_renderCmds;
+	std::vector< uint32_t >		m_order; // Passes sorted by group
+
+	std::array< compiled_t, SWAPCHAIN_BUFFERING_LEVEL > m_compiled; // Per frame index
+	uint32_t											m_compiledCount = 0;
+	uint32_t											m_reusedCount	= 0;
+};
+
+extern RenderGraph g_renderGraph;
+
+} // namespace render
+} // namespace vkRuna
@@ -7,13 +7,20 @@
 #include "renderer/Buffer.h"
 #include "renderer/Check.h"
 #include "renderer/Image.h"
+#include "renderer/ShaderCache.h"
+#include "renderer/ShaderCompiler.h"
 #include "renderer/VkAllocator.h"
 #include "renderer/VkBackend.h"
+#include "rnLib/Hash.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cstring>
 #include <iostream>
 #include <regex>
 #include <stdexcept>
+#include <thread>
+#include <unordered_map>
 #include <utility>
 
 namespace vkRuna
@@ -29,7 +36,12 @@ void shader_t::UpdateModule( const char *spvFile )
 {
 	std::vector< char > binary = ReadBinary< char >( spvFile );
 
-	CHECK_PRED( !binary.empty() && ( ( binary.size() % 4 ) == 0 ) )
+	UpdateModule( reinterpret_cast< const uint32_t * >( binary.data() ), binary.size() );
+}
+
+void shader_t::UpdateModule( const uint32_t *code, size_t size )
+{
+	CHECK_PRED( size != 0 && ( ( size % 4 ) == 0 ) )
 
 	DestroyModule();
 
@@ -37,8 +49,8 @@ void shader_t::UpdateModule( const char *spvFile )
 	ci.sType	= VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
 	ci.pNext	= nullptr;
 	ci.flags	= 0;
-	ci.codeSize = binary.size();
-	ci.pCode	= reinterpret_cast< uint32_t * >( binary.data() );
+	ci.codeSize = size;
+	ci.pCode	= code;
 
 	VkShaderModule *pModule = reinterpret_cast< VkShaderModule * >( &module );
 	VK_CHECK( vkCreateShaderModule( render::GetVulkanContext().device, &ci, nullptr, pModule ) )
@@ -59,8 +71,39 @@ namespace render
 {
 PipelineManager g_pipelineManager;
 
-static const char *CACHE_DIR		= "renderCache";
-static const char *GLSL_INCLUDE_DIR = "glsl/lib";
+static const char *CACHE_DIR			  = "renderCache";
+static const char *PIPELINE_CACHE_PATH = "renderCache/pipelineCache.bin";
+static const char *SHADER_CACHE_DIR	  = "renderCache/spirv";
+
+static const uint32_t PIPELINE_CACHE_MAGIC	 = 0x50434e52; // "RNCP"
+static const uint32_t PIPELINE_CACHE_VERSION = 1;
+
+// Prepended to the data of the VkPipelineCache. The driver version is not part of the header written by the driver,
+// the blob is discarded once it changes.
+struct pipelineCacheHeader_t
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t vendorID;
+	uint32_t deviceID;
+	uint32_t driverVersion;
+	uint8_t	 pipelineCacheUUID[ VK_UUID_SIZE ];
+	uint64_t dataSize;
+	uint64_t dataHash; // Detects truncated and corrupted blobs
+};
+
+static void FillPipelineCacheHeader( pipelineCacheHeader_t &header )
+{
+	const VkPhysicalDeviceProperties &props = GetVulkanContext().gpu.properties;
+
+	std::memset( &header, 0, sizeof( header ) );
+	header.magic		 = PIPELINE_CACHE_MAGIC;
+	header.version		 = PIPELINE_CACHE_VERSION;
+	header.vendorID		 = props.vendorID;
+	header.deviceID		 = props.deviceID;
+	header.driverVersion = props.driverVersion;
+	std::memcpy( header.pipelineCacheUUID, props.pipelineCacheUUID, VK_UUID_SIZE );
+}
 
 static const std::array< std::string, 3 > VALID_EXT = { "vert", "frag", "comp" };
 
@@ -68,12 +111,16 @@ static const std::array< VkShaderStageFlagBits, SS_COUNT > SS_VK_TYPES = { VK_SH
 																		   VK_SHADER_STAGE_FRAGMENT_BIT,
 																		   VK_SHADER_STAGE_COMPUTE_BIT };
 
-static const std::array< VkDescriptorType, DS_COUNT > DS_VK_TYPES = { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+// UBOs live in the frame arena, their descriptors are dynamic so that the frame slice is selected at bind time
+static const std::array< VkDescriptorType, DS_COUNT > DS_VK_TYPES = { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
 																	  VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
 																	  VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
-																	  VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER };
+																	  VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC };
 
-static const std::array< uint32_t, DS_COUNT > DS_POOL_SIZES = { 1 << 13, 1 << 13, 1 << 13, 256 };
+static const std::array< uint32_t, DS_COUNT > DS_POOL_SIZES = { 1 << 13,
+																  SWAPCHAIN_BUFFERING_LEVEL << 13,
+																  1 << 13,
+																  256 };
 
 struct vkGraphicsPipeline_t
 {
@@ -92,6 +139,48 @@ struct vkGraphicsPipeline_t
 	VkPipelineDynamicStateCreateInfo						dynamic {};
 };
 
+// One shader stage being loaded. Parsing fills the inputs, the build step compiles the code unless the shader cache
+// has it and creates the module.
+struct shaderBuild_t
+{
+	shaderStage_t stage = SS_UNKNOWN;
+	std::string	  path;
+
+	std::vector< std::unique_ptr< ShaderTokenizer > > tokenizers;
+	std::vector< std::vector< shaderLineMap_t > >	  sourceLineMaps; // Of the events rewriting the shader code
+	std::vector< shaderLineMap_t >					  lineMap;
+	std::string										  glslCode;
+	std::string										  glslPath;
+	uint64_t										  spirvKey = 0;
+	std::string										  spirvFile; // Set on a shader cache hit
+
+	const shaderBuild_t *sameCode = nullptr; // Earlier build of the same batch compiling the same code
+
+	bool							  compiled = false;
+	std::vector< uint32_t >			  spirv; // Empty on a shader cache hit
+	std::vector< shaderDiagnostic_t > diagnostics;
+	std::string						  readError;
+	std::unique_ptr< shader_t >		  shader;
+	int64_t							  buildTicks = 0;
+};
+
+// New pipeline of a live one, built in the background
+struct pipelineReload_t
+{
+	std::weak_ptr< pipelineProg_t >	  target;
+	std::unique_ptr< pipelineProg_t > next;
+	std::vector< shaderBuild_t >	  builds;
+};
+
+// Pipelines reloaded together, they are all swapped in or none of them is
+struct reloadJob_t
+{
+	std::vector< pipelineReload_t >	  reloads;
+	PipelineManager::reloadCallback_t onDone;
+	int64_t							  startTicks = 0;
+	std::atomic< bool >				  built { false }; // Set by the reload thread
+};
+
 void ValidatePipeline( pipelineProg_t &pp )
 {
 	if ( !pp.shaders[ SS_VERTEX ] && !pp.shaders[ SS_FRAGMENT ] && !pp.shaders[ SS_COMPUTE ] )
@@ -231,13 +320,17 @@ std::vector< const interfaceBlock_t * > PipelineManager::GetUniqueSharedBlocks(
 inline std::string GetGLSLPath( const char *path )
 {
 	const char *fileName = std::strrchr( path, '\\' );
+	if ( const char *slash = std::strrchr( path, '/' ); slash && ( !fileName || slash > fileName ) )
+	{
+		fileName = slash;
+	}
 	if ( !fileName )
 	{
 		return std::string();
 	}
 
 	std::string out( CACHE_DIR );
-	out += '\\';
+	out += '/';
 	out += ( fileName + 1 );
 	return out;
 }
@@ -378,7 +471,7 @@ uint8_t StateToStencilMask( uint64_t state )
 VkDeviceSize UpdateUBO( const std::vector< interfaceBlock_t > &ibVec,
 						const char *						   varName,
 						const float *						   values,
-						Buffer *							   ubo )
+						uboPool_t &							   ubo )
 {
 	const VkDeviceSize minUniformBufferOffsetAlignment =
 		GetVulkanContext().gpu.properties.limits.minUniformBufferOffsetAlignment;
@@ -392,7 +485,8 @@ VkDeviceSize UpdateUBO( const std::vector< interfaceBlock_t > &ibVec,
 			VkDeviceSize byteSize = GetMemberTypeByteSize( uniform.type );
 			if ( uniform.name == varName )
 			{
-				ubo->Update( byteSize, static_cast< const void * >( values ), offset );
+				CHECK_PRED( offset + byteSize <= ubo.data.size() );
+				std::memcpy( ubo.data.data() + offset, values, byteSize );
 				return byteSize;
 			}
 
@@ -405,22 +499,6 @@ VkDeviceSize UpdateUBO( const std::vector< interfaceBlock_t > &ibVec,
 	return 0;
 }
 
-static bool CompileShader( const std::string &shaderFile, const std::string &stage, const std::string &outFile )
-{
-	std::string cmdLine = RUNA_SHADER_COMPILER_PATH;
-	cmdLine += " -I ";
-	cmdLine += GLSL_INCLUDE_DIR;
-	cmdLine += " -O -fshader-stage=";
-	cmdLine += stage;
-	cmdLine += " --target-env=vulkan1.2 -o \"";
-	cmdLine += outFile;
-	cmdLine += "\" \"";
-	cmdLine += shaderFile;
-	cmdLine += "\"";
-
-	return ExecuteAndWait( const_cast< char * >( cmdLine.c_str() ) );
-}
-
 PipelineManager::PipelineManager() {}
 
 PipelineManager::~PipelineManager()
@@ -430,39 +508,176 @@ PipelineManager::~PipelineManager()
 
 void PipelineManager::Init()
 {
-	CreateDescriptorPool();
-	CreatePipelineCache();
-
-	m_sharedBlocksPool = new Buffer;
-	m_sharedBlocksPool->Alloc( VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, BP_DYNAMIC, RENDERPROGS_SHARED_BLOCKS_POOL_SIZE );
-
 	sysCallRet_t exitCode = Mkdir( CACHE_DIR );
 	if ( exitCode != sysCallRet_t::SUCCESS && exitCode != sysCallRet_t::DIR_EXIST )
 	{
 		FatalError( "Could not create \"%s\" Directory", CACHE_DIR );
 	}
 
+	g_shaderCache.Init( SHADER_CACHE_DIR, SHADER_CACHE_MAX_SIZE );
+	g_shaderCompiler.Init();
+
+	// hardware_concurrency may be unknown
+	const int coreCount = static_cast< int >( std::thread::hardware_concurrency() );
+	m_compileThreads.Init( static_cast< uint32_t >( std::clamp( coreCount, 1, SHADER_COMPILE_MAX_THREADS ) ) );
+
+	m_reloadQuit   = false;
+	m_reloadThread = std::thread( &PipelineManager::ReloadThreadMain, this );
+
+	CreateDescriptorPool();
+	CreatePipelineCache();
+
+	m_sharedBlocksPool.data.assign( RENDERPROGS_SHARED_BLOCKS_POOL_SIZE, 0 );
+	m_sharedBlocksPool.uploadFrameId = UINT64_MAX;
+
 	g_shaderLexer.Init();
 }
 
 void PipelineManager::Shutdown()
 {
+	m_compileThreads.Shutdown();
+
+	if ( m_reloadThread.joinable() )
+	{
+		{
+			std::lock_guard< std::mutex > lock( m_reloadMutex );
+			m_reloadQuit = true;
+		}
+		m_reloadCv.notify_one();
+		m_reloadThread.join();
+	}
+	m_reloadQueue.clear();
+	m_reloadJobs.clear();
+
+	m_pipelineProgs.clear();
+	m_shaders.clear();
+
+	// The device is idle
+	for ( std::vector< bufferWrite_t > &writes : m_bufferWrites )
+	{
+		writes.clear();
+	}
+	EmptyGarbage( UINT64_MAX );
+
 	g_shaderLexer.Shutdown();
+	g_shaderCompiler.Shutdown();
+	g_shaderCache.Shutdown();
+
+	if ( m_pipelineCache != VK_NULL_HANDLE )
+	{
+		const pipelineCacheStats_t stats = GetPipelineCacheStats();
+		Log( "Pipeline cache (%s start): %u pipelines created in %.2f ms",
+			 stats.warm ? "warm" : "cold",
+			 stats.pipelineCount,
+			 stats.pipelineMs );
+
+		if ( IsPipelineCacheDirty() )
+		{
+			SavePipelineCache();
+		}
+	}
 
 	DestroyPipelineCache();
 	DestroyDescriptorPool();
 
-	m_pipelineProgs.clear();
-	m_shaders.clear();
 	m_sharedBlocks.clear();
-	delete m_sharedBlocksPool;
-	m_sharedBlocksPool			 = nullptr;
+	m_sharedBlocksPool.data.clear();
 	m_sharedBlocksBindingCounter = 0;
 
 	m_descriptorPool = VK_NULL_HANDLE;
 	m_pipelineCache	 = VK_NULL_HANDLE;
 }
 
+void PipelineManager::BeginFrame( uint64_t frameId )
+{
+	{
+		std::lock_guard< std::mutex > lock( m_garbageMutex );
+		m_frameId = frameId;
+	}
+
+	std::vector< bufferWrite_t > &writes = m_bufferWrites[ g_frameArena.GetFrameIndex() ];
+	if ( writes.empty() )
+	{
+		return;
+	}
+
+	std::vector< VkWriteDescriptorSet > wdsVec( writes.size() );
+	for ( size_t i = 0; i < writes.size(); ++i )
+	{
+		VkWriteDescriptorSet &wds = wdsVec[ i ];
+		wds.sType				  = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		wds.pNext				  = nullptr;
+		wds.dstSet				  = writes[ i ].set;
+		wds.dstBinding			  = writes[ i ].binding;
+		wds.dstArrayElement		  = 0;
+		wds.descriptorCount		  = 1;
+		wds.descriptorType		  = DS_VK_TYPES[ DS_BUFFER ];
+		wds.pImageInfo			  = nullptr;
+		wds.pBufferInfo			  = &writes[ i ].info;
+		wds.pTexelBufferView	  = nullptr;
+	}
+
+	vkUpdateDescriptorSets( GetVulkanContext().device,
+							static_cast< uint32_t >( wdsVec.size() ),
+							wdsVec.data(),
+							0,
+							nullptr );
+
+	writes.clear();
+}
+
+void PipelineManager::EmptyGarbage( uint64_t completedFrameCount )
+{
+	auto &device = GetVulkanContext().device;
+
+	std::lock_guard< std::mutex > lock( m_garbageMutex );
+
+	size_t kept = 0;
+	for ( garbage_t &garbage : m_garbage )
+	{
+		if ( garbage.frameId >= completedFrameCount )
+		{
+			m_garbage[ kept++ ] = garbage;
+			continue;
+		}
+
+		if ( garbage.pipeline != VK_NULL_HANDLE )
+		{
+			vkDestroyPipeline( device, garbage.pipeline, nullptr );
+		}
+		if ( garbage.pipelineLayout != VK_NULL_HANDLE )
+		{
+			vkDestroyPipelineLayout( device, garbage.pipelineLayout, nullptr );
+		}
+		if ( garbage.descriptorSetLayout != VK_NULL_HANDLE )
+		{
+			vkDestroyDescriptorSetLayout( device, garbage.descriptorSetLayout, nullptr );
+		}
+		if ( garbage.descriptorSet != VK_NULL_HANDLE )
+		{
+			vkFreeDescriptorSets( device, m_descriptorPool, 1, &garbage.descriptorSet );
+		}
+	}
+
+	m_garbage.resize( kept );
+}
+
+void PipelineManager::Retire( garbage_t garbage )
+{
+	std::lock_guard< std::mutex > lock( m_garbageMutex );
+
+	garbage.frameId = m_frameId;
+	m_garbage.emplace_back( garbage );
+}
+
+pipelineCacheStats_t PipelineManager::GetPipelineCacheStats() const
+{
+	pipelineCacheStats_t stats = m_pipelineCacheStats;
+	stats.pipelineMs		   = 1e3 * double( m_pipelineTicks ) / double( ClockTicksFrequency() );
+
+	return stats;
+}
+
 void PipelineManager::AddSharedInterfaceBlock( interfaceBlock_t ib )
 {
 	// #TODO: check whether or not this block is already registered
@@ -578,8 +793,11 @@ void PipelineManager::CreateDepthPrepassPipeline( pipelineProg_t &dpp, const pip
 
 	dpp.status		   = srcpp.GetStatus();
 	dpp.stateBits	   = srcpp.stateBits;
-	dpp.pipelineLayout = srcpp.pipelineLayout;
-	dpp.descriptorSets = srcpp.descriptorSets;
+	dpp.pipelineLayout		= srcpp.pipelineLayout;
+	dpp.descriptorSets		= srcpp.descriptorSets;
+	dpp.frameBufferSets		= srcpp.frameBufferSets;
+	dpp.dynamicOffsetCounts = srcpp.dynamicOffsetCounts;
+	dpp.uboPool				= srcpp.uboPool;
 
 	vkGraphicsPipeline_t vkgp {};
 	GetVulkanGraphicsPipelineInfo( srcpp, vkgp );
@@ -630,10 +848,12 @@ void PipelineManager::CreateDepthPrepassPipeline( pipelineProg_t &dpp, const pip
 	pipelineCI.basePipelineHandle  = VK_NULL_HANDLE;
 	pipelineCI.basePipelineIndex   = -1;
 
-	DestroyPipelineHandle( dpp );
+	RetirePipelineHandle( dpp );
 
-	VkDevice &device = GetVulkanContext().device;
+	VkDevice &	  device	 = GetVulkanContext().device;
+	const int64_t startTicks = GetClockTicks();
 	VK_CHECK( vkCreateGraphicsPipelines( device, m_pipelineCache, 1, &pipelineCI, nullptr, &dpp.pipeline ) );
+	OnPipelineCreated( startTicks );
 }
 
 void PipelineManager::RegisterEvent( pipelineProg_t &pp, std::unique_ptr< Event > ev )
@@ -647,6 +867,24 @@ void PipelineManager::RegisterEvent( pipelineProg_t &pp, std::unique_ptr< Event
 }
 
 void PipelineManager::BindGraphicsPipeline( VkCommandBuffer cmdBuffer, pipelineProg_t &graphicsPipeline )
+{
+	PrepareGraphicsPipeline( graphicsPipeline );
+
+	BindDescriptorSets( cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline );
+
+	vkCmdBindPipeline( cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline.pipeline );
+}
+
+void PipelineManager::BindComputePipeline( VkCommandBuffer cmdBuffer, pipelineProg_t &computePipeline )
+{
+	PrepareComputePipeline( computePipeline );
+
+	BindDescriptorSets( cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computePipeline );
+
+	vkCmdBindPipeline( cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computePipeline.pipeline );
+}
+
+void PipelineManager::PrepareGraphicsPipeline( pipelineProg_t &graphicsPipeline )
 {
 	CHECK_PRED( graphicsPipeline.GetStatus() == pipelineStatus_t::Ok );
 
@@ -655,19 +893,10 @@ void PipelineManager::BindGraphicsPipeline( VkCommandBuffer cmdBuffer, pipelineP
 		CreateGraphicsPipeline( graphicsPipeline );
 	}
 
-	vkCmdBindDescriptorSets( cmdBuffer,
-							 VK_PIPELINE_BIND_POINT_GRAPHICS,
-							 graphicsPipeline.pipelineLayout,
-							 0,
-							 static_cast< uint32_t >( graphicsPipeline.descriptorSets.size() ),
-							 graphicsPipeline.descriptorSets.data(),
-							 0,
-							 nullptr );
-
-	vkCmdBindPipeline( cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline.pipeline );
+	UploadUBOs( graphicsPipeline );
 }
 
-void PipelineManager::BindComputePipeline( VkCommandBuffer cmdBuffer, pipelineProg_t &computePipeline )
+void PipelineManager::PrepareComputePipeline( pipelineProg_t &computePipeline )
 {
 	CHECK_PRED( computePipeline.GetStatus() == pipelineStatus_t::Ok );
 
@@ -676,16 +905,7 @@ void PipelineManager::BindComputePipeline( VkCommandBuffer cmdBuffer, pipelinePr
 		CreateComputePipeline( computePipeline );
 	}
 
-	vkCmdBindDescriptorSets( cmdBuffer,
-							 VK_PIPELINE_BIND_POINT_COMPUTE,
-							 computePipeline.pipelineLayout,
-							 0,
-							 static_cast< uint32_t >( computePipeline.descriptorSets.size() ),
-							 computePipeline.descriptorSets.data(),
-							 0,
-							 nullptr );
-
-	vkCmdBindPipeline( cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computePipeline.pipeline );
+	UploadUBOs( computePipeline );
 }
 
 void PipelineManager::UpdateUBOs( pipelineProg_t &	 pp,
@@ -694,6 +914,11 @@ void PipelineManager::UpdateUBOs( pipelineProg_t &	 pp,
 								  const size_t *	 byteSizes,
 								  const float *		 values )
 {
+	if ( !pp.uboPool )
+	{
+		return;
+	}
+
 	VkDeviceSize valuesOffset = 0;
 	for ( size_t i = 0; i < count; ++i )
 	{
@@ -701,7 +926,7 @@ void PipelineManager::UpdateUBOs( pipelineProg_t &	 pp,
 
 		VkDeviceSize writeSize = byteSizes[ i ];
 
-		/*writeSize = */ UpdateUBO( pp.interfaceBlocks, name, values + valuesOffset, pp.uboPool );
+		/*writeSize = */ UpdateUBO( pp.interfaceBlocks, name, values + valuesOffset, *pp.uboPool );
 
 		/*if ( writeSize == 0 )
 		{
@@ -780,21 +1005,25 @@ void PipelineManager::UpdateImages( pipelineProg_t &		  pp,
 	vkUpdateDescriptorSets( device, static_cast< uint32_t >( wdsVec.size() ), wdsVec.data(), 0, nullptr );
 }
 
-void PipelineManager::UpdateBuffers( pipelineProg_t &	  pp,
-									 size_t				  count,
-									 const char *const *  varNames,
-									 const Buffer *const *buffers )
+void PipelineManager::UpdateBuffers( pipelineProg_t &	 pp,
+									 size_t				 count,
+									 const char *const * varNames,
+									 const bufferView_t *views )
 {
 	auto &device = GetVulkanContext().device;
 
+	// The frame that last recorded the current slot has completed, the other slots are written when recycled
+	const uint32_t currentFrameIndex = g_frameArena.GetFrameIndex();
+
 	std::vector< VkWriteDescriptorSet >	  wdsVec;
 	std::vector< VkDescriptorBufferInfo > dbiVec;
 
+	for ( uint32_t frameIndex = 0; frameIndex < pp.frameBufferSets.size(); ++frameIndex )
 	{
 		VkWriteDescriptorSet wds {};
 		wds.sType			 = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
 		wds.pNext			 = nullptr;
-		wds.dstSet			 = pp.descriptorSets[ DS_BUFFER ];
+		wds.dstSet			 = pp.frameBufferSets[ frameIndex ];
 		wds.dstArrayElement	 = 0;
 		wds.descriptorCount	 = 1;
 		wds.descriptorType	 = DS_VK_TYPES[ DS_BUFFER ];
@@ -803,9 +1032,9 @@ void PipelineManager::UpdateBuffers( pipelineProg_t &	  pp,
 
 		for ( size_t i = 0; i < count; ++i )
 		{
-			const Buffer &buffer			= *( buffers[ i ] );
-			bool		  found				= false;
-			const auto	  IsCorrespondingIB = [ & ]( const interfaceBlock_t &ib ) {
+			const bufferView_t &view			  = views[ i ];
+			bool				found			  = false;
+			const auto			IsCorrespondingIB = [ & ]( const interfaceBlock_t &ib ) {
 				   return ib.type == BT_BUFFER && ( std::strcmp( ib.name.c_str(), varNames[ i ] ) == 0 );
 			};
 
@@ -815,22 +1044,28 @@ void PipelineManager::UpdateBuffers( pipelineProg_t &	  pp,
 			{
 				if ( IsCorrespondingIB( ib ) )
 				{
-					wds.dstBinding = ib.binding;
-					wdsVec.emplace_back( wds );
-
 					VkDescriptorBufferInfo dbi {};
-					dbi.buffer = buffer.GetHandle();
-					dbi.offset = 0;
-					dbi.range  = VK_WHOLE_SIZE; // buffer.GetSize() is incorrect, since allocated size is greater than
-												// size specified upon creation
-					dbiVec.emplace_back( dbi );
+					dbi.buffer = view.buffer->GetHandle();
+					dbi.offset = view.GetOffset( frameIndex );
+					dbi.range  = view.GetRange();
+
+					if ( frameIndex == currentFrameIndex )
+					{
+						wds.dstBinding = ib.binding;
+						wdsVec.emplace_back( wds );
+						dbiVec.emplace_back( dbi );
+					}
+					else
+					{
+						QueueBufferWrite( frameIndex, wds.dstSet, ib.binding, dbi );
+					}
 
 					found = true;
 					break;
 				}
 			}
 
-			if ( !found )
+			if ( !found && frameIndex == 0 )
 			{
 				Error( "While updating buffer: variable \"%s\" not found.\n", varNames[ i ] );
 			}
@@ -848,14 +1083,76 @@ void PipelineManager::UpdateBuffers( pipelineProg_t &	  pp,
 	vkUpdateDescriptorSets( device, static_cast< uint32_t >( wdsVec.size() ), wdsVec.data(), 0, nullptr );
 }
 
+void PipelineManager::QueueBufferWrite( uint32_t					  frameIndex,
+										VkDescriptorSet				  set,
+										uint32_t					  binding,
+										const VkDescriptorBufferInfo &dbi )
+{
+	std::vector< bufferWrite_t > &writes = m_bufferWrites[ frameIndex ];
+
+	// Only the last write of a binding is made
+	for ( bufferWrite_t &write : writes )
+	{
+		if ( write.set == set && write.binding == binding )
+		{
+			write.info = dbi;
+			return;
+		}
+	}
+
+	bufferWrite_t write;
+	write.set	  = set;
+	write.binding = binding;
+	write.info	  = dbi;
+	writes.emplace_back( write );
+}
+
 bool PipelineManager::LoadShaders( pipelineProg_t &		pp,
 								   size_t				count,
 								   const shaderStage_t *shaderStages,
 								   const char *const *	paths )
 {
-	DestroyPipelineHandle( pp );
-
 	std::vector< std::string > shaderCodes;
+	if ( !ReadShaders( pp, count, paths, shaderCodes ) )
+	{
+		return false;
+	}
+
+	return LoadShaders( pp, count, shaderStages, paths, shaderCodes.data() );
+}
+
+bool PipelineManager::LoadShaders( pipelineProg_t &		pp,
+								   size_t				count,
+								   const shaderStage_t *shaderStages,
+								   const char *const *	paths,
+								   std::string *		shaderCodes )
+{
+	m_shaderDiagnostics.clear();
+
+	std::vector< shaderBuild_t > builds;
+	if ( !ParseShaders( pp, count, shaderStages, paths, shaderCodes, builds ) )
+	{
+		return false;
+	}
+
+	std::vector< shaderBuild_t * > buildPtrs;
+	for ( shaderBuild_t &build : builds )
+	{
+		buildPtrs.emplace_back( &build );
+	}
+
+	BuildShaders( buildPtrs.size(), buildPtrs.data() );
+
+	return FinishShaders( pp, builds.size(), builds.data() );
+}
+
+bool PipelineManager::ReadShaders( pipelineProg_t &			   pp,
+								   size_t					   count,
+								   const char *const *		   paths,
+								   std::vector< std::string > &shaderCodes )
+{
+	RetirePipelineHandle( pp );
+
 	shaderCodes.reserve( count );
 
 	for ( size_t i = 0; i < count; ++i )
@@ -895,27 +1192,21 @@ bool PipelineManager::LoadShaders( pipelineProg_t &		pp,
 		shaderCodes.emplace_back( std::move( shaderCode ) );
 	}
 
-	return LoadShaders( pp, count, shaderStages, paths, shaderCodes.data() );
+	return true;
 }
 
-bool PipelineManager::LoadShaders( pipelineProg_t &		pp,
-								   size_t				count,
-								   const shaderStage_t *shaderStages,
-								   const char *const *	paths,
-								   std::string *		shaderCodes )
+bool PipelineManager::ParseShaders( pipelineProg_t &			  pp,
+									size_t						  count,
+									const shaderStage_t *		  shaderStages,
+									const char *const *			  paths,
+									std::string *				  shaderCodes,
+									std::vector< shaderBuild_t > &builds )
 {
-	struct ShaderCompileInfo
-	{
-		std::vector< std::unique_ptr< ShaderTokenizer > > tokenizers;
-		std::string										  glslCode;
-		std::string										  glslPath;
-		std::string										  stageStr;
-	};
+	RetirePipelineHandle( pp );
+	RetireResourceBindings( pp );
 
-	DestroyPipelineHandle( pp );
-	DestroyResourceBindings( pp );
-
-	std::vector< ShaderCompileInfo > shaderCompileInfoVec( count );
+	builds.clear();
+	builds.resize( count );
 
 	for ( size_t i = 0; i < count; ++i )
 	{
@@ -929,12 +1220,18 @@ bool PipelineManager::LoadShaders( pipelineProg_t &		pp,
 			{
 				if ( ev->IsOfType( EV_BEFORE_SHADER_PARSING ) )
 				{
-					if ( !ev->Call( 0, &code, shaderStage ) )
+					std::vector< shaderLineMap_t > lineMap;
+					if ( !ev->Call( 0, &code, shaderStage, &lineMap ) )
 					{
 						Error( "Pre parsing shader %s failed.", shaderPath );
 						SetPipelineStatus( pp, pipelineStatus_t::ShaderNotCompiled );
 						return false;
 					}
+
+					if ( !lineMap.empty() )
+					{
+						builds[ i ].sourceLineMaps.emplace_back( std::move( lineMap ) );
+					}
 				}
 			}
 		}
@@ -948,7 +1245,7 @@ bool PipelineManager::LoadShaders( pipelineProg_t &		pp,
 		if ( !g_shaderLexer.Parse( code,
 								   exprTorkenizers.size(),
 								   exprTorkenizers.data(),
-								   shaderCompileInfoVec[ i ].tokenizers,
+								   builds[ i ].tokenizers,
 								   true ) )
 		{
 			Error( "Parsing shader %s failed.", shaderPath );
@@ -956,7 +1253,7 @@ bool PipelineManager::LoadShaders( pipelineProg_t &		pp,
 			return false;
 		}
 
-		for ( const auto &tokenizer : shaderCompileInfoVec[ i ].tokenizers )
+		for ( const auto &tokenizer : builds[ i ].tokenizers )
 		{
 			parsedObjectAction_t actions = tokenizer->GetActions();
 			if ( actions & POA_BIND_IB_SCOPE_PIPELINE )
@@ -974,7 +1271,11 @@ bool PipelineManager::LoadShaders( pipelineProg_t &		pp,
 
 	for ( size_t i = 0; i < count; ++i )
 	{
-		for ( const auto &tokenizer : shaderCompileInfoVec[ i ].tokenizers )
+		shaderBuild_t &build = builds[ i ];
+		build.stage			 = shaderStages[ i ];
+		build.path			 = paths[ i ];
+
+		for ( const auto &tokenizer : build.tokenizers )
 		{
 			parsedObjectAction_t actions = tokenizer->GetActions();
 			if ( actions & POA_BIND_IB_SCOPE_PIPELINE )
@@ -989,100 +1290,271 @@ bool PipelineManager::LoadShaders( pipelineProg_t &		pp,
 			}
 		}
 
-		g_shaderLexer.Combine( shaderCompileInfoVec[ i ].tokenizers, shaderCompileInfoVec[ i ].glslCode );
+		g_shaderLexer.Combine( build.tokenizers, build.glslCode, &build.lineMap );
 
-		// Output GLSL code
+		// Only written to disk by the fallback compiler and SHADER_DEBUG_DUMP
 		{
-			std::string	 glslPath	= GetGLSLPath( paths[ i ] ); // #TODO remove call ?
-			const size_t period_pos = glslPath.rfind( '.' );
-			if ( std::string::npos == period_pos )
+			const std::string glslPath = GetGLSLPath( paths[ i ] ); // #TODO remove call ?
+			if ( std::string::npos == glslPath.rfind( '.' ) )
 			{
 				Error( "File \"%s\" has no extension.", glslPath.c_str() );
 				SetPipelineStatus( pp, pipelineStatus_t::Doomed );
 				return false;
 			}
-			shaderCompileInfoVec[ i ].stageStr = std::string( glslPath.cbegin() + period_pos + 1, glslPath.cend() );
-			shaderCompileInfoVec[ i ].glslPath = glslPath + ".glsl";
-
-			std::ofstream ostrm( shaderCompileInfoVec[ i ].glslPath, std::ios_base::out | std::ios_base::trunc );
-			if ( !ostrm.is_open() )
-			{
-				Error( "Could not create %s.", shaderCompileInfoVec[ i ].glslPath.c_str() );
-				SetPipelineStatus( pp, pipelineStatus_t::Doomed );
-				return false;
-			}
-
-			ostrm.write( shaderCompileInfoVec[ i ].glslCode.c_str(), shaderCompileInfoVec[ i ].glslCode.size() );
+			build.glslPath = glslPath + ".glsl";
 		}
 
-		std::string spirvFile = shaderCompileInfoVec[ i ].glslPath;
-		spirvFile += ".spv";
-
-		// Compile to spir-V
+		// Compiled to spir-V by the build step, unless the same code was compiled before
+		build.spirvKey = g_shaderCompiler.Hash( build.glslCode, build.stage );
+		if ( !g_shaderCache.Find( build.spirvKey, build.spirvFile ) )
 		{
-			if ( !CompileShader( shaderCompileInfoVec[ i ].glslPath, shaderCompileInfoVec[ i ].stageStr, spirvFile ) )
-			{
-				Error( "Compiling %s failed.", spirvFile.c_str() );
-				SetPipelineStatus( pp, pipelineStatus_t::ShaderNotCompiled );
-				return false;
-			}
+			build.spirvFile.clear();
 		}
+	}
 
-		// Create shader module
-		{
-			const shaderStage_t shaderStage = shaderStages[ i ];
-			const char *		shaderPath	= paths[ i ];
+	return true;
+}
+
+// Work is the time the jobs would have taken on a single thread
+static void LogSpeedup( const char *what, size_t count, uint32_t threadCount, int64_t wallTicks, int64_t workTicks )
+{
+	const double msPerTick = 1e3 / double( ClockTicksFrequency() );
+	const double wallMs	   = double( wallTicks ) * msPerTick;
+	const double workMs	   = double( workTicks ) * msPerTick;
 
-			auto &shader = pp.shaders[ shaderStage ];
+	Log( "%s: %zu in %.2f ms on %zu thread(s), %.2f ms of work (%.1fx speedup)",
+		 what,
+		 count,
+		 wallMs,
+		 std::min< size_t >( count, threadCount ),
+		 workMs,
+		 wallMs > 0.0 ? workMs / wallMs : 1.0 );
+}
 
-			if ( shader == nullptr )
-			{
-				shader		  = std::make_unique< shader_t >();
-				shader->stage = shaderStage;
-			}
-			else
-			{
-				shader->DestroyModule();
-			}
+static void CompileShader( shaderBuild_t &build )
+{
+	const int64_t buildTicks = GetClockTicks();
 
-			shader->path = shaderPath;
+	build.compiled =
+		g_shaderCompiler.Compile( build.glslCode, build.stage, build.glslPath, build.spirv, build.diagnostics );
 
-			shader->UpdateModule( spirvFile.c_str() );
+	build.buildTicks += GetClockTicks() - buildTicks;
+}
+
+// Modules of stages sharing their code are created from the SPIR-V of the first one
+static void CreateShaderModule( shaderBuild_t &build )
+{
+	const int64_t buildTicks = GetClockTicks();
+
+	build.shader		= std::make_unique< shader_t >();
+	build.shader->stage = build.stage;
+	build.shader->path	= build.path;
+
+	if ( !build.spirvFile.empty() )
+	{
+		try
+		{
+			build.shader->UpdateModule( build.spirvFile.c_str() );
+		}
+		catch ( const std::ios::failure &e )
+		{
+			build.readError = e.what();
+		}
+	}
+	else
+	{
+		const shaderBuild_t &compile = build.sameCode ? *build.sameCode : build;
+		if ( compile.compiled )
+		{
+			build.shader->UpdateModule( compile.spirv.data(), compile.spirv.size() * sizeof( uint32_t ) );
 		}
 	}
 
-	FinalizeShadersUpdate( pp );
-
-	ValidatePipeline( pp );
-	return true;
+	build.buildTicks += GetClockTicks() - buildTicks;
 }
 
-void PipelineManager::FinalizeShadersUpdate( pipelineProg_t &pp )
+static bool IsShaderBuilt( const shaderBuild_t &build )
 {
-	AllocUBOs( pp );
-
-	UpdateResourceBindings( pp );
+	if ( !build.readError.empty() )
+	{
+		return false;
+	}
 
-	UpdateDescriptorSetUBO( pp );
+	return !build.spirvFile.empty() || ( build.sameCode ? build.sameCode->compiled : build.compiled );
 }
 
-void PipelineManager::UpdateResourceBindings( pipelineProg_t &pp )
+void PipelineManager::BuildShaders( size_t count, shaderBuild_t *const *builds )
 {
-	auto &device = GetVulkanContext().device;
+	if ( count == 0 )
+	{
+		return;
+	}
 
-	// Create descriptor sets layouts
+	const int64_t startTicks = GetClockTicks();
+
+	// Stages missing from the shader cache are compiled once per batch. The fallback compiler writes its input next to
+	// the caches, stages compiled together need their own file.
+	std::vector< shaderBuild_t * >					compiles;
+	std::unordered_map< uint64_t, shaderBuild_t * > compilesByKey;
+	std::unordered_map< std::string, uint32_t >		glslPathUses;
+	for ( size_t i = 0; i < count; ++i )
 	{
-		std::array< std::vector< VkDescriptorSetLayoutBinding >, DS_COUNT > dslbVecTable;
+		shaderBuild_t &build = *builds[ i ];
+		if ( !build.spirvFile.empty() )
+		{
+			continue;
+		}
 
-		for ( interfaceBlock_t &ib : pp.interfaceBlocks )
+		auto found = compilesByKey.find( build.spirvKey );
+		if ( found != compilesByKey.end() )
 		{
-			descriptorSet_t setId = BindingTypeToDescSet( ib.type );
+			build.sameCode = found->second;
+			continue;
+		}
+		compilesByKey[ build.spirvKey ] = &build;
 
-			std::vector< VkDescriptorSetLayoutBinding > &dslbVec = dslbVecTable[ setId ];
+		const uint32_t uses = glslPathUses[ build.glslPath ]++;
+		if ( uses > 0 )
+		{
+			build.glslPath.insert( build.glslPath.rfind( '.' ), '.' + std::to_string( uses ) );
+		}
 
-			const auto predSameBinding = [ & ]( const VkDescriptorSetLayoutBinding &elt ) {
-				return elt.binding == ib.binding;
-			};
+		compiles.emplace_back( &build );
+	}
+
+	const uint32_t threadCount = m_compileThreads.GetThreadCount();
+
+	const uint32_t compileCount = static_cast< uint32_t >( compiles.size() );
+	m_compileThreads.ParallelFor( compileCount, threadCount, [ & ]( uint32_t index, uint32_t ) {
+		CompileShader( *compiles[ index ] );
+	} );
+
+	m_compileThreads.ParallelFor( static_cast< uint32_t >( count ), threadCount, [ & ]( uint32_t index, uint32_t ) {
+		CreateShaderModule( *builds[ index ] );
+	} );
+
+	int64_t workTicks = 0;
+	for ( size_t i = 0; i < count; ++i )
+	{
+		workTicks += builds[ i ]->buildTicks;
+	}
+
+	LogSpeedup( "Shaders built", count, threadCount, GetClockTicks() - startTicks, workTicks );
+}
+
+// Prints the diagnostics of the builds and adds the SPIR-V they compiled to the shader cache
+bool PipelineManager::ReportShaders( size_t count, shaderBuild_t *builds )
+{
+	bool built = true;
+
+	for ( size_t i = 0; i < count; ++i )
+	{
+		shaderBuild_t &build = builds[ i ];
+
+		// Lines of the generated GLSL back to the ones of the shader
+		for ( shaderDiagnostic_t &diagnostic : build.diagnostics )
+		{
+			if ( diagnostic.file == build.glslPath )
+			{
+				const auto &sourceLineMaps = build.sourceLineMaps;
+
+				diagnostic.file = build.path;
+				diagnostic.line = ShaderLexer::MapLine( build.lineMap, diagnostic.line );
+				for ( auto it = sourceLineMaps.crbegin(); it != sourceLineMaps.crend(); ++it )
+				{
+					diagnostic.line = ShaderLexer::MapLine( *it, diagnostic.line );
+				}
+			}
+
+			if ( diagnostic.error )
+			{
+				Error( "%s(%u): error: %s", diagnostic.file.c_str(), diagnostic.line, diagnostic.message.c_str() );
+			}
+			else
+			{
+				Log( "%s(%u): warning: %s", diagnostic.file.c_str(), diagnostic.line, diagnostic.message.c_str() );
+			}
+
+			m_shaderDiagnostics.emplace_back( std::move( diagnostic ) );
+		}
+
+		if ( !build.readError.empty() )
+		{
+			Error( "%s", build.readError.c_str() );
+			built = false;
+			continue;
+		}
+
+		if ( build.spirvFile.empty() )
+		{
+			if ( !IsShaderBuilt( build ) )
+			{
+				Error( "Compiling %s failed.", build.path.c_str() );
+				built = false;
+				continue;
+			}
+
+			// Compiled anyway if the blob cannot be written
+			if ( !build.sameCode )
+			{
+				g_shaderCache.Add( build.spirvKey, build.spirv.data(), build.spirv.size() * sizeof( uint32_t ) );
+			}
+		}
+	}
+
+	return built;
+}
+
+bool PipelineManager::FinishShaders( pipelineProg_t &pp, size_t count, shaderBuild_t *builds )
+{
+	const bool built = ReportShaders( count, builds );
+
+	for ( size_t i = 0; i < count; ++i )
+	{
+		if ( IsShaderBuilt( builds[ i ] ) )
+		{
+			pp.shaders[ builds[ i ].stage ] = std::move( builds[ i ].shader );
+		}
+	}
+
+	if ( !built )
+	{
+		SetPipelineStatus( pp, pipelineStatus_t::ShaderNotCompiled );
+		return false;
+	}
+
+	FinalizeShadersUpdate( pp );
+
+	ValidatePipeline( pp );
+	return true;
+}
+
+void PipelineManager::FinalizeShadersUpdate( pipelineProg_t &pp )
+{
+	AllocUBOs( pp );
+
+	UpdateResourceBindings( pp );
+
+	UpdateDescriptorSetUBO( pp );
+}
+
+void PipelineManager::UpdateResourceBindings( pipelineProg_t &pp )
+{
+	auto &device = GetVulkanContext().device;
+
+	// Create descriptor sets layouts
+	{
+		std::array< std::vector< VkDescriptorSetLayoutBinding >, DS_COUNT > dslbVecTable;
+
+		for ( interfaceBlock_t &ib : pp.interfaceBlocks )
+		{
+			descriptorSet_t setId = BindingTypeToDescSet( ib.type );
+
+			std::vector< VkDescriptorSetLayoutBinding > &dslbVec = dslbVecTable[ setId ];
+
+			const auto predSameBinding = [ & ]( const VkDescriptorSetLayoutBinding &elt ) {
+				return elt.binding == ib.binding;
+			};
 			if ( std::find_if( dslbVec.cbegin(), dslbVec.cend(), predSameBinding ) == dslbVec.cend() )
 			{
 				VkDescriptorSetLayoutBinding dslb {};
@@ -1118,7 +1590,26 @@ void PipelineManager::UpdateResourceBindings( pipelineProg_t &pp )
 			}
 		}
 
-		DestroyDescriptorSetLayouts( pp );
+		// Dynamic offsets are given in set then binding order, all bindings of a set share the same offset
+		uint32_t dynamicOffsetCount = 0;
+		for ( size_t i = 0; i < dslbVecTable.size(); ++i )
+		{
+			const bool isDynamic = DS_VK_TYPES[ i ] == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+
+			pp.dynamicOffsetCounts[ i ] = isDynamic ? static_cast< uint32_t >( dslbVecTable[ i ].size() ) : 0;
+			dynamicOffsetCount += pp.dynamicOffsetCounts[ i ];
+		}
+
+		const uint32_t maxDynamicUBOs =
+			GetVulkanContext().gpu.properties.limits.maxDescriptorSetUniformBuffersDynamic;
+		if ( dynamicOffsetCount > RENDERPROGS_MAX_DYNAMIC_UBOS || dynamicOffsetCount > maxDynamicUBOs )
+		{
+			FatalError( "Pipeline uses %u uniform blocks, max is %u.",
+						dynamicOffsetCount,
+						std::min< uint32_t >( RENDERPROGS_MAX_DYNAMIC_UBOS, maxDynamicUBOs ) );
+		}
+
+		RetireDescriptorSetLayouts( pp );
 
 		for ( size_t i = 0; i < dslbVecTable.size(); ++i )
 		{
@@ -1140,7 +1631,7 @@ void PipelineManager::UpdateResourceBindings( pipelineProg_t &pp )
 
 	// Create pipeline layout
 	{
-		DestroyPipelineLayout( pp );
+		RetirePipelineLayout( pp );
 
 		VkPipelineLayoutCreateInfo plCI {};
 		plCI.sType				 = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
@@ -1153,20 +1644,21 @@ void PipelineManager::UpdateResourceBindings( pipelineProg_t &pp )
 
 		VK_CHECK( vkCreatePipelineLayout( device, &plCI, nullptr, &pp.pipelineLayout ) );
 
-		FreeDescriptorSets( pp );
+		RetireDescriptorSets( pp );
 		AllocDescriptorSets( pp );
 	}
 }
 
-void PipelineManager::DestroyResourceBindings( pipelineProg_t &pp )
+void PipelineManager::RetireResourceBindings( pipelineProg_t &pp )
 {
 	FreeUBOs( pp );
-	FreeDescriptorSets( pp );
-	DestroyDescriptorSetLayouts( pp );
-	DestroyPipelineLayout( pp );
+	RetireDescriptorSets( pp );
+	RetireDescriptorSetLayouts( pp );
+	RetirePipelineLayout( pp );
 	pp.interfaceBlocks.clear();
 	pp.sharedInterfaceBlockBindings.clear();
 	pp.pipelineLayout = VK_NULL_HANDLE;
+	pp.dynamicOffsetCounts.fill( 0 );
 	ResetCounters( pp );
 }
 
@@ -1199,7 +1691,7 @@ void PipelineManager::UpdateVertexDesc( pipelineProg_t &						 pp,
 
 void PipelineManager::UpdateState( pipelineProg_t &pp, uint64_t state )
 {
-	DestroyPipelineHandle( pp );
+	RetirePipelineHandle( pp );
 	pp.stateBits = state;
 }
 
@@ -1220,42 +1712,376 @@ byte *PipelineManager::GetUBOPtr( const pipelineProg_t &pp, int interfaceBlockIn
 		}
 	}
 
-	return static_cast< byte * >( pp.uboPool->GetPointer() ) + offset;
+	return pp.uboPool->data.data() + offset;
+}
+
+static size_t GetShaderPaths( const pipelineProg_t &pp, shaderStage_t *stages, const char **paths )
+{
+	size_t count = 0;
+
+	for ( int i = 0; i < SS_COUNT; ++i )
+	{
+		auto &shader = pp.shaders[ i ];
+		if ( shader == nullptr )
+		{
+			continue;
+		}
+
+		stages[ count ] = shader->stage;
+		paths[ count ]	= shader->path.c_str();
+
+		++count;
+	}
+
+	return count;
 }
 
 NO_DISCARD bool PipelineManager::Reload( pipelineProg_t &pp )
 {
-	bool shadersReloaded = ReloadShaders( pp );
+	pipelineProg_t *pps[] = { &pp };
+
+	return Reload( 1, pps );
+}
 
-	if ( shadersReloaded && pp.serializedValues )
+bool PipelineManager::Reload( size_t count, pipelineProg_t *const *pps, bool *reloaded )
+{
+	m_shaderDiagnostics.clear();
+
+	std::vector< std::vector< shaderBuild_t > > builds( count );
+	std::vector< shaderBuild_t * >				buildPtrs;
+	std::vector< uint8_t >						parsed( count, 0 );
+
+	for ( size_t p = 0; p < count; ++p )
 	{
-		DeserializeInterfaceBlocks( pp, *pp.serializedValues );
+		pipelineProg_t &pp = *pps[ p ];
+
+		shaderStage_t stages[ SS_COUNT ];
+		const char *  paths[ SS_COUNT ];
+		const size_t  shaderCount = GetShaderPaths( pp, stages, paths );
+
+		std::vector< std::string > shaderCodes;
+		if ( !ReadShaders( pp, shaderCount, paths, shaderCodes ) ||
+			 !ParseShaders( pp, shaderCount, stages, paths, shaderCodes.data(), builds[ p ] ) )
+		{
+			continue;
+		}
+
+		parsed[ p ] = 1;
+		for ( shaderBuild_t &build : builds[ p ] )
+		{
+			buildPtrs.emplace_back( &build );
+		}
 	}
 
-	return shadersReloaded;
+	BuildShaders( buildPtrs.size(), buildPtrs.data() );
+
+	bool allReloaded = true;
+	for ( size_t p = 0; p < count; ++p )
+	{
+		pipelineProg_t &pp = *pps[ p ];
+
+		const bool shadersReloaded = parsed[ p ] && FinishShaders( pp, builds[ p ].size(), builds[ p ].data() );
+		if ( shadersReloaded && pp.serializedValues )
+		{
+			DeserializeInterfaceBlocks( pp, *pp.serializedValues );
+		}
+
+		if ( reloaded )
+		{
+			reloaded[ p ] = shadersReloaded;
+		}
+		allReloaded &= shadersReloaded;
+	}
+
+	SavePipelineCacheIfDue();
+
+	return allReloaded;
 }
 
 bool PipelineManager::ReloadShaders( pipelineProg_t &pp )
 {
 	shaderStage_t stages[ SS_COUNT ];
 	char const *  paths[ SS_COUNT ];
-	size_t		  count = 0;
+	const size_t  count = GetShaderPaths( pp, stages, paths );
 
-	for ( int i = 0; i < SS_COUNT; ++i )
+	return LoadShaders( pp, count, stages, paths );
+}
+
+void PipelineManager::CreatePipelines( size_t count, pipelineProg_t *const *pps )
+{
+	std::vector< pipelineProg_t * > creations;
+	for ( size_t i = 0; i < count; ++i )
 	{
-		auto &shader = pp.shaders[ i ];
-		if ( shader == nullptr )
+		if ( pps[ i ]->GetStatus() == pipelineStatus_t::Ok && pps[ i ]->pipeline == VK_NULL_HANDLE )
+		{
+			creations.emplace_back( pps[ i ] );
+		}
+	}
+
+	if ( creations.empty() )
+	{
+		return;
+	}
+
+	const int64_t  startTicks	 = GetClockTicks();
+	const int64_t  pipelineTicks = m_pipelineTicks;
+	const uint32_t threadCount	 = m_compileThreads.GetThreadCount();
+
+	// The pipeline cache is internally synchronized
+	const uint32_t creationCount = static_cast< uint32_t >( creations.size() );
+	m_compileThreads.ParallelFor( creationCount, threadCount, [ & ]( uint32_t index, uint32_t ) {
+		pipelineProg_t &pp = *creations[ index ];
+		if ( pp.shaders[ SS_COMPUTE ] )
+		{
+			CreateComputePipeline( pp );
+		}
+		else
+		{
+			CreateGraphicsPipeline( pp );
+		}
+	} );
+
+	LogSpeedup( "Pipelines created",
+				creations.size(),
+				threadCount,
+				GetClockTicks() - startTicks,
+				m_pipelineTicks - pipelineTicks );
+}
+
+bool PipelineManager::ReloadAsync( size_t count, const pipelineReloadDesc_t *descs, reloadCallback_t onDone )
+{
+	std::unique_ptr< reloadJob_t > job = std::make_unique< reloadJob_t >();
+	job->reloads.resize( count );
+	job->onDone		= std::move( onDone );
+	job->startTicks = GetClockTicks();
+
+	// Parsing updates the shared blocks and the descriptor sets come from m_descriptorPool, both stay on this thread
+	for ( size_t i = 0; i < count; ++i )
+	{
+		const pipelineReloadDesc_t &desc   = descs[ i ];
+		pipelineReload_t &			reload = job->reloads[ i ];
+
+		std::shared_ptr< pipelineProg_t > pp = desc.pipeline.lock();
+		if ( !pp || desc.stages.size() != desc.paths.size() )
+		{
+			CHECK_PRED( false );
+			return false;
+		}
+
+		reload.target = desc.pipeline;
+		reload.next	  = std::make_unique< pipelineProg_t >();
+
+		pipelineProg_t &next	  = *reload.next;
+		next.stateBits			  = desc.stateBits;
+		next.vertexBindingDesc	  = pp->vertexBindingDesc;
+		next.vertexAttributeDescs = pp->vertexAttributeDescs;
+
+		std::vector< const char * > paths;
+		for ( const std::string &path : desc.paths )
+		{
+			paths.emplace_back( path.c_str() );
+		}
+
+		// The events of the live pipeline rewrite the shaders, they stay owned by it
+		const size_t			   shaderCount = paths.size();
+		std::vector< std::string > shaderCodes;
+		next.events		  = pp->events;
+		const bool parsed = ReadShaders( next, shaderCount, paths.data(), shaderCodes ) &&
+							ParseShaders( next,
+										  shaderCount,
+										  desc.stages.data(),
+										  paths.data(),
+										  shaderCodes.data(),
+										  reload.builds );
+		next.events = nullptr;
+
+		if ( !parsed )
+		{
+			return false;
+		}
+
+		FinalizeShadersUpdate( next );
+
+		// The fallback compiler must not overwrite the GLSL of a load running meanwhile
+		for ( shaderBuild_t &build : reload.builds )
+		{
+			build.glslPath.insert( build.glslPath.rfind( '.' ), ".reload" );
+		}
+	}
+
+	{
+		std::lock_guard< std::mutex > lock( m_reloadMutex );
+		m_reloadQueue.emplace_back( job.get() );
+	}
+	m_reloadCv.notify_one();
+
+	m_reloadJobs.emplace_back( std::move( job ) );
+
+	return true;
+}
+
+bool PipelineManager::IsReloading( const pipelineProg_t &pp ) const
+{
+	for ( const std::unique_ptr< reloadJob_t > &job : m_reloadJobs )
+	{
+		for ( const pipelineReload_t &reload : job->reloads )
+		{
+			if ( reload.target.lock().get() == &pp )
+			{
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+void PipelineManager::UpdateReloads()
+{
+	// In request order, a pipeline reloaded twice ends up with the last shaders. onDone may request new reloads.
+	while ( !m_reloadJobs.empty() && m_reloadJobs.front()->built )
+	{
+		std::unique_ptr< reloadJob_t > job = std::move( m_reloadJobs.front() );
+		m_reloadJobs.erase( m_reloadJobs.begin() );
+
+		FinishReload( *job );
+	}
+}
+
+void PipelineManager::ReloadThreadMain()
+{
+	for ( ;; )
+	{
+		reloadJob_t *job = nullptr;
+		{
+			std::unique_lock< std::mutex > lock( m_reloadMutex );
+			m_reloadCv.wait( lock, [ this ]() { return m_reloadQuit || !m_reloadQueue.empty(); } );
+			if ( m_reloadQuit )
+			{
+				return;
+			}
+
+			job = m_reloadQueue.front();
+			m_reloadQueue.pop_front();
+		}
+
+		BuildReload( *job );
+		job->built = true;
+	}
+}
+
+// Runs on the reload thread, the stages of a job are few and built one after another
+void PipelineManager::BuildReload( reloadJob_t &job )
+{
+	for ( pipelineReload_t &reload : job.reloads )
+	{
+		bool built = true;
+		for ( shaderBuild_t &build : reload.builds )
+		{
+			if ( build.spirvFile.empty() )
+			{
+				CompileShader( build );
+			}
+			CreateShaderModule( build );
+
+			built &= IsShaderBuilt( build );
+		}
+
+		if ( !built )
 		{
 			continue;
 		}
 
-		stages[ count ] = shader->stage;
-		paths[ count ]	= shader->path.c_str();
+		pipelineProg_t &next = *reload.next;
+		for ( shaderBuild_t &build : reload.builds )
+		{
+			next.shaders[ build.stage ] = std::move( build.shader );
+		}
 
-		++count;
+		ValidatePipeline( next );
+		if ( next.GetStatus() != pipelineStatus_t::Ok )
+		{
+			continue;
+		}
+
+		// The pipeline cache is internally synchronized
+		if ( next.shaders[ SS_COMPUTE ] )
+		{
+			CreateComputePipeline( next );
+		}
+		else
+		{
+			CreateGraphicsPipeline( next );
+		}
 	}
+}
 
-	return LoadShaders( pp, count, stages, paths );
+static void SwapPipelineProgs( pipelineProg_t &a, pipelineProg_t &b )
+{
+	// Not the events nor the serialized values, which belong to the owner of the pipeline
+	std::swap( a.status, b.status );
+	std::swap( a.interfaceBlocks, b.interfaceBlocks );
+	std::swap( a.uboPool, b.uboPool );
+	std::swap( a.descriptorSets, b.descriptorSets );
+	std::swap( a.dynamicOffsetCounts, b.dynamicOffsetCounts );
+	std::swap( a.pipelineLayout, b.pipelineLayout );
+	std::swap( a.pipeline, b.pipeline );
+	std::swap( a.frameBufferSets, b.frameBufferSets );
+	std::swap( a.shaders, b.shaders );
+	std::swap( a.sharedInterfaceBlockBindings, b.sharedInterfaceBlockBindings );
+	std::swap( a.descriptorSetLayouts, b.descriptorSetLayouts );
+	std::swap( a.resourceCounters, b.resourceCounters );
+	std::swap( a.vertexBindingDesc, b.vertexBindingDesc );
+	std::swap( a.vertexAttributeDescs, b.vertexAttributeDescs );
+	std::swap( a.stateBits, b.stateBits );
+}
+
+void PipelineManager::FinishReload( reloadJob_t &job )
+{
+	m_shaderDiagnostics.clear();
+
+	bool swap = true;
+	for ( pipelineReload_t &reload : job.reloads )
+	{
+		swap &= ReportShaders( reload.builds.size(), reload.builds.data() );
+		swap &= reload.next->GetStatus() == pipelineStatus_t::Ok;
+		swap &= !reload.target.expired();
+	}
+
+	if ( swap )
+	{
+		for ( pipelineReload_t &reload : job.reloads )
+		{
+			std::shared_ptr< pipelineProg_t > pp = reload.target.lock();
+
+			// User values, as edited while the new pipeline was built
+			if ( pp->GetStatus() == pipelineStatus_t::Ok )
+			{
+				DeserializeInterfaceBlocks( *reload.next, SerializeInterfaceBlocks( *pp ) );
+			}
+
+			SwapPipelineProgs( *pp, *reload.next );
+			++pp->generation;
+
+			// Frames in flight still use the previous pipeline, its destruction retires it
+			reload.next = nullptr;
+		}
+
+		Log( "Reload: %zu pipeline(s) swapped in %.2f ms after the request",
+			 job.reloads.size(),
+			 1e3 * double( GetClockTicks() - job.startTicks ) / double( ClockTicksFrequency() ) );
+
+		SavePipelineCacheIfDue();
+	}
+	else
+	{
+		Error( "Reload failed, the previous pipelines are kept." );
+	}
+
+	if ( job.onDone )
+	{
+		job.onDone( swap );
+	}
 }
 
 void PipelineManager::ClearSerializedValues( pipelineProg_t &pp )
@@ -1268,8 +2094,8 @@ void PipelineManager::DestroyPipelineProg( pipelineProg_t &pp )
 	const shaderStage_t stage = SS_ALL;
 
 	DestroyShaders( pp, 1, &stage );
-	DestroyResourceBindings( pp );
-	DestroyPipelineHandle( pp );
+	RetireResourceBindings( pp );
+	RetirePipelineHandle( pp );
 
 	std::memset( &pp.vertexBindingDesc, 0, sizeof( pp.vertexBindingDesc ) );
 
@@ -1282,11 +2108,6 @@ void PipelineManager::DestroyPipelineProg( pipelineProg_t &pp )
 	pp.serializedValues = nullptr;
 }
 
-void PipelineManager::DestroyPipelineProgKeepResources( pipelineProg_t &pp )
-{
-	DestroyPipelineHandle( pp );
-}
-
 void PipelineManager::DestroyShaders( pipelineProg_t &pp, size_t count, const shaderStage_t *shaderStages )
 {
 	for ( size_t i = 0; i < count; ++i )
@@ -1317,7 +2138,6 @@ void PipelineManager::DestroyShaders( pipelineProg_t &pp, size_t count, const sh
 
 void PipelineManager::FreeUBOs( pipelineProg_t &pp )
 {
-	delete pp.uboPool;
 	pp.uboPool = nullptr;
 }
 
@@ -1485,10 +2305,12 @@ void PipelineManager::CreateGraphicsPipeline( pipelineProg_t &pp )
 	pipelineCI.basePipelineHandle  = VK_NULL_HANDLE;
 	pipelineCI.basePipelineIndex   = -1;
 
-	DestroyPipelineHandle( pp );
+	RetirePipelineHandle( pp );
 
-	VkDevice &device = GetVulkanContext().device;
+	VkDevice &	  device	 = GetVulkanContext().device;
+	const int64_t startTicks = GetClockTicks();
 	VK_CHECK( vkCreateGraphicsPipelines( device, m_pipelineCache, 1, &pipelineCI, nullptr, &pp.pipeline ) );
+	OnPipelineCreated( startTicks );
 }
 
 void PipelineManager::CreateComputePipeline( pipelineProg_t &pp )
@@ -1510,9 +2332,11 @@ void PipelineManager::CreateComputePipeline( pipelineProg_t &pp )
 	pipelineCI.basePipelineHandle		 = VK_NULL_HANDLE;
 	pipelineCI.basePipelineIndex		 = -1;
 
-	DestroyPipelineHandle( pp );
+	RetirePipelineHandle( pp );
 
+	const int64_t startTicks = GetClockTicks();
 	VK_CHECK( vkCreateComputePipelines( device, m_pipelineCache, 1, &pipelineCI, nullptr, &pp.pipeline ) );
+	OnPipelineCreated( startTicks );
 }
 
 void BindResource( pipelineProg_t &pp, interfaceBlock_t &interfaceBlock, uint32_t &counter )
@@ -1625,12 +2449,6 @@ void PipelineManager::UpdateDescriptorSetUBO( pipelineProg_t &pp )
 	const VkDeviceSize minUniformBufferOffsetAlignment =
 		GetVulkanContext().gpu.properties.limits.minUniformBufferOffsetAlignment;
 
-	Buffer *uboPool = pp.uboPool;
-	if ( !uboPool )
-	{
-		return; // #TODO risky early exit ?
-	}
-
 	std::vector< const interfaceBlock_t * > privateUBOs = GetUniquePrivateUBOs( pp );
 	std::vector< const interfaceBlock_t * > sharedUBOs	= GetUniqueSharedBlocks( pp );
 
@@ -1655,7 +2473,7 @@ void PipelineManager::UpdateDescriptorSetUBO( pipelineProg_t &pp )
 	// Private UBOs
 	{
 		VkDescriptorBufferInfo dbi {};
-		dbi.buffer = uboPool->GetHandle();
+		dbi.buffer = g_frameArena.GetHandle();
 
 		VkDeviceSize offset = 0;
 		for ( const interfaceBlock_t *ib : privateUBOs )
@@ -1696,7 +2514,7 @@ void PipelineManager::UpdateDescriptorSetUBO( pipelineProg_t &pp )
 		wds.descriptorType = DS_VK_TYPES[ DS_SHARED_BUFFER ];
 
 		VkDescriptorBufferInfo dbi {};
-		dbi.buffer = m_sharedBlocksPool->GetHandle();
+		dbi.buffer = g_frameArena.GetHandle();
 
 		VkDeviceSize offset = 0;
 		for ( const interfaceBlock_t *ib : sharedUBOs )
@@ -1742,6 +2560,59 @@ void PipelineManager::UpdateDescriptorSetUBO( pipelineProg_t &pp )
 	vkUpdateDescriptorSets( device, static_cast< uint32_t >( wdsVec.size() ), wdsVec.data(), 0, nullptr );
 }
 
+void PipelineManager::BindDescriptorSets( VkCommandBuffer cmdBuffer, VkPipelineBindPoint bindPoint, pipelineProg_t &pp )
+{
+	std::array< uint32_t, RENDERPROGS_MAX_DYNAMIC_UBOS > dynamicOffsets;
+	uint32_t											 dynamicOffsetCount = 0;
+
+	for ( uint32_t i = 0; i < pp.dynamicOffsetCounts[ DS_UBO ]; ++i )
+	{
+		dynamicOffsets[ dynamicOffsetCount++ ] = static_cast< uint32_t >( pp.uboPool->dynamicOffset );
+	}
+	for ( uint32_t i = 0; i < pp.dynamicOffsetCounts[ DS_SHARED_BUFFER ]; ++i )
+	{
+		dynamicOffsets[ dynamicOffsetCount++ ] = static_cast< uint32_t >( m_sharedBlocksPool.dynamicOffset );
+	}
+
+	std::array< VkDescriptorSet, DS_COUNT > descriptorSets = pp.descriptorSets;
+	descriptorSets[ DS_BUFFER ]							   = pp.frameBufferSets[ g_frameArena.GetFrameIndex() ];
+
+	vkCmdBindDescriptorSets( cmdBuffer,
+							 bindPoint,
+							 pp.pipelineLayout,
+							 0,
+							 static_cast< uint32_t >( descriptorSets.size() ),
+							 descriptorSets.data(),
+							 dynamicOffsetCount,
+							 dynamicOffsets.data() );
+}
+
+void PipelineManager::UploadUBOs( pipelineProg_t &pp )
+{
+	const VkDeviceSize minUniformBufferOffsetAlignment =
+		GetVulkanContext().gpu.properties.limits.minUniformBufferOffsetAlignment;
+
+	const uint64_t frameId = g_frameArena.GetFrameId();
+
+	CHECK_PRED( pp.dynamicOffsetCounts[ DS_UBO ] == 0 || pp.uboPool );
+
+	std::array< uboPool_t *, 2 > pools = { pp.uboPool.get(),
+										   pp.dynamicOffsetCounts[ DS_SHARED_BUFFER ] ? &m_sharedBlocksPool : nullptr };
+	for ( uboPool_t *pool : pools )
+	{
+		if ( pool == nullptr || pool->uploadFrameId == frameId )
+		{
+			continue;
+		}
+
+		frameAllocation_t slice = g_frameArena.Alloc( pool->data.size(), minUniformBufferOffsetAlignment );
+		std::memcpy( slice.data, pool->data.data(), pool->data.size() );
+
+		pool->dynamicOffset = slice.offset;
+		pool->uploadFrameId = frameId;
+	}
+}
+
 void PipelineManager::AllocUBOs( pipelineProg_t &pp )
 {
 	const VkDeviceSize minUniformBufferOffsetAlignment =
@@ -1764,8 +2635,8 @@ void PipelineManager::AllocUBOs( pipelineProg_t &pp )
 
 	if ( allocSize > 0 )
 	{
-		pp.uboPool = new Buffer;
-		pp.uboPool->Alloc( VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, BP_DYNAMIC, allocSize );
+		pp.uboPool = std::make_shared< uboPool_t >();
+		pp.uboPool->data.assign( allocSize, 0 );
 	}
 }
 
@@ -1781,53 +2652,81 @@ void PipelineManager::AllocDescriptorSets( pipelineProg_t &pp )
 	allocInfo.pSetLayouts		 = pp.descriptorSetLayouts.data();
 
 	VK_CHECK( vkAllocateDescriptorSets( device, &allocInfo, pp.descriptorSets.data() ) );
+
+	std::array< VkDescriptorSetLayout, SWAPCHAIN_BUFFERING_LEVEL - 1 > frameBufferLayouts;
+	frameBufferLayouts.fill( pp.descriptorSetLayouts[ DS_BUFFER ] );
+
+	allocInfo.descriptorSetCount = static_cast< uint32_t >( frameBufferLayouts.size() );
+	allocInfo.pSetLayouts		 = frameBufferLayouts.data();
+
+	pp.frameBufferSets[ 0 ] = pp.descriptorSets[ DS_BUFFER ];
+	VK_CHECK( vkAllocateDescriptorSets( device, &allocInfo, pp.frameBufferSets.data() + 1 ) );
 }
 
-void PipelineManager::FreeDescriptorSets( pipelineProg_t &pp )
+void PipelineManager::RetireDescriptorSets( pipelineProg_t &pp )
 {
-	auto &device = GetVulkanContext().device;
 	if ( pp.descriptorSets.size() > 0 && pp.descriptorSets[ 0 ] != VK_NULL_HANDLE )
 	{
-		vkFreeDescriptorSets( device,
-							  m_descriptorPool,
-							  static_cast< uint32_t >( pp.descriptorSets.size() ),
-							  pp.descriptorSets.data() );
+		// frameBufferSets[ 0 ] is descriptorSets[ DS_BUFFER ]
+		std::array< VkDescriptorSet, DS_COUNT + SWAPCHAIN_BUFFERING_LEVEL - 1 > sets;
+		std::copy( pp.descriptorSets.cbegin(), pp.descriptorSets.cend(), sets.begin() );
+		std::copy( pp.frameBufferSets.cbegin() + 1, pp.frameBufferSets.cend(), sets.begin() + DS_COUNT );
+
+		for ( std::vector< bufferWrite_t > &writes : m_bufferWrites )
+		{
+			const auto IsRetired = [ & ]( const bufferWrite_t &write ) {
+				return std::find( sets.cbegin(), sets.cend(), write.set ) != sets.cend();
+			};
+			writes.erase( std::remove_if( writes.begin(), writes.end(), IsRetired ), writes.end() );
+		}
+
+		for ( VkDescriptorSet set : sets )
+		{
+			garbage_t garbage;
+			garbage.descriptorSet = set;
+			Retire( garbage );
+		}
+
 		std::memset( pp.descriptorSets.data(), 0, pp.descriptorSets.size() * sizeof( pp.descriptorSets[ 0 ] ) );
+		std::memset( pp.frameBufferSets.data(), 0, pp.frameBufferSets.size() * sizeof( pp.frameBufferSets[ 0 ] ) );
 	}
 }
 
-void PipelineManager::DestroyDescriptorSetLayouts( pipelineProg_t &pp )
+void PipelineManager::RetireDescriptorSetLayouts( pipelineProg_t &pp )
 {
-	auto &device = GetVulkanContext().device;
-
 	for ( VkDescriptorSetLayout &dsl : pp.descriptorSetLayouts )
 	{
 		if ( dsl != VK_NULL_HANDLE )
 		{
-			vkDestroyDescriptorSetLayout( device, dsl, nullptr );
+			garbage_t garbage;
+			garbage.descriptorSetLayout = dsl;
+			Retire( garbage );
+
 			dsl = VK_NULL_HANDLE;
 		}
 	}
 }
 
-void PipelineManager::DestroyPipelineLayout( pipelineProg_t &pp )
+void PipelineManager::RetirePipelineLayout( pipelineProg_t &pp )
 {
-	auto &device = GetVulkanContext().device;
-
 	if ( pp.pipelineLayout != VK_NULL_HANDLE )
 	{
-		vkDestroyPipelineLayout( device, pp.pipelineLayout, nullptr );
+		garbage_t garbage;
+		garbage.pipelineLayout = pp.pipelineLayout;
+		Retire( garbage );
+
 		pp.pipelineLayout = VK_NULL_HANDLE;
 	}
 }
 
-void PipelineManager::DestroyPipelineHandle( pipelineProg_t &pp )
+void PipelineManager::RetirePipelineHandle( pipelineProg_t &pp )
 {
-	auto &device = GetVulkanContext().device;
-
 	if ( pp.pipeline != VK_NULL_HANDLE )
 	{
-		vkDestroyPipeline( device, pp.pipeline, nullptr );
+		garbage_t garbage;
+		garbage.pipeline = pp.pipeline;
+		Retire( garbage );
+
 		pp.pipeline = VK_NULL_HANDLE;
 	}
 }
@@ -1878,9 +2777,180 @@ void PipelineManager ::CreatePipelineCache()
 
 	DestroyPipelineCache();
 
+	m_pipelineCacheStats	 = pipelineCacheStats_t();
+	m_pipelineTicks			 = 0;
+	m_pipelineCacheSaveTicks = GetClockTicks();
+	m_pipelineCacheDirty	 = false;
+
+	std::vector< char > data;
+	const bool			warm = LoadPipelineCacheData( data );
+
 	VkPipelineCacheCreateInfo pipelineCacheCreateInfo {};
-	pipelineCacheCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
-	VK_CHECK( vkCreatePipelineCache( device, &pipelineCacheCreateInfo, nullptr, &m_pipelineCache ) );
+	pipelineCacheCreateInfo.sType			= VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	pipelineCacheCreateInfo.initialDataSize = warm ? data.size() - sizeof( pipelineCacheHeader_t ) : 0;
+	pipelineCacheCreateInfo.pInitialData	= warm ? data.data() + sizeof( pipelineCacheHeader_t ) : nullptr;
+
+	// Drivers may still reject data they do not recognize, start from an empty cache then
+	VkResult ret = vkCreatePipelineCache( device, &pipelineCacheCreateInfo, nullptr, &m_pipelineCache );
+	if ( warm && ret != VK_SUCCESS )
+	{
+		Log( "Pipeline cache: \"%s\" rejected by the driver, starting cold", PIPELINE_CACHE_PATH );
+
+		pipelineCacheCreateInfo.initialDataSize = 0;
+		pipelineCacheCreateInfo.pInitialData	= nullptr;
+		ret = vkCreatePipelineCache( device, &pipelineCacheCreateInfo, nullptr, &m_pipelineCache );
+	}
+	VK_CHECK( ret );
+
+	m_pipelineCacheStats.warm		= warm && pipelineCacheCreateInfo.pInitialData != nullptr;
+	m_pipelineCacheStats.loadedSize = pipelineCacheCreateInfo.initialDataSize;
+}
+
+bool PipelineManager::LoadPipelineCacheData( std::vector< char > &data )
+{
+	try
+	{
+		data = ReadBinary< char >( PIPELINE_CACHE_PATH );
+	}
+	catch ( const std::ios::failure & )
+	{
+		Log( "Pipeline cache: no \"%s\", starting cold", PIPELINE_CACHE_PATH );
+		return false;
+	}
+
+	pipelineCacheHeader_t expected;
+	FillPipelineCacheHeader( expected );
+
+	pipelineCacheHeader_t header;
+	if ( data.size() < sizeof( header ) )
+	{
+		Log( "Pipeline cache: \"%s\" is truncated, discarding it", PIPELINE_CACHE_PATH );
+		return false;
+	}
+	std::memcpy( &header, data.data(), sizeof( header ) );
+
+	const char * payload	 = data.data() + sizeof( header );
+	const size_t payloadSize = data.size() - sizeof( header );
+
+	const char *reason = nullptr;
+	if ( header.magic != expected.magic || header.version != expected.version )
+	{
+		reason = "unknown format";
+	}
+	else if ( header.vendorID != expected.vendorID || header.deviceID != expected.deviceID )
+	{
+		reason = "other device";
+	}
+	else if ( header.driverVersion != expected.driverVersion )
+	{
+		reason = "other driver version";
+	}
+	else if ( std::memcmp( header.pipelineCacheUUID, expected.pipelineCacheUUID, VK_UUID_SIZE ) != 0 )
+	{
+		reason = "other pipeline cache UUID";
+	}
+	else if ( header.dataSize != payloadSize || header.dataHash != HashFNV1a( payload, payloadSize ) )
+	{
+		reason = "corrupted data";
+	}
+	else if ( payloadSize < 16 + VK_UUID_SIZE )
+	{
+		reason = "no driver header";
+	}
+	else
+	{
+		// Header written by the driver: length, version, vendor ID, device ID and pipeline cache UUID
+		uint32_t driverHeader[ 4 ];
+		std::memcpy( driverHeader, payload, sizeof( driverHeader ) );
+
+		if ( driverHeader[ 0 ] < 16 + VK_UUID_SIZE || driverHeader[ 1 ] != VK_PIPELINE_CACHE_HEADER_VERSION_ONE ||
+			 driverHeader[ 2 ] != expected.vendorID || driverHeader[ 3 ] != expected.deviceID ||
+			 std::memcmp( payload + 16, expected.pipelineCacheUUID, VK_UUID_SIZE ) != 0 )
+		{
+			reason = "driver header mismatch";
+		}
+	}
+
+	if ( reason )
+	{
+		Log( "Pipeline cache: discarding \"%s\" (%s), starting cold", PIPELINE_CACHE_PATH, reason );
+		return false;
+	}
+
+	Log( "Pipeline cache: loaded %zu bytes from \"%s\"", payloadSize, PIPELINE_CACHE_PATH );
+
+	return true;
+}
+
+// Hot reloads keep the cache on disk up to date, in case the application does not shut down properly
+void PipelineManager::SavePipelineCacheIfDue()
+{
+	// The reload thread may be creating pipelines into the cache, it is saved once no reload is pending
+	if ( !m_reloadJobs.empty() )
+	{
+		return;
+	}
+
+	const double sinceSaveS = double( GetClockTicks() - m_pipelineCacheSaveTicks ) / double( ClockTicksFrequency() );
+	if ( sinceSaveS >= PIPELINE_CACHE_SAVE_INTERVAL_S && IsPipelineCacheDirty() )
+	{
+		SavePipelineCache();
+	}
+}
+
+void PipelineManager::SavePipelineCache()
+{
+	auto &device = GetVulkanContext().device;
+
+	// Pipelines created from here on are saved next time
+	{
+		std::lock_guard< std::mutex > lock( m_pipelineStatsMutex );
+		m_pipelineCacheDirty = false;
+	}
+
+	// The cache grows if pipelines are created between both calls, the copy is then incomplete and retried
+	std::vector< char > data;
+	size_t				size = 0;
+	VkResult			ret	 = VK_INCOMPLETE;
+	while ( ret == VK_INCOMPLETE )
+	{
+		VK_CHECK( vkGetPipelineCacheData( device, m_pipelineCache, &size, nullptr ) );
+
+		data.resize( sizeof( pipelineCacheHeader_t ) + size );
+		ret = vkGetPipelineCacheData( device, m_pipelineCache, &size, data.data() + sizeof( pipelineCacheHeader_t ) );
+	}
+	VK_CHECK( ret );
+	data.resize( sizeof( pipelineCacheHeader_t ) + size );
+
+	pipelineCacheHeader_t header;
+	FillPipelineCacheHeader( header );
+	header.dataSize = size;
+	header.dataHash = HashFNV1a( data.data() + sizeof( header ), size );
+	std::memcpy( data.data(), &header, sizeof( header ) );
+
+	// The previous cache stays on disk if the write fails
+	if ( WriteFileAtomic( PIPELINE_CACHE_PATH, data.data(), data.size() ) )
+	{
+		++m_pipelineCacheStats.saveCount;
+	}
+
+	m_pipelineCacheSaveTicks = GetClockTicks();
+}
+
+bool PipelineManager::IsPipelineCacheDirty()
+{
+	std::lock_guard< std::mutex > lock( m_pipelineStatsMutex );
+
+	return m_pipelineCacheDirty;
+}
+
+void PipelineManager::OnPipelineCreated( int64_t startTicks )
+{
+	std::lock_guard< std::mutex > lock( m_pipelineStatsMutex );
+
+	m_pipelineTicks += GetClockTicks() - startTicks;
+	++m_pipelineCacheStats.pipelineCount;
+	m_pipelineCacheDirty = true;
 }
 
 void PipelineManager::DestroyPipelineCache()
@@ -8,20 +8,28 @@
 #include "external/vulkan/vulkan.hpp"
 #include "platform/Serializable.h"
 #include "platform/Sys.h"
+#include "platform/ThreadPool.h"
 #include "platform/defines.h"
 #include "renderer/Buffer.h"
+#include "renderer/BufferPool.h"
 #include "renderer/RenderConfig.h"
 #include "renderer/Shader.h"
+#include "renderer/ShaderCompiler.h"
 #include "renderer/ShaderLexer.h"
 #include "renderer/State.h"
 #include "rnLib/Event.h"
 #include "rnLib/Math.h"
 
 #include <array>
+#include <condition_variable>
 #include <cstring>
+#include <deque>
 #include <exception>
+#include <functional>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 
 namespace vkRuna
@@ -33,8 +41,38 @@ class Image;
 class VulkanBackend;
 
 struct pipelineProg_t;
+struct reloadJob_t;
+struct shaderBuild_t;
 struct vkGraphicsPipeline_t;
 
+// CPU side copy of uniform blocks. It is copied to the frame arena the first time it is bound in a frame, so that
+// writes never race frames still in flight.
+struct uboPool_t
+{
+	std::vector< byte > data;
+	uint64_t			uploadFrameId = UINT64_MAX;
+	VkDeviceSize		dynamicOffset = 0;
+};
+
+// Startup cost of the pipelines, a warm VkPipelineCache lets the driver skip their compilation
+struct pipelineCacheStats_t
+{
+	bool	 warm			= false; // Initial data loaded from CACHE_DIR
+	size_t	 loadedSize		= 0;
+	uint32_t pipelineCount	= 0; // Created since Init
+	double	 pipelineMs		= 0.0;
+	uint32_t saveCount		= 0;
+};
+
+// Shaders to rebuild a live pipeline from, see PipelineManager::ReloadAsync
+struct pipelineReloadDesc_t
+{
+	std::weak_ptr< pipelineProg_t > pipeline;
+	std::vector< shaderStage_t >	stages;
+	std::vector< std::string >		paths;
+	uint64_t						stateBits = 0; // Of the new pipeline
+};
+
 enum descriptorSet_t
 {
 	DS_UBO,
@@ -52,12 +90,23 @@ class PipelineManager
 {
 	NO_COPY_NO_ASSIGN( PipelineManager )
    public:
+	using reloadCallback_t = std::function< void( bool swapped ) >;
+
 	PipelineManager();
 	~PipelineManager();
 
 	void Init();
 	void Shutdown();
 
+	// Released pipelines, layouts and descriptor sets wait in the garbage until the frames that may use them complete,
+	// like the buffer pools. Called once the frame that last used the slot of frameId has completed.
+	void BeginFrame( uint64_t frameId );
+	void EmptyGarbage( uint64_t completedFrameCount );
+
+	pipelineCacheStats_t GetPipelineCacheStats() const;
+	// Of the last shaders loaded, lines are the ones of the shader files
+	const std::vector< shaderDiagnostic_t > &GetShaderDiagnostics() const { return m_shaderDiagnostics; }
+
    public:
 	void AddSharedInterfaceBlock( interfaceBlock_t ib );
 	void SetSharedVar( size_t count, const char *const *varNames, const float *values );
@@ -81,10 +130,15 @@ class PipelineManager
 
 	void RegisterEvent( pipelineProg_t &pp, std::unique_ptr< Event > ev );
 
+	// Binding uploads the pipeline UBOs to the frame arena, once per frame, and selects them with dynamic offsets
 	void BindGraphicsPipeline( VkCommandBuffer cmdBuffer, pipelineProg_t &graphicsPipeline );
 	// void BindGraphicsPipeline( VkCommandBuffer cmdBuffer, int cacheIndex );
 	void BindComputePipeline( VkCommandBuffer cmdBuffer, pipelineProg_t &computePipeline );
 	// void BindComputePipeline( VkCommandBuffer cmdBuffer, int cacheIndex );
+	// Prepare creates the pipeline and uploads its UBOs for the frame. Binding a prepared pipeline only records commands,
+	// several threads may then bind it into their own command buffers.
+	void PrepareGraphicsPipeline( pipelineProg_t &graphicsPipeline );
+	void PrepareComputePipeline( pipelineProg_t &computePipeline );
 
 	void UpdateUBOs( pipelineProg_t &	pp,
 					 size_t				count,
@@ -95,7 +149,7 @@ class PipelineManager
 					   size_t					 count,
 					   const std::string *const *varNames,
 					   const Image *const *		 images );
-	void UpdateBuffers( pipelineProg_t &pp, size_t count, const char *const *varNames, const Buffer *const *buffers );
+	void UpdateBuffers( pipelineProg_t &pp, size_t count, const char *const *varNames, const bufferView_t *views );
 
 	NO_DISCARD bool LoadShaders( pipelineProg_t &	  pp,
 								 size_t				  count,
@@ -118,7 +172,20 @@ class PipelineManager
 	byte *GetUBOPtr( const pipelineProg_t &pp, int interfaceBlockIndex );
 
 	NO_DISCARD bool Reload( pipelineProg_t &pp );
+	// Reloads several pipelines at once. Their shaders are parsed one after another, then compiled and turned into
+	// modules on the compile threads. reloaded, when set, receives the result of each pipeline.
+	NO_DISCARD bool Reload( size_t count, pipelineProg_t *const *pps, bool *reloaded = nullptr );
 	NO_DISCARD bool ReloadShaders( pipelineProg_t &pp );
+	// Creates the Vulkan pipelines of the valid programs on the compile threads, rather than when they are first bound
+	void CreatePipelines( size_t count, pipelineProg_t *const *pps );
+
+	// Builds new pipelines from descs on the reload thread while the live ones keep rendering. UpdateReloads swaps all
+	// of them in at once if they all built, then calls onDone. Returns false, without calling onDone, when a shader
+	// cannot be read or parsed.
+	NO_DISCARD bool ReloadAsync( size_t count, const pipelineReloadDesc_t *descs, reloadCallback_t onDone );
+	bool			IsReloading( const pipelineProg_t &pp ) const;
+	// Swaps in the pipelines built since the last call. Called before the frame records any command.
+	void UpdateReloads();
 
 	// Cached objects should be marked somehow, at least because there is no way
 	// to copy a VkShaderModule. Consider cached objects immutable ?
@@ -131,7 +198,8 @@ class PipelineManager
 	// const pipelineProg_t &GetCachedPipeline( int pipelineCacheIndex );
 	void ClearSerializedValues( pipelineProg_t &pp );
 	void DestroyPipelineProg( pipelineProg_t &pp );
-	void DestroyPipelineProgKeepResources( pipelineProg_t &pp );
+	// Releases the pipeline handle once the frames in flight complete, the resources belong to another pipeline
+	void RetirePipelineProgKeepResources( pipelineProg_t &pp ) { RetirePipelineHandle( pp ); }
 	void DestroyShaders( pipelineProg_t &pp, size_t count, const shaderStage_t *shaderStages );
 
    private:
@@ -151,27 +219,62 @@ class PipelineManager
 	std::vector< const interfaceBlock_t * > GetUniqueSharedBlocks( const pipelineProg_t &pp );
 
 	void UpdateDescriptorSetUBO( pipelineProg_t &pp );
+	void BindDescriptorSets( VkCommandBuffer cmdBuffer, VkPipelineBindPoint bindPoint, pipelineProg_t &pp );
+	void UploadUBOs( pipelineProg_t &pp );
 
 	void AllocUBOs( pipelineProg_t &pp );
 	void FreeUBOs( pipelineProg_t &pp );
 
 	void UpdateResourceBindings( pipelineProg_t &pp );
-	void DestroyResourceBindings( pipelineProg_t &pp );
+	// The Retire functions release Vulkan objects once the frames in flight complete
+	void RetireResourceBindings( pipelineProg_t &pp );
 	void ResetCounters( pipelineProg_t &pp );
 	void AllocDescriptorSets( pipelineProg_t &pp );
-	void FreeDescriptorSets( pipelineProg_t &pp );
-	void DestroyDescriptorSetLayouts( pipelineProg_t &pp );
-	void DestroyPipelineLayout( pipelineProg_t &pp );
+	void RetireDescriptorSets( pipelineProg_t &pp );
+	void RetireDescriptorSetLayouts( pipelineProg_t &pp );
+	void RetirePipelineLayout( pipelineProg_t &pp );
+
+	// LoadShaders step by step. Parsing touches shared state and runs on the calling thread, building runs on the
+	// compile threads, finishing binds the modules and the resources of the pipeline.
+	NO_DISCARD bool ReadShaders( pipelineProg_t &			 pp,
+								 size_t						 count,
+								 const char *const *		 paths,
+								 std::vector< std::string > &shaderCodes );
+	NO_DISCARD bool ParseShaders( pipelineProg_t &				pp,
+								  size_t						count,
+								  const shaderStage_t *			shaderStages,
+								  const char *const *			paths,
+								  std::string *					shaderCodes,
+								  std::vector< shaderBuild_t > &builds );
+	void			BuildShaders( size_t count, shaderBuild_t *const *builds );
+	NO_DISCARD bool ReportShaders( size_t count, shaderBuild_t *builds );
+	NO_DISCARD bool FinishShaders( pipelineProg_t &pp, size_t count, shaderBuild_t *builds );
+
+	void ReloadThreadMain();
+	void BuildReload( reloadJob_t &job );
+	void FinishReload( reloadJob_t &job );
 
 	void FinalizeShadersUpdate( pipelineProg_t &pp );
 
-	void DestroyPipelineHandle( pipelineProg_t &pp );
+	void RetirePipelineHandle( pipelineProg_t &pp );
+
+	struct garbage_t;
+	void Retire( garbage_t garbage );
+	void QueueBufferWrite( uint32_t						frameIndex,
+						   VkDescriptorSet				set,
+						   uint32_t						binding,
+						   const VkDescriptorBufferInfo &dbi );
 
 	void CreateDescriptorPool();
 	void DestroyDescriptorPool();
 
 	void CreatePipelineCache();
 	void DestroyPipelineCache();
+	bool LoadPipelineCacheData( std::vector< char > &data );
+	void SavePipelineCache();
+	void SavePipelineCacheIfDue();
+	bool IsPipelineCacheDirty();
+	void OnPipelineCreated( int64_t startTicks );
 
    private:
 	friend class VulkanBackend;
@@ -181,12 +284,54 @@ class PipelineManager
 	std::vector< shader_t >		  m_shaders;	   // holds cached shaders
 
 	std::vector< interfaceBlock_t > m_sharedBlocks;
-	Buffer *						m_sharedBlocksPool			 = nullptr;
+	uboPool_t						m_sharedBlocksPool;
 	uint32_t						m_sharedBlocksBindingCounter = 0;
 
 	VkDescriptorPool m_descriptorPool = VK_NULL_HANDLE;
 	VkPipelineCache	 m_pipelineCache  = VK_NULL_HANDLE;
 
+	pipelineCacheStats_t m_pipelineCacheStats;
+	int64_t				 m_pipelineTicks		  = 0;
+	int64_t				 m_pipelineCacheSaveTicks = 0;	   // Of the last save, or of Init
+	bool				 m_pipelineCacheDirty	  = false; // Pipelines were created since the last save
+	std::mutex			 m_pipelineStatsMutex;			   // Pipelines are created on the compile threads
+
+	std::vector< shaderDiagnostic_t > m_shaderDiagnostics;
+
+	sys::ThreadPool m_compileThreads;
+
+	// Reloads in request order. The reload thread builds the queued ones, the main thread owns them.
+	std::vector< std::unique_ptr< reloadJob_t > > m_reloadJobs;
+	std::deque< reloadJob_t * >					  m_reloadQueue;
+	std::mutex									  m_reloadMutex;
+	std::condition_variable						  m_reloadCv;
+	std::thread									  m_reloadThread;
+	bool										  m_reloadQuit = false;
+
+	// Holds a single object
+	struct garbage_t
+	{
+		VkPipeline			  pipeline			  = VK_NULL_HANDLE;
+		VkPipelineLayout	  pipelineLayout	  = VK_NULL_HANDLE;
+		VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+		VkDescriptorSet		  descriptorSet		  = VK_NULL_HANDLE;
+		uint64_t			  frameId			  = 0;
+	};
+
+	std::vector< garbage_t > m_garbage;
+	uint64_t				 m_frameId = 0;
+	std::mutex				 m_garbageMutex; // Pipelines are created on the compile and reload threads
+
+	struct bufferWrite_t
+	{
+		VkDescriptorSet		   set	   = VK_NULL_HANDLE;
+		uint32_t			   binding = 0;
+		VkDescriptorBufferInfo info {};
+	};
+
+	// DS_BUFFER writes of each frame slot, made when the slot is next recorded: frames in flight may still use its sets
+	std::array< std::vector< bufferWrite_t >, SWAPCHAIN_BUFFERING_LEVEL > m_bufferWrites;
+
    private:
 	VkDescriptorPool GetDescriptorPool() { return m_descriptorPool; }
 	VkPipelineCache	 GetPipelineCache() { return m_pipelineCache; }
@@ -218,11 +363,16 @@ struct pipelineProg_t
 
 	pipelineStatus_t						status = pipelineStatus_t::Unknown;
 	std::vector< interfaceBlock_t >			interfaceBlocks {};
-	Buffer *								uboPool = nullptr;
+	std::shared_ptr< uboPool_t >			uboPool; // Shared with the depth prepass pipeline
 	std::array< VkDescriptorSet, DS_COUNT > descriptorSets {};
+	std::array< uint32_t, DS_COUNT >		dynamicOffsetCounts {};
 	VkPipelineLayout						pipelineLayout = VK_NULL_HANDLE;
 	VkPipeline								pipeline	   = VK_NULL_HANDLE;
 
+	// DS_BUFFER set of each frame in flight, the first one is descriptorSets[ DS_BUFFER ]. BP_PER_FRAME buffers are
+	// bound to the slice of the frame.
+	std::array< VkDescriptorSet, SWAPCHAIN_BUFFERING_LEVEL > frameBufferSets {};
+
 	std::array< std::unique_ptr< shader_t >, SS_COUNT > shaders {};
 	std::vector< int >									sharedInterfaceBlockBindings {};
 
@@ -233,7 +383,8 @@ struct pipelineProg_t
 	VkVertexInputBindingDescription					 vertexBindingDesc {};
 	std::vector< VkVertexInputAttributeDescription > vertexAttributeDescs {};
 
-	uint64_t stateBits = 0;
+	uint64_t stateBits	= 0;
+	uint32_t generation = 0; // Incremented each time ReloadAsync swaps in new shaders
 
 	std::vector< std::unique_ptr< Event > > *		   events = nullptr;
 	std::unique_ptr< std::vector< SerializableData > > serializedValues;
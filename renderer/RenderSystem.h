@@ -21,6 +21,7 @@ class RenderSystem
 	virtual void BeginFrame() = 0;
 	virtual void EndFrame()	  = 0;
 
+	// GetPreRenderCmds builds the commands of the frame, it is called first
 	virtual int GetRenderCmds( gpuCmd_t **firstCmd )	= 0;
 	virtual int GetPreRenderCmds( gpuCmd_t **firstCmd ) = 0;
 
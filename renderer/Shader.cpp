@@ -14,7 +14,7 @@ static const std::array< uint32_t, MT_COUNT > NATIVE_TYPES_SIZES = { 4 * sizeof(
 																	 0,
 																	 0 };
 
-const char *vkRuna::EnumToString( shaderStage_t stage )
+const char *EnumToString( shaderStage_t stage )
 {
 	switch ( stage )
 	{
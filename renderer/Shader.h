@@ -84,6 +84,15 @@ enum shaderStage_t : uint32_t
 const char *EnumToString( shaderStage_t stage );
 const char *GetExtensionList( shaderStage_t stage );
 
+// Lines of a generated GLSL from glslLine on come from its source from sourceLine on. Lines past sourceLineCount were
+// generated, they map to its last line. A sourceLine of 0 stands for lines without source.
+struct shaderLineMap_t
+{
+	uint32_t glslLine		 = 1;
+	uint32_t sourceLine		 = 1;
+	uint32_t sourceLineCount = 1;
+};
+
 //#pragma warning( error : 4820 )
 struct shader_t
 {
@@ -92,6 +101,7 @@ struct shader_t
 	~shader_t();
 
 	void UpdateModule( const char *spvFile );
+	void UpdateModule( const uint32_t *code, size_t size ); // size in bytes
 	void DestroyModule();
 
 	bool IsValid() { return module != nullptr; }
@@ -0,0 +1,212 @@
+// Copyright (c) 2021 Arno Galvez
+
+#include "renderer/ShaderCache.h"
+
+#include "platform/Sys.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <system_error>
+#include <vector>
+
+namespace vkRuna
+{
+namespace render
+{
+namespace fs = std::filesystem;
+
+ShaderCache g_shaderCache;
+
+static const char *SHADER_CACHE_EXT = ".spv";
+
+ShaderCache::ShaderCache() {}
+
+ShaderCache::~ShaderCache()
+{
+	Shutdown();
+}
+
+void ShaderCache::Init( const char *dir, uint64_t maxSize )
+{
+	Shutdown();
+
+	m_dir	  = dir;
+	m_maxSize = maxSize;
+
+	sys::sysCallRet_t exitCode = sys::Mkdir( dir );
+	if ( exitCode != sys::sysCallRet_t::SUCCESS && exitCode != sys::sysCallRet_t::DIR_EXIST )
+	{
+		sys::FatalError( "Could not create \"%s\" Directory", dir );
+	}
+
+	struct file_t
+	{
+		fs::file_time_type lastUse;
+		entry_t			   entry;
+	};
+	std::vector< file_t > files;
+
+	std::error_code ec;
+	for ( const fs::directory_entry &dirEntry : fs::directory_iterator( m_dir, ec ) )
+	{
+		const fs::path &path = dirEntry.path();
+
+		// Left over by a compilation that did not complete
+		if ( path.extension() == ".tmp" )
+		{
+			fs::remove( path, ec );
+			continue;
+		}
+
+		const std::string stem = path.stem().string();
+		if ( path.extension() != SHADER_CACHE_EXT || stem.size() != 16 )
+		{
+			continue;
+		}
+
+		char * end = nullptr;
+		file_t file;
+		file.entry.key = std::strtoull( stem.c_str(), &end, 16 );
+		if ( *end != '\0' )
+		{
+			continue;
+		}
+
+		std::error_code sizeEc;
+		std::error_code timeEc;
+		file.entry.size = dirEntry.file_size( sizeEc );
+		file.lastUse	= dirEntry.last_write_time( timeEc );
+		if ( !sizeEc && !timeEc )
+		{
+			files.emplace_back( file );
+		}
+	}
+
+	// Blobs are touched when used, their write time orders them from one launch to the next
+	std::sort( files.begin(), files.end(), []( const file_t &a, const file_t &b ) { return a.lastUse > b.lastUse; } );
+
+	for ( const file_t &file : files )
+	{
+		m_lru.emplace_back( file.entry );
+		m_entries[ file.entry.key ] = std::prev( m_lru.end() );
+		m_stats.size += file.entry.size;
+	}
+
+	Trim();
+}
+
+void ShaderCache::Shutdown()
+{
+	if ( m_dir.empty() )
+	{
+		return;
+	}
+
+	sys::Log( "Shader cache: %u hits, %u misses, %u evictions, %zu blobs (%" PRIu64 " bytes)",
+			  m_stats.hits,
+			  m_stats.misses,
+			  m_stats.evictions,
+			  m_entries.size(),
+			  m_stats.size );
+
+	m_dir.clear();
+	m_lru.clear();
+	m_entries.clear();
+	m_stats = shaderCacheStats_t();
+}
+
+bool ShaderCache::Find( uint64_t key, std::string &path )
+{
+	path = GetPath( key );
+
+	auto found = m_entries.find( key );
+	if ( found == m_entries.end() )
+	{
+		++m_stats.misses;
+		return false;
+	}
+
+	std::error_code ec;
+	if ( !fs::exists( path, ec ) )
+	{
+		// Deleted behind our back
+		Remove( found->second );
+		++m_stats.misses;
+		return false;
+	}
+
+	m_lru.splice( m_lru.begin(), m_lru, found->second );
+	fs::last_write_time( path, fs::file_time_type::clock::now(), ec );
+
+	++m_stats.hits;
+	return true;
+}
+
+bool ShaderCache::Add( uint64_t key, const void *data, size_t size )
+{
+	// Blobs are never partially written, a crash leaves at most a .tmp file behind
+	if ( !sys::WriteFileAtomic( GetPath( key ).c_str(), data, size ) )
+	{
+		return false;
+	}
+
+	auto found = m_entries.find( key );
+	if ( found != m_entries.end() )
+	{
+		Remove( found->second );
+	}
+
+	entry_t entry;
+	entry.key  = key;
+	entry.size = size;
+
+	m_lru.emplace_front( entry );
+	m_entries[ key ] = m_lru.begin();
+	m_stats.size += entry.size;
+
+	Trim();
+
+	return true;
+}
+
+shaderCacheStats_t ShaderCache::GetStats() const
+{
+	shaderCacheStats_t stats = m_stats;
+	stats.entryCount		 = static_cast< uint32_t >( m_entries.size() );
+
+	return stats;
+}
+
+std::string ShaderCache::GetPath( uint64_t key ) const
+{
+	char name[ 17 ];
+	std::snprintf( name, sizeof( name ), "%016" PRIx64, key );
+
+	return m_dir + '/' + name + SHADER_CACHE_EXT;
+}
+
+void ShaderCache::Remove( std::list< entry_t >::iterator it )
+{
+	m_stats.size -= it->size;
+	m_entries.erase( it->key );
+	m_lru.erase( it );
+}
+
+void ShaderCache::Trim()
+{
+	// The most recently used blob is kept whatever its size, it is about to be loaded
+	while ( m_stats.size > m_maxSize && m_lru.size() > 1 )
+	{
+		std::error_code ec;
+		fs::remove( GetPath( m_lru.back().key ), ec );
+
+		Remove( std::prev( m_lru.end() ) );
+		++m_stats.evictions;
+	}
+}
+
+} // namespace render
+} // namespace vkRuna
@@ -0,0 +1,69 @@
+// Copyright (c) 2021 Arno Galvez
+
+#pragma once
+
+#include "platform/defines.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+
+namespace vkRuna
+{
+namespace render
+{
+struct shaderCacheStats_t
+{
+	uint32_t hits		= 0; // Since Init
+	uint32_t misses		= 0;
+	uint32_t evictions	= 0;
+	uint32_t entryCount = 0;
+	uint64_t size		= 0; // Bytes of SPIR-V on disk
+};
+
+// SPIR-V blobs on disk, named after the hash of everything the compiler reads to produce them. Blobs survive across
+// launches, the least recently used ones are evicted once the cache grows above its size cap.
+class ShaderCache
+{
+	NO_COPY_NO_ASSIGN( ShaderCache )
+
+   public:
+	ShaderCache();
+	~ShaderCache();
+
+	void Init( const char *dir, uint64_t maxSize );
+	void Shutdown();
+
+	// Path of the blob of key. Returns true on a hit, the blob must be added on a miss.
+	bool Find( uint64_t key, std::string &path );
+	// Writes the blob compiled for key, evicting the least recently used blobs
+	bool Add( uint64_t key, const void *data, size_t size );
+
+	shaderCacheStats_t GetStats() const;
+
+   private:
+	struct entry_t
+	{
+		uint64_t key  = 0;
+		uint64_t size = 0;
+	};
+
+	std::string GetPath( uint64_t key ) const;
+	void		Remove( std::list< entry_t >::iterator it );
+	void		Trim();
+
+   private:
+	std::string m_dir;
+	uint64_t	m_maxSize = 0;
+
+	std::list< entry_t >											   m_lru; // Most recently used first
+	std::unordered_map< uint64_t, std::list< entry_t >::iterator > m_entries;
+	shaderCacheStats_t												   m_stats;
+};
+
+extern ShaderCache g_shaderCache;
+
+} // namespace render
+} // namespace vkRuna
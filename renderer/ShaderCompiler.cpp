@@ -0,0 +1,320 @@
+// Copyright (c) 2021 Arno Galvez
+
+#include "renderer/ShaderCompiler.h"
+
+#include "platform/Sys.h"
+#include "renderer/RenderConfig.h"
+#include "rnLib/Hash.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstring>
+#include <regex>
+#include <sstream>
+
+#ifdef RUNA_SHADERC
+	#include <shaderc/shaderc.hpp>
+#endif
+
+namespace vkRuna
+{
+namespace render
+{
+using namespace sys;
+
+ShaderCompiler g_shaderCompiler;
+
+static const char *GLSL_INCLUDE_DIR = "glsl/lib";
+
+static const std::array< const char *, SS_COUNT > STAGE_NAMES = { "vert", "frag", "comp" };
+
+#ifdef RUNA_SHADERC
+static const char *COMPILER_ID = "shaderc";
+
+static const std::array< shaderc_shader_kind, SS_COUNT > SHADERC_KINDS = { shaderc_glsl_vertex_shader,
+																		   shaderc_glsl_fragment_shader,
+																		   shaderc_glsl_compute_shader };
+
+static shaderc::Compiler *g_compiler = nullptr;
+#else
+static const char *COMPILER_ID = RUNA_SHADER_COMPILER_PATH;
+#endif
+
+// Both compilers optimize for performance and target Vulkan 1.2
+static const char *COMPILER_FLAGS = "-O --target-env=vulkan1.2";
+
+static bool ReadInclude( const std::string &name, std::string &content )
+{
+	try
+	{
+		content = ReadFile( ( std::string( GLSL_INCLUDE_DIR ) + '/' + name ).c_str() );
+	}
+	catch ( const std::ios::failure & )
+	{
+		return false;
+	}
+
+	return true;
+}
+
+// Hashes the files included from GLSL_INCLUDE_DIR, recursively. Missing files only hash their name, the compilation
+// fails anyway.
+static uint64_t HashIncludes( const std::string &code, uint64_t hash, std::vector< std::string > &included )
+{
+	static const char	  INCLUDE_DIRECTIVE[] = "#include";
+	static const size_t INCLUDE_LENGTH		= sizeof( INCLUDE_DIRECTIVE ) - 1;
+
+	for ( size_t pos = code.find( INCLUDE_DIRECTIVE ); pos != std::string::npos;
+		  pos		 = code.find( INCLUDE_DIRECTIVE, pos + INCLUDE_LENGTH ) )
+	{
+		const size_t lineEnd = code.find( '\n', pos );
+		const size_t begin	 = code.find_first_of( "\"<", pos + INCLUDE_LENGTH );
+		if ( begin == std::string::npos || begin > lineEnd )
+		{
+			continue;
+		}
+		const size_t end = code.find_first_of( "\">", begin + 1 );
+		if ( end == std::string::npos || end > lineEnd )
+		{
+			continue;
+		}
+
+		std::string name = code.substr( begin + 1, end - begin - 1 );
+		if ( std::find( included.cbegin(), included.cend(), name ) != included.cend() )
+		{
+			continue;
+		}
+		hash = HashFNV1a( name.data(), name.size(), hash );
+		included.emplace_back( std::move( name ) );
+
+		std::string includeCode;
+		if ( ReadInclude( included.back(), includeCode ) )
+		{
+			hash = HashFNV1a( includeCode.data(), includeCode.size(), hash );
+			hash = HashIncludes( includeCode, hash, included );
+		}
+	}
+
+	return hash;
+}
+
+#ifdef RUNA_SHADERC
+// "file:line: error: message", the line is missing for errors about the whole file
+static const std::regex DIAGNOSTIC_REGEX( "^(.*?):(?:(\\d+):)? (error|warning): (.*)$", std::regex::optimize );
+
+static void ParseDiagnostics( const std::string &messages, std::vector< shaderDiagnostic_t > &diagnostics )
+{
+	std::istringstream stream( messages );
+	std::string		   line;
+	while ( std::getline( stream, line ) )
+	{
+		if ( !line.empty() && line.back() == '\r' )
+		{
+			line.pop_back();
+		}
+
+		std::smatch sm;
+		if ( !std::regex_match( line, sm, DIAGNOSTIC_REGEX ) )
+		{
+			// Summaries such as "1 error generated."
+			continue;
+		}
+
+		shaderDiagnostic_t diagnostic;
+		diagnostic.file	   = sm[ 1 ].str();
+		diagnostic.line	   = sm[ 2 ].matched ? static_cast< uint32_t >( std::stoul( sm[ 2 ].str() ) ) : 0;
+		diagnostic.error   = sm[ 3 ] == "error";
+		diagnostic.message = sm[ 4 ].str();
+		diagnostics.emplace_back( std::move( diagnostic ) );
+	}
+}
+
+// Resolves #include directives from GLSL_INCLUDE_DIR, as glslc -I does
+class Includer : public shaderc::CompileOptions::IncluderInterface
+{
+	struct include_t
+	{
+		shaderc_include_result result;
+		std::string			   name;
+		std::string			   content;
+	};
+
+   public:
+	shaderc_include_result *GetInclude( const char *		 requestedSource,
+										shaderc_include_type type,
+										const char *		 requestingSource,
+										size_t				 includeDepth ) final
+	{
+		include_t *include = new include_t;
+		if ( ReadInclude( requestedSource, include->content ) )
+		{
+			include->name = requestedSource;
+		}
+		else
+		{
+			// An empty name reports the content as the error
+			include->content = "Cannot find \"" + std::string( requestedSource ) + "\" in " + GLSL_INCLUDE_DIR;
+		}
+
+		include->result.source_name		   = include->name.c_str();
+		include->result.source_name_length = include->name.size();
+		include->result.content			   = include->content.c_str();
+		include->result.content_length	   = include->content.size();
+		include->result.user_data		   = include;
+
+		return &include->result;
+	}
+
+	void ReleaseInclude( shaderc_include_result *data ) final { delete static_cast< include_t * >( data->user_data ); }
+};
+#endif
+
+static void DumpFile( const std::string &path, const void *data, size_t size )
+{
+	std::ofstream file( path, std::ios::out | std::ios::binary | std::ios::trunc );
+	if ( !file.is_open() )
+	{
+		Error( "Could not create %s.", path.c_str() );
+		return;
+	}
+
+	file.write( static_cast< const char * >( data ), static_cast< std::streamsize >( size ) );
+}
+
+ShaderCompiler::ShaderCompiler() {}
+
+ShaderCompiler::~ShaderCompiler()
+{
+	Shutdown();
+}
+
+void ShaderCompiler::Init()
+{
+#ifdef RUNA_SHADERC
+	if ( g_compiler == nullptr )
+	{
+		g_compiler = new shaderc::Compiler;
+		if ( !g_compiler->IsValid() )
+		{
+			FatalError( "Could not initialize shaderc." );
+		}
+	}
+#endif
+}
+
+void ShaderCompiler::Shutdown()
+{
+#ifdef RUNA_SHADERC
+	delete g_compiler;
+	g_compiler = nullptr;
+#endif
+}
+
+uint64_t ShaderCompiler::Hash( const std::string &glslCode, shaderStage_t stage ) const
+{
+	uint64_t hash = HashFNV1a( COMPILER_ID, std::strlen( COMPILER_ID ) + 1 );
+	hash		  = HashFNV1a( COMPILER_FLAGS, std::strlen( COMPILER_FLAGS ) + 1, hash );
+	hash		  = HashFNV1a( STAGE_NAMES[ stage ], std::strlen( STAGE_NAMES[ stage ] ) + 1, hash );
+	hash		  = HashFNV1a( glslCode.data(), glslCode.size(), hash );
+
+	std::vector< std::string > included;
+	return HashIncludes( glslCode, hash, included );
+}
+
+bool ShaderCompiler::Compile( const std::string &				glslCode,
+							  shaderStage_t						stage,
+							  const std::string &				name,
+							  std::vector< uint32_t > &			spirv,
+							  std::vector< shaderDiagnostic_t > &diagnostics )
+{
+	spirv.clear();
+
+#ifdef RUNA_SHADERC
+	shaderc::CompileOptions options;
+	options.SetSourceLanguage( shaderc_source_language_glsl );
+	options.SetTargetEnvironment( shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_2 );
+	options.SetOptimizationLevel( shaderc_optimization_level_performance );
+	options.SetIncluder( std::make_unique< Includer >() );
+
+	if ( SHADER_DEBUG_DUMP )
+	{
+		DumpFile( name, glslCode.data(), glslCode.size() );
+	}
+
+	shaderc::SpvCompilationResult result =
+		g_compiler->CompileGlslToSpv( glslCode, SHADERC_KINDS[ stage ], name.c_str(), options );
+
+	ParseDiagnostics( result.GetErrorMessage(), diagnostics );
+
+	if ( result.GetCompilationStatus() != shaderc_compilation_status_success )
+	{
+		if ( diagnostics.empty() )
+		{
+			shaderDiagnostic_t diagnostic;
+			diagnostic.file	   = name;
+			diagnostic.message = result.GetErrorMessage();
+			diagnostics.emplace_back( std::move( diagnostic ) );
+		}
+		return false;
+	}
+
+	spirv.assign( result.cbegin(), result.cend() );
+
+	if ( SHADER_DEBUG_DUMP )
+	{
+		DumpFile( name + ".spv", spirv.data(), spirv.size() * sizeof( uint32_t ) );
+	}
+#else
+	// The compiler prints its diagnostics to the console
+	DumpFile( name, glslCode.data(), glslCode.size() );
+
+	const std::string spirvFile = name + ".spv";
+
+	std::string cmdLine = RUNA_SHADER_COMPILER_PATH;
+	cmdLine += " -I ";
+	cmdLine += GLSL_INCLUDE_DIR;
+	cmdLine += " ";
+	cmdLine += COMPILER_FLAGS;
+	cmdLine += " -fshader-stage=";
+	cmdLine += STAGE_NAMES[ stage ];
+	cmdLine += " -o \"";
+	cmdLine += spirvFile;
+	cmdLine += "\" \"";
+	cmdLine += name;
+	cmdLine += "\"";
+
+	if ( !ExecuteAndWait( const_cast< char * >( cmdLine.c_str() ) ) )
+	{
+		shaderDiagnostic_t diagnostic;
+		diagnostic.file	   = name;
+		diagnostic.message = "compilation failed, see the compiler output";
+		diagnostics.emplace_back( std::move( diagnostic ) );
+		return false;
+	}
+
+	std::vector< char > binary;
+	try
+	{
+		binary = ReadBinary< char >( spirvFile.c_str() );
+	}
+	catch ( const std::ios::failure &e )
+	{
+		Error( e.what() );
+		return false;
+	}
+
+	if ( !SHADER_DEBUG_DUMP )
+	{
+		std::remove( spirvFile.c_str() );
+	}
+
+	spirv.resize( binary.size() / sizeof( uint32_t ) );
+	std::memcpy( spirv.data(), binary.data(), spirv.size() * sizeof( uint32_t ) );
+#endif
+
+	return true;
+}
+
+} // namespace render
+} // namespace vkRuna
@@ -0,0 +1,52 @@
+// Copyright (c) 2021 Arno Galvez
+
+#pragma once
+
+#include "platform/defines.h"
+#include "renderer/Shader.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace vkRuna
+{
+namespace render
+{
+struct shaderDiagnostic_t
+{
+	std::string file;		// Source the compiler reported, the shader or one of its includes
+	uint32_t	line  = 0;	// In file, 0 when unknown
+	bool		error = true; // Otherwise a warning
+	std::string message;
+};
+
+// GLSL to SPIR-V. Compiles in memory with shaderc when the build finds it (RUNA_SHADERC), otherwise spawns
+// RUNA_SHADER_COMPILER_PATH through files in CACHE_DIR.
+class ShaderCompiler
+{
+	NO_COPY_NO_ASSIGN( ShaderCompiler )
+
+   public:
+	ShaderCompiler();
+	~ShaderCompiler();
+
+	void Init();
+	void Shutdown();
+
+	// Hash of everything that changes the SPIR-V of glslCode: the code, the included files, the stage and the compiler
+	uint64_t Hash( const std::string &glslCode, shaderStage_t stage ) const;
+
+	// name: path of the GLSL written by the fallback compiler and by SHADER_DEBUG_DUMP. Diagnostics lines are the ones
+	// of glslCode for the shader itself.
+	NO_DISCARD bool Compile( const std::string &				glslCode,
+							 shaderStage_t						stage,
+							 const std::string &				name,
+							 std::vector< uint32_t > &			spirv,
+							 std::vector< shaderDiagnostic_t > &diagnostics );
+};
+
+extern ShaderCompiler g_shaderCompiler;
+
+} // namespace render
+} // namespace vkRuna
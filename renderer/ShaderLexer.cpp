@@ -7,6 +7,7 @@
 #include "renderer/RenderProgs.h"
 #include "renderer/VFX.h"
 
+#include <algorithm>
 #include <array>
 #include <iostream>
 #include <thread>
@@ -76,6 +77,12 @@ enum captureGroup_t
 
 static const std::regex CE_DECL_REGEX( CE_REG_BEG "([\\S\\s]*?)" CE_REG_END, std::regex::optimize );
 
+template< typename It >
+static uint32_t CountNewlines( It begin, It end )
+{
+	return static_cast< uint32_t >( std::count( begin, end, '\n' ) );
+}
+
 std::regex ResourceExprTokenizer::UBO_REGEX( CE_FLAGS CE_LAYOUT_DECL
 											 "(uniform\\s+"
 											 "(\\w+)\\s+"
@@ -231,10 +238,13 @@ NO_DISCARD bool ShaderLexer::Parse( std::string &									   shaderCode,
 		{
 			{
 				std::unique_ptr< PassthroughTokenizer > pt( new PassthroughTokenizer );
+				pt->sourceNewlines = CountNewlines( ce_sm.prefix().first, ce_sm.prefix().second );
 				pt->Scan( ce_sm.prefix().str() );
 				out.emplace_back( std::move( pt ) );
 			}
 
+			const uint32_t exprNewlines = CountNewlines( ce_sm[ 0 ].first, ce_sm[ 0 ].second );
+
 			std::string expr		= ce_sm[ 1 ];
 			bool		exprMatched = false;
 			for ( size_t i = 0; i < tokenizersCount; ++i )
@@ -242,7 +252,8 @@ NO_DISCARD bool ShaderLexer::Parse( std::string &									   shaderCode,
 				auto &tokenizer = tokenizers[ i ];
 				if ( tokenizer->Scan( expr ) )
 				{
-					auto newTokenizer = tokenizer->NewInstance();
+					auto newTokenizer		 = tokenizer->NewInstance();
+					tokenizer->sourceNewlines = exprNewlines;
 					out.emplace_back( std::move( tokenizer ) );
 					tokenizer = std::move( newTokenizer );
 
@@ -260,6 +271,7 @@ NO_DISCARD bool ShaderLexer::Parse( std::string &									   shaderCode,
 			if ( !exprMatched )
 			{
 				std::unique_ptr< PassthroughTokenizer > pt( new PassthroughTokenizer );
+				pt->sourceNewlines = exprNewlines;
 				pt->Scan( ce_sm.str( 0 ) );
 				out.emplace_back( std::move( pt ) );
 			}
@@ -267,6 +279,7 @@ NO_DISCARD bool ShaderLexer::Parse( std::string &									   shaderCode,
 
 		{
 			std::unique_ptr< PassthroughTokenizer > pt( new PassthroughTokenizer );
+			pt->sourceNewlines = CountNewlines( shaderCode.cbegin(), shaderCode.cend() );
 			pt->Scan( std::move( shaderCode ) );
 			out.emplace_back( std::move( pt ) );
 		}
@@ -291,17 +304,113 @@ NO_DISCARD bool ShaderLexer::Parse( std::string &									   shaderCode,
 //	return ParseSpecific( shaderCode, static_cast< int >( exprTorkenizers.size() ), exprTorkenizers.data(), out, true );
 //}
 
-void ShaderLexer::Combine( const std::vector< std::unique_ptr< ShaderTokenizer > > &tokenizers, std::string &out )
+void ShaderLexer::Combine( const std::vector< std::unique_ptr< ShaderTokenizer > > &tokenizers,
+						   std::string &										   out,
+						   std::vector< shaderLineMap_t > *						   lineMap /*= nullptr*/ )
 {
+	shaderLineMap_t segment;
+	segment.glslLine   = 1 + CountNewlines( out.cbegin(), out.cend() );
+	segment.sourceLine = 1;
+
 	std::string r;
 	for ( auto &st : tokenizers )
 	{
 		st->Evaluate( r );
 		out += r;
+
+		if ( lineMap )
+		{
+			segment.sourceLineCount = st->sourceNewlines + 1;
+			lineMap->emplace_back( segment );
+
+			segment.glslLine += CountNewlines( r.cbegin(), r.cend() );
+			segment.sourceLine += st->sourceNewlines;
+		}
+
 		r.clear(); // #TODO: memsetzero instead
 	}
 }
 
+uint32_t ShaderLexer::MapLine( const std::vector< shaderLineMap_t > &lineMap, uint32_t glslLine )
+{
+	if ( glslLine == 0 )
+	{
+		return 0;
+	}
+
+	auto startsAfter = []( uint32_t line, const shaderLineMap_t &segment ) { return line < segment.glslLine; };
+
+	// Last segment starting at or before glslLine
+	auto it = std::upper_bound( lineMap.cbegin(), lineMap.cend(), glslLine, startsAfter );
+	if ( it == lineMap.cbegin() )
+	{
+		return glslLine;
+	}
+	--it;
+
+	if ( it->sourceLine == 0 )
+	{
+		return 0;
+	}
+
+	const uint32_t offset = std::min( glslLine - it->glslLine, it->sourceLineCount - 1 );
+	return it->sourceLine + offset;
+}
+
+void ShaderLexer::CropLineMap( std::vector< shaderLineMap_t > &lineMap, uint32_t firstLine, uint32_t lineCount )
+{
+	const uint32_t endLine = firstLine + lineCount;
+
+	std::vector< shaderLineMap_t > cropped;
+	cropped.reserve( lineMap.size() + 2 );
+
+	for ( size_t i = 0; i < lineMap.size(); ++i )
+	{
+		const shaderLineMap_t &segment = lineMap[ i ];
+
+		// Generated lines may be fewer than the source lines, the pieces never start past the next segment
+		const uint32_t nextGlslLine = i + 1 < lineMap.size() ? lineMap[ i + 1 ].glslLine : UINT32_MAX;
+		auto		   pieceStart	= [ & ]( uint32_t sourceLine ) {
+			  return std::min( segment.glslLine + ( sourceLine - segment.sourceLine ), nextGlslLine );
+		};
+
+		const uint32_t segmentEnd = segment.sourceLine + segment.sourceLineCount;
+		const uint32_t keptBegin  = std::max( segment.sourceLine, firstLine );
+		const uint32_t keptEnd	  = std::min( segmentEnd, endLine );
+
+		shaderLineMap_t piece;
+		if ( segment.sourceLine == 0 || keptBegin >= keptEnd )
+		{
+			piece.glslLine	 = segment.glslLine;
+			piece.sourceLine = 0;
+			cropped.emplace_back( piece );
+			continue;
+		}
+
+		if ( segment.sourceLine < keptBegin )
+		{
+			piece.glslLine	 = segment.glslLine;
+			piece.sourceLine = 0;
+			cropped.emplace_back( piece );
+		}
+
+		piece.glslLine		  = pieceStart( keptBegin );
+		piece.sourceLine	  = keptBegin - firstLine + 1;
+		piece.sourceLineCount = keptEnd - keptBegin;
+		cropped.emplace_back( piece );
+
+		if ( keptEnd < segmentEnd )
+		{
+			piece.glslLine		  = pieceStart( keptEnd );
+			piece.sourceLine	  = 0;
+			piece.sourceLineCount = 1;
+			cropped.emplace_back( piece );
+		}
+	}
+
+	lineMap = std::move( cropped );
+}
+
 bool ResourceExprTokenizer::Scan( const std::string &text )
 {
 	std::smatch sm;
@@ -36,6 +36,8 @@ class ShaderTokenizer
 	virtual bool				 Evaluate( std::string &out ) = 0;
 	virtual parsedObjectAction_t GetActions()				  = 0;
 	virtual void *				 GetActionParams()			  = 0;
+
+	uint32_t sourceNewlines = 0; // In the parsed code the tokenizer stands for, set by ShaderLexer::Parse
 };
 
 class ShaderLexer
@@ -56,7 +58,14 @@ class ShaderLexer
 						   std::vector< std::unique_ptr< ShaderTokenizer > > &out,
 						   bool												  errorOnExpressionNotFound = false );
 	// NO_DISCARD bool ParseAllExpr( std::string &shaderCode, std::vector< std::unique_ptr< ShaderTokenizer > > &out );
-	void Combine( const std::vector< std::unique_ptr< ShaderTokenizer > > &tokenizers, std::string &out );
+	void Combine( const std::vector< std::unique_ptr< ShaderTokenizer > > &tokenizers,
+				  std::string &											  out,
+				  std::vector< shaderLineMap_t > *						  lineMap = nullptr );
+
+	// Line of the parsed code a line of the combined GLSL comes from, 0 when unknown
+	static uint32_t MapLine( const std::vector< shaderLineMap_t > &lineMap, uint32_t glslLine );
+	// Only keeps the source lines [firstLine, firstLine + lineCount), renumbered from 1. The others become unknown.
+	static void		CropLineMap( std::vector< shaderLineMap_t > &lineMap, uint32_t firstLine, uint32_t lineCount );
 };
 
 extern ShaderLexer g_shaderLexer;
@@ -1,12 +1,16 @@
 // Copyright (c) 2021 Arno Galvez
 
-#include "renderer/uiBackend.h"
+#include "renderer/UiBackend.h"
 
-#include "external/imgui/imgui_impl_win32.h"
-#include "platform/Window.h"
 #include "renderer/Check.h"
 #include "renderer/VkBackend.h"
 
+// The UI needs a window, headless builds never initialize it
+#ifdef VK_USE_PLATFORM_WIN32_KHR
+	#include "external/imgui/imgui_impl_win32.h"
+	#include "platform/Window.h"
+#endif
+
 namespace vkRuna
 {
 static const char *FONT_PATH = "font/Roboto-Medium.ttf";
@@ -28,8 +32,10 @@ void UiBackend::Init( ImGui_ImplVulkan_InitInfo *info, VkRenderPass renderPass,
 	ImGui::StyleColorsDark();
 	// ImGui::StyleColorsClassic();
 
+#ifdef VK_USE_PLATFORM_WIN32_KHR
 	HWND hwnd = Window::GetInstance().GetHWND();
 	CHECK_PRED( ImGui_ImplWin32_Init( hwnd ) );
+#endif
 	ImGui_ImplVulkan_Init( info, renderPass );
 
 	io.Fonts->AddFontFromFileTTF( FONT_PATH, FONT_SIZE );
@@ -121,7 +127,9 @@ void UiBackend::Init( ImGui_ImplVulkan_InitInfo *info, VkRenderPass renderPass,
 void UiBackend::Shutdown()
 {
 	ImGui_ImplVulkan_Shutdown();
+#ifdef VK_USE_PLATFORM_WIN32_KHR
 	ImGui_ImplWin32_Shutdown();
+#endif
 	ImGui::DestroyContext();
 }
 
@@ -129,7 +137,9 @@ void UiBackend::BeginFrame()
 {
 	// Start the Dear ImGui frame
 	ImGui_ImplVulkan_NewFrame();
+#ifdef VK_USE_PLATFORM_WIN32_KHR
 	ImGui_ImplWin32_NewFrame();
+#endif
 	ImGui::NewFrame();
 }
 
@@ -143,6 +153,12 @@ void UiBackend::EndFrame()
 
 void *UiBackend::GetDrawData()
 {
+	// Headless backends have no UI
+	if ( ImGui::GetCurrentContext() == nullptr )
+	{
+		return nullptr;
+	}
+
 	return ImGui::GetDrawData();
 }
 
@@ -5,19 +5,21 @@
 #include "external/cereal/archives/json.hpp"
 #include "game/Game.h"
 #include "platform/Sys.h"
-#include "platform/Window.h"
 #include "renderer/Check.h"
+#include "renderer/Defragmenter.h"
 #include "renderer/RenderProgs.h"
 #include "renderer/VkBackend.h"
 #include "rnLib/Event.h"
 #include "rnLib/Math.h"
 
+#include <algorithm>
 #include <cmath>
 #include <cstring>
 #include <exception>
 #include <filesystem>
 #include <iostream>
 #include <string>
+#include <vector>
 
 namespace vkRuna
 {
@@ -74,11 +76,15 @@ VFX::~VFX()
 	Clear();
 }
 
-VFX::VFX( const char *file )
+VFX::VFX()
 	: m_isValid( false )
-	, m_path( file )
 	, m_computePipeline( std::make_shared< pipelineProg_t >() )
 	, m_graphicsPipeline( std::make_shared< pipelineProg_t >() )
+{
+}
+
+VFX::VFX( const char *file )
+	: VFX()
 {
 	Load( file );
 }
@@ -99,7 +105,6 @@ bool VFX::Save( const char *path )
 void VFX::ReloadBuffers()
 {
 	AllocBuffers();
-	InitBarriers();
 }
 
 bool VFX::GetComputeCmd( gpuCmd_t &computeCmd )
@@ -116,6 +121,7 @@ bool VFX::GetComputeCmd( gpuCmd_t &computeCmd )
 	computeCmd.groupCountDim[ 1 ] = 1;
 	computeCmd.groupCountDim[ 2 ] = 1;
 	computeCmd.pipeline			  = m_computePipeline.get();
+	computeCmd.profileName		  = m_path.c_str();
 
 	return true;
 }
@@ -132,7 +138,7 @@ bool VFX::InsertRenderCmds( std::vector< gpuCmd_t > &renderCmds )
 
 	uint32_t nbIndices = GetIndicesCount();
 
-	if ( m_indexBuffer.GetAllocSize() == 0 )
+	if ( !m_indexBuffer.IsValid() )
 	{
 		uint16_t *indices = new uint16_t[ nbIndices ];
 		switch ( m_renderPrimitive )
@@ -208,16 +214,17 @@ bool VFX::InsertRenderCmds( std::vector< gpuCmd_t > &renderCmds )
 			default: break;
 		}
 
-		m_indexBuffer.Alloc( VK_BUFFER_USAGE_INDEX_BUFFER_BIT, BP_STATIC, nbIndices * sizeof( uint16_t ), indices );
+		m_indexBuffer = g_staticBufferPool.Alloc( nbIndices * sizeof( uint16_t ), indices );
 		delete[] indices;
 	}
 	gpuCmd_t renderCmd;
-	renderCmd.type = CT_GRAPHIC;
+	renderCmd.type		  = CT_GRAPHIC;
+	renderCmd.profileName = m_path.c_str();
 
 	const uint32_t particlesPerInstance = nbIndices / VFX_RP_TO_NUM_VERTICES[ m_renderPrimitive ];
 	renderCmd.drawSurf.Zero();
-	renderCmd.drawSurf.indexBuffer		 = &m_indexBuffer;
-	renderCmd.drawSurf.indexBufferOffset = 0;
+	renderCmd.drawSurf.indexBuffer		 = m_indexBuffer.buffer;
+	renderCmd.drawSurf.indexBufferOffset = m_indexBuffer.offset;
 	renderCmd.drawSurf.instanceCount	 = m_capacity;
 	renderCmd.drawSurf.indexCount		 = nbIndices;
 
@@ -236,28 +243,6 @@ bool VFX::InsertRenderCmds( std::vector< gpuCmd_t > &renderCmds )
 	return true;
 }
 
-int VFX::BarriersUpdateToRender( VkBufferMemoryBarrier **barriers )
-{
-	if ( !IsValid() )
-	{
-		return 0;
-	}
-
-	*barriers = m_barriersUpdateToRender.data();
-	return m_attributesCount;
-}
-
-int VFX::BarrierRenderToUpdate( VkBufferMemoryBarrier **barriers )
-{
-	if ( !IsValid() )
-	{
-		return 0;
-	}
-
-	*barriers = m_barriersRenderToUpdate.data();
-	return m_attributesCount;
-}
-
 void VFX::Update( double deltaFrame )
 {
 	if ( !IsValid() )
@@ -276,18 +261,40 @@ void VFX::Update( double deltaFrame )
 		int n = reviveCounterLeftovers + static_cast< int >( toRevive );
 		n *= deltaFrame != 0; // #TODO WTF ???
 		// n = m_capacity;
-		m_revivalCounter.Update( sizeof( n ), &n );
+		m_revivalCounter.buffer->Update( sizeof( n ), &n, m_revivalCounter.offset );
 
 		m_reviveAcc -= toRevive;
 	}
 	else
 	{
 		const int n = static_cast< int >( m_capacity );
-		m_revivalCounter.Update( sizeof( n ), &n );
+		m_revivalCounter.buffer->Update( sizeof( n ), &n, m_revivalCounter.offset );
 	}
 }
 
+// Relative to the working directory. Samples are saved on Windows, their separators are backslashes.
+static std::string CanonicalShaderPath( std::string path )
+{
+#ifndef _WIN32
+	std::replace( path.begin(), path.end(), '\\', '/' );
+#endif
+	return std::filesystem::canonical( path ).string();
+}
+
 bool VFX::LoadFromJSON( const char *path )
+{
+	if ( !ReadJSON( path ) )
+	{
+		return false;
+	}
+
+	VFX *vfx = this;
+	InitPipelines( 1, &vfx );
+
+	return FinishLoading();
+}
+
+bool VFX::ReadJSON( const char *path )
 {
 	m_isValid = false;
 
@@ -301,14 +308,20 @@ bool VFX::LoadFromJSON( const char *path )
 	}
 
 	{
-		EventOnShaderRead::Func f =
-			std::bind( &VFX::ParseCustomVars, this, std::placeholders::_1, std::placeholders::_2 );
+		EventOnShaderRead::Func f = std::bind( &VFX::ParseCustomVars,
+											   this,
+											   std::placeholders::_1,
+											   std::placeholders::_2,
+											   std::placeholders::_3 );
 		std::unique_ptr< Event > onShaderRead = std::make_unique< EventOnShaderRead >( std::move( f ) );
 		g_pipelineManager.RegisterEvent( *m_computePipeline, std::move( onShaderRead ) );
 	}
 	{
-		EventOnShaderRead::Func f =
-			std::bind( &VFX::ParseCustomVars, this, std::placeholders::_1, std::placeholders::_2 );
+		EventOnShaderRead::Func f = std::bind( &VFX::ParseCustomVars,
+											   this,
+											   std::placeholders::_1,
+											   std::placeholders::_2,
+											   std::placeholders::_3 );
 		std::unique_ptr< Event > onShaderRead = std::make_unique< EventOnShaderRead >( std::move( f ) );
 		g_pipelineManager.RegisterEvent( *m_graphicsPipeline, std::move( onShaderRead ) );
 	}
@@ -344,7 +357,7 @@ bool VFX::LoadFromJSON( const char *path )
 			std::string &computePath = m_computePipeline->shaders[ SS_COMPUTE ]->path;
 			if ( !computePath.empty() )
 			{
-				computePath = std::filesystem::canonical( computePath ).string();
+				computePath = CanonicalShaderPath( computePath );
 			}
 		}
 
@@ -353,13 +366,13 @@ bool VFX::LoadFromJSON( const char *path )
 			std::string &vertexPath = m_graphicsPipeline->shaders[ SS_VERTEX ]->path;
 			if ( !vertexPath.empty() )
 			{
-				vertexPath = std::filesystem::canonical( vertexPath ).string();
+				vertexPath = CanonicalShaderPath( vertexPath );
 			}
 
 			std::string &fragmentPath = m_graphicsPipeline->shaders[ SS_FRAGMENT ]->path;
 			if ( !fragmentPath.empty() )
 			{
-				fragmentPath = std::filesystem::canonical( fragmentPath ).string();
+				fragmentPath = CanonicalShaderPath( fragmentPath );
 			}
 		}
 
@@ -368,8 +381,11 @@ bool VFX::LoadFromJSON( const char *path )
 
 	ReloadBuffers();
 
-	InitPipelines();
+	return true;
+}
 
+bool VFX::FinishLoading()
+{
 	BindBuffers();
 
 	bool pipelinesValid = m_computePipeline->GetStatus() == pipelineStatus_t::Ok &&
@@ -458,6 +474,9 @@ uint32_t VFX::GetIndicesCount()
 
 void VFX::AllocBuffers()
 {
+	// The async compute queue simulates the next frame while the graphics queue renders the current one
+	const bufferProps_t attributesProp = HasAsyncCompute() ? BP_GPU_PER_FRAME : BP_STATIC;
+
 	m_attributesCount	  = 0;
 	m_userAttributesCount = 0;
 	for ( VFXBuffer_t &vfxBuffer : m_attributesBuffers )
@@ -469,7 +488,7 @@ void VFX::AllocBuffers()
 
 		VkDeviceSize arity = vfxBuffer.arity;
 		vfxBuffer.buffer.Alloc( VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
-								BP_STATIC,
+								attributesProp,
 								Align< VkDeviceSize >( arity * VFX_BUFFER_TYPES_TO_ELT_SIZE[ vfxBuffer.dataType ] *
 														   static_cast< VkDeviceSize >( m_capacity ),
 													   VULKAN_FILL_BUFFER_ALIGNMENT ) );
@@ -486,7 +505,7 @@ void VFX::AllocBuffers()
 		strcpy( vfxBuffer.name, "life" );
 		vfxBuffer.buffer.Alloc(
 			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
-			BP_STATIC,
+			attributesProp,
 			Align< VkDeviceSize >( vfxBuffer.arity * VFX_BUFFER_TYPES_TO_ELT_SIZE[ vfxBuffer.dataType ] *
 									   static_cast< VkDeviceSize >( m_capacity ),
 								   VULKAN_FILL_BUFFER_ALIGNMENT ) );
@@ -495,11 +514,10 @@ void VFX::AllocBuffers()
 	}
 
 	uint32_t toRevive = 0;
-	m_revivalCounter.Alloc( VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, BP_DYNAMIC, sizeof( toRevive ), &toRevive );
+	g_perFrameBufferPool.Free( m_revivalCounter );
+	m_revivalCounter = g_perFrameBufferPool.Alloc( sizeof( toRevive ), &toRevive );
 
 	g_vfxManager.MemsetZeroVFX( *this ); // #TODO move to allocbuffers
-
-	InitBarriers();
 }
 
 void VFX::BindBuffers()
@@ -509,47 +527,7 @@ void VFX::BindBuffers()
 					return;
 	}*/
 
-	// Update gpu local buffers
-	{
-		const int maxBuffNameSize = VFX_MAX_BUFFER_NAME_LENGTH + 32;
-
-		std::array< char[ maxBuffNameSize ], VFX_MAX_BUFFERS + 1 > bufferNames;
-		std::array< const char *, VFX_MAX_BUFFERS + 1 >			   bufferNamesPtrs;
-		std::array< const Buffer *, VFX_MAX_BUFFERS + 1 >		   bufferHandles;
-
-		for ( int i = 0; i < m_attributesCount; ++i )
-		{
-			const VFXBuffer_t &vfxBuffer = m_attributesBuffers[ i ];
-
-			VFXTokenizer::GetBufferInterfaceBlockName( vfxBuffer.name, bufferNames[ i ], maxBuffNameSize );
-			bufferNamesPtrs[ i ] = bufferNames[ i ];
-			bufferHandles[ i ]	 = &vfxBuffer.buffer;
-		}
-
-		// graphics pipeline buffers
-		if ( m_graphicsPipeline->GetStatus() == pipelineStatus_t::Ok )
-		{
-			g_pipelineManager.UpdateBuffers( *m_graphicsPipeline,
-											 m_attributesCount,
-											 bufferNamesPtrs.data(),
-											 bufferHandles.data() );
-		}
-
-		// compute pipeline buffers
-		if ( m_computePipeline->GetStatus() == pipelineStatus_t::Ok )
-		{
-			VFXTokenizer::GetBufferInterfaceBlockName( SHADER_PARTICLE_TO_REVIVE,
-													   bufferNames[ m_attributesCount ],
-													   maxBuffNameSize );
-			bufferNamesPtrs[ m_attributesCount ] = bufferNames[ m_attributesCount ];
-			bufferHandles[ m_attributesCount ]	 = &m_revivalCounter;
-
-			g_pipelineManager.UpdateBuffers( *m_computePipeline,
-											 m_attributesCount + 1,
-											 bufferNamesPtrs.data(),
-											 bufferHandles.data() );
-		}
-	}
+	BindBufferDescriptors();
 
 	// Update ubos
 	{
@@ -587,6 +565,51 @@ void VFX::BindBuffers()
 	}
 }
 
+void VFX::BindBufferDescriptors()
+{
+	// Update gpu local buffers
+	{
+		const int maxBuffNameSize = VFX_MAX_BUFFER_NAME_LENGTH + 32;
+
+		std::array< char[ maxBuffNameSize ], VFX_MAX_BUFFERS + 1 > bufferNames;
+		std::array< const char *, VFX_MAX_BUFFERS + 1 >			   bufferNamesPtrs;
+		std::array< bufferView_t, VFX_MAX_BUFFERS + 1 >			   bufferViews;
+
+		for ( int i = 0; i < m_attributesCount; ++i )
+		{
+			VFXBuffer_t &vfxBuffer = m_attributesBuffers[ i ];
+
+			VFXTokenizer::GetBufferInterfaceBlockName( vfxBuffer.name, bufferNames[ i ], maxBuffNameSize );
+			bufferNamesPtrs[ i ]	= bufferNames[ i ];
+			bufferViews[ i ].buffer = &vfxBuffer.buffer;
+		}
+
+		// graphics pipeline buffers
+		if ( m_graphicsPipeline->GetStatus() == pipelineStatus_t::Ok )
+		{
+			g_pipelineManager.UpdateBuffers( *m_graphicsPipeline,
+											 m_attributesCount,
+											 bufferNamesPtrs.data(),
+											 bufferViews.data() );
+		}
+
+		// compute pipeline buffers
+		if ( m_computePipeline->GetStatus() == pipelineStatus_t::Ok )
+		{
+			VFXTokenizer::GetBufferInterfaceBlockName( SHADER_PARTICLE_TO_REVIVE,
+													   bufferNames[ m_attributesCount ],
+													   maxBuffNameSize );
+			bufferNamesPtrs[ m_attributesCount ] = bufferNames[ m_attributesCount ];
+			bufferViews[ m_attributesCount ]	 = m_revivalCounter;
+
+			g_pipelineManager.UpdateBuffers( *m_computePipeline,
+											 m_attributesCount + 1,
+											 bufferNamesPtrs.data(),
+											 bufferViews.data() );
+		}
+	}
+}
+
 bool VFX::CheckPipelines()
 {
 	if ( m_graphicsPipeline->GetStatus() != pipelineStatus_t::Ok ||
@@ -599,80 +622,44 @@ bool VFX::CheckPipelines()
 	return true;
 }
 
-void VFX::InitBarriers()
+void VFX::InitPipelines( size_t count, VFX *const *vfxs )
 {
-	/*if ( !CheckPipelines() )
-	{
-					return;
-	}*/
+	// Graphics then compute pipeline of each VFX
+	std::vector< pipelineProg_t * > pipelines;
+	pipelines.reserve( 2 * count );
 
-	std::memset( m_barriersUpdateToRender.data(),
-				 0,
-				 m_barriersUpdateToRender.size() * sizeof( m_barriersUpdateToRender[ 0 ] ) );
-	for ( int i = 0; i < m_attributesCount; ++i )
+	for ( size_t i = 0; i < count; ++i )
 	{
-		VFXBuffer_t &vfxBuffer = m_attributesBuffers[ i ];
-
-		VkBufferMemoryBarrier &barrier = m_barriersUpdateToRender[ i ];
-		barrier.sType				   = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
-		barrier.pNext				   = nullptr;
-		barrier.srcAccessMask		   = VK_ACCESS_MEMORY_WRITE_BIT;
-		barrier.dstAccessMask		   = VK_ACCESS_SHADER_READ_BIT;
-		barrier.srcQueueFamilyIndex	   = GetVulkanContext().graphicsFamilyId;
-		barrier.dstQueueFamilyIndex	   = GetVulkanContext().graphicsFamilyId;
-		barrier.buffer				   = vfxBuffer.buffer.GetHandle();
-		barrier.offset				   = 0;
-		barrier.size				   = VK_WHOLE_SIZE;
-	}
+		VFX &vfx = *vfxs[ i ];
 
-	std::memset( m_barriersRenderToUpdate.data(),
-				 0,
-				 m_barriersRenderToUpdate.size() * sizeof( m_barriersRenderToUpdate[ 0 ] ) );
-	for ( int i = 0; i < m_attributesCount; ++i )
-	{
-		VFXBuffer_t &vfxBuffer = m_attributesBuffers[ i ];
-
-		VkBufferMemoryBarrier &barrier = m_barriersRenderToUpdate[ i ];
-		barrier.sType				   = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
-		barrier.pNext				   = nullptr;
-		barrier.srcAccessMask		   = VK_ACCESS_SHADER_READ_BIT;
-		barrier.dstAccessMask		   = VK_ACCESS_MEMORY_WRITE_BIT;
-		barrier.srcQueueFamilyIndex	   = GetVulkanContext().graphicsFamilyId;
-		barrier.dstQueueFamilyIndex	   = GetVulkanContext().graphicsFamilyId;
-		barrier.buffer				   = vfxBuffer.buffer.GetHandle();
-		barrier.offset				   = 0;
-		barrier.size				   = VK_WHOLE_SIZE;
-	}
-}
+		vfx.SetRenderPrimitive( vfx.m_renderPrimitive );
 
-void VFX::InitPipelines()
-{
-	/*uint64_t state = m_graphicsPipeline->stateBits;
-	if ( m_renderPrimitive == VFX_RP_QUAD )
-	{
-		state &= ~DST_BLEND_FACTOR_MASK;
-		state |= DSTBLEND_FACTOR_ONE;
-		state &= ~DEPTH_TEST_ENABLE;
-	}
-	else
-	{
-		state &= ~DST_BLEND_FACTOR_MASK;
-		state |= DSTBLEND_FACTOR_ZERO;
-		state |= DEPTH_TEST_ENABLE;
+		pipelines.emplace_back( vfx.m_graphicsPipeline.get() );
+		pipelines.emplace_back( vfx.m_computePipeline.get() );
 	}
-	g_pipelineManager.UpdateState( *m_graphicsPipeline, state );*/
-	SetRenderPrimitive( m_renderPrimitive );
 
-	if ( !g_pipelineManager.Reload( *m_graphicsPipeline ) )
+	std::unique_ptr< bool[] > reloaded( new bool[ pipelines.size() ] );
+	if ( !g_pipelineManager.Reload( pipelines.size(), pipelines.data(), reloaded.get() ) )
 	{
-		Error( "Failed to initialize graphics pipeline for VFX %s", GetPath().c_str() );
+		for ( size_t i = 0; i < count; ++i )
+		{
+			if ( !reloaded[ 2 * i ] )
+			{
+				Error( "Failed to initialize graphics pipeline for VFX %s", vfxs[ i ]->GetPath().c_str() );
+			}
+			if ( !reloaded[ 2 * i + 1 ] )
+			{
+				Error( "Failed to initialize compute pipeline for VFX %s", vfxs[ i ]->GetPath().c_str() );
+			}
+		}
 	}
-	if ( !g_pipelineManager.Reload( *m_computePipeline ) )
+
+	for ( size_t i = 0; i < count; ++i )
 	{
-		Error( "Failed to initialize compute pipeline for VFX %s", GetPath().c_str() );
+		vfxs[ i ]->SetupRenderpass();
 	}
 
-	SetupRenderpass();
+	g_pipelineManager.CreatePipelines( pipelines.size(), pipelines.data() );
 }
 
 void VFX::SetupRenderpass()
@@ -703,8 +690,13 @@ void VFX::SetRenderPrimitive( vfxRenderPrimitive_t renderPrimitive )
 {
 	m_renderPrimitive = renderPrimitive;
 
-	uint64_t state = m_graphicsPipeline->stateBits;
-	if ( m_renderPrimitive == VFX_RP_QUAD )
+	g_pipelineManager.UpdateState( *m_graphicsPipeline,
+								   GetPrimitiveState( m_graphicsPipeline->stateBits, m_renderPrimitive ) );
+}
+
+uint64_t VFX::GetPrimitiveState( uint64_t state, vfxRenderPrimitive_t renderPrimitive )
+{
+	if ( renderPrimitive == VFX_RP_QUAD )
 	{
 		state = StateSetSrcBlendFactor( state, SRCBLEND_FACTOR_ONE );
 		state = StateSetDstBlendFactor( state, DSTBLEND_FACTOR_ONE );
@@ -721,12 +713,37 @@ void VFX::SetRenderPrimitive( vfxRenderPrimitive_t renderPrimitive )
 		state = StateSetDepthOp( state, DEPTH_COMPARE_OP_EQUAL );
 		state = StateSetCullMode( state, CULL_MODE_BACK_BIT );
 	}
-	g_pipelineManager.UpdateState( *m_graphicsPipeline, state );
+
+	return state;
 }
 
-NO_DISCARD bool VFX::ParseCustomVars( std::string *shaderCode, shaderStage_t shaderStage )
+void VFX::OnPipelinesReloaded( float lifeMin, float lifeMax, vfxRenderPrimitive_t renderPrimitive )
 {
-	AddShaderCodeHeaderAndFooter( *shaderCode, shaderStage );
+	m_lifeMin = lifeMin;
+	m_lifeMax = lifeMax;
+
+	if ( renderPrimitive != m_renderPrimitive )
+	{
+		// Holds the indices of the previous primitive
+		g_staticBufferPool.Free( m_indexBuffer );
+		m_renderPrimitive = renderPrimitive;
+	}
+
+	// The new pipelines have their own descriptor sets and UBOs
+	BindBuffers();
+	SetupRenderpass();
+
+	m_isValid = m_computePipeline->GetStatus() == pipelineStatus_t::Ok &&
+				m_graphicsPipeline->GetStatus() == pipelineStatus_t::Ok;
+}
+
+NO_DISCARD bool VFX::ParseCustomVars( std::string *					 shaderCode,
+									  shaderStage_t					 shaderStage,
+									  std::vector< shaderLineMap_t > *lineMap )
+{
+	const auto	   userNewlines	   = std::count( shaderCode->cbegin(), shaderCode->cend(), '\n' );
+	const uint32_t userLineCount   = 1 + static_cast< uint32_t >( userNewlines );
+	const uint32_t headerLineCount = AddShaderCodeHeaderAndFooter( *shaderCode, shaderStage );
 
 	std::unique_ptr< ShaderTokenizer > vfxTokenizer = std::make_unique< VFXTokenizer >( this, shaderStage );
 	std::vector< std::unique_ptr< ShaderTokenizer > > tokenizerOut;
@@ -736,12 +753,19 @@ NO_DISCARD bool VFX::ParseCustomVars( std::string *shaderCode, shaderStage_t sha
 		return false;
 	}
 	shaderCode->clear();
-	g_shaderLexer.Combine( tokenizerOut, *shaderCode );
+	g_shaderLexer.Combine( tokenizerOut, *shaderCode, lineMap );
+
+	// Errors are reported in the user code, not in the header and footer
+	if ( lineMap )
+	{
+		ShaderLexer::CropLineMap( *lineMap, headerLineCount + 1, userLineCount );
+	}
 
 	return true;
 }
 
-void VFX::AddShaderCodeHeaderAndFooter( std::string &shaderCode, shaderStage_t stage )
+// Returns the lines of the header before the shader code
+uint32_t VFX::AddShaderCodeHeaderAndFooter( std::string &shaderCode, shaderStage_t stage )
 {
 	std::string header;
 	std::string footer;
@@ -774,6 +798,8 @@ void VFX::AddShaderCodeHeaderAndFooter( std::string &shaderCode, shaderStage_t s
 	}
 
 	shaderCode = header + shaderCode + footer;
+
+	return static_cast< uint32_t >( std::count( header.cbegin(), header.cend(), '\n' ) );
 }
 
 int VFX::GetUBOMembers( char *buffer, size_t bufferSize ) const
@@ -816,8 +842,9 @@ void VFX::FreeBuffers()
 		b.Free();
 	}
 
-	m_indexBuffer.Free(); // #TODO given how this function is called, doing this
-						  // here is odd
+	g_staticBufferPool.Free( m_indexBuffer ); // #TODO given how this function is called, doing this
+											  // here is odd
+	g_perFrameBufferPool.Free( m_revivalCounter );
 }
 
 const char *VFX::TypeIndexToStr( int vfxBufferTypeIndex )
@@ -838,23 +865,56 @@ VFXManager::~VFXManager()
 
 VFXManager::VFXManager() {}
 
-void VFXManager::Init() {}
+void VFXManager::Init()
+{
+	g_bufferDefragmenter.AddRelocationCallback(
+		[]( const Buffer &buffer ) { g_vfxManager.OnBufferRelocated( buffer ); } );
+}
 
 void VFXManager::Shutdown()
 {
 	m_vfxContainer.clear();
-	m_preRenderCmds.clear();
-	m_barriers.clear();
+	m_renderCmds.clear();
+	m_attributes.clear();
+	m_copies.clear();
 }
 
 VFXManager::VFXContent_t VFXManager::AddVFXFromFile( const char *file )
 {
-	auto vfx = MakeVFX( file );
-	m_vfxContainer.emplace_back( vfx );
+	VFXContent_t vfx;
+	AddVFXsFromFiles( 1, &file, &vfx );
 
 	return vfx;
 }
 
+void VFXManager::AddVFXsFromFiles( size_t count, const char *const *files, VFXContent_t *vfxs )
+{
+	std::vector< VFX * > loading;
+
+	for ( size_t i = 0; i < count; ++i )
+	{
+		vfxs[ i ] = MakeVFX();
+		m_vfxContainer.emplace_back( vfxs[ i ] );
+
+		VFX &vfx = *vfxs[ i ];
+		vfx.SetPath( files[ i ] );
+		Log( "Loading VFX %s", files[ i ] );
+		if ( vfx.ReadJSON( vfx.GetPath().c_str() ) )
+		{
+			loading.emplace_back( &vfx );
+		}
+	}
+
+	VFX::InitPipelines( loading.size(), loading.data() );
+
+	for ( VFX *vfx : loading )
+	{
+		vfx->FinishLoading();
+	}
+
+	Log( "Loading done." );
+}
+
 void VFXManager::RemoveVFX( VFXContent_t vfx )
 {
 	if ( vfx )
@@ -864,57 +924,27 @@ void VFXManager::RemoveVFX( VFXContent_t vfx )
 	}
 }
 
-int VFXManager::GetPreRenderCmds( gpuCmd_t **cmds )
+void VFXManager::AddPasses()
 {
-	m_preRenderCmds.clear();
-	m_barriers.clear();
+	m_copies.clear();
 
-	double deltaFrame = g_game->GetDeltaFrame();
-	// std::cout << deltaFrame << '\n';
+	const double deltaFrame = g_game->GetDeltaFrame();
 
-	// Get memory barriers
+	// With async compute, each frame in flight simulates its own slice of the attributes, starting from the slice of
+	// the previous frame. Frames still rendering their slice never wait on the simulation of the next one.
+	const bool	   copySlices	  = HasAsyncCompute();
+	const uint32_t frameIndex	  = g_frameArena.GetFrameIndex();
+	const uint32_t prevFrameIndex = ( frameIndex + SWAPCHAIN_BUFFERING_LEVEL - 1 ) % SWAPCHAIN_BUFFERING_LEVEL;
+
+	// Copy commands point to m_copies, it must not grow once they are added
+	size_t copyCount = 0;
 	for ( VFXContent_t &vfx : m_vfxContainer )
 	{
-		if ( !vfx->IsValid() )
-		{
-			continue;
-		}
-
-		vfx->Update( deltaFrame );
-
-		{
-			gpuBarrier_t barrier;
-			barrier.srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-			barrier.dstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
-
-			VkBufferMemoryBarrier *vkBarriers;
-			int					   barriersCount = vfx->BarrierRenderToUpdate( &vkBarriers );
-			for ( int i = 0; i < barriersCount; ++i )
-			{
-				barrier.bufferBarriers.emplace_back( vkBarriers[ i ] );
-			}
-
-			m_barriers.emplace_back( std::move( barrier ) );
-		}
-
-		{
-			gpuBarrier_t barrier;
-			barrier.srcStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
-			barrier.dstStageMask = VK_PIPELINE_STAGE_VERTEX_SHADER_BIT;
-
-			VkBufferMemoryBarrier *vkBarriers;
-			int					   count = vfx->BarriersUpdateToRender( &vkBarriers );
-			for ( int i = 0; i < count; ++i )
-			{
-				barrier.bufferBarriers.emplace_back( vkBarriers[ i ] );
-			}
-
-			m_barriers.emplace_back( std::move( barrier ) );
-		}
+		copyCount += copySlices && vfx->IsValid() ? vfx->m_attributesCount : 0;
 	}
+	m_copies.reserve( copyCount );
 
-	// Create cmds
-	size_t barrierIndex = 0;
+	// Attributes of different VFXs do not alias, the graph groups their copies and their dispatches
 	for ( VFXContent_t &vfx : m_vfxContainer )
 	{
 		if ( !vfx->IsValid() )
@@ -922,58 +952,79 @@ int VFXManager::GetPreRenderCmds( gpuCmd_t **cmds )
 			continue;
 		}
 
-		gpuBarrier_t &barrierRenderToUpdate = m_barriers[ 2 * barrierIndex ];
-		gpuBarrier_t &barrierUpdateToRender = m_barriers[ 2 * barrierIndex + 1 ];
-		++barrierIndex;
+		vfx->Update( deltaFrame );
 
+		m_attributes.clear();
+		for ( int i = 0; i < vfx->m_attributesCount; ++i )
 		{
-			gpuCmd_t barrierCmd;
-			barrierCmd.type = CT_BARRIER;
-			barrierCmd.obj	= &barrierRenderToUpdate;
-			m_preRenderCmds.emplace_back( barrierCmd );
+			const Buffer &buffer = vfx->m_attributesBuffers[ i ].buffer;
+			m_attributes.emplace_back( g_renderGraph.ImportBuffer( buffer.GetHandle(),
+																   buffer.GetFrameOffset( frameIndex ),
+																   buffer.GetFrameRange() ) );
 		}
 
+		if ( copySlices )
 		{
-			gpuCmd_t computeCmd;
-			vfx->GetComputeCmd( computeCmd );
-			m_preRenderCmds.emplace_back( computeCmd );
+			g_renderGraph.AddPass( "VFX copy", RGP_PRE_RENDER );
+
+			for ( int i = 0; i < vfx->m_attributesCount; ++i )
+			{
+				Buffer &buffer = vfx->m_attributesBuffers[ i ].buffer;
+
+				gpuBufferCopy_t copy;
+				copy.srcBuffer = &buffer;
+				copy.srcOffset = buffer.GetFrameOffset( prevFrameIndex );
+				copy.dstBuffer = &buffer;
+				copy.dstOffset = buffer.GetFrameOffset( frameIndex );
+				copy.size	   = buffer.GetFrameRange();
+				m_copies.emplace_back( copy );
+
+				g_renderGraph.Use( g_renderGraph.ImportBuffer( buffer.GetHandle(), copy.srcOffset, copy.size ),
+								   RGU_TRANSFER_SRC );
+				g_renderGraph.Use( m_attributes[ i ], RGU_TRANSFER_DST );
+
+				gpuCmd_t copyCmd;
+				copyCmd.type = CT_COPY;
+				copyCmd.obj	 = &m_copies.back();
+				g_renderGraph.AddCmd( copyCmd );
+			}
 		}
 
+		gpuCmd_t computeCmd;
+		if ( vfx->GetComputeCmd( computeCmd ) )
 		{
-			gpuCmd_t barrierCmd;
-			barrierCmd.type = CT_BARRIER;
-			barrierCmd.obj	= &barrierUpdateToRender;
-			m_preRenderCmds.emplace_back( barrierCmd );
+			g_renderGraph.AddPass( "VFX simulation", RGP_PRE_RENDER );
+			for ( rgResource_t attribute : m_attributes )
+			{
+				g_renderGraph.Use( attribute, RGU_COMPUTE_WRITE );
+			}
+			g_renderGraph.AddCmd( computeCmd );
 		}
-	}
-
-	*cmds = m_preRenderCmds.data();
-
-	return static_cast< int >( m_preRenderCmds.size() );
-}
 
-int VFXManager::GetRenderCmds( gpuCmd_t **cmds )
-{
-	m_renderCmds.clear();
-
-	for ( VFXContent_t &vfx : m_vfxContainer )
-	{
-		if ( !vfx->IsValid() )
+		m_renderCmds.clear();
+		if ( vfx->InsertRenderCmds( m_renderCmds ) )
 		{
-			continue;
+			g_renderGraph.AddPass( "VFX draw", RGP_RENDER );
+			g_renderGraph.Use( g_renderGraph.GetBackbuffer(), RGU_COLOR_ATTACHMENT );
+			if ( g_renderGraph.GetDepthBuffer() != RG_NULL_RESOURCE )
+			{
+				g_renderGraph.Use( g_renderGraph.GetDepthBuffer(), RGU_DEPTH_ATTACHMENT );
+			}
+			for ( rgResource_t attribute : m_attributes )
+			{
+				g_renderGraph.Use( attribute, RGU_GRAPHICS_READ );
+			}
+			for ( const gpuCmd_t &renderCmd : m_renderCmds )
+			{
+				g_renderGraph.AddCmd( renderCmd );
+			}
 		}
-
-		vfx->InsertRenderCmds( m_renderCmds );
 	}
-
-	*cmds = m_renderCmds.data();
-
-	return static_cast< int >( m_renderCmds.size() );
 }
 
-VFXManager::VFXContent_t VFXManager::MakeVFX( const char *file )
+VFXManager::VFXContent_t VFXManager::MakeVFX()
 {
-	return std::make_shared< VFX >( file );
+	return VFXContent_t( new VFX );
 }
 
 void VFXManager::MemsetZeroVFX( VFX &vfx )
@@ -985,6 +1036,23 @@ void VFXManager::MemsetZeroVFX( VFX &vfx )
 	}
 }
 
+void VFXManager::OnBufferRelocated( const Buffer &buffer )
+{
+	// Descriptor sets still point to the old handle. Those of the frames in flight are rewritten when their slot is
+	// recycled, the old buffer outlives them.
+	for ( VFXContent_t &vfx : m_vfxContainer )
+	{
+		for ( int i = 0; i < vfx->m_attributesCount; ++i )
+		{
+			if ( &vfx->m_attributesBuffers[ i ].buffer == &buffer )
+			{
+				vfx->BindBufferDescriptors();
+				break;
+			}
+		}
+	}
+}
+
 void VFX::VFXBuffer_t::GetGLSLType( std::string &out ) const
 {
 	if ( arity == 1 )
@@ -1022,7 +1090,7 @@ void VFX::VFXBuffer_t::Fill( uint32_t data )
 
 void VFX::depthPrepassDeleter_t::operator()( pipelineProg_t *pp )
 {
-	g_pipelineManager.DestroyPipelineProgKeepResources( *pp );
+	g_pipelineManager.RetirePipelineProgKeepResources( *pp );
 }
 
 } // namespace render
@@ -9,7 +9,9 @@
 #include "platform/Serializable.h"
 #include "platform/defines.h"
 #include "renderer/Buffer.h"
+#include "renderer/BufferPool.h"
 #include "renderer/RenderConfig.h"
+#include "renderer/RenderGraph.h"
 #include "renderer/Shader.h"
 #include "renderer/VkRenderCommon.h"
 #include "renderer/vfxtypes.h"
@@ -58,9 +60,6 @@ class VFX : public ISerializable
 	bool GetComputeCmd( gpuCmd_t &computeCmd );
 	bool InsertRenderCmds( std::vector< gpuCmd_t > &renderCmds );
 
-	int BarriersUpdateToRender( VkBufferMemoryBarrier **barriers );
-	int BarrierRenderToUpdate( VkBufferMemoryBarrier **barriers );
-
 	const auto &		 GetPath() const { return m_path; }
 	uint32_t			 GetCapacity() const { return m_capacity; }
 	float				 GetLifeMin() const { return m_lifeMin; }
@@ -71,33 +70,46 @@ class VFX : public ISerializable
 
    private:
 	static const char *	  TypeIndexToStr( int vfxBufferTypeIndex );
-	static NO_DISCARD int GetRevivalCounterName( char *buffer, int bufferSize );
+	NO_DISCARD static int GetRevivalCounterName( char *buffer, int bufferSize );
 
 	template< class Archive >
 	void serialize( Archive &ar );
 
+	VFX(); // Not loaded, see VFXManager::AddVFXsFromFiles
+
 	bool			LoadFromJSON( const char *path );
 	NO_DISCARD bool SaveToJson( const char *path );
+	// LoadFromJSON without the pipelines, so that VFXManager initializes those of several VFXs together
+	NO_DISCARD bool ReadJSON( const char *path );
+	bool			FinishLoading();
 
 	uint32_t GetIndicesCount();
 
 	void AllocBuffers();
 	void BindBuffers();
+	// The descriptors of the attribute buffers and of the revival counter, BindBuffers also updates the UBOs
+	void BindBufferDescriptors();
 
 	NO_DISCARD bool CheckPipelines();
 
-	void InitBarriers();
-	void InitPipelines();
-	void SetupRenderpass();
+	// Shaders of all the VFXs are compiled together, then their pipelines are created together
+	static void InitPipelines( size_t count, VFX *const *vfxs );
+	void		SetupRenderpass();
 
 	void SetPath( const char *path ) { m_path = path; }
 	void SetCapacity( uint32_t capacity ) { m_capacity = capacity; }
 	void SetLifeMin( float lifeMin ) { m_lifeMin = lifeMin; }
 	void SetLifeMax( float lifeMax ) { m_lifeMax = lifeMax; }
 	void SetRenderPrimitive( vfxRenderPrimitive_t renderPrimitive );
-
-	NO_DISCARD bool ParseCustomVars( std::string *shaderCode, shaderStage_t shaderStage );
-	void			AddShaderCodeHeaderAndFooter( std::string &shaderCode, shaderStage_t stage );
+	// Graphics pipeline state drawing renderPrimitive
+	static uint64_t GetPrimitiveState( uint64_t state, vfxRenderPrimitive_t renderPrimitive );
+	// Settings of a background reload, applied once its pipelines are swapped in
+	void OnPipelinesReloaded( float lifeMin, float lifeMax, vfxRenderPrimitive_t renderPrimitive );
+
+	NO_DISCARD bool ParseCustomVars( std::string *					  shaderCode,
+									 shaderStage_t					  shaderStage,
+									 std::vector< shaderLineMap_t > *lineMap );
+	uint32_t		AddShaderCodeHeaderAndFooter( std::string &shaderCode, shaderStage_t stage );
 	int				GetUBOMembers( char *buffer, size_t bufferSize ) const;
 
 	/*void			AddShaderMain( const char *mainFilePath, std::string &out );
@@ -159,18 +171,16 @@ class VFX : public ISerializable
 	float	 m_lifeMax	 = 1.0f;
 
 	vfxRenderPrimitive_t m_renderPrimitive = VFX_RP_CUBE;
-	Buffer				 m_indexBuffer {}; // Could be shared by all VFXs ?
+	bufferView_t		 m_indexBuffer {}; // g_staticBufferPool, shared by VFXs with the same primitive
 
-	Buffer m_revivalCounter {};
-	double m_reviveAcc		   = 0.0;
-	bool   m_infiniteSpawnRate = false;
+	bufferView_t m_revivalCounter {}; // g_perFrameBufferPool
+	double		 m_reviveAcc		 = 0.0;
+	bool		 m_infiniteSpawnRate = false;
 
 	int										   m_userAttributesCount = 0;
 	int										   m_attributesCount	 = 0;
 	std::array< VFXBuffer_t, VFX_MAX_BUFFERS > m_attributesBuffers {};
 	// std::array< VFXBuffer_t, 1 >						 m_hiddenAttributesBuffers {};
-	std::array< VkBufferMemoryBarrier, VFX_MAX_BUFFERS > m_barriersUpdateToRender {};
-	std::array< VkBufferMemoryBarrier, VFX_MAX_BUFFERS > m_barriersRenderToUpdate {};
 };
 
 class VFXManager
@@ -194,23 +204,26 @@ class VFXManager
 
 	// VFXContent_t          AddVFX( uint32_t capacity, float spawnRate );
 	VFXContent_t	AddVFXFromFile( const char *file );
+	// Loading several VFXs at once compiles their shaders in parallel
+	void			AddVFXsFromFiles( size_t count, const char *const *files, VFXContent_t *vfxs );
 	void			RemoveVFX( VFXContent_t vfx );
 	VFXContainer_t &GetContainer() { return m_vfxContainer; }
 
-	int GetPreRenderCmds( gpuCmd_t **cmds );
-	int GetRenderCmds( gpuCmd_t **cmds );
+	// Declares the simulation and the draws of the valid VFXs into g_renderGraph, which infers their barriers
+	void AddPasses();
 
    private:
 	// VFXContent_t MakeVFX( uint32_t capacity, float spawnRate );
-	VFXContent_t MakeVFX( const char *file );
+	VFXContent_t MakeVFX(); // Not loaded
 	void		 MemsetZeroVFX( VFX &vfx );
+	void		 OnBufferRelocated( const Buffer &buffer );
 
    private:
 	VFXContainer_t m_vfxContainer;
 
-	std::vector< gpuCmd_t >		m_preRenderCmds;
-	std::vector< gpuCmd_t >		m_renderCmds;
-	std::vector< gpuBarrier_t > m_barriers;
+	std::vector< gpuCmd_t >		   m_renderCmds; // Of the VFX being declared
+	std::vector< rgResource_t >	   m_attributes; // Of the VFX being declared
+	std::vector< gpuBufferCopy_t > m_copies;	 // Async compute, from the slices of the previous frame
 };
 
 extern VFXManager g_vfxManager;
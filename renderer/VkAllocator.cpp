@@ -3,12 +3,15 @@
 #include "VkAllocator.h"
 
 #include "platform/Heap.h"
+#include "platform/Profiler.h"
+#include "platform/Sys.h"
 #include "renderer/Check.h"
 #include "renderer/VkBackend.h"
 #include "rnLib/Math.h"
 
 #include <algorithm>
 #include <cstdio>
+#include <cstring>
 
 namespace vkRuna
 {
@@ -19,6 +22,20 @@ static const VkDeviceSize g_hostVisibleBlocksCount = 512;
 
 static VulkanAllocator g_allocator;
 
+// Named Tracy memory pool of a memory type, the returned pointer stays valid for the whole run
+const char *MemoryTypePoolName( uint32_t memoryTypeIndex )
+{
+	static std::array< std::array< char, 32 >, VK_MAX_MEMORY_TYPES > names {};
+
+	char *name = names[ memoryTypeIndex ].data();
+	if ( name[ 0 ] == '\0' )
+	{
+		std::snprintf( name, names[ memoryTypeIndex ].size(), "GPU memory type %u", memoryTypeIndex );
+	}
+
+	return name;
+}
+
 void UsageToMemPropsFlags( const vulkanMemoryUsage_t usage,
 						   VkMemoryPropertyFlags &	 required,
 						   VkMemoryPropertyFlags &	 preferred )
@@ -103,14 +120,22 @@ void VulkanBlock::Init()
 		VK_CHECK( vkMapMemory( vkContext.device, m_deviceMemory, 0, m_size, 0, &m_data ) );
 	}
 
-	chunk_t chunk;
-	chunk.id	 = m_nextChunkId++;
-	chunk.size	 = m_size;
-	chunk.offset = 0;
-	chunk.type	 = VULKAN_ALLOCATION_TYPE_FREE;
-
 	m_chunks.clear();
-	m_chunks.emplace_back( chunk );
+	m_freeChunks.clear();
+	m_flBitmap = 0;
+	m_slBitmaps.fill( 0 );
+	for ( auto &freeList : m_freeLists )
+	{
+		freeList.fill( NULL_CHUNK );
+	}
+
+	m_firstChunk = NewChunk();
+
+	chunk_t &chunk = m_chunks[ m_firstChunk ];
+	chunk.size	   = m_size;
+	chunk.offset   = 0;
+
+	InsertFreeChunk( m_firstChunk );
 }
 
 void VulkanBlock::Shutdown()
@@ -125,11 +150,15 @@ void VulkanBlock::Shutdown()
 	vkFreeMemory( vkContext.device, m_deviceMemory, nullptr );
 
 	m_chunks.clear();
+	m_freeChunks.clear();
 
 	m_deviceMemory = VK_NULL_HANDLE;
 	m_allocated	   = 0;
 	m_data		   = nullptr;
-	m_nextChunkId  = 0;
+	m_firstChunk   = NULL_CHUNK;
+	m_flBitmap	   = 0;
+
+	m_allocationCount = 0;
 }
 
 bool CanAllocationTypesAliase( vulkanAllocationType_t type_1, vulkanAllocationType_t type_2 )
@@ -163,105 +192,312 @@ bool AreResourcesOnSamePage( VkDeviceSize resourceA_end, VkDeviceSize resourceB_
 	return resourceA_endPage < resourceB_startPage;
 }
 
-bool VulkanBlock::Alloc( VkDeviceSize			size,
-						 VkDeviceSize			alignment,
-						 VkDeviceSize			bufferImageGranularity,
-						 vulkanAllocationType_t type,
-						 vulkanAllocation_t &	allocation )
+void VulkanBlock::MappingInsert( VkDeviceSize size, uint32_t &fl, uint32_t &sl )
 {
-	VkDeviceSize freeSize = m_size - m_allocated;
+	if ( size < TLSF_SL_COUNT )
+	{
+		fl = 0;
+		sl = static_cast< uint32_t >( size );
+	}
+	else
+	{
+		const int msb = bitScanReverse( size );
 
-	if ( freeSize < size )
+		fl = static_cast< uint32_t >( msb ) - TLSF_SL_LOG2 + 1;
+		sl = static_cast< uint32_t >( size >> ( msb - TLSF_SL_LOG2 ) ) ^ TLSF_SL_COUNT;
+	}
+}
+
+// Round up to the next list, so that any chunk of the list size maps to is large enough
+VkDeviceSize VulkanBlock::RoundUpToList( VkDeviceSize size )
+{
+	if ( size >= TLSF_SL_COUNT )
 	{
-		return false;
+		size += ( VkDeviceSize( 1 ) << ( bitScanReverse( size ) - TLSF_SL_LOG2 ) ) - 1;
 	}
 
-	VkDeviceSize allocOffset = 0;
-	// VkDeviceSize allocPadding = 0;
+	return size;
+}
+
+void VulkanBlock::MappingSearch( VkDeviceSize size, uint32_t &fl, uint32_t &sl )
+{
+	MappingInsert( RoundUpToList( size ), fl, sl );
+}
 
-	int fittingChunkIndex = -1;
-	for ( size_t i = 0; i < m_chunks.size(); ++i )
+VkDeviceSize VulkanBlock::GetMinSize( VkDeviceSize size, VkDeviceSize alignment )
+{
+	// The size Alloc searches the free lists for
+	return RoundUpToList( size + alignment - 1 );
+}
+
+uint32_t VulkanBlock::FindFreeList( uint32_t &fl, uint32_t &sl ) const
+{
+	if ( fl >= TLSF_FL_COUNT )
 	{
-		auto &chunk = m_chunks[ i ];
+		return NULL_CHUNK;
+	}
 
-		if ( chunk.type != VULKAN_ALLOCATION_TYPE_FREE )
+	uint32_t slMap = sl < TLSF_SL_COUNT ? m_slBitmaps[ fl ] & ( ~0u << sl ) : 0;
+	if ( slMap == 0 )
+	{
+		const uint64_t flMap = fl + 1 < TLSF_FL_COUNT ? m_flBitmap & ( ~uint64_t( 0 ) << ( fl + 1 ) ) : 0;
+		if ( flMap == 0 )
 		{
-			continue;
+			return NULL_CHUNK;
 		}
-		if ( chunk.size < size )
+
+		fl	  = static_cast< uint32_t >( bitScanForward( flMap ) );
+		slMap = m_slBitmaps[ fl ];
+	}
+
+	sl = static_cast< uint32_t >( bitScanForward( slMap ) );
+
+	return m_freeLists[ fl ][ sl ];
+}
+
+void VulkanBlock::InsertFreeChunk( uint32_t chunkId )
+{
+	chunk_t &chunk = m_chunks[ chunkId ];
+	chunk.type	   = VULKAN_ALLOCATION_TYPE_FREE;
+
+	uint32_t fl, sl;
+	MappingInsert( chunk.size, fl, sl );
+
+	uint32_t &head = m_freeLists[ fl ][ sl ];
+
+	chunk.prevFree = NULL_CHUNK;
+	chunk.nextFree = head;
+	if ( head != NULL_CHUNK )
+	{
+		m_chunks[ head ].prevFree = chunkId;
+	}
+	head = chunkId;
+
+	m_slBitmaps[ fl ] |= 1u << sl;
+	m_flBitmap |= uint64_t( 1 ) << fl;
+}
+
+void VulkanBlock::RemoveFreeChunk( uint32_t chunkId )
+{
+	chunk_t &chunk = m_chunks[ chunkId ];
+	CHECK_PRED( chunk.type == VULKAN_ALLOCATION_TYPE_FREE );
+
+	uint32_t fl, sl;
+	MappingInsert( chunk.size, fl, sl );
+
+	if ( chunk.prevFree != NULL_CHUNK )
+	{
+		m_chunks[ chunk.prevFree ].nextFree = chunk.nextFree;
+	}
+	else
+	{
+		m_freeLists[ fl ][ sl ] = chunk.nextFree;
+	}
+
+	if ( chunk.nextFree != NULL_CHUNK )
+	{
+		m_chunks[ chunk.nextFree ].prevFree = chunk.prevFree;
+	}
+
+	if ( m_freeLists[ fl ][ sl ] == NULL_CHUNK )
+	{
+		m_slBitmaps[ fl ] &= ~( 1u << sl );
+		if ( m_slBitmaps[ fl ] == 0 )
 		{
-			continue;
+			m_flBitmap &= ~( uint64_t( 1 ) << fl );
 		}
+	}
+
+	chunk.prevFree = NULL_CHUNK;
+	chunk.nextFree = NULL_CHUNK;
+}
 
-		allocOffset = Align( chunk.offset, alignment );
+bool VulkanBlock::FitChunk( const chunk_t &		   chunk,
+							VkDeviceSize		   size,
+							VkDeviceSize		   alignment,
+							VkDeviceSize		   bufferImageGranularity,
+							vulkanAllocationType_t type,
+							VkDeviceSize &		   allocOffset ) const
+{
+	allocOffset = Align( chunk.offset, alignment );
 
-		if ( i > 0 )
+	if ( chunk.prevPhys != NULL_CHUNK )
+	{
+		const chunk_t &previousChunk = m_chunks[ chunk.prevPhys ];
+		if ( CanAllocationTypesAliase( previousChunk.type, type ) )
 		{
-			auto &previousChunk = m_chunks[ i - 1 ];
-			if ( CanAllocationTypesAliase( previousChunk.type, type ) )
+			if ( AreResourcesOnSamePage( previousChunk.offset + previousChunk.size - 1,
+										 allocOffset,
+										 bufferImageGranularity ) )
 			{
-				if ( AreResourcesOnSamePage( previousChunk.offset + previousChunk.size - 1,
-											 allocOffset,
-											 bufferImageGranularity ) )
-				{
-					allocOffset = Align( allocOffset, bufferImageGranularity );
-				}
+				allocOffset = Align( allocOffset, bufferImageGranularity );
 			}
 		}
+	}
 
-		if ( allocOffset + size > chunk.offset + chunk.size )
-		{
-			continue;
-		}
+	if ( allocOffset + size > chunk.offset + chunk.size )
+	{
+		return false;
+	}
 
-		if ( i < m_chunks.size() - 1 )
+	if ( chunk.nextPhys != NULL_CHUNK )
+	{
+		const chunk_t &nextChunk = m_chunks[ chunk.nextPhys ];
+		if ( CanAllocationTypesAliase( type, nextChunk.type ) )
 		{
-			auto &nextChunk = m_chunks[ i + 1 ];
-			if ( CanAllocationTypesAliase( type, nextChunk.type ) )
+			if ( AreResourcesOnSamePage( allocOffset + size - 1, nextChunk.offset, bufferImageGranularity ) )
 			{
-				if ( AreResourcesOnSamePage( allocOffset + size - 1, nextChunk.offset, bufferImageGranularity ) )
-				{
-					continue;
-				}
+				return false;
 			}
 		}
+	}
 
-		fittingChunkIndex = static_cast< int >( i );
-		break;
+	return true;
+}
+
+uint32_t VulkanBlock::NewChunk()
+{
+	uint32_t chunkId;
+	if ( !m_freeChunks.empty() )
+	{
+		chunkId = m_freeChunks.back();
+		m_freeChunks.pop_back();
+	}
+	else
+	{
+		chunkId = static_cast< uint32_t >( m_chunks.size() );
+		m_chunks.emplace_back();
 	}
 
-	if ( fittingChunkIndex == -1 )
+	chunk_t &chunk = m_chunks[ chunkId ];
+	chunk.type	   = VULKAN_ALLOCATION_TYPE_FREE;
+	chunk.size	   = 0;
+	chunk.offset   = 0;
+	chunk.prevPhys = NULL_CHUNK;
+	chunk.nextPhys = NULL_CHUNK;
+	chunk.prevFree = NULL_CHUNK;
+	chunk.nextFree = NULL_CHUNK;
+
+	return chunkId;
+}
+
+void VulkanBlock::DeleteChunk( uint32_t chunkId )
+{
+	m_freeChunks.push_back( chunkId );
+}
+
+bool VulkanBlock::Alloc( VkDeviceSize			size,
+						 VkDeviceSize			alignment,
+						 VkDeviceSize			bufferImageGranularity,
+						 vulkanAllocationType_t type,
+						 vulkanAllocation_t &	allocation )
+{
+	VkDeviceSize freeSize = m_size - m_allocated;
+
+	if ( freeSize < size )
 	{
 		return false;
 	}
 
-	chunk_t *fittingChunk = &m_chunks[ fittingChunkIndex ];
+	// Searching for size + alignment - 1 makes the first candidate fit whatever its offset. Granularity
+	// conflicts with the physical neighbours may still reject it, in that case try the next free chunks.
+	uint32_t fl, sl;
+	MappingSearch( size + alignment - 1, fl, sl );
+
+	VkDeviceSize allocOffset = 0;
+	uint32_t	 chunkId	 = FindFreeList( fl, sl );
+	while ( chunkId != NULL_CHUNK )
+	{
+		if ( FitChunk( m_chunks[ chunkId ], size, alignment, bufferImageGranularity, type, allocOffset ) )
+		{
+			break;
+		}
+
+		chunkId = m_chunks[ chunkId ].nextFree;
+		if ( chunkId == NULL_CHUNK )
+		{
+			++sl;
+			chunkId = FindFreeList( fl, sl );
+		}
+	}
+
+	if ( chunkId == NULL_CHUNK )
+	{
+		return false;
+	}
 
-	VkDeviceSize paddedAllocSize = size + ( allocOffset - fittingChunk->offset );
+	RemoveFreeChunk( chunkId );
 
-	if ( fittingChunk->offset + fittingChunk->size > allocOffset + size )
+	// Give the alignment padding back to the free lists. The previous chunk is never free, free chunks are always
+	// merged.
+	const VkDeviceSize padding = allocOffset - m_chunks[ chunkId ].offset;
+	if ( padding > 0 )
 	{
-		chunk_t leftover;
-		leftover.type	= VULKAN_ALLOCATION_TYPE_FREE;
-		leftover.id		= m_nextChunkId++;
-		leftover.offset = allocOffset + size;
-		leftover.size	= fittingChunk->size - paddedAllocSize;
+		const uint32_t paddingId = NewChunk();
+
+		chunk_t &chunk		 = m_chunks[ chunkId ];
+		chunk_t &paddingChunk = m_chunks[ paddingId ];
+
+		paddingChunk.offset	  = chunk.offset;
+		paddingChunk.size	  = padding;
+		paddingChunk.prevPhys = chunk.prevPhys;
+		paddingChunk.nextPhys = chunkId;
+
+		if ( chunk.prevPhys != NULL_CHUNK )
+		{
+			m_chunks[ chunk.prevPhys ].nextPhys = paddingId;
+		}
+		else
+		{
+			m_firstChunk = paddingId;
+		}
 
-		m_chunks.insert( m_chunks.begin() + fittingChunkIndex + 1, leftover );
+		chunk.prevPhys = paddingId;
+		chunk.offset   = allocOffset;
+		chunk.size -= padding;
+
+		InsertFreeChunk( paddingId );
 	}
 
-	fittingChunk = &m_chunks[ fittingChunkIndex ];
+	if ( m_chunks[ chunkId ].size > size )
+	{
+		const uint32_t leftoverId = NewChunk();
+
+		chunk_t &chunk	  = m_chunks[ chunkId ];
+		chunk_t &leftover = m_chunks[ leftoverId ];
+
+		leftover.offset	  = allocOffset + size;
+		leftover.size	  = chunk.size - size;
+		leftover.prevPhys = chunkId;
+		leftover.nextPhys = chunk.nextPhys;
 
-	fittingChunk->type = type;
-	fittingChunk->size = paddedAllocSize;
+		if ( chunk.nextPhys != NULL_CHUNK )
+		{
+			m_chunks[ chunk.nextPhys ].prevPhys = leftoverId;
+		}
 
-	m_allocated += paddedAllocSize;
+		chunk.nextPhys = leftoverId;
+		chunk.size	   = size;
+
+		InsertFreeChunk( leftoverId );
+	}
+
+	chunk_t &fittingChunk = m_chunks[ chunkId ];
+	fittingChunk.type	  = type;
+
+	m_allocated += fittingChunk.size;
+	++m_allocationCount;
 
 	allocation.block		= this;
-	allocation.id			= fittingChunk->id;
+	allocation.node			= chunkId;
 	allocation.deviceMemory = m_deviceMemory;
 	allocation.offset		= allocOffset;
 	allocation.size			= size;
+
+	RUNA_PROFILE_ALLOC( (void *)( (uint64_t)m_deviceMemory + allocOffset ),
+						size,
+						MemoryTypePoolName( m_memTypeIndex ) );
+
 	if ( IsHostVisible() )
 	{
 		allocation.data = static_cast< byte * >( m_data ) + allocOffset;
@@ -276,46 +512,59 @@ bool VulkanBlock::Alloc( VkDeviceSize			size,
 
 void VulkanBlock::Free( vulkanAllocation_t &allocation )
 {
-	int chunkIndex = -1;
-	for ( int i = 0; i < m_chunks.size(); ++i )
-	{
-		auto &chunk = m_chunks[ i ];
-		if ( chunk.id == allocation.id && chunk.type != VULKAN_ALLOCATION_TYPE_FREE )
-		{
-			chunkIndex = i;
-			break;
-		}
-	}
+	CHECK_PRED( allocation.block == this );
+	CHECK_PRED( allocation.node < m_chunks.size() );
+
+	uint32_t chunkId = allocation.node;
+	CHECK_PRED( m_chunks[ chunkId ].type != VULKAN_ALLOCATION_TYPE_FREE );
 
-	CHECK_PRED( chunkIndex != -1 );
+	RUNA_PROFILE_FREE( (void *)( (uint64_t)m_deviceMemory + allocation.offset ), MemoryTypePoolName( m_memTypeIndex ) );
 
-	m_chunks[ chunkIndex ].type = VULKAN_ALLOCATION_TYPE_FREE;
-	m_allocated -= m_chunks[ chunkIndex ].size;
+	m_allocated -= m_chunks[ chunkId ].size;
+	--m_allocationCount;
 
 	// merge contiguous free chunks
-	if ( chunkIndex > 0 )
+	const uint32_t previousId = m_chunks[ chunkId ].prevPhys;
+	if ( previousId != NULL_CHUNK && m_chunks[ previousId ].type == VULKAN_ALLOCATION_TYPE_FREE )
 	{
-		auto &previousChunk = m_chunks[ chunkIndex - 1 ];
-		if ( previousChunk.type == VULKAN_ALLOCATION_TYPE_FREE )
+		RemoveFreeChunk( previousId );
+
+		chunk_t &chunk		   = m_chunks[ chunkId ];
+		chunk_t &previousChunk = m_chunks[ previousId ];
+
+		previousChunk.size += chunk.size;
+		previousChunk.nextPhys = chunk.nextPhys;
+		if ( chunk.nextPhys != NULL_CHUNK )
 		{
-			previousChunk.size += m_chunks[ chunkIndex ].size;
-			m_chunks.erase( m_chunks.begin() + chunkIndex );
-			--chunkIndex;
+			m_chunks[ chunk.nextPhys ].prevPhys = previousId;
 		}
+
+		DeleteChunk( chunkId );
+		chunkId = previousId;
 	}
 
-	if ( chunkIndex < m_chunks.size() - 1 )
+	const uint32_t nextId = m_chunks[ chunkId ].nextPhys;
+	if ( nextId != NULL_CHUNK && m_chunks[ nextId ].type == VULKAN_ALLOCATION_TYPE_FREE )
 	{
-		auto &nextChunk = m_chunks[ chunkIndex + 1 ];
-		if ( nextChunk.type == VULKAN_ALLOCATION_TYPE_FREE )
+		RemoveFreeChunk( nextId );
+
+		chunk_t &chunk	   = m_chunks[ chunkId ];
+		chunk_t &nextChunk = m_chunks[ nextId ];
+
+		chunk.size += nextChunk.size;
+		chunk.nextPhys = nextChunk.nextPhys;
+		if ( nextChunk.nextPhys != NULL_CHUNK )
 		{
-			m_chunks[ chunkIndex ].size += nextChunk.size;
-			m_chunks.erase( m_chunks.begin() + chunkIndex + 1 );
+			m_chunks[ nextChunk.nextPhys ].prevPhys = chunkId;
 		}
+
+		DeleteChunk( nextId );
 	}
 
-	allocation.block = nullptr;
-	// allocation.id           = UINT32_MAX;
+	InsertFreeChunk( chunkId );
+
+	allocation.block		= nullptr;
+	allocation.node			= UINT32_MAX;
 	allocation.deviceMemory = VK_NULL_HANDLE;
 	allocation.offset		= 0;
 	allocation.size			= 0;
@@ -347,6 +596,26 @@ const char *ToStringAllocType( vulkanAllocationType_t type )
 	}
 }
 
+VkDeviceSize VulkanBlock::GetLargestFreeRange() const
+{
+	if ( m_flBitmap == 0 )
+	{
+		return 0;
+	}
+
+	// Every chunk of the highest non empty list is bigger than the chunks of the other lists
+	const uint32_t fl = static_cast< uint32_t >( bitScanReverse( m_flBitmap ) );
+	const uint32_t sl = static_cast< uint32_t >( bitScanReverse( m_slBitmaps[ fl ] ) );
+
+	VkDeviceSize largest = 0;
+	for ( uint32_t chunkId = m_freeLists[ fl ][ sl ]; chunkId != NULL_CHUNK; chunkId = m_chunks[ chunkId ].nextFree )
+	{
+		largest = std::max( largest, m_chunks[ chunkId ].size );
+	}
+
+	return largest;
+}
+
 void VulkanBlock::Print() const
 {
 	std::printf(
@@ -358,11 +627,12 @@ void VulkanBlock::Print() const
 		m_allocated,
 		ToStringMemUsage( m_usage ),
 		m_memTypeIndex,
-		m_chunks.size() );
+		m_chunks.size() - m_freeChunks.size() );
 
-	for ( auto &chunk : m_chunks )
+	for ( uint32_t chunkId = m_firstChunk; chunkId != NULL_CHUNK; chunkId = m_chunks[ chunkId ].nextPhys )
 	{
-		std::printf( "[ %u, %llu, %llu, %s ]\n", chunk.id, chunk.offset, chunk.size, ToStringAllocType( chunk.type ) );
+		const chunk_t &chunk = m_chunks[ chunkId ];
+		std::printf( "[ %u, %llu, %llu, %s ]\n", chunkId, chunk.offset, chunk.size, ToStringAllocType( chunk.type ) );
 	}
 }
 
@@ -398,10 +668,22 @@ void VulkanAllocator::Init()
 	}
 
 	m_bufferImageGranularity = gpu.properties.limits.bufferImageGranularity;
+
+	m_lastStatsTicks = sys::GetClockTicks();
 }
 
 void VulkanAllocator::Shutdown()
 {
+	// Called once the device is idle and other threads stopped allocating. Released ranges may return to the caches,
+	// they are drained last.
+	for ( garbage_t &garbage : m_garbage )
+	{
+		ReleaseGarbage( garbage );
+	}
+	m_garbage.clear();
+
+	TrimThreadCaches( false );
+
 	for ( auto &blocks : m_blockChains )
 	{
 		for ( VulkanBlock *block : blocks )
@@ -422,17 +704,40 @@ vulkanAllocation_t VulkanAllocator::Alloc( vulkanAllocationType_t type,
 
 	vulkanAllocation_t allocation;
 
-	auto &gpu = GetVulkanContext().gpu;
+	int memoryTypeId = FindMemoryTypeIndex( usage, requirements.memoryTypeBits );
+	CHECK_PRED( memoryTypeId != -1 );
 
-	uint32_t flagsRequired, flagsPreferred;
-	UsageToMemPropsFlags( usage, flagsRequired, flagsPreferred );
+	++m_counters[ memoryTypeId ].allocs;
 
-	int memoryTypeId = FindMemoryType( &gpu.memProps, requirements.memoryTypeBits, flagsPreferred );
-	if ( memoryTypeId == -1 )
+	if ( type == VULKAN_ALLOCATION_TYPE_BUFFER && requirements.size <= CACHE_MAX_SIZE )
 	{
-		memoryTypeId = FindMemoryType( &gpu.memProps, requirements.memoryTypeBits, flagsRequired );
+		// Ranges are aligned on the lowest set bit of their class size, larger alignments take the next classes
+		for ( uint32_t sizeClass = GetSizeClass( requirements.size ); sizeClass < CACHE_CLASS_COUNT; ++sizeClass )
+		{
+			const VkDeviceSize classSize = GetClassSize( sizeClass );
+			if ( requirements.alignment <= ( classSize & ( ~classSize + 1 ) ) )
+			{
+				if ( AllocFromThreadCache( memoryTypeId, usage, sizeClass, allocation ) )
+				{
+					return allocation;
+				}
+				break;
+			}
+		}
 	}
-	CHECK_PRED( memoryTypeId != -1 );
+
+	std::lock_guard< std::mutex > lock( m_chainMutexes[ memoryTypeId ] );
+
+	return AllocFromChain( memoryTypeId, type, usage, requirements.size, requirements.alignment );
+}
+
+vulkanAllocation_t VulkanAllocator::AllocFromChain( uint32_t			   memoryTypeId,
+													vulkanAllocationType_t type,
+													vulkanMemoryUsage_t	   usage,
+													VkDeviceSize		   size,
+													VkDeviceSize		   alignment )
+{
+	vulkanAllocation_t allocation;
 
 	auto &blocks = m_blockChains[ memoryTypeId ];
 
@@ -445,7 +750,7 @@ vulkanAllocation_t VulkanAllocator::Alloc( vulkanAllocationType_t type,
 			continue;
 		}
 
-		if ( block->Alloc( requirements.size, requirements.alignment, m_bufferImageGranularity, type, allocation ) )
+		if ( block->Alloc( size, alignment, m_bufferImageGranularity, type, allocation ) )
 		{
 			// Print();
 			return allocation;
@@ -455,12 +760,12 @@ vulkanAllocation_t VulkanAllocator::Alloc( vulkanAllocationType_t type,
 	VkDeviceSize blockSize = usage != VULKAN_MEMORY_USAGE_GPU_ONLY
 								 ? m_hostVisibleMemoryBytes / g_hostVisibleBlocksCount
 								 : m_deviceLocalMemoryBytes / g_deviceLocalBlocksCount;
+	blockSize = std::max( blockSize, VulkanBlock::GetMinSize( size, alignment ) );
 
 	auto *block = new VulkanBlock( memoryTypeId, blockSize, usage );
 	block->Init();
-	CHECK_PRED_MSG(
-		block->Alloc( requirements.size, requirements.alignment, m_bufferImageGranularity, type, allocation ),
-		"GPU Block allocation failed." );
+	CHECK_PRED_MSG( block->Alloc( size, alignment, m_bufferImageGranularity, type, allocation ),
+					"GPU Block allocation failed." );
 
 	blocks.emplace_back( block );
 
@@ -469,36 +774,599 @@ vulkanAllocation_t VulkanAllocator::Alloc( vulkanAllocationType_t type,
 	return allocation;
 }
 
+void VulkanAllocator::FreeToChain( vulkanAllocation_t &allocation )
+{
+	auto *block = allocation.block;
+
+	block->Free( allocation );
+	if ( block->GetAllocatedSize() == 0 )
+	{
+		auto &blockChain = m_blockChains[ block->GetMemoryTypeIndex() ];
+
+		auto pos = std::find( blockChain.cbegin(), blockChain.cend(), block );
+		CHECK_PRED( pos != blockChain.cend() );
+
+		blockChain.erase( pos );
+		delete block;
+	}
+}
+
+uint32_t VulkanAllocator::GetSizeClass( VkDeviceSize size )
+{
+	if ( size <= CACHE_MIN_SIZE )
+	{
+		return 0;
+	}
+
+	// Power of two range of size, then the step of its classes
+	const uint32_t	   range	= static_cast< uint32_t >( bitScanReverse( size - 1 ) ) - CACHE_MIN_SIZE_LOG2;
+	const VkDeviceSize base		= CACHE_MIN_SIZE << range;
+	const uint32_t	   stepLog2 = CACHE_MIN_SIZE_LOG2 + range - CACHE_CLASS_LOG2;
+
+	return ( range << CACHE_CLASS_LOG2 ) +
+		   static_cast< uint32_t >( ( size - base + ( VkDeviceSize( 1 ) << stepLog2 ) - 1 ) >> stepLog2 );
+}
+
+VkDeviceSize VulkanAllocator::GetClassSize( uint32_t sizeClass )
+{
+	if ( sizeClass == 0 )
+	{
+		return CACHE_MIN_SIZE;
+	}
+
+	const uint32_t range = ( sizeClass - 1 ) >> CACHE_CLASS_LOG2;
+	const uint32_t step	 = ( ( sizeClass - 1 ) & ( ( 1 << CACHE_CLASS_LOG2 ) - 1 ) ) + 1;
+
+	return ( CACHE_MIN_SIZE << range ) + ( VkDeviceSize( step ) << ( CACHE_MIN_SIZE_LOG2 + range - CACHE_CLASS_LOG2 ) );
+}
+
+// Ranges of each size class, carved in batches from the chains of every memory type. The owner thread takes them
+// under the cache lock, the main thread returns released ones and trims them under the same lock. lowWater counts
+// the ranges that stayed cached since the last trim.
+struct VulkanAllocator::threadCache_t
+{
+	using ranges_t = std::vector< vulkanAllocation_t >;
+
+	std::array< std::array< ranges_t, CACHE_CLASS_COUNT >, VK_MAX_MEMORY_TYPES > ranges;
+	std::array< std::array< uint32_t, CACHE_CLASS_COUNT >, VK_MAX_MEMORY_TYPES > lowWater {}; // Since the last trim
+
+	VulkanAllocator *allocator = nullptr;
+	uint32_t		 id		   = 0;
+	std::mutex		 mutex;
+
+	~threadCache_t()
+	{
+		if ( allocator == nullptr )
+		{
+			return;
+		}
+
+		std::lock_guard< std::mutex > lock( allocator->m_threadCachesMutex );
+
+		// Ranges still allocated by the thread go back to the chains once released
+		auto &caches = allocator->m_threadCaches;
+		caches.erase( std::find( caches.begin(), caches.end(), this ) );
+
+		allocator->DrainThreadCache( *this );
+	}
+};
+
+VulkanAllocator::threadCache_t &VulkanAllocator::GetThreadCache()
+{
+	thread_local threadCache_t cache;
+
+	if ( cache.allocator == nullptr )
+	{
+		std::lock_guard< std::mutex > lock( m_threadCachesMutex );
+
+		cache.allocator = this;
+		cache.id		= m_nextCacheId++;
+		m_threadCaches.emplace_back( &cache );
+	}
+
+	CHECK_PRED( cache.allocator == this );
+
+	return cache;
+}
+
+bool VulkanAllocator::AllocFromThreadCache( uint32_t			memoryTypeId,
+											vulkanMemoryUsage_t usage,
+											uint32_t			sizeClass,
+											vulkanAllocation_t &allocation )
+{
+	threadCache_t &cache = GetThreadCache();
+
+	std::lock_guard< std::mutex > cacheLock( cache.mutex );
+
+	threadCache_t::ranges_t &ranges = cache.ranges[ memoryTypeId ][ sizeClass ];
+
+	if ( ranges.empty() )
+	{
+		const VkDeviceSize classSize	  = GetClassSize( sizeClass );
+		const VkDeviceSize classAlignment = classSize & ( ~classSize + 1 );
+
+		std::lock_guard< std::mutex > lock( m_chainMutexes[ memoryTypeId ] );
+
+		// Sizes are multiples of the alignment, the ranges of a refill are carved back to back
+		for ( uint32_t i = 0; i < CACHE_REFILL_COUNT; ++i )
+		{
+			vulkanAllocation_t range =
+				AllocFromChain( memoryTypeId, VULKAN_ALLOCATION_TYPE_BUFFER, usage, classSize, classAlignment );
+			range.cacheId = cache.id;
+			ranges.emplace_back( range );
+		}
+	}
+
+	allocation = ranges.back();
+	ranges.pop_back();
+
+	uint32_t &lowWater = cache.lowWater[ memoryTypeId ][ sizeClass ];
+	lowWater		   = std::min( lowWater, static_cast< uint32_t >( ranges.size() ) );
+
+	return true;
+}
+
+bool VulkanAllocator::ReturnToThreadCache( const vulkanAllocation_t &allocation )
+{
+	std::lock_guard< std::mutex > lock( m_threadCachesMutex );
+
+	// The thread that carved the range may have exited
+	const uint32_t cacheId = allocation.cacheId;
+	auto		   it	   = std::find_if( m_threadCaches.begin(),
+								   m_threadCaches.end(),
+								   [ cacheId ]( const threadCache_t *cache ) { return cache->id == cacheId; } );
+	if ( it == m_threadCaches.end() )
+	{
+		return false;
+	}
+
+	threadCache_t &cache = **it;
+
+	std::lock_guard< std::mutex > cacheLock( cache.mutex );
+
+	threadCache_t::ranges_t &ranges =
+		cache.ranges[ allocation.block->GetMemoryTypeIndex() ][ GetSizeClass( allocation.size ) ];
+	if ( ranges.size() >= CACHE_MAX_RANGES )
+	{
+		return false;
+	}
+
+	ranges.emplace_back( allocation );
+
+	return true;
+}
+
+void VulkanAllocator::DrainThreadCache( threadCache_t &cache )
+{
+	for ( uint32_t memoryTypeId = 0; memoryTypeId < VK_MAX_MEMORY_TYPES; ++memoryTypeId )
+	{
+		for ( threadCache_t::ranges_t &ranges : cache.ranges[ memoryTypeId ] )
+		{
+			if ( ranges.empty() )
+			{
+				continue;
+			}
+
+			std::lock_guard< std::mutex > lock( m_chainMutexes[ memoryTypeId ] );
+			for ( vulkanAllocation_t &allocation : ranges )
+			{
+				FreeToChain( allocation );
+			}
+			ranges.clear();
+		}
+	}
+}
+
+void VulkanAllocator::TrimThreadCaches( bool unusedOnly )
+{
+	std::lock_guard< std::mutex > lock( m_threadCachesMutex );
+
+	for ( threadCache_t *cache : m_threadCaches )
+	{
+		std::lock_guard< std::mutex > cacheLock( cache->mutex );
+
+		for ( uint32_t memoryTypeId = 0; memoryTypeId < VK_MAX_MEMORY_TYPES; ++memoryTypeId )
+		{
+			for ( uint32_t sizeClass = 0; sizeClass < CACHE_CLASS_COUNT; ++sizeClass )
+			{
+				threadCache_t::ranges_t &ranges	  = cache->ranges[ memoryTypeId ][ sizeClass ];
+				uint32_t &				 lowWater = cache->lowWater[ memoryTypeId ][ sizeClass ];
+
+				// The oldest ranges are at the front, the owner takes from the back
+				const size_t count = unusedOnly ? std::min< size_t >( lowWater, ranges.size() ) : ranges.size();
+				if ( count > 0 )
+				{
+					std::lock_guard< std::mutex > chainLock( m_chainMutexes[ memoryTypeId ] );
+					for ( size_t i = 0; i < count; ++i )
+					{
+						FreeToChain( ranges[ i ] );
+					}
+					ranges.erase( ranges.begin(), ranges.begin() + count );
+				}
+
+				lowWater = static_cast< uint32_t >( ranges.size() );
+			}
+		}
+	}
+}
+
+bool VulkanAllocator::AllocOutsideBlock( vulkanAllocationType_t type,
+										 vulkanMemoryUsage_t	usage,
+										 VkMemoryRequirements	requirements,
+										 const VulkanBlock *	excludedBlock,
+										 vulkanAllocation_t &	allocation )
+{
+	CHECK_PRED( type != VULKAN_ALLOCATION_TYPE_FREE );
+	CHECK_PRED( usage != VULKAN_MEMORY_USAGE_UNKNOWN );
+
+	int memoryTypeId = FindMemoryTypeIndex( usage, requirements.memoryTypeBits );
+	if ( memoryTypeId == -1 )
+	{
+		return false;
+	}
+
+	std::lock_guard< std::mutex > lock( m_chainMutexes[ memoryTypeId ] );
+
+	// Fill the densest blocks first, otherwise drained data could land in the next sparse block
+	std::vector< VulkanBlock * > blocks = m_blockChains[ memoryTypeId ];
+	std::sort( blocks.begin(), blocks.end(), []( const VulkanBlock *a, const VulkanBlock *b ) {
+		return a->GetAllocatedSize() > b->GetAllocatedSize();
+	} );
+
+	for ( VulkanBlock *block : blocks )
+	{
+		if ( block == excludedBlock )
+		{
+			continue;
+		}
+
+		if ( block->Alloc( requirements.size, requirements.alignment, m_bufferImageGranularity, type, allocation ) )
+		{
+			++m_counters[ memoryTypeId ].allocs;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool VulkanAllocator::CanEvacuate( const VulkanBlock *block ) const
+{
+	std::lock_guard< std::mutex > lock( m_chainMutexes[ block->GetMemoryTypeIndex() ] );
+
+	const auto &blocks = m_blockChains[ block->GetMemoryTypeIndex() ];
+	if ( blocks.size() < 2 )
+	{
+		return false;
+	}
+
+	VkDeviceSize freeSize = 0;
+	for ( const VulkanBlock *other : blocks )
+	{
+		if ( other != block )
+		{
+			freeSize += other->GetSize() - other->GetAllocatedSize();
+		}
+	}
+
+	return freeSize >= block->GetAllocatedSize();
+}
+
 void VulkanAllocator::Free( vulkanAllocation_t &allocation )
 {
 	if ( allocation.block == nullptr )
 	{
 		return;
 	}
-	m_garbage.emplace_back( allocation );
-	std::memset( &allocation, 0, sizeof( allocation ) );
+
+	garbage_t garbage;
+	garbage.allocation = allocation;
+	PushGarbage( garbage );
+
+	allocation = vulkanAllocation_t();
 }
 
-void VulkanAllocator::EmptyGarbage()
+void VulkanAllocator::FreeBuffer( VkBuffer &buffer, vulkanAllocation_t &allocation )
 {
-	for ( auto &allocation : m_garbage )
+	if ( buffer == VK_NULL_HANDLE && allocation.block == nullptr )
 	{
-		auto *block = allocation.block;
+		return;
+	}
 
-		block->Free( allocation );
-		if ( block->GetAllocatedSize() == 0 )
+	garbage_t garbage;
+	garbage.allocation = allocation;
+	garbage.buffer	   = buffer;
+	PushGarbage( garbage );
+
+	buffer	   = VK_NULL_HANDLE;
+	allocation = vulkanAllocation_t();
+}
+
+void VulkanAllocator::FreeImage( VkImage &image, VkImageView &view, VkSampler &sampler, vulkanAllocation_t &allocation )
+{
+	if ( image == VK_NULL_HANDLE && view == VK_NULL_HANDLE && sampler == VK_NULL_HANDLE &&
+		 allocation.block == nullptr )
+	{
+		return;
+	}
+
+	garbage_t garbage;
+	garbage.allocation = allocation;
+	garbage.image	   = image;
+	garbage.view	   = view;
+	garbage.sampler	   = sampler;
+	PushGarbage( garbage );
+
+	image	   = VK_NULL_HANDLE;
+	view	   = VK_NULL_HANDLE;
+	sampler	   = VK_NULL_HANDLE;
+	allocation = vulkanAllocation_t();
+}
+
+void VulkanAllocator::FreeFramebuffer( VkFramebuffer &framebuffer )
+{
+	if ( framebuffer == VK_NULL_HANDLE )
+	{
+		return;
+	}
+
+	garbage_t garbage;
+	garbage.framebuffer = framebuffer;
+	PushGarbage( garbage );
+
+	framebuffer = VK_NULL_HANDLE;
+}
+
+void VulkanAllocator::PushGarbage( garbage_t &garbage )
+{
+	garbage.frameId = m_frameId;
+
+	std::lock_guard< std::mutex > lock( m_garbageMutex );
+	m_garbage.emplace_back( garbage );
+}
+
+void VulkanAllocator::EmptyGarbage( uint64_t completedFrameCount )
+{
+	std::vector< garbage_t > released;
+
+	{
+		std::lock_guard< std::mutex > lock( m_garbageMutex );
+
+		size_t kept = 0;
+		for ( garbage_t &garbage : m_garbage )
 		{
-			auto &blockChain = m_blockChains[ block->GetMemoryTypeIndex() ];
+			if ( garbage.frameId < completedFrameCount )
+			{
+				released.emplace_back( garbage );
+			}
+			else
+			{
+				m_garbage[ kept++ ] = garbage;
+			}
+		}
 
-			auto pos = std::find( blockChain.cbegin(), blockChain.cend(), block );
-			CHECK_PRED( pos != blockChain.cend() );
+		m_garbage.resize( kept );
+	}
 
-			blockChain.erase( pos );
-			delete block;
+	for ( garbage_t &garbage : released )
+	{
+		ReleaseGarbage( garbage );
+	}
+
+	// Waiting on the whole device releases with UINT64_MAX, the next frames restart the period
+	if ( completedFrameCount < m_lastTrimFrame )
+	{
+		m_lastTrimFrame = completedFrameCount;
+	}
+	else if ( completedFrameCount - m_lastTrimFrame >= CACHE_TRIM_FRAMES )
+	{
+		m_lastTrimFrame = completedFrameCount;
+		TrimThreadCaches( true );
+	}
+}
+
+uint32_t VulkanAllocator::GetGarbageCount( const VulkanBlock *block ) const
+{
+	std::lock_guard< std::mutex > lock( m_garbageMutex );
+
+	uint32_t count = 0;
+	for ( const garbage_t &garbage : m_garbage )
+	{
+		count += garbage.allocation.block == block;
+	}
+
+	return count;
+}
+
+void VulkanAllocator::ReleaseGarbage( garbage_t &garbage )
+{
+	auto &device = GetVulkanContext().device;
+
+	// Framebuffers reference views and views their image, destroy them first
+	if ( garbage.framebuffer != VK_NULL_HANDLE )
+	{
+		vkDestroyFramebuffer( device, garbage.framebuffer, nullptr );
+	}
+	if ( garbage.view != VK_NULL_HANDLE )
+	{
+		vkDestroyImageView( device, garbage.view, nullptr );
+	}
+	if ( garbage.image != VK_NULL_HANDLE )
+	{
+		vkDestroyImage( device, garbage.image, nullptr );
+	}
+	if ( garbage.sampler != VK_NULL_HANDLE )
+	{
+		vkDestroySampler( device, garbage.sampler, nullptr );
+	}
+	if ( garbage.buffer != VK_NULL_HANDLE )
+	{
+		vkDestroyBuffer( device, garbage.buffer, nullptr );
+	}
+
+	auto *block = garbage.allocation.block;
+	if ( block == nullptr )
+	{
+		return;
+	}
+
+	const uint32_t memoryTypeId = block->GetMemoryTypeIndex();
+
+	++m_counters[ memoryTypeId ].frees;
+
+	if ( garbage.allocation.cacheId != 0 && ReturnToThreadCache( garbage.allocation ) )
+	{
+		return;
+	}
+
+	std::lock_guard< std::mutex > lock( m_chainMutexes[ memoryTypeId ] );
+	FreeToChain( garbage.allocation );
+}
+
+int VulkanAllocator::FindMemoryTypeIndex( vulkanMemoryUsage_t usage, uint32_t memoryTypeBits ) const
+{
+	auto &gpu = GetVulkanContext().gpu;
+
+	uint32_t flagsRequired, flagsPreferred;
+	UsageToMemPropsFlags( usage, flagsRequired, flagsPreferred );
+
+	int memoryTypeId = FindMemoryType( &gpu.memProps, memoryTypeBits, flagsPreferred );
+	if ( memoryTypeId == -1 )
+	{
+		memoryTypeId = FindMemoryType( &gpu.memProps, memoryTypeBits, flagsRequired );
+	}
+
+	return memoryTypeId;
+}
+
+void VulkanAllocator::GetStats( std::vector< memoryTypeStats_t > &stats )
+{
+	stats.clear();
+
+	const int64_t now	  = sys::GetClockTicks();
+	const double  elapsed = double( now - m_lastStatsTicks ) / double( sys::ClockTicksFrequency() );
+	m_lastStatsTicks	  = now;
+
+	for ( uint32_t i = 0; i < VK_MAX_MEMORY_TYPES; ++i )
+	{
+		std::lock_guard< std::mutex > lock( m_chainMutexes[ i ] );
+
+		const auto &	 blocks	  = m_blockChains[ i ];
+		allocCounters_t &counters = m_counters[ i ];
+
+		if ( blocks.empty() && counters.allocs == 0 )
+		{
+			continue;
+		}
+
+		memoryTypeStats_t typeStats;
+		typeStats.memoryTypeIndex = i;
+		typeStats.blockCount	  = static_cast< uint32_t >( blocks.size() );
+		typeStats.totalAllocs	  = counters.allocs.load();
+		typeStats.totalFrees	  = counters.frees.load();
+
+		for ( const VulkanBlock *block : blocks )
+		{
+			typeStats.allocationCount += block->GetAllocationCount();
+			typeStats.reservedBytes += block->GetSize();
+			typeStats.usedBytes += block->GetAllocatedSize();
+			typeStats.largestFreeRange = std::max( typeStats.largestFreeRange, block->GetLargestFreeRange() );
+		}
+
+		const VkDeviceSize freeBytes = typeStats.reservedBytes - typeStats.usedBytes;
+		if ( freeBytes > 0 )
+		{
+			typeStats.fragmentation = 1.0 - double( typeStats.largestFreeRange ) / double( freeBytes );
+		}
+
+		if ( elapsed > 0.0 )
+		{
+			typeStats.allocsPerSecond = double( typeStats.totalAllocs - counters.lastAllocs ) / elapsed;
+			typeStats.freesPerSecond  = double( typeStats.totalFrees - counters.lastFrees ) / elapsed;
 		}
+		counters.lastAllocs = typeStats.totalAllocs;
+		counters.lastFrees	= typeStats.totalFrees;
+
+		stats.emplace_back( typeStats );
 	}
+}
 
-	m_garbage.clear();
+bool VulkanAllocator::DumpStatsJson( const char *path )
+{
+	FILE *file = std::fopen( path, "w" );
+	if ( file == nullptr )
+	{
+		sys::Error( "Could not open %s to dump allocator stats.", path );
+		return false;
+	}
+
+	std::vector< memoryTypeStats_t > stats;
+	GetStats( stats );
+
+	std::fprintf( file,
+				  "{\n"
+				  "\t\"deviceLocalMemoryBytes\": %llu,\n"
+				  "\t\"hostVisibleMemoryBytes\": %llu,\n"
+				  "\t\"memoryTypes\": [",
+				  static_cast< unsigned long long >( m_deviceLocalMemoryBytes ),
+				  static_cast< unsigned long long >( m_hostVisibleMemoryBytes ) );
+
+	for ( size_t i = 0; i < stats.size(); ++i )
+	{
+		const memoryTypeStats_t &typeStats = stats[ i ];
+
+		std::fprintf( file,
+					  "%s\n\t\t{\n"
+					  "\t\t\t\"memoryTypeIndex\": %u,\n"
+					  "\t\t\t\"blockCount\": %u,\n"
+					  "\t\t\t\"allocationCount\": %u,\n"
+					  "\t\t\t\"reservedBytes\": %llu,\n"
+					  "\t\t\t\"usedBytes\": %llu,\n"
+					  "\t\t\t\"largestFreeRange\": %llu,\n"
+					  "\t\t\t\"fragmentation\": %f,\n"
+					  "\t\t\t\"totalAllocs\": %llu,\n"
+					  "\t\t\t\"totalFrees\": %llu,\n"
+					  "\t\t\t\"allocsPerSecond\": %f,\n"
+					  "\t\t\t\"freesPerSecond\": %f,\n"
+					  "\t\t\t\"blocks\": [",
+					  i == 0 ? "" : ",",
+					  typeStats.memoryTypeIndex,
+					  typeStats.blockCount,
+					  typeStats.allocationCount,
+					  static_cast< unsigned long long >( typeStats.reservedBytes ),
+					  static_cast< unsigned long long >( typeStats.usedBytes ),
+					  static_cast< unsigned long long >( typeStats.largestFreeRange ),
+					  typeStats.fragmentation,
+					  static_cast< unsigned long long >( typeStats.totalAllocs ),
+					  static_cast< unsigned long long >( typeStats.totalFrees ),
+					  typeStats.allocsPerSecond,
+					  typeStats.freesPerSecond );
+
+		std::lock_guard< std::mutex > lock( m_chainMutexes[ typeStats.memoryTypeIndex ] );
+
+		const auto &blocks = m_blockChains[ typeStats.memoryTypeIndex ];
+		for ( size_t j = 0; j < blocks.size(); ++j )
+		{
+			const VulkanBlock *block = blocks[ j ];
+			std::fprintf( file,
+						  "%s\n\t\t\t\t{ \"size\": %llu, \"used\": %llu, \"allocations\": %u, "
+						  "\"largestFreeRange\": %llu, \"usage\": \"%s\" }",
+						  j == 0 ? "" : ",",
+						  static_cast< unsigned long long >( block->GetSize() ),
+						  static_cast< unsigned long long >( block->GetAllocatedSize() ),
+						  block->GetAllocationCount(),
+						  static_cast< unsigned long long >( block->GetLargestFreeRange() ),
+						  ToStringMemUsage( block->GetUsage() ) );
+		}
+
+		std::fprintf( file, "%s]\n\t\t}", blocks.empty() ? "" : "\n\t\t\t" );
+	}
+
+	std::fprintf( file, "%s]\n}\n", stats.empty() ? "" : "\n\t" );
+
+	std::fclose( file );
+
+	return true;
 }
 
 void VulkanAllocator::Print() const
@@ -513,8 +1381,11 @@ void VulkanAllocator::Print() const
 		m_deviceLocalMemoryBytes,
 		m_hostVisibleMemoryBytes );
 
-	for ( const auto &blocks : m_blockChains )
+	for ( uint32_t i = 0; i < VK_MAX_MEMORY_TYPES; ++i )
 	{
+		std::lock_guard< std::mutex > lock( m_chainMutexes[ i ] );
+
+		const auto &blocks = m_blockChains[ i ];
 		if ( blocks.size() == 0 )
 		{
 			continue;
@@ -529,5 +1400,85 @@ void VulkanAllocator::Print() const
 	}
 }
 
+VulkanFrameArena g_frameArena;
+
+VulkanFrameArena::VulkanFrameArena() {}
+
+VulkanFrameArena::~VulkanFrameArena()
+{
+	Shutdown();
+}
+
+void VulkanFrameArena::Init( VkDeviceSize frameSize )
+{
+	auto &device = GetVulkanContext().device;
+
+	Shutdown();
+
+	// Keep every region start aligned for any kind of descriptor offset
+	m_frameSize = Align< VkDeviceSize >( frameSize, 256 );
+
+	VkBufferCreateInfo bufferCI {};
+	bufferCI.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferCI.pNext = nullptr;
+	bufferCI.flags = 0;
+	bufferCI.size  = m_frameSize * SWAPCHAIN_BUFFERING_LEVEL;
+	bufferCI.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+					 VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
+					 VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+	bufferCI.sharingMode		   = VK_SHARING_MODE_EXCLUSIVE;
+	bufferCI.queueFamilyIndexCount = 0;
+	bufferCI.pQueueFamilyIndices   = nullptr;
+	SetConcurrentSharingMode( bufferCI ); // Uniforms of the VFX simulation
+
+	VK_CHECK( vkCreateBuffer( device, &bufferCI, nullptr, &m_buffer ) );
+
+	VkMemoryRequirements memRequirements;
+	vkGetBufferMemoryRequirements( device, m_buffer, &memRequirements );
+
+	m_alloc = g_vulkanAllocator.Alloc( VULKAN_ALLOCATION_TYPE_BUFFER, VULKAN_MEMORY_USAGE_CPU_TO_GPU, memRequirements );
+	CHECK_PRED( m_alloc.data != nullptr );
+
+	VK_CHECK( vkBindBufferMemory( device, m_buffer, m_alloc.deviceMemory, m_alloc.offset ) );
+
+	m_frameId = 0;
+	BeginFrame( 0 );
+}
+
+void VulkanFrameArena::Shutdown()
+{
+	g_vulkanAllocator.FreeBuffer( m_buffer, m_alloc );
+
+	m_frameSize	   = 0;
+	m_regionOffset = 0;
+	m_regionHead   = 0;
+}
+
+void VulkanFrameArena::BeginFrame( uint32_t frameIndex )
+{
+	CHECK_PRED( frameIndex < SWAPCHAIN_BUFFERING_LEVEL );
+
+	m_frameIndex   = frameIndex;
+	m_regionOffset = frameIndex * m_frameSize;
+	m_regionHead   = 0;
+	++m_frameId;
+}
+
+frameAllocation_t VulkanFrameArena::Alloc( VkDeviceSize size, VkDeviceSize alignment )
+{
+	const VkDeviceSize offset = Align( m_regionHead, alignment );
+	CHECK_PRED_MSG( offset + size <= m_frameSize, "Frame arena is full, consider raising FRAME_ARENA_SIZE." );
+
+	m_regionHead = offset + size;
+
+	frameAllocation_t allocation;
+	allocation.buffer = m_buffer;
+	allocation.offset = m_regionOffset + offset;
+	allocation.size	  = size;
+	allocation.data	  = static_cast< byte * >( m_alloc.data ) + allocation.offset;
+
+	return allocation;
+}
+
 } // namespace render
 } // namespace vkRuna
@@ -4,9 +4,12 @@
 
 #include "external/vulkan/vulkan.hpp"
 #include "platform/defines.h"
+#include "renderer/RenderConfig.h"
 
 #include <array>
+#include <atomic>
 #include <cstdint>
+#include <mutex>
 #include <vector>
 
 namespace vkRuna
@@ -42,11 +45,12 @@ class VulkanBlock;
 struct vulkanAllocation_t
 {
 	VulkanBlock *  block		= nullptr;
-	uint32_t	   id			= 0;
+	uint32_t	   node			= UINT32_MAX; // Chunk handle inside block, makes VulkanBlock::Free O(1)
 	VkDeviceMemory deviceMemory = VK_NULL_HANDLE;
 	VkDeviceSize   offset		= 0;
 	VkDeviceSize   size			= 0;
 	void *		   data			= nullptr;
+	uint32_t	   cacheId		= 0; // Thread cache the range was carved for, 0 when allocated from a chain
 };
 
 class VulkanBlock
@@ -67,37 +71,99 @@ class VulkanBlock
 				vulkanAllocation_t &   allocation );
 	void Free( vulkanAllocation_t &allocation );
 
-	bool IsHostVisible() { return m_usage != VULKAN_MEMORY_USAGE_GPU_ONLY; }
+	// Smallest empty block where Alloc succeeds, free lists are searched with rounded up sizes
+	static VkDeviceSize GetMinSize( VkDeviceSize size, VkDeviceSize alignment );
+
+	bool IsHostVisible() const { return m_usage != VULKAN_MEMORY_USAGE_GPU_ONLY; }
 
 	void Print() const;
 
    public:
-	uint32_t	 GetMemoryTypeIndex() { return m_memTypeIndex; }
-	VkDeviceSize GetSize() { return m_size; }
-	VkDeviceSize GetAllocatedSize() { return m_allocated; }
+	uint32_t			GetMemoryTypeIndex() const { return m_memTypeIndex; }
+	vulkanMemoryUsage_t GetUsage() const { return m_usage; }
+	VkDeviceSize		GetSize() const { return m_size; }
+	VkDeviceSize		GetAllocatedSize() const { return m_allocated; }
+	uint32_t			GetAllocationCount() const { return m_allocationCount; }
+	VkDeviceSize		GetLargestFreeRange() const;
 
    private:
+	// Two-level segregated fit (TLSF) free lists. First level splits sizes by power of two,
+	// second level splits each power of two range linearly in TLSF_SL_COUNT lists.
+	static constexpr uint32_t TLSF_SL_LOG2	= 5;
+	static constexpr uint32_t TLSF_SL_COUNT = 1 << TLSF_SL_LOG2;
+	static constexpr uint32_t TLSF_FL_COUNT = 64 - TLSF_SL_LOG2 + 1;
+	static constexpr uint32_t NULL_CHUNK	= UINT32_MAX;
+
 	struct chunk_t
 	{
-		uint32_t			   id;
 		vulkanAllocationType_t type;
 		VkDeviceSize		   size;
 		VkDeviceSize		   offset;
+		uint32_t			   prevPhys; // Physical neighbours in the block
+		uint32_t			   nextPhys;
+		uint32_t			   prevFree; // Free list links, only meaningful when type is FREE
+		uint32_t			   nextFree;
 	};
 
+	static VkDeviceSize RoundUpToList( VkDeviceSize size );
+	static void			MappingInsert( VkDeviceSize size, uint32_t &fl, uint32_t &sl );
+	static void			MappingSearch( VkDeviceSize size, uint32_t &fl, uint32_t &sl );
+
+	uint32_t FindFreeList( uint32_t &fl, uint32_t &sl ) const;
+	void	 InsertFreeChunk( uint32_t chunkId );
+	void	 RemoveFreeChunk( uint32_t chunkId );
+	bool	 FitChunk( const chunk_t &		  chunk,
+					   VkDeviceSize			  size,
+					   VkDeviceSize			  alignment,
+					   VkDeviceSize			  bufferImageGranularity,
+					   vulkanAllocationType_t type,
+					   VkDeviceSize &		  allocOffset ) const;
+
+	uint32_t NewChunk();
+	void	 DeleteChunk( uint32_t chunkId );
+
 	VkDeviceMemory m_deviceMemory = VK_NULL_HANDLE;
 	VkDeviceSize   m_size		  = 0;
 	VkDeviceSize   m_allocated	  = 0;
 
+	uint32_t m_allocationCount = 0;
+
 	uint32_t			m_memTypeIndex = UINT32_MAX;
 	vulkanMemoryUsage_t m_usage		   = VULKAN_MEMORY_USAGE_UNKNOWN;
 
-	std::vector< chunk_t > m_chunks;
-	uint32_t			   m_nextChunkId = 0;
+	std::vector< chunk_t >	m_chunks;	  // Chunk pool, indexed by vulkanAllocation_t::node
+	std::vector< uint32_t > m_freeChunks; // Recycled slots of m_chunks
+	uint32_t				m_firstChunk = NULL_CHUNK;
+
+	uint64_t														   m_flBitmap = 0;
+	std::array< uint32_t, TLSF_FL_COUNT >							   m_slBitmaps {};
+	std::array< std::array< uint32_t, TLSF_SL_COUNT >, TLSF_FL_COUNT > m_freeLists;
 
 	void *m_data = nullptr;
 };
 
+struct memoryTypeStats_t
+{
+	uint32_t	 memoryTypeIndex  = 0;
+	uint32_t	 blockCount		  = 0;
+	uint32_t	 allocationCount  = 0;
+	VkDeviceSize reservedBytes	  = 0; // Sum of the block sizes
+	VkDeviceSize usedBytes		  = 0;
+	VkDeviceSize largestFreeRange = 0;
+	double		 fragmentation	  = 0.0; // 1 - largestFreeRange / free bytes, 0 when free memory is contiguous
+	uint64_t	 totalAllocs	  = 0;
+	uint64_t	 totalFrees		  = 0;
+	double		 allocsPerSecond  = 0.0; // Measured since the previous GetStats call
+	double		 freesPerSecond	  = 0.0;
+};
+
+// Alloc and the Free functions may be called from any thread. Each memory type chain has its own lock, and small
+// buffer allocations are served from per-thread caches of pre-carved ranges. Only releasing deferred frees and
+// trimming lock the cache of another thread, so the owner rarely waits on its lock.
+// Released ranges go back to the cache of the thread that allocated them, up to CACHE_MAX_RANGES per size class.
+// Caches are drained when their thread exits and on Trim. Every CACHE_TRIM_FRAMES frames, the ranges a thread did not
+// take since the previous trim go back to the chains, so that idle caches do not keep blocks alive.
+// Init, Shutdown, BeginFrame, EmptyGarbage and Trim are main thread only.
 class VulkanAllocator
 {
 	NO_COPY_NO_ASSIGN( VulkanAllocator )
@@ -112,23 +178,164 @@ class VulkanAllocator
 	vulkanAllocation_t Alloc( vulkanAllocationType_t type,
 							  vulkanMemoryUsage_t	 usage,
 							  VkMemoryRequirements	 requirements );
-	void			   Free( vulkanAllocation_t &allocation );
-	void			   EmptyGarbage();
+
+	// Frees are deferred: resources are tagged with the current frame and released once that frame has completed on
+	// the GPU. Handles are destroyed along with the memory, the caller's copies are reset.
+	void Free( vulkanAllocation_t &allocation );
+	void FreeBuffer( VkBuffer &buffer, vulkanAllocation_t &allocation );
+	void FreeImage( VkImage &image, VkImageView &view, VkSampler &sampler, vulkanAllocation_t &allocation );
+	void FreeFramebuffer( VkFramebuffer &framebuffer );
+
+	// frameId is the frame being recorded, completedFrameCount the number of frames whose fence has signaled
+	void BeginFrame( uint64_t frameId ) { m_frameId = frameId; }
+	void EmptyGarbage( uint64_t completedFrameCount );
+
+	uint32_t GetGarbageCount( const VulkanBlock *block ) const; // Allocations of block waiting for release
+
+	void Trim() { TrimThreadCaches( false ); } // Gives every cached range back to the chains
+
+	// Defragmentation support. AllocOutsideBlock never creates a block: it places the allocation in the densest
+	// existing block of the chain that can hold it, so that excludedBlock can be drained and released.
+	bool AllocOutsideBlock( vulkanAllocationType_t type,
+							vulkanMemoryUsage_t	   usage,
+							VkMemoryRequirements   requirements,
+							const VulkanBlock *	   excludedBlock,
+							vulkanAllocation_t &   allocation );
+	bool CanEvacuate( const VulkanBlock *block ) const;
+
+	// One entry per memory type that holds blocks or served allocations
+	void GetStats( std::vector< memoryTypeStats_t > &stats );
+	bool DumpStatsJson( const char *path );
 
 	void Print() const;
 
    private:
+	struct threadCache_t;
+
+	// Thread cache size classes, for UBOs and small storage buffers. Powers of two from CACHE_MIN_SIZE to
+	// CACHE_MAX_SIZE are split in 1 << CACHE_CLASS_LOG2 classes, a 257 bytes UBO takes 320 bytes.
+	static constexpr uint32_t	  CACHE_MIN_SIZE_LOG2 = 8;
+	static constexpr uint32_t	  CACHE_MAX_SIZE_LOG2 = 16;
+	static constexpr uint32_t	  CACHE_CLASS_LOG2	  = 2;
+	static constexpr uint32_t	  CACHE_CLASS_COUNT =
+		1 + ( ( CACHE_MAX_SIZE_LOG2 - CACHE_MIN_SIZE_LOG2 ) << CACHE_CLASS_LOG2 );
+	static constexpr VkDeviceSize CACHE_MIN_SIZE	  = VkDeviceSize( 1 ) << CACHE_MIN_SIZE_LOG2;
+	static constexpr VkDeviceSize CACHE_MAX_SIZE	  = VkDeviceSize( 1 ) << CACHE_MAX_SIZE_LOG2;
+	static constexpr uint32_t	  CACHE_REFILL_COUNT  = 16;						 // Ranges carved per refill
+	static constexpr uint32_t	  CACHE_MAX_RANGES	  = 2 * CACHE_REFILL_COUNT; // Per size class
+	static constexpr uint64_t	  CACHE_TRIM_FRAMES	  = 64;
+
+	static uint32_t		GetSizeClass( VkDeviceSize size ); // Smallest class holding size
+	static VkDeviceSize GetClassSize( uint32_t sizeClass );
+
+	int FindMemoryTypeIndex( vulkanMemoryUsage_t usage, uint32_t memoryTypeBits ) const;
+
+	// Chain functions, the chain lock of memoryTypeId must be held
+	vulkanAllocation_t AllocFromChain( uint32_t				  memoryTypeId,
+									   vulkanAllocationType_t type,
+									   vulkanMemoryUsage_t	  usage,
+									   VkDeviceSize			  size,
+									   VkDeviceSize			  alignment );
+	void			   FreeToChain( vulkanAllocation_t &allocation );
+
+	threadCache_t &GetThreadCache();
+	bool		   AllocFromThreadCache( uint32_t			 memoryTypeId,
+										 vulkanMemoryUsage_t usage,
+										 uint32_t			 sizeClass,
+										 vulkanAllocation_t &allocation );
+	bool		   ReturnToThreadCache( const vulkanAllocation_t &allocation );
+	void		   DrainThreadCache( threadCache_t &cache );
+	void		   TrimThreadCaches( bool unusedOnly ); // Only the ranges not taken since the previous trim
+
+   private:
+	struct garbage_t
+	{
+		vulkanAllocation_t allocation;
+		VkBuffer		   buffer	   = VK_NULL_HANDLE;
+		VkImage			   image	   = VK_NULL_HANDLE;
+		VkImageView		   view		   = VK_NULL_HANDLE;
+		VkSampler		   sampler	   = VK_NULL_HANDLE;
+		VkFramebuffer	   framebuffer = VK_NULL_HANDLE;
+		uint64_t		   frameId	   = 0; // Last frame that may reference the resources
+	};
+
+	void PushGarbage( garbage_t &garbage );
+	void ReleaseGarbage( garbage_t &garbage );
+
+	struct allocCounters_t
+	{
+		std::atomic< uint64_t > allocs { 0 };
+		std::atomic< uint64_t > frees { 0 };
+		uint64_t				lastAllocs = 0; // Values at the previous GetStats call
+		uint64_t				lastFrees  = 0;
+	};
+
 	VkDeviceSize m_deviceLocalMemoryBytes = 0;
 	VkDeviceSize m_hostVisibleMemoryBytes = 0;
 
 	std::array< std::vector< VulkanBlock * >, VK_MAX_MEMORY_TYPES > m_blockChains;
+	mutable std::array< std::mutex, VK_MAX_MEMORY_TYPES >			m_chainMutexes;
 
 	VkDeviceSize m_bufferImageGranularity = 0;
 
-	std::vector< vulkanAllocation_t > m_garbage;
+	std::vector< garbage_t > m_garbage;
+	mutable std::mutex		 m_garbageMutex;
+	std::atomic< uint64_t >	 m_frameId { 0 };
+
+	std::vector< threadCache_t * > m_threadCaches;
+	std::mutex					   m_threadCachesMutex;
+	uint32_t					   m_nextCacheId = 1;
+	uint64_t					   m_lastTrimFrame = 0;
+
+	std::array< allocCounters_t, VK_MAX_MEMORY_TYPES > m_counters;
+	int64_t											   m_lastStatsTicks = 0;
 };
 
 extern VulkanAllocator g_vulkanAllocator;
 
+struct frameAllocation_t
+{
+	VkBuffer	 buffer = VK_NULL_HANDLE;
+	VkDeviceSize offset = 0;
+	VkDeviceSize size	= 0;
+	void *		 data	= nullptr;
+};
+
+// Linear allocator for data that only lives for one frame. The arena is one persistently mapped buffer split in
+// SWAPCHAIN_BUFFERING_LEVEL regions. BeginFrame recycles a whole region at once, so it must only be called once the
+// fence of the frame that last used this region has signaled.
+class VulkanFrameArena
+{
+	NO_COPY_NO_ASSIGN( VulkanFrameArena )
+
+   public:
+	VulkanFrameArena();
+	~VulkanFrameArena();
+
+	void Init( VkDeviceSize frameSize );
+	void Shutdown();
+
+	void BeginFrame( uint32_t frameIndex );
+
+	frameAllocation_t Alloc( VkDeviceSize size, VkDeviceSize alignment );
+
+	VkBuffer	 GetHandle() const { return m_buffer; }
+	VkDeviceSize GetFrameSize() const { return m_frameSize; }
+	uint64_t	 GetFrameId() const { return m_frameId; }		// Incremented on each BeginFrame
+	uint32_t	 GetFrameIndex() const { return m_frameIndex; }	// Region of the current frame
+
+   private:
+	VkBuffer		   m_buffer = VK_NULL_HANDLE;
+	vulkanAllocation_t m_alloc;
+
+	VkDeviceSize m_frameSize	= 0;
+	VkDeviceSize m_regionOffset = 0;
+	VkDeviceSize m_regionHead	= 0;
+	uint64_t	 m_frameId		= 0;
+	uint32_t	 m_frameIndex	= 0;
+};
+
+extern VulkanFrameArena g_frameArena;
+
 } // namespace render
 } // namespace vkRuna
\ No newline at end of file
@@ -3,14 +3,17 @@
 #include "renderer/VkBackend.h"
 
 #include "platform/Heap.h"
-#include "platform/Window.h"
+#include "platform/Sys.h"
 #include "renderer/Buffer.h"
+#include "renderer/BufferPool.h"
 #include "renderer/Check.h"
+#include "renderer/Defragmenter.h"
 #include "renderer/GPUMailManager.h"
+#include "renderer/GPUProfiler.h"
 #include "renderer/Image.h"
 #include "renderer/RenderProgs.h"
 #include "renderer/VkUtil.h"
-#include "renderer/uiBackend.h"
+#include "renderer/UiBackend.h"
 
 #include <algorithm>
 #include <array>
@@ -18,6 +21,10 @@
 #include <utility>
 #include <vector>
 
+#ifdef VK_USE_PLATFORM_WIN32_KHR
+	#include "platform/Window.h"
+#endif
+
 namespace vkRuna
 {
 namespace render
@@ -29,30 +36,43 @@ enum renderPassAttachment_t
 	RPA_COUNT
 };
 
-#ifdef RUNA_DEBUG
-static const std::array< const char *, 3 > g_instanceExtensions = { VK_KHR_SURFACE_EXTENSION_NAME,
-																	VK_KHR_WIN32_SURFACE_EXTENSION_NAME,
-																	VK_EXT_DEBUG_REPORT_EXTENSION_NAME };
-#else
-static const std::array< const char *, 2 > g_instanceExtensions = { VK_KHR_SURFACE_EXTENSION_NAME,
-																	VK_KHR_WIN32_SURFACE_EXTENSION_NAME };
-#endif
-
 static const std::array< const char *, 1 > g_validationLayers = {
 	/*"VK_LAYER_LUNARG_standard_validation"*/ "VK_LAYER_KHRONOS_validation"
 };
 
 static const std::array< const char *, 1 > g_deviceExtensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
 
+static_assert( FRAMES_IN_FLIGHT >= 1 && FRAMES_IN_FLIGHT <= SWAPCHAIN_BUFFERING_LEVEL,
+			   "Frames in flight own a swapchain buffering slot." );
+
 static VulkanBackend g_vkInstance;
 
 static vulkanContext_t g_vulkanContext;
 
+static std::array< uint32_t, 2 > g_concurrentFamilyIds = {};
+
 vulkanContext_t &GetVulkanContext()
 {
 	return g_vulkanContext;
 }
 
+bool HasAsyncCompute()
+{
+	return g_vulkanContext.computeFamilyId != g_vulkanContext.graphicsFamilyId;
+}
+
+void SetConcurrentSharingMode( VkBufferCreateInfo &bufferCI )
+{
+	if ( !HasAsyncCompute() )
+	{
+		return;
+	}
+
+	bufferCI.sharingMode		   = VK_SHARING_MODE_CONCURRENT;
+	bufferCI.queueFamilyIndexCount = static_cast< uint32_t >( g_concurrentFamilyIds.size() );
+	bufferCI.pQueueFamilyIndices   = g_concurrentFamilyIds.data();
+}
+
 VulkanBackend::VulkanBackend() {}
 
 VulkanBackend &VulkanBackend::GetInstance()
@@ -60,11 +80,23 @@ VulkanBackend &VulkanBackend::GetInstance()
 	return g_vkInstance;
 }
 
+void VulkanBackend::SetHeadless( uint32_t width, uint32_t height )
+{
+	CHECK_PRED( m_instance == VK_NULL_HANDLE );
+	CHECK_PRED( width > 0 && height > 0 );
+
+	m_headless		  = true;
+	m_swapchainExtent = { width, height };
+}
+
 void VulkanBackend::Init()
 {
 	CreateInstance();
 
-	CreatePresentationSurface();
+	if ( !m_headless )
+	{
+		CreatePresentationSurface();
+	}
 
 	PickPhysicalDevice();
 
@@ -78,7 +110,20 @@ void VulkanBackend::Init()
 
 	g_vulkanAllocator.Init();
 
-	g_gpuMail.Init();
+	g_frameArena.Init( FRAME_ARENA_SIZE );
+
+	g_gpuMail.Init( GPU_MAIL_RING_SIZE );
+
+	g_staticBufferPool.Init( VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+								 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+							 BP_STATIC,
+							 BUFFER_POOL_BLOCK_SIZE );
+	g_perFrameBufferPool.Init( VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+							   BP_PER_FRAME,
+							   BUFFER_POOL_BLOCK_SIZE );
+
+	// Offscreen images are never read back, they stay color attachments
+	g_renderGraph.Init( m_headless ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR );
 
 	CreateSwapChain();
 
@@ -90,27 +135,46 @@ void VulkanBackend::Init()
 
 	g_pipelineManager.Init();
 
-	ImGui_ImplVulkan_InitInfo imgui_init_info {};
-	imgui_init_info.Instance		= m_instance;
-	imgui_init_info.PhysicalDevice	= g_vulkanContext.gpu.device;
-	imgui_init_info.Device			= g_vulkanContext.device;
-	imgui_init_info.QueueFamily		= g_vulkanContext.graphicsFamilyId;
-	imgui_init_info.Queue			= g_vulkanContext.graphicsQueue;
-	imgui_init_info.PipelineCache	= g_pipelineManager.GetPipelineCache();
-	imgui_init_info.DescriptorPool	= g_pipelineManager.GetDescriptorPool();
-	imgui_init_info.Allocator		= nullptr;
-	imgui_init_info.MinImageCount	= SWAPCHAIN_BUFFERING_LEVEL;
-	imgui_init_info.ImageCount		= SWAPCHAIN_BUFFERING_LEVEL;
-	imgui_init_info.CheckVkResultFn = nullptr;
-
-	g_uiBackend.Init( &imgui_init_info, g_vulkanContext.renderPass, m_commandBuffers[ 0 ] );
+	g_gpuProfiler.Init();
+
+	if ( !m_headless )
+	{
+		ImGui_ImplVulkan_InitInfo imgui_init_info {};
+		imgui_init_info.Instance		= m_instance;
+		imgui_init_info.PhysicalDevice	= g_vulkanContext.gpu.device;
+		imgui_init_info.Device			= g_vulkanContext.device;
+		imgui_init_info.QueueFamily		= g_vulkanContext.graphicsFamilyId;
+		imgui_init_info.Queue			= g_vulkanContext.graphicsQueue;
+		imgui_init_info.PipelineCache	= g_pipelineManager.GetPipelineCache();
+		imgui_init_info.DescriptorPool	= g_pipelineManager.GetDescriptorPool();
+		imgui_init_info.Allocator		= nullptr;
+		imgui_init_info.MinImageCount	= SWAPCHAIN_BUFFERING_LEVEL;
+		imgui_init_info.ImageCount		= SWAPCHAIN_BUFFERING_LEVEL;
+		imgui_init_info.CheckVkResultFn = nullptr;
+
+		g_uiBackend.Init( &imgui_init_info, g_vulkanContext.renderPass, m_commandBuffers[ 0 ] );
+	}
 
 	vkResetCommandPool( g_vulkanContext.device, m_commandPool, 0 );
+
+	m_recordingThreads.Init( RECORDING_MAX_THREADS );
+
+	m_statsTicks = sys::GetClockTicks();
 }
 
 void VulkanBackend::Shutdown()
 {
-	g_uiBackend.Shutdown();
+	// Frames in flight still use the resources destroyed below
+	VK_CHECK( vkDeviceWaitIdle( g_vulkanContext.device ) );
+
+	m_recordingThreads.Shutdown();
+
+	if ( !m_headless )
+	{
+		g_uiBackend.Shutdown();
+	}
+
+	g_gpuProfiler.Shutdown();
 
 	g_pipelineManager.Shutdown();
 
@@ -120,10 +184,19 @@ void VulkanBackend::Shutdown()
 
 	DestroyRenderTargets();
 
+	g_renderGraph.Shutdown();
+
 	DestroySwapChain();
 
+	g_perFrameBufferPool.Shutdown();
+	g_staticBufferPool.Shutdown();
+
+	g_bufferDefragmenter.Shutdown();
+
 	g_gpuMail.Shutdown();
 
+	g_frameArena.Shutdown();
+
 	g_vulkanAllocator.Shutdown();
 
 	DestroyCommandBuffers();
@@ -134,7 +207,10 @@ void VulkanBackend::Shutdown()
 
 	DestroyDevice();
 
-	DestroyPresentationSurface();
+	if ( !m_headless )
+	{
+		DestroyPresentationSurface();
+	}
 
 	DestroyInstance();
 }
@@ -149,110 +225,117 @@ void VulkanBackend::ExecuteCommands( int			 preRenderCount,
 		return;
 	}
 
-	for ( int i = 0; i < preRenderCount; ++i )
-	{
-		const gpuCmd_t &cmd = preRenderCmds[ i ];
+	const int64_t startTicks = sys::GetClockTicks();
 
-		switch ( cmd.type )
-		{
-			case CT_COMPUTE:
-			{
-				if ( cmd.pipeline != nullptr )
-				{
-					g_pipelineManager.BindComputePipeline( m_commandBuffers[ m_current ], *cmd.pipeline );
-				}
-				Dispatch( cmd.groupCountDim[ 0 ], cmd.groupCountDim[ 1 ], cmd.groupCountDim[ 2 ] );
-			}
-			break;
+	g_renderGraph.BindBackbuffer( m_swapchainImages[ m_currentSwapChainImage ] );
 
-			case CT_BARRIER:
-			{
-				auto *gpuBarrier = static_cast< gpuBarrier_t * >( cmd.obj );
-				InsertBarriers( *gpuBarrier );
-			}
-			break;
-
-			default: CHECK_PRED( false ) break;
+	// The transient images were repacked, the framebuffers still use the views of the previous ones. Frames in
+	// flight may still render to them, they are released along with those views.
+	if ( m_framebuffersVersion != g_renderGraph.GetTransientsVersion() )
+	{
+		for ( VkFramebuffer &framebuffer : m_framebuffers )
+		{
+			g_vulkanAllocator.FreeFramebuffer( framebuffer );
 		}
+
+		CreateFramebuffers();
 	}
 
-	BeginRenderPass();
+	g_gpuProfiler.BeginFrame( m_current, m_frameCount, preRenderCount, preRenderCmds, renderCmdCount, renderCmds );
 
-	for ( int i = 0; i < renderCmdCount; ++i )
-	{
-		const gpuCmd_t &cmd = renderCmds[ i ];
+	const uint32_t preRenderRangeCount = GetRangeCount( preRenderCount, m_recordingThreadCount );
+	const uint32_t renderRangeCount	   = GetRangeCount( renderCmdCount, m_recordingThreadCount );
 
-		switch ( cmd.type )
-		{
-			case CT_GRAPHIC:
-			{
-				if ( ( cmd.pipeline != nullptr ) )
-				{
-					if ( ( cmd.pipeline->pipeline == VK_NULL_HANDLE ) ||
-						 ( g_vulkanContext.boundGraphicsPipelines[ m_current ] != cmd.pipeline->pipeline ) )
-					{
-						g_pipelineManager.BindGraphicsPipeline( m_commandBuffers[ m_current ], *cmd.pipeline );
-						g_vulkanContext.boundGraphicsPipelines[ m_current ] = cmd.pipeline->pipeline;
-					}
-				}
-				Draw( cmd.drawSurf );
-			}
-			break;
+	// Recording threads only record commands, pipelines are created and their UBOs uploaded beforehand
+	if ( preRenderRangeCount > 1 || renderRangeCount > 1 )
+	{
+		PreparePipelines( preRenderCount, preRenderCmds );
+		PreparePipelines( renderCmdCount, renderCmds );
+	}
 
-			case CT_BARRIER:
-			{
-				auto *gpuBarrier = static_cast< gpuBarrier_t * >( cmd.obj );
-				InsertBarriers( *gpuBarrier );
-			}
-			break;
+	if ( HasAsyncCompute() )
+	{
+		SubmitAsyncCompute( preRenderCount, preRenderCmds, preRenderRangeCount );
+	}
+	else
+	{
+		g_gpuProfiler.ResetQueries( m_commandBuffers[ m_current ], GPL_PRE_RENDER );
+		RecordCmds( m_commandBuffers[ m_current ], preRenderCount, preRenderCmds, preRenderRangeCount, false );
+	}
 
-			case CT_UI:
-			{
-				g_uiBackend.Draw( cmd.obj, m_commandBuffers[ m_current ] );
-			}
-			break;
+	g_gpuProfiler.ResetQueries( m_commandBuffers[ m_current ], GPL_RENDER );
 
-			default: CHECK_PRED( false ) break;
-		}
+	const gpuBarrier_t &renderPassBarrier = g_renderGraph.GetRenderPassBarrier();
+	if ( renderPassBarrier.srcStageMask != 0 )
+	{
+		InsertBarriers( m_commandBuffers[ m_current ], renderPassBarrier );
 	}
 
+	BeginRenderPass( renderRangeCount > 1 ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS
+										  : VK_SUBPASS_CONTENTS_INLINE );
+
+	RecordCmds( m_commandBuffers[ m_current ], renderCmdCount, renderCmds, renderRangeCount, true );
+
 	EndFrame();
+
+	m_recordTicks += sys::GetClockTicks() - startTicks;
 }
 
 void VulkanBackend::Present()
 {
-	// Does not seem to be needed
-	VK_CHECK( vkWaitForFences( g_vulkanContext.device, 1, &m_commandBufferFences[ m_current ], VK_TRUE, UINT64_MAX ) );
-
-	VK_CHECK( vkResetFences( g_vulkanContext.device, 1, &m_commandBufferFences[ m_current ] ) );
-
-	VkResult		 swapchainResult;
-	VkPresentInfoKHR presentInfo {};
-	presentInfo.sType			   = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-	presentInfo.pNext			   = nullptr;
-	presentInfo.waitSemaphoreCount = 1;
-	presentInfo.pWaitSemaphores	   = &m_renderCompleteSemaphores[ m_current ];
-	presentInfo.swapchainCount	   = 1;
-	presentInfo.pSwapchains		   = &m_swapchain;
-	presentInfo.pImageIndices	   = &m_currentSwapChainImage;
-	presentInfo.pResults		   = &swapchainResult;
+	if ( !m_frameSubmitted )
+	{
+		// No image was acquired, the next frame is recorded in the same slot
+		g_frameArena.BeginFrame( m_current );
+		return;
+	}
 
-	vkQueuePresentKHR( g_vulkanContext.presentQueue, &presentInfo );
+	m_frameSubmitted = false;
 
-	switch ( swapchainResult )
+	if ( !m_headless )
 	{
-		case VK_SUCCESS: break;
-		case VK_ERROR_OUT_OF_DATE_KHR:
-		case VK_SUBOPTIMAL_KHR:
+		VkResult		 swapchainResult;
+		VkPresentInfoKHR presentInfo {};
+		presentInfo.sType			   = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+		presentInfo.pNext			   = nullptr;
+		presentInfo.waitSemaphoreCount = 1;
+		presentInfo.pWaitSemaphores	   = &m_renderCompleteSemaphores[ m_current ];
+		presentInfo.swapchainCount	   = 1;
+		presentInfo.pSwapchains		   = &m_swapchain;
+		presentInfo.pImageIndices	   = &m_currentSwapChainImage;
+		presentInfo.pResults		   = &swapchainResult;
+
+		vkQueuePresentKHR( g_vulkanContext.presentQueue, &presentInfo );
+
+		switch ( swapchainResult )
 		{
-			OnWindowSizeChanged();
-			break;
+			case VK_SUCCESS: break;
+			case VK_ERROR_OUT_OF_DATE_KHR:
+			case VK_SUBOPTIMAL_KHR:
+			{
+				OnWindowSizeChanged();
+				break;
+			}
+			default: CHECK_PRED( false );
 		}
-		default: CHECK_PRED( false );
 	}
 
 	m_current = ( m_current + 1 ) % SWAPCHAIN_BUFFERING_LEVEL;
 	++m_frameCount;
+	++m_presentedCount;
+
+	// The CPU only blocks when it is m_framesInFlight frames ahead of the GPU. This also completes the frame that
+	// last used the slot, whose command buffers, descriptor sets and frame arena region are reused from here on.
+	if ( m_frameCount >= m_framesInFlight )
+	{
+		WaitForFrame( m_frameCount - m_framesInFlight );
+	}
+
+	g_frameArena.BeginFrame( m_current );
+	g_vulkanAllocator.BeginFrame( m_frameCount );
+	g_staticBufferPool.BeginFrame( m_frameCount );
+	g_perFrameBufferPool.BeginFrame( m_frameCount );
+	g_pipelineManager.BeginFrame( m_frameCount );
 }
 
 void VulkanBackend::ExecuteComputeCommands( int count, const gpuCmd_t *cmds )
@@ -285,32 +368,150 @@ void VulkanBackend::ExecuteComputeCommands( int count, const gpuCmd_t *cmds )
 	EndComputeFrame();
 }
 
-bool VulkanBackend::StartFrame()
+void VulkanBackend::SetFramesInFlight( uint32_t count )
 {
-	g_gpuMail.Flush();
-	g_vulkanAllocator.EmptyGarbage();
+	m_framesInFlight = std::min< uint32_t >( std::max< uint32_t >( count, 1 ), SWAPCHAIN_BUFFERING_LEVEL );
+}
 
-	VkResult acquireResult = vkAcquireNextImageKHR( g_vulkanContext.device,
-													m_swapchain,
-													UINT64_MAX,
-													m_imageAvailableSemaphores[ m_current ],
-													VK_NULL_HANDLE,
-													&m_currentSwapChainImage );
+void VulkanBackend::SetRecordingThreadCount( uint32_t count )
+{
+	m_recordingThreadCount = std::min< uint32_t >( std::max< uint32_t >( count, 1 ), RECORDING_MAX_THREADS );
+}
 
-	switch ( acquireResult )
+frameStats_t VulkanBackend::GetFrameStats()
+{
+	const int64_t ticks		= sys::GetClockTicks();
+	const double  msPerTick = 1e3 / double( sys::ClockTicksFrequency() );
+
+	frameStats_t stats;
+	stats.framesInFlight = m_framesInFlight;
+	stats.frameCount	 = m_presentedCount;
+
+	if ( m_presentedCount > 0 )
 	{
-		case VK_SUCCESS:
-		case VK_SUBOPTIMAL_KHR: break;
+		stats.cpuFrameMs  = double( ticks - m_statsTicks ) * msPerTick / double( m_presentedCount );
+		stats.fenceWaitMs = double( m_fenceWaitTicks ) * msPerTick / double( m_presentedCount );
+		stats.overlap	  = stats.cpuFrameMs > 0.0 ? 1.0 - stats.fenceWaitMs / stats.cpuFrameMs : 0.0;
+		stats.stallRatio  = double( m_stalledCount ) / double( m_presentedCount );
+		stats.recordMs	  = double( m_recordTicks ) * msPerTick / double( m_presentedCount );
+	}
 
-		case VK_ERROR_OUT_OF_DATE_KHR:
+	if ( m_retiredCount > 0 )
+	{
+		stats.latencyMs		= double( m_latencyTicks ) * msPerTick / double( m_retiredCount );
+		stats.latencyFrames = double( m_latencyFrames ) / double( m_retiredCount );
+	}
+
+	m_statsTicks	 = ticks;
+	m_fenceWaitTicks = 0;
+	m_recordTicks	 = 0;
+	m_latencyTicks	 = 0;
+	m_latencyFrames	 = 0;
+	m_presentedCount = 0;
+	m_stalledCount	 = 0;
+	m_retiredCount	 = 0;
+
+	return stats;
+}
+
+void VulkanBackend::WaitForFrame( uint64_t frameId )
+{
+	PollCompletedFrames();
+
+	if ( frameId < m_completedFrameCount )
+	{
+		return;
+	}
+
+	const int64_t startTicks = sys::GetClockTicks();
+
+	VK_CHECK( vkWaitForFences( g_vulkanContext.device,
+							   1,
+							   &m_commandBufferFences[ frameId % SWAPCHAIN_BUFFERING_LEVEL ],
+							   VK_TRUE,
+							   UINT64_MAX ) );
+
+	const int64_t ticks = sys::GetClockTicks();
+
+	m_fenceWaitTicks += ticks - startTicks;
+	++m_stalledCount;
+
+	while ( m_completedFrameCount <= frameId )
+	{
+		RetireFrame( ticks );
+	}
+}
+
+void VulkanBackend::PollCompletedFrames()
+{
+	const int64_t ticks = sys::GetClockTicks();
+
+	// Frames older than m_frameCount have been submitted, the slot of m_frameCount holds an older fence
+	while ( m_completedFrameCount < m_frameCount )
+	{
+		VkFence fence = m_commandBufferFences[ m_completedFrameCount % SWAPCHAIN_BUFFERING_LEVEL ];
+		if ( vkGetFenceStatus( g_vulkanContext.device, fence ) != VK_SUCCESS )
 		{
-			OnWindowSizeChanged();
-			return false;
+			break;
 		}
-		default:
+
+		RetireFrame( ticks );
+	}
+}
+
+void VulkanBackend::RetireFrame( int64_t ticks )
+{
+	m_latencyTicks += ticks - m_submitTicks[ m_completedFrameCount % SWAPCHAIN_BUFFERING_LEVEL ];
+	m_latencyFrames += m_frameCount - m_completedFrameCount;
+	++m_retiredCount;
+
+	g_gpuProfiler.RetireFrame( m_completedFrameCount );
+
+	++m_completedFrameCount;
+}
+
+bool VulkanBackend::StartFrame()
+{
+	PollCompletedFrames();
+
+	g_bufferDefragmenter.Update( DEFRAG_FRAME_BUDGET_MS, DEFRAG_FRAME_BUDGET_BYTES );
+
+	g_gpuMail.UpdateStreams( GPU_MAIL_STREAM_FRAME_BUDGET );
+	g_gpuMail.Flush();
+	g_vulkanAllocator.EmptyGarbage( m_completedFrameCount );
+	g_staticBufferPool.EmptyGarbage( m_completedFrameCount );
+	g_perFrameBufferPool.EmptyGarbage( m_completedFrameCount );
+	g_pipelineManager.EmptyGarbage( m_completedFrameCount );
+
+	if ( m_headless )
+	{
+		// Each slot owns its offscreen image, the frame that last rendered to it has completed
+		m_currentSwapChainImage = m_current;
+	}
+	else
+	{
+		VkResult acquireResult = vkAcquireNextImageKHR( g_vulkanContext.device,
+														m_swapchain,
+														UINT64_MAX,
+														m_imageAvailableSemaphores[ m_current ],
+														VK_NULL_HANDLE,
+														&m_currentSwapChainImage );
+
+		switch ( acquireResult )
 		{
-			CHECK_PRED( false );
-			return false;
+			case VK_SUCCESS:
+			case VK_SUBOPTIMAL_KHR: break;
+
+			case VK_ERROR_OUT_OF_DATE_KHR:
+			{
+				OnWindowSizeChanged();
+				return false;
+			}
+			default:
+			{
+				CHECK_PRED( false );
+				return false;
+			}
 		}
 	}
 
@@ -320,6 +521,18 @@ bool VulkanBackend::StartFrame()
 	cmdBufferBeginInfo.flags			= VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 	cmdBufferBeginInfo.pInheritanceInfo = nullptr;
 
+	// Begin resets the command buffer of the slot, the frame that last used it has completed
+	VK_CHECK( vkBeginCommandBuffer( m_commandBuffers[ m_current ], &cmdBufferBeginInfo ) );
+
+	g_gpuProfiler.CollectTracyZones( m_commandBuffers[ m_current ], GPL_RENDER );
+
+	SetDynamicState( m_commandBuffers[ m_current ] );
+
+	return true;
+}
+
+void VulkanBackend::SetDynamicState( VkCommandBuffer cmdBuffer )
+{
 	VkViewport viewport {};
 	viewport.x		  = 0.0f;
 	viewport.y		  = 0.0f;
@@ -333,29 +546,261 @@ bool VulkanBackend::StartFrame()
 	scissor.offset.y = 0;
 	scissor.extent	 = m_swapchainExtent;
 
-	VK_CHECK( vkResetCommandPool(
-		g_vulkanContext.device,
-		m_commandPool,
-		0 ) ); // Careful with that call, no command buffer should be in use. Wait this call goes against the fact that
-			   // there is an array of command buffers so that multiple buffers can be in flight !
+	vkCmdSetViewport( cmdBuffer, 0, 1, &viewport );
 
-	VK_CHECK( vkBeginCommandBuffer( m_commandBuffers[ m_current ], &cmdBufferBeginInfo ) );
+	vkCmdSetScissor( cmdBuffer, 0, 1, &scissor );
 
-	vkCmdSetViewport( m_commandBuffers[ m_current ], 0, 1, &viewport );
+	if ( g_vulkanContext.gpu.features.depthBounds )
+	{
+		vkCmdSetDepthBounds( cmdBuffer, 0.0f, 1.0f );
+	}
+}
 
-	vkCmdSetScissor( m_commandBuffers[ m_current ], 0, 1, &scissor );
+uint32_t VulkanBackend::GetRangeCount( int cmdCount, uint32_t threadCount ) const
+{
+	const uint32_t maxRangeCount = static_cast< uint32_t >( std::max( cmdCount / RECORDING_MIN_RANGE_SIZE, 1 ) );
 
-	if ( g_vulkanContext.gpu.features.depthBounds )
+	return std::min( threadCount, maxRangeCount );
+}
+
+void VulkanBackend::PreparePipelines( int count, const gpuCmd_t *cmds )
+{
+	for ( int i = 0; i < count; ++i )
+	{
+		const gpuCmd_t &cmd = cmds[ i ];
+		if ( cmd.pipeline == nullptr )
+		{
+			continue;
+		}
+
+		if ( cmd.type == CT_GRAPHIC )
+		{
+			g_pipelineManager.PrepareGraphicsPipeline( *cmd.pipeline );
+		}
+		else if ( cmd.type == CT_COMPUTE )
+		{
+			g_pipelineManager.PrepareComputePipeline( *cmd.pipeline );
+		}
+	}
+}
+
+void VulkanBackend::RecordCmds( VkCommandBuffer cmdBuffer,
+								int				count,
+								const gpuCmd_t *cmds,
+								uint32_t		rangeCount,
+								bool			renderPass )
+{
+	if ( rangeCount <= 1 )
+	{
+		if ( renderPass )
+		{
+			RecordRenderRange( cmdBuffer, cmds, 0, count, true );
+		}
+		else
+		{
+			RecordPreRenderRange( cmdBuffer, cmds, 0, count, true );
+		}
+		return;
+	}
+
+	VkCommandBufferInheritanceInfo inheritanceInfo {};
+	inheritanceInfo.sType				 = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+	inheritanceInfo.pNext				 = nullptr;
+	inheritanceInfo.renderPass			 = renderPass ? g_vulkanContext.renderPass : VK_NULL_HANDLE;
+	inheritanceInfo.subpass				 = 0;
+	inheritanceInfo.framebuffer			 = renderPass ? m_framebuffers[ m_currentSwapChainImage ] : VK_NULL_HANDLE;
+	inheritanceInfo.occlusionQueryEnable = VK_FALSE;
+	inheritanceInfo.queryFlags			 = 0;
+	inheritanceInfo.pipelineStatistics	 = 0;
+
+	VkCommandBufferBeginInfo cmdBufferBeginInfo {};
+	cmdBufferBeginInfo.sType			= VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	cmdBufferBeginInfo.pNext			= nullptr;
+	cmdBufferBeginInfo.flags			= VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	cmdBufferBeginInfo.pInheritanceInfo = &inheritanceInfo;
+	if ( renderPass )
 	{
-		vkCmdSetDepthBounds( m_commandBuffers[ m_current ], 0.0f, 1.0f );
+		cmdBufferBeginInfo.flags |= VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
 	}
 
-	// pipeline barrier for acquired swap chain image ?
+	std::array< VkCommandBuffer, RECORDING_MAX_THREADS > secondaryCmdBuffers {};
 
-	return true;
+	// Ranges are contiguous, executing their command buffers in order keeps the order of the list
+	m_recordingThreads.ParallelFor( rangeCount, rangeCount, [ & ]( uint32_t range, uint32_t ) {
+		const int begin = static_cast< int >( int64_t( count ) * range / rangeCount );
+		const int end	= static_cast< int >( int64_t( count ) * ( range + 1 ) / rangeCount );
+
+		recordingContext_t &context	  = m_recordingContexts[ m_current ][ range ];
+		VkCommandPool		pool	  = renderPass ? context.renderCommandPool : context.preRenderCommandPool;
+		VkCommandBuffer		secondary = renderPass ? context.renderCmdBuffer : context.preRenderCmdBuffer;
+
+		// The frame that last used the slot has completed
+		VK_CHECK( vkResetCommandPool( g_vulkanContext.device, pool, 0 ) );
+		VK_CHECK( vkBeginCommandBuffer( secondary, &cmdBufferBeginInfo ) );
+
+		if ( renderPass )
+		{
+			SetDynamicState( secondary );
+			RecordRenderRange( secondary, cmds, begin, end, false );
+		}
+		else
+		{
+			RecordPreRenderRange( secondary, cmds, begin, end, false );
+		}
+
+		VK_CHECK( vkEndCommandBuffer( secondary ) );
+
+		secondaryCmdBuffers[ range ] = secondary;
+	} );
+
+	vkCmdExecuteCommands( cmdBuffer, rangeCount, secondaryCmdBuffers.data() );
 }
 
-void VulkanBackend::BeginRenderPass()
+// Commands without a pipeline reuse the last one bound in their list, which may have been recorded in another range
+static pipelineProg_t *FindBoundPipeline( const gpuCmd_t *cmds, int index, gpuCmdType_t type )
+{
+	for ( int i = index - 1; i >= 0; --i )
+	{
+		if ( cmds[ i ].type == type && cmds[ i ].pipeline != nullptr )
+		{
+			return cmds[ i ].pipeline;
+		}
+	}
+
+	return nullptr;
+}
+
+void VulkanBackend::RecordPreRenderRange( VkCommandBuffer cmdBuffer,
+										  const gpuCmd_t *cmds,
+										  int			  begin,
+										  int			  end,
+										  bool			  tracyZones )
+{
+	bool pipelineBound = false;
+
+	for ( int i = begin; i < end; ++i )
+	{
+		const gpuCmd_t &cmd = cmds[ i ];
+
+		switch ( cmd.type )
+		{
+			case CT_COMPUTE:
+			{
+				RUNA_PROFILE_GPU_ZONE( g_gpuProfiler.GetTracyContext( GPL_PRE_RENDER ),
+									   cmdBuffer,
+									   GPUProfiler::GetZoneName( cmd ),
+									   tracyZones );
+				g_gpuProfiler.BeginZone( cmdBuffer, GPL_PRE_RENDER, i );
+
+				pipelineProg_t *pipeline = cmd.pipeline;
+				if ( pipeline == nullptr && !pipelineBound )
+				{
+					pipeline = FindBoundPipeline( cmds, i, CT_COMPUTE );
+				}
+
+				if ( pipeline != nullptr )
+				{
+					g_pipelineManager.BindComputePipeline( cmdBuffer, *pipeline );
+					pipelineBound = true;
+				}
+				Dispatch( cmdBuffer, cmd.groupCountDim[ 0 ], cmd.groupCountDim[ 1 ], cmd.groupCountDim[ 2 ] );
+
+				g_gpuProfiler.EndZone( cmdBuffer, GPL_PRE_RENDER, i );
+			}
+			break;
+
+			case CT_BARRIER:
+			{
+				auto *gpuBarrier = static_cast< gpuBarrier_t * >( cmd.obj );
+				InsertBarriers( cmdBuffer, *gpuBarrier );
+			}
+			break;
+
+			case CT_COPY:
+			{
+				auto *copy = static_cast< gpuBufferCopy_t * >( cmd.obj );
+
+				VkBufferCopy region {};
+				region.srcOffset = copy->srcOffset;
+				region.dstOffset = copy->dstOffset;
+				region.size		 = copy->size;
+				vkCmdCopyBuffer( cmdBuffer, copy->srcBuffer->GetHandle(), copy->dstBuffer->GetHandle(), 1, &region );
+			}
+			break;
+
+			default: CHECK_PRED( false ) break;
+		}
+	}
+}
+
+void VulkanBackend::RecordRenderRange( VkCommandBuffer cmdBuffer,
+									   const gpuCmd_t *cmds,
+									   int			   begin,
+									   int			   end,
+									   bool			   tracyZones )
+{
+	VkPipeline boundPipeline = VK_NULL_HANDLE;
+
+	for ( int i = begin; i < end; ++i )
+	{
+		const gpuCmd_t &cmd = cmds[ i ];
+
+		switch ( cmd.type )
+		{
+			case CT_GRAPHIC:
+			{
+				RUNA_PROFILE_GPU_ZONE( g_gpuProfiler.GetTracyContext( GPL_RENDER ),
+									   cmdBuffer,
+									   GPUProfiler::GetZoneName( cmd ),
+									   tracyZones );
+				g_gpuProfiler.BeginZone( cmdBuffer, GPL_RENDER, i );
+
+				pipelineProg_t *pipeline = cmd.pipeline;
+				if ( pipeline == nullptr && boundPipeline == VK_NULL_HANDLE )
+				{
+					pipeline = FindBoundPipeline( cmds, i, CT_GRAPHIC );
+				}
+
+				if ( ( pipeline != nullptr ) )
+				{
+					if ( ( pipeline->pipeline == VK_NULL_HANDLE ) || ( boundPipeline != pipeline->pipeline ) )
+					{
+						g_pipelineManager.BindGraphicsPipeline( cmdBuffer, *pipeline );
+						boundPipeline = pipeline->pipeline;
+					}
+				}
+				Draw( cmdBuffer, cmd.drawSurf );
+
+				g_gpuProfiler.EndZone( cmdBuffer, GPL_RENDER, i );
+			}
+			break;
+
+			case CT_BARRIER:
+			{
+				auto *gpuBarrier = static_cast< gpuBarrier_t * >( cmd.obj );
+				InsertBarriers( cmdBuffer, *gpuBarrier );
+			}
+			break;
+
+			case CT_UI:
+			{
+				RUNA_PROFILE_GPU_ZONE( g_gpuProfiler.GetTracyContext( GPL_RENDER ),
+									   cmdBuffer,
+									   GPUProfiler::GetZoneName( cmd ),
+									   tracyZones );
+				g_gpuProfiler.BeginZone( cmdBuffer, GPL_RENDER, i );
+				g_uiBackend.Draw( cmd.obj, cmdBuffer );
+				g_gpuProfiler.EndZone( cmdBuffer, GPL_RENDER, i );
+				boundPipeline = VK_NULL_HANDLE; // The UI binds its own pipeline
+			}
+			break;
+
+			default: CHECK_PRED( false ) break;
+		}
+	}
+}
+
+void VulkanBackend::BeginRenderPass( VkSubpassContents contents )
 {
 	std::array< VkClearValue, RPA_COUNT > clearValues {};
 
@@ -373,14 +818,14 @@ void VulkanBackend::BeginRenderPass()
 	renderPassBeginCI.sType				= VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
 	renderPassBeginCI.pNext				= nullptr;
 	renderPassBeginCI.renderPass		= g_vulkanContext.renderPass;
-	renderPassBeginCI.framebuffer		= m_framebuffers[ m_current ];
+	renderPassBeginCI.framebuffer		= m_framebuffers[ m_currentSwapChainImage ];
 	renderPassBeginCI.renderArea.extent = m_swapchainExtent;
 	renderPassBeginCI.clearValueCount	= static_cast< uint32_t >( clearValues.size() );
 	renderPassBeginCI.pClearValues		= clearValues.data();
-	vkCmdBeginRenderPass( m_commandBuffers[ m_current ], &renderPassBeginCI, VK_SUBPASS_CONTENTS_INLINE );
+	vkCmdBeginRenderPass( m_commandBuffers[ m_current ], &renderPassBeginCI, contents );
 }
 
-void VulkanBackend::Draw( const drawSurf_t &surf )
+void VulkanBackend::Draw( VkCommandBuffer cmdBuffer, const drawSurf_t &surf )
 {
 	if ( !surf.vertexBuffer && !surf.indexBuffer )
 	{
@@ -390,30 +835,22 @@ void VulkanBackend::Draw( const drawSurf_t &surf )
 	if ( surf.vertexBuffer )
 	{
 		VkBuffer vertexBuffer = surf.vertexBuffer->GetHandle();
-		vkCmdBindVertexBuffers( m_commandBuffers[ m_current ], 0, 1, &vertexBuffer, &surf.vertexBufferOffset );
+		vkCmdBindVertexBuffers( cmdBuffer, 0, 1, &vertexBuffer, &surf.vertexBufferOffset );
 	}
 
 	if ( surf.indexBuffer )
 	{
 		VkBuffer indexBuffer = surf.indexBuffer->GetHandle();
-		vkCmdBindIndexBuffer( m_commandBuffers[ m_current ],
-							  indexBuffer,
-							  surf.indexBufferOffset,
-							  VK_INDEX_TYPE_UINT16 );
+		vkCmdBindIndexBuffer( cmdBuffer, indexBuffer, surf.indexBufferOffset, VK_INDEX_TYPE_UINT16 );
 
-		vkCmdDrawIndexed( m_commandBuffers[ m_current ], surf.indexCount, surf.instanceCount, 0, 0, 0 );
+		vkCmdDrawIndexed( cmdBuffer, surf.indexCount, surf.instanceCount, 0, 0, 0 );
 	}
 	else
 	{
-		vkCmdDraw( m_commandBuffers[ m_current ], surf.vertexCount, surf.instanceCount, 0, 0 );
+		vkCmdDraw( cmdBuffer, surf.vertexCount, surf.instanceCount, 0, 0 );
 	}
 }
 
-void VulkanBackend::Dispatch( uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ )
-{
-	vkCmdDispatch( m_commandBuffers[ m_current ], groupCountX, groupCountY, groupCountZ );
-}
-
 void VulkanBackend::Dispatch( VkCommandBuffer cmdBuffer,
 							  uint32_t		  groupCountX,
 							  uint32_t		  groupCountY,
@@ -437,7 +874,7 @@ void VulkanBackend::EndComputeFrame()
 	submitInfo.signalSemaphoreCount = 0;
 	submitInfo.pSignalSemaphores	= nullptr;
 
-	vkQueueSubmit( g_vulkanContext.graphicsQueue, 1, &submitInfo, m_computeCommandBufferFences[ m_computeCurrent ] );
+	vkQueueSubmit( g_vulkanContext.computeQueue, 1, &submitInfo, m_computeCommandBufferFences[ m_computeCurrent ] );
 
 	VK_CHECK( vkWaitForFences( g_vulkanContext.device,
 							   1,
@@ -451,9 +888,9 @@ void VulkanBackend::EndComputeFrame()
 	++m_computeFrameCount;
 }
 
-void VulkanBackend::InsertBarriers( const gpuBarrier_t &gpuBarrier )
+void VulkanBackend::InsertBarriers( VkCommandBuffer cmdBuffer, const gpuBarrier_t &gpuBarrier )
 {
-	vkCmdPipelineBarrier( m_commandBuffers[ m_current ],
+	vkCmdPipelineBarrier( cmdBuffer,
 						  gpuBarrier.srcStageMask,
 						  gpuBarrier.dstStageMask,
 						  gpuBarrier.dependencyFlags,
@@ -469,66 +906,104 @@ void VulkanBackend::EndFrame()
 {
 	vkCmdEndRenderPass( m_commandBuffers[ m_current ] );
 
-	if ( g_vulkanContext.presentFamilyId != g_vulkanContext.graphicsFamilyId )
-	{
-		VkImageMemoryBarrier barrier {};
-		barrier.sType							= VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-		barrier.pNext							= nullptr;
-		barrier.srcAccessMask					= VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-		barrier.dstAccessMask					= VK_ACCESS_MEMORY_READ_BIT;
-		barrier.oldLayout						= VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-		barrier.newLayout						= VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-		barrier.srcQueueFamilyIndex				= g_vulkanContext.graphicsFamilyId;
-		barrier.dstQueueFamilyIndex				= g_vulkanContext.presentFamilyId;
-		barrier.image							= m_swapchainImages[ m_currentSwapChainImage ];
-		barrier.subresourceRange.aspectMask		= VK_IMAGE_ASPECT_COLOR_BIT;
-		barrier.subresourceRange.baseMipLevel	= 0;
-		barrier.subresourceRange.levelCount		= 1;
-		barrier.subresourceRange.baseArrayLayer = 0;
-		barrier.subresourceRange.layerCount		= 1;
-
-		vkCmdPipelineBarrier( m_commandBuffers[ m_current ],
-							  VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-							  VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
-							  0,
-							  0,
-							  nullptr,
-							  0,
-							  nullptr,
-							  0,
-							  nullptr );
+	// The swapchain is shared concurrently when the present family differs, only its layout changes
+	const gpuBarrier_t &postRenderBarrier = g_renderGraph.GetPostRenderBarrier();
+	if ( postRenderBarrier.srcStageMask != 0 )
+	{
+		InsertBarriers( m_commandBuffers[ m_current ], postRenderBarrier );
 	}
 
 	VK_CHECK( vkEndCommandBuffer( m_commandBuffers[ m_current ] ) );
 
-	const VkPipelineStageFlags pipelineStageFlags = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	// VFX draws read the attributes written by the async compute submission of the frame
+	const std::array< VkSemaphore, 2 > waitSemaphores = { m_imageAvailableSemaphores[ m_current ],
+														  m_computeCompleteSemaphores[ m_current ] };
+
+	const std::array< VkPipelineStageFlags, 2 > pipelineStageFlags = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+																	   VK_PIPELINE_STAGE_VERTEX_SHADER_BIT };
+
+	// Offscreen images are neither acquired nor presented
+	const uint32_t firstWait = m_headless ? 1 : 0;
 
 	VkSubmitInfo submitInfo {};
 	submitInfo.sType				= VK_STRUCTURE_TYPE_SUBMIT_INFO;
 	submitInfo.pNext				= nullptr;
-	submitInfo.waitSemaphoreCount	= 1;
-	submitInfo.pWaitSemaphores		= &m_imageAvailableSemaphores[ m_current ];
-	submitInfo.pWaitDstStageMask	= &pipelineStageFlags;
+	submitInfo.waitSemaphoreCount	= ( HasAsyncCompute() ? 2 : 1 ) - firstWait;
+	submitInfo.pWaitSemaphores		= waitSemaphores.data() + firstWait;
+	submitInfo.pWaitDstStageMask	= pipelineStageFlags.data() + firstWait;
 	submitInfo.commandBufferCount	= 1;
 	submitInfo.pCommandBuffers		= &m_commandBuffers[ m_current ];
-	submitInfo.signalSemaphoreCount = 1;
+	submitInfo.signalSemaphoreCount = m_headless ? 0 : 1;
 	submitInfo.pSignalSemaphores	= &m_renderCompleteSemaphores[ m_current ];
 
+	// Fences are created signaled and only reset here, once the previous frame of the slot has been waited on
+	VK_CHECK( vkResetFences( g_vulkanContext.device, 1, &m_commandBufferFences[ m_current ] ) );
+
 	VK_CHECK( vkQueueSubmit( g_vulkanContext.graphicsQueue, 1, &submitInfo, m_commandBufferFences[ m_current ] ) );
 
-	g_vulkanContext.boundGraphicsPipelines[ m_current ] = VK_NULL_HANDLE;
+	m_submitTicks[ m_current ] = sys::GetClockTicks();
+	m_frameSubmitted		   = true;
 }
 
-void VulkanBackend::StartComputeFrame()
+void VulkanBackend::SubmitAsyncCompute( int count, const gpuCmd_t *cmds, uint32_t rangeCount )
 {
+	VkCommandBuffer cmdBuffer = m_asyncComputeCommandBuffers[ m_current ];
+
 	VkCommandBufferBeginInfo cmdBufferBeginInfo {};
 	cmdBufferBeginInfo.sType			= VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
 	cmdBufferBeginInfo.pNext			= nullptr;
 	cmdBufferBeginInfo.flags			= VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 	cmdBufferBeginInfo.pInheritanceInfo = nullptr;
 
-	VK_CHECK( vkResetCommandPool( g_vulkanContext.device, m_commandPool, 0 ) );
+	// The fence of the frame that last used this command buffer has been waited on
+	VK_CHECK( vkBeginCommandBuffer( cmdBuffer, &cmdBufferBeginInfo ) );
+
+	g_gpuProfiler.CollectTracyZones( cmdBuffer, GPL_PRE_RENDER );
+	g_gpuProfiler.ResetQueries( cmdBuffer, GPL_PRE_RENDER );
+
+	RecordCmds( cmdBuffer, count, cmds, rangeCount, false );
+
+	VK_CHECK( vkEndCommandBuffer( cmdBuffer ) );
+
+	// GPU mails fill and upload buffers on the graphics queue, which does not order them with this queue
+	const uint64_t			   mailValue	 = g_gpuMail.GetTimelineValue();
+	const VkSemaphore		   mailTimeline	 = g_gpuMail.GetTimeline();
+	const VkPipelineStageFlags waitStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+	const bool				   waitMail		 = mailValue > m_computeMailValue;
+
+	VkTimelineSemaphoreSubmitInfo timelineInfo {};
+	timelineInfo.sType					   = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+	timelineInfo.pNext					   = nullptr;
+	timelineInfo.waitSemaphoreValueCount   = 1;
+	timelineInfo.pWaitSemaphoreValues	   = &mailValue;
+	timelineInfo.signalSemaphoreValueCount = 0;
+	timelineInfo.pSignalSemaphoreValues	   = nullptr;
 
+	VkSubmitInfo submitInfo {};
+	submitInfo.sType				= VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.pNext				= waitMail ? &timelineInfo : nullptr;
+	submitInfo.waitSemaphoreCount	= waitMail ? 1 : 0;
+	submitInfo.pWaitSemaphores		= &mailTimeline;
+	submitInfo.pWaitDstStageMask	= &waitStageMask;
+	submitInfo.commandBufferCount	= 1;
+	submitInfo.pCommandBuffers		= &cmdBuffer;
+	submitInfo.signalSemaphoreCount = 1;
+	submitInfo.pSignalSemaphores	= &m_computeCompleteSemaphores[ m_current ];
+
+	VK_CHECK( vkQueueSubmit( g_vulkanContext.computeQueue, 1, &submitInfo, VK_NULL_HANDLE ) );
+
+	m_computeMailValue = mailValue;
+}
+
+void VulkanBackend::StartComputeFrame()
+{
+	VkCommandBufferBeginInfo cmdBufferBeginInfo {};
+	cmdBufferBeginInfo.sType			= VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	cmdBufferBeginInfo.pNext			= nullptr;
+	cmdBufferBeginInfo.flags			= VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	cmdBufferBeginInfo.pInheritanceInfo = nullptr;
+
+	// Begin resets the command buffer, the compute command pool is never reset as a whole
 	VK_CHECK( vkBeginCommandBuffer( m_computeCommandBuffers[ m_computeCurrent ], &cmdBufferBeginInfo ) );
 }
 
@@ -557,9 +1032,22 @@ void VulkanBackend::CreateInstance()
 	vkinstanceCI.ppEnabledLayerNames = nullptr;
 #endif
 
-	CHECK_PRED( CheckExtensionsInstanceLevel( g_instanceExtensions.data(), g_instanceExtensions.size() ) );
-	vkinstanceCI.enabledExtensionCount	 = static_cast< uint32_t >( g_instanceExtensions.size() );
-	vkinstanceCI.ppEnabledExtensionNames = g_instanceExtensions.data();
+	// Headless instances have no surface to create
+	std::vector< const char * > extensions;
+	if ( !m_headless )
+	{
+		extensions.emplace_back( VK_KHR_SURFACE_EXTENSION_NAME );
+#ifdef VK_USE_PLATFORM_WIN32_KHR
+		extensions.emplace_back( VK_KHR_WIN32_SURFACE_EXTENSION_NAME );
+#endif
+	}
+#ifdef RUNA_DEBUG
+	extensions.emplace_back( VK_EXT_DEBUG_REPORT_EXTENSION_NAME );
+#endif
+
+	CHECK_PRED( CheckExtensionsInstanceLevel( extensions.data(), extensions.size() ) );
+	vkinstanceCI.enabledExtensionCount	 = static_cast< uint32_t >( extensions.size() );
+	vkinstanceCI.ppEnabledExtensionNames = extensions.data();
 
 	VK_CHECK( vkCreateInstance( &vkinstanceCI, nullptr, &m_instance ) );
 }
@@ -572,6 +1060,7 @@ void VulkanBackend::DestroyInstance()
 
 void VulkanBackend::CreatePresentationSurface()
 {
+#ifdef VK_USE_PLATFORM_WIN32_KHR
 	auto &win = Window::GetInstance();
 
 	VkWin32SurfaceCreateInfoKHR surfaceCreateInfo {};
@@ -582,6 +1071,9 @@ void VulkanBackend::CreatePresentationSurface()
 	surfaceCreateInfo.hwnd		= win.GetHWND();
 
 	VK_CHECK( vkCreateWin32SurfaceKHR( m_instance, &surfaceCreateInfo, nullptr, &m_presentationSurface ) );
+#else
+	sys::FatalError( "No presentation surface on this platform, the backend must be headless." );
+#endif
 }
 
 void VulkanBackend::DestroyPresentationSurface()
@@ -614,6 +1106,52 @@ static bool CheckExtensions( size_t										 numExtensions,
 	return true;
 }
 
+// Prefers a transfer only family (DMA engine), images are uploaded at any texel offset so the family must not have a
+// coarser transfer granularity
+static uint32_t FindTransferQueueFamily( const GPUInfo_t &gpu, uint32_t graphicsFamilyId )
+{
+	for ( uint32_t i = 0; i < gpu.queueFamiliesProps.size(); ++i )
+	{
+		const auto &props = gpu.queueFamiliesProps[ i ];
+
+		if ( props.queueCount == 0 || ( props.queueFlags & VK_QUEUE_TRANSFER_BIT ) == 0 ||
+			 ( props.queueFlags & ( VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT ) ) != 0 )
+		{
+			continue;
+		}
+
+		const VkExtent3D &granularity = props.minImageTransferGranularity;
+		if ( granularity.width == 1 && granularity.height == 1 && granularity.depth == 1 )
+		{
+			return i;
+		}
+	}
+
+	return graphicsFamilyId;
+}
+
+// Prefers a compute only family, whose queue runs alongside the graphics queue
+static uint32_t FindComputeQueueFamily( const GPUInfo_t &gpu, uint32_t graphicsFamilyId )
+{
+	if ( !VFX_ASYNC_COMPUTE )
+	{
+		return graphicsFamilyId;
+	}
+
+	for ( uint32_t i = 0; i < gpu.queueFamiliesProps.size(); ++i )
+	{
+		const auto &props = gpu.queueFamiliesProps[ i ];
+
+		if ( props.queueCount > 0 && ( props.queueFlags & VK_QUEUE_COMPUTE_BIT ) != 0 &&
+			 ( props.queueFlags & VK_QUEUE_GRAPHICS_BIT ) == 0 )
+		{
+			return i;
+		}
+	}
+
+	return graphicsFamilyId;
+}
+
 void VulkanBackend::PickPhysicalDevice()
 {
 	uint32_t numPhysicalDevices = 0;
@@ -649,30 +1187,35 @@ void VulkanBackend::PickPhysicalDevice()
 															gpu.extensionsProps.data() ) );
 		}
 
-		VK_CHECK( vkGetPhysicalDeviceSurfaceCapabilitiesKHR( gpu.device, m_presentationSurface, &gpu.surfaceCaps ) );
-		{
-			uint32_t numFormats = 0;
-			VK_CHECK_PRED(
-				vkGetPhysicalDeviceSurfaceFormatsKHR( gpu.device, m_presentationSurface, &numFormats, nullptr ),
-				numFormats > 0 );
-
-			gpu.surfaceFormats.resize( numFormats );
-			VK_CHECK( vkGetPhysicalDeviceSurfaceFormatsKHR( gpu.device,
-															m_presentationSurface,
-															&numFormats,
-															gpu.surfaceFormats.data() ) );
-		}
+		// Headless devices never present
+		if ( !m_headless )
 		{
-			uint32_t numModes = 0;
-			VK_CHECK_PRED(
-				vkGetPhysicalDeviceSurfacePresentModesKHR( gpu.device, m_presentationSurface, &numModes, nullptr ),
-				numModes != 0 );
-
-			gpu.presentModes.resize( numModes );
-			VK_CHECK( vkGetPhysicalDeviceSurfacePresentModesKHR( gpu.device,
-																 m_presentationSurface,
-																 &numModes,
-																 gpu.presentModes.data() ) );
+			VK_CHECK(
+				vkGetPhysicalDeviceSurfaceCapabilitiesKHR( gpu.device, m_presentationSurface, &gpu.surfaceCaps ) );
+			{
+				uint32_t numFormats = 0;
+				VK_CHECK_PRED(
+					vkGetPhysicalDeviceSurfaceFormatsKHR( gpu.device, m_presentationSurface, &numFormats, nullptr ),
+					numFormats > 0 );
+
+				gpu.surfaceFormats.resize( numFormats );
+				VK_CHECK( vkGetPhysicalDeviceSurfaceFormatsKHR( gpu.device,
+																m_presentationSurface,
+																&numFormats,
+																gpu.surfaceFormats.data() ) );
+			}
+			{
+				uint32_t numModes = 0;
+				VK_CHECK_PRED(
+					vkGetPhysicalDeviceSurfacePresentModesKHR( gpu.device, m_presentationSurface, &numModes, nullptr ),
+					numModes != 0 );
+
+				gpu.presentModes.resize( numModes );
+				VK_CHECK( vkGetPhysicalDeviceSurfacePresentModesKHR( gpu.device,
+																	 m_presentationSurface,
+																	 &numModes,
+																	 gpu.presentModes.data() ) );
+			}
 		}
 
 		{
@@ -689,18 +1232,21 @@ void VulkanBackend::PickPhysicalDevice()
 
 	for ( auto &gpu : gpus )
 	{
-		if ( !CheckExtensions( g_deviceExtensions.size(), g_deviceExtensions.data(), gpu.extensionsProps ) )
+		if ( !m_headless )
 		{
-			continue;
-		}
+			if ( !CheckExtensions( g_deviceExtensions.size(), g_deviceExtensions.data(), gpu.extensionsProps ) )
+			{
+				continue;
+			}
 
-		if ( gpu.surfaceFormats.size() == 0 )
-		{
-			continue;
-		}
-		if ( gpu.presentModes.size() == 0 )
-		{
-			continue;
+			if ( gpu.surfaceFormats.size() == 0 )
+			{
+				continue;
+			}
+			if ( gpu.presentModes.size() == 0 )
+			{
+				continue;
+			}
 		}
 
 		int graphicsQueueId = -1;
@@ -722,7 +1268,15 @@ void VulkanBackend::PickPhysicalDevice()
 			}
 
 			VkBool32 supportPresent = VK_FALSE;
-			vkGetPhysicalDeviceSurfaceSupportKHR( gpu.device, i, m_presentationSurface, &supportPresent );
+			if ( m_headless )
+			{
+				// Nothing is presented, the graphics family stands in for the present family
+				supportPresent = graphicsQueueId == i;
+			}
+			else
+			{
+				vkGetPhysicalDeviceSurfaceSupportKHR( gpu.device, i, m_presentationSurface, &supportPresent );
+			}
 			if ( supportPresent )
 			{
 				presentQueueId = i;
@@ -738,6 +1292,8 @@ void VulkanBackend::PickPhysicalDevice()
 		{
 			g_vulkanContext.graphicsFamilyId = graphicsQueueId;
 			g_vulkanContext.presentFamilyId	 = presentQueueId;
+			g_vulkanContext.transferFamilyId = FindTransferQueueFamily( gpu, graphicsQueueId );
+			g_vulkanContext.computeFamilyId	 = FindComputeQueueFamily( gpu, graphicsQueueId );
 			g_vulkanContext.gpu				 = gpu;
 
 			deviceFound = true;
@@ -757,6 +1313,9 @@ void VulkanBackend::CreateDeviceAndAndQueues()
 	std::vector< int > queuesId;
 	queuesId.emplace_back( g_vulkanContext.graphicsFamilyId );
 	queuesId.emplace_back( g_vulkanContext.presentFamilyId );
+	queuesId.emplace_back( g_vulkanContext.transferFamilyId );
+	queuesId.emplace_back( g_vulkanContext.computeFamilyId );
+	std::sort( queuesId.begin(), queuesId.end() );
 	auto last = std::unique( queuesId.begin(), queuesId.end() );
 	queuesId.erase( last, queuesId.end() );
 
@@ -781,10 +1340,17 @@ void VulkanBackend::CreateDeviceAndAndQueues()
 	deviceFeatures.depthBiasClamp			= VK_TRUE;
 	deviceFeatures.depthBounds				= g_vulkanContext.gpu.features.depthBounds;
 	deviceFeatures.fillModeNonSolid			= VK_TRUE;
+	deviceFeatures.pipelineStatisticsQuery	= g_vulkanContext.gpu.features.pipelineStatisticsQuery;
+
+	// Tracks GPUMailManager submissions
+	VkPhysicalDeviceTimelineSemaphoreFeatures timelineFeatures {};
+	timelineFeatures.sType			   = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+	timelineFeatures.pNext			   = nullptr;
+	timelineFeatures.timelineSemaphore = VK_TRUE;
 
 	VkDeviceCreateInfo deviceCI {};
 	deviceCI.sType				  = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-	deviceCI.pNext				  = nullptr;
+	deviceCI.pNext				  = &timelineFeatures;
 	deviceCI.flags				  = 0;
 	deviceCI.queueCreateInfoCount = static_cast< uint32_t >( queuesCI.size() );
 	deviceCI.pQueueCreateInfos	  = queuesCI.data();
@@ -795,14 +1361,18 @@ void VulkanBackend::CreateDeviceAndAndQueues()
 	deviceCI.enabledLayerCount		 = 0;
 	deviceCI.ppEnabledLayerNames	 = nullptr;
 #endif
-	deviceCI.enabledExtensionCount	 = static_cast< uint32_t >( g_deviceExtensions.size() );
-	deviceCI.ppEnabledExtensionNames = g_deviceExtensions.data();
+	deviceCI.enabledExtensionCount	 = m_headless ? 0 : static_cast< uint32_t >( g_deviceExtensions.size() );
+	deviceCI.ppEnabledExtensionNames = m_headless ? nullptr : g_deviceExtensions.data();
 	deviceCI.pEnabledFeatures		 = &deviceFeatures; // will certainly change, according to vulkan layers output.
 
 	VK_CHECK( vkCreateDevice( g_vulkanContext.gpu.device, &deviceCI, nullptr, &g_vulkanContext.device ) );
 
 	vkGetDeviceQueue( g_vulkanContext.device, g_vulkanContext.graphicsFamilyId, 0, &g_vulkanContext.graphicsQueue );
 	vkGetDeviceQueue( g_vulkanContext.device, g_vulkanContext.presentFamilyId, 0, &g_vulkanContext.presentQueue );
+	vkGetDeviceQueue( g_vulkanContext.device, g_vulkanContext.transferFamilyId, 0, &g_vulkanContext.transferQueue );
+	vkGetDeviceQueue( g_vulkanContext.device, g_vulkanContext.computeFamilyId, 0, &g_vulkanContext.computeQueue );
+
+	g_concurrentFamilyIds = { g_vulkanContext.graphicsFamilyId, g_vulkanContext.computeFamilyId };
 }
 
 void VulkanBackend::DestroyDevice()
@@ -822,6 +1392,7 @@ void VulkanBackend::CreateSemaphores()
 	{
 		VK_CHECK( vkCreateSemaphore( g_vulkanContext.device, &semCI, nullptr, &m_imageAvailableSemaphores[ i ] ) );
 		VK_CHECK( vkCreateSemaphore( g_vulkanContext.device, &semCI, nullptr, &m_renderCompleteSemaphores[ i ] ) );
+		VK_CHECK( vkCreateSemaphore( g_vulkanContext.device, &semCI, nullptr, &m_computeCompleteSemaphores[ i ] ) );
 	}
 }
 
@@ -831,8 +1402,10 @@ void VulkanBackend::DestroySemaphores()
 	{
 		vkDestroySemaphore( g_vulkanContext.device, m_imageAvailableSemaphores[ i ], nullptr );
 		vkDestroySemaphore( g_vulkanContext.device, m_renderCompleteSemaphores[ i ], nullptr );
-		m_imageAvailableSemaphores[ i ] = VK_NULL_HANDLE;
-		m_renderCompleteSemaphores[ i ] = VK_NULL_HANDLE;
+		vkDestroySemaphore( g_vulkanContext.device, m_computeCompleteSemaphores[ i ], nullptr );
+		m_imageAvailableSemaphores[ i ]	 = VK_NULL_HANDLE;
+		m_renderCompleteSemaphores[ i ]	 = VK_NULL_HANDLE;
+		m_computeCompleteSemaphores[ i ] = VK_NULL_HANDLE;
 	}
 }
 
@@ -845,12 +1418,48 @@ void VulkanBackend::CreateCommandPool()
 	commandPoolCI.queueFamilyIndex = g_vulkanContext.graphicsFamilyId;
 
 	VK_CHECK( vkCreateCommandPool( g_vulkanContext.device, &commandPoolCI, nullptr, &m_commandPool ) );
+
+	commandPoolCI.queueFamilyIndex = g_vulkanContext.computeFamilyId;
+
+	VK_CHECK( vkCreateCommandPool( g_vulkanContext.device, &commandPoolCI, nullptr, &m_computeCommandPool ) );
+
+	// Recording contexts are reset as a whole each time their slot is recorded
+	commandPoolCI.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+	for ( auto &contexts : m_recordingContexts )
+	{
+		for ( recordingContext_t &context : contexts )
+		{
+			commandPoolCI.queueFamilyIndex = g_vulkanContext.computeFamilyId;
+			VK_CHECK( vkCreateCommandPool( g_vulkanContext.device,
+										   &commandPoolCI,
+										   nullptr,
+										   &context.preRenderCommandPool ) );
+
+			commandPoolCI.queueFamilyIndex = g_vulkanContext.graphicsFamilyId;
+			VK_CHECK(
+				vkCreateCommandPool( g_vulkanContext.device, &commandPoolCI, nullptr, &context.renderCommandPool ) );
+		}
+	}
 }
 
 void VulkanBackend::DestroyCommandPool()
 {
 	vkDestroyCommandPool( g_vulkanContext.device, m_commandPool, nullptr );
-	m_commandPool = VK_NULL_HANDLE;
+	vkDestroyCommandPool( g_vulkanContext.device, m_computeCommandPool, nullptr );
+	m_commandPool		 = VK_NULL_HANDLE;
+	m_computeCommandPool = VK_NULL_HANDLE;
+
+	for ( auto &contexts : m_recordingContexts )
+	{
+		for ( recordingContext_t &context : contexts )
+		{
+			vkDestroyCommandPool( g_vulkanContext.device, context.preRenderCommandPool, nullptr );
+			vkDestroyCommandPool( g_vulkanContext.device, context.renderCommandPool, nullptr );
+			context.preRenderCommandPool = VK_NULL_HANDLE;
+			context.renderCommandPool	 = VK_NULL_HANDLE;
+		}
+	}
 }
 
 void VulkanBackend::CreateCommandBuffers()
@@ -864,20 +1473,47 @@ void VulkanBackend::CreateCommandBuffers()
 
 	VK_CHECK( vkAllocateCommandBuffers( g_vulkanContext.device, &cmdBufferAllocInfo, m_commandBuffers.data() ) );
 
+	cmdBufferAllocInfo.commandPool		  = m_computeCommandPool;
 	cmdBufferAllocInfo.commandBufferCount = static_cast< uint32_t >( m_computeCommandBuffers.size() );
 
 	VK_CHECK( vkAllocateCommandBuffers( g_vulkanContext.device, &cmdBufferAllocInfo, m_computeCommandBuffers.data() ) );
 
+	cmdBufferAllocInfo.commandBufferCount = static_cast< uint32_t >( m_asyncComputeCommandBuffers.size() );
+
+	VK_CHECK( vkAllocateCommandBuffers( g_vulkanContext.device,
+										&cmdBufferAllocInfo,
+										m_asyncComputeCommandBuffers.data() ) );
+
+	cmdBufferAllocInfo.level			  = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+	cmdBufferAllocInfo.commandBufferCount = 1;
+
+	for ( auto &contexts : m_recordingContexts )
+	{
+		for ( recordingContext_t &context : contexts )
+		{
+			cmdBufferAllocInfo.commandPool = context.preRenderCommandPool;
+			VK_CHECK( vkAllocateCommandBuffers( g_vulkanContext.device,
+												&cmdBufferAllocInfo,
+												&context.preRenderCmdBuffer ) );
+
+			cmdBufferAllocInfo.commandPool = context.renderCommandPool;
+			VK_CHECK(
+				vkAllocateCommandBuffers( g_vulkanContext.device, &cmdBufferAllocInfo, &context.renderCmdBuffer ) );
+		}
+	}
+
 	VkFenceCreateInfo fenceCI {};
 	fenceCI.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
 	fenceCI.pNext = nullptr;
-	fenceCI.flags = 0; // VK_FENCE_CREATE_SIGNALED_BIT;
+	fenceCI.flags = VK_FENCE_CREATE_SIGNALED_BIT; // Waited on before the first use of the slot
 
 	for ( auto &fence : m_commandBufferFences )
 	{
 		VK_CHECK( vkCreateFence( g_vulkanContext.device, &fenceCI, nullptr, &fence ) );
 	}
 
+	fenceCI.flags = 0;
+
 	for ( auto &fence : m_computeCommandBufferFences )
 	{
 		VK_CHECK( vkCreateFence( g_vulkanContext.device, &fenceCI, nullptr, &fence ) );
@@ -902,12 +1538,33 @@ void VulkanBackend::DestroyCommandBuffers()
 						  static_cast< uint32_t >( m_commandBuffers.size() ),
 						  m_commandBuffers.data() );
 	vkFreeCommandBuffers( g_vulkanContext.device,
-						  m_commandPool,
-						  static_cast< uint32_t >( m_commandBuffers.size() ),
+						  m_computeCommandPool,
+						  static_cast< uint32_t >( m_computeCommandBuffers.size() ),
 						  m_computeCommandBuffers.data() );
+	vkFreeCommandBuffers( g_vulkanContext.device,
+						  m_computeCommandPool,
+						  static_cast< uint32_t >( m_asyncComputeCommandBuffers.size() ),
+						  m_asyncComputeCommandBuffers.data() );
 
 	std::memset( m_commandBuffers.data(), 0, m_commandBuffers.size() * sizeof( VkCommandBuffer ) );
 	std::memset( m_computeCommandBuffers.data(), 0, m_computeCommandBuffers.size() * sizeof( VkCommandBuffer ) );
+	std::memset( m_asyncComputeCommandBuffers.data(),
+				 0,
+				 m_asyncComputeCommandBuffers.size() * sizeof( VkCommandBuffer ) );
+
+	for ( auto &contexts : m_recordingContexts )
+	{
+		for ( recordingContext_t &context : contexts )
+		{
+			vkFreeCommandBuffers( g_vulkanContext.device,
+								  context.preRenderCommandPool,
+								  1,
+								  &context.preRenderCmdBuffer );
+			vkFreeCommandBuffers( g_vulkanContext.device, context.renderCommandPool, 1, &context.renderCmdBuffer );
+			context.preRenderCmdBuffer = VK_NULL_HANDLE;
+			context.renderCmdBuffer	   = VK_NULL_HANDLE;
+		}
+	}
 }
 
 void VulkanBackend::CreateSwapChain()
@@ -917,6 +1574,12 @@ void VulkanBackend::CreateSwapChain()
 		vkDeviceWaitIdle( g_vulkanContext.device );
 	}
 
+	if ( m_headless )
+	{
+		CreateOffscreenImages();
+		return;
+	}
+
 	auto &gpu = g_vulkanContext.gpu;
 
 	VK_CHECK( vkGetPhysicalDeviceSurfaceCapabilitiesKHR( gpu.device, m_presentationSurface, &gpu.surfaceCaps ) );
@@ -1002,6 +1665,12 @@ void VulkanBackend::CreateSwapChain()
 
 void VulkanBackend::DestroySwapChain()
 {
+	if ( m_headless )
+	{
+		DestroyOffscreenImages();
+		return;
+	}
+
 	for ( size_t i = 0; i < m_swapchainImagesViews.size(); ++i )
 	{
 		vkDestroyImageView( g_vulkanContext.device, m_swapchainImagesViews[ i ], nullptr );
@@ -1013,6 +1682,42 @@ void VulkanBackend::DestroySwapChain()
 	m_swapchain = VK_NULL_HANDLE;
 }
 
+void VulkanBackend::CreateOffscreenImages()
+{
+	m_swapchainFormat = VK_FORMAT_R8G8B8A8_UNORM;
+
+	imageOpts_t imageOpts;
+	imageOpts.type		 = TT_2D;
+	imageOpts.format	 = m_swapchainFormat;
+	imageOpts.width		 = m_swapchainExtent.width;
+	imageOpts.height	 = m_swapchainExtent.height;
+	imageOpts.usageFlags = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+
+	samplerOpts_t samplerOpts;
+	samplerOpts.filter		= VK_FILTER_LINEAR;
+	samplerOpts.addressMode = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+
+	for ( size_t i = 0; i < SWAPCHAIN_BUFFERING_LEVEL; ++i )
+	{
+		m_offscreenImages[ i ] = new Image();
+		m_offscreenImages[ i ]->AllocImage( imageOpts, samplerOpts );
+
+		m_swapchainImages[ i ]		= m_offscreenImages[ i ]->GetHandle();
+		m_swapchainImagesViews[ i ] = m_offscreenImages[ i ]->GetView();
+	}
+}
+
+void VulkanBackend::DestroyOffscreenImages()
+{
+	for ( Image *&image : m_offscreenImages )
+	{
+		delete image;
+		image = nullptr;
+	}
+	std::memset( m_swapchainImagesViews.data(), 0, m_swapchainImagesViews.size() * sizeof( VkImageView ) );
+	std::memset( m_swapchainImages.data(), 0, m_swapchainImages.size() * sizeof( VkImage ) );
+}
+
 VkFormat ChooseFormat( const VkFormat *formats, size_t count, VkImageTiling tiling, VkFormatFeatureFlagBits features )
 {
 	for ( size_t i = 0; i < count; ++i )
@@ -1047,30 +1752,30 @@ void VulkanBackend::CreateRenderTargets()
 {
 	const std::array< VkFormat, 2 > depthFormats = { VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT };
 
-	VkFormat depthFormat = ChooseFormat( depthFormats.data(),
-										 depthFormats.size(),
-										 VK_IMAGE_TILING_OPTIMAL,
-										 VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT );
+	m_depthFormat = ChooseFormat( depthFormats.data(),
+								  depthFormats.size(),
+								  VK_IMAGE_TILING_OPTIMAL,
+								  VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT );
 
 	imageOpts_t imageOpts;
 	imageOpts.type		 = TT_DEPTH;
-	imageOpts.format	 = depthFormat;
+	imageOpts.format	 = m_depthFormat;
 	imageOpts.width		 = m_swapchainExtent.width;
 	imageOpts.height	 = m_swapchainExtent.height;
 	imageOpts.usageFlags = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
 
-	samplerOpts_t samplerOpts;
-	samplerOpts.filter		= VK_FILTER_LINEAR;
-	samplerOpts.addressMode = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-
-	m_depthImage = new Image();
-	m_depthImage->AllocImage( imageOpts, samplerOpts );
+	// Only lives within the render pass, the graph may place other transient images in its memory
+	m_depthImage = g_renderGraph.CreateTransientImage( "Depth", imageOpts );
+	g_renderGraph.SetDepthBuffer( m_depthImage );
 }
 
 void VulkanBackend::DestroyRenderTargets()
 {
-	delete m_depthImage;
-	m_depthImage = nullptr;
+	if ( m_depthImage != RG_NULL_RESOURCE )
+	{
+		g_renderGraph.DestroyTransientImage( m_depthImage );
+		m_depthImage = RG_NULL_RESOURCE;
+	}
 }
 
 void VulkanBackend::CreateRenderPass()
@@ -1085,18 +1790,18 @@ void VulkanBackend::CreateRenderPass()
 	colorAttachment.storeOp		   = VK_ATTACHMENT_STORE_OP_STORE;
 	colorAttachment.stencilLoadOp  = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 	colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-	colorAttachment.initialLayout  = VK_IMAGE_LAYOUT_UNDEFINED;
-	colorAttachment.finalLayout	   = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	colorAttachment.initialLayout  = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL; // g_renderGraph transitions the layouts
+	colorAttachment.finalLayout	   = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
 	auto &depthAttachment		   = attachments[ RPA_stencilDepth ];
 	depthAttachment.flags		   = 0;
-	depthAttachment.format		   = m_depthImage->GetFormat();
+	depthAttachment.format		   = m_depthFormat;
 	depthAttachment.samples		   = VK_SAMPLE_COUNT_1_BIT;
 	depthAttachment.loadOp		   = VK_ATTACHMENT_LOAD_OP_CLEAR;
-	depthAttachment.storeOp		   = VK_ATTACHMENT_STORE_OP_STORE;
+	depthAttachment.storeOp		   = VK_ATTACHMENT_STORE_OP_DONT_CARE; // Transient
 	depthAttachment.stencilLoadOp  = VK_ATTACHMENT_LOAD_OP_CLEAR;
-	depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_STORE;
-	depthAttachment.initialLayout  = VK_IMAGE_LAYOUT_UNDEFINED;
+	depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	depthAttachment.initialLayout  = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 	depthAttachment.finalLayout	   = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 
 	VkAttachmentReference colorRef {};
@@ -1119,22 +1824,6 @@ void VulkanBackend::CreateRenderPass()
 	subpass.preserveAttachmentCount = 0;
 	subpass.pPreserveAttachments	= nullptr;
 
-	VkSubpassDependency dependencyPresentToDraw {};
-	dependencyPresentToDraw.srcSubpass		= VK_SUBPASS_EXTERNAL;
-	dependencyPresentToDraw.dstSubpass		= 0;
-	dependencyPresentToDraw.srcStageMask	= VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
-	dependencyPresentToDraw.dstStageMask	= VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-	dependencyPresentToDraw.srcAccessMask	= VK_ACCESS_MEMORY_READ_BIT;
-	dependencyPresentToDraw.dstAccessMask	= VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-	dependencyPresentToDraw.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
-
-	VkSubpassDependency dependencyDrawToPresent = dependencyPresentToDraw;
-	std::swap( dependencyDrawToPresent.srcSubpass, dependencyDrawToPresent.dstSubpass );
-	std::swap( dependencyDrawToPresent.srcStageMask, dependencyDrawToPresent.dstStageMask );
-	std::swap( dependencyDrawToPresent.srcAccessMask, dependencyDrawToPresent.dstAccessMask );
-
-	std::array< VkSubpassDependency, 2 > dependencies = { dependencyPresentToDraw, dependencyDrawToPresent };
-
 	VkRenderPassCreateInfo renderPass {};
 	renderPass.sType		   = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
 	renderPass.pNext		   = nullptr;
@@ -1143,8 +1832,8 @@ void VulkanBackend::CreateRenderPass()
 	renderPass.pAttachments	   = attachments.data();
 	renderPass.subpassCount	   = 1;
 	renderPass.pSubpasses	   = &subpass;
-	renderPass.dependencyCount = static_cast< uint32_t >( dependencies.size() );
-	renderPass.pDependencies   = dependencies.data();
+	renderPass.dependencyCount = 0; // Replaced by the barriers of g_renderGraph, recorded around the render pass
+	renderPass.pDependencies   = nullptr;
 
 	VK_CHECK( vkCreateRenderPass( g_vulkanContext.device, &renderPass, nullptr, &g_vulkanContext.renderPass ) );
 }
@@ -1159,9 +1848,10 @@ void VulkanBackend::CreateFramebuffers()
 {
 	std::array< VkImageView, 2 > attachments {};
 
-	CHECK_PRED( m_depthImage != nullptr );
+	CHECK_PRED( m_depthImage != RG_NULL_RESOURCE );
 
-	attachments[ RPA_stencilDepth ] = m_depthImage->GetView();
+	attachments[ RPA_stencilDepth ] = g_renderGraph.GetImageView( m_depthImage );
+	m_framebuffersVersion			= g_renderGraph.GetTransientsVersion();
 
 	VkFramebufferCreateInfo framebufferCI {};
 	framebufferCI.sType			  = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
@@ -1193,6 +1883,9 @@ void VulkanBackend::DestroyFramebuffers()
 //  Unhandled case: minimized window
 void VulkanBackend::OnWindowSizeChanged()
 {
+	// Frames in flight still render to the swapchain images and the depth buffer
+	VK_CHECK( vkDeviceWaitIdle( g_vulkanContext.device ) );
+
 	DestroySwapChain();
 	CreateSwapChain();
 
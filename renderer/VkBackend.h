@@ -3,8 +3,10 @@
 #pragma once
 
 #include "external/vulkan/vulkan.hpp"
+#include "platform/ThreadPool.h"
 #include "renderer/Backend.h"
 #include "renderer/RenderConfig.h"
+#include "renderer/RenderGraph.h"
 #include "renderer/VkRenderCommon.h"
 
 #include <array>
@@ -40,16 +42,37 @@ struct vulkanContext_t
 	VkDevice device			  = VK_NULL_HANDLE;
 	uint32_t graphicsFamilyId = ~0u;
 	uint32_t presentFamilyId  = ~0u;
+	uint32_t transferFamilyId = ~0u; // graphicsFamilyId when the device has no dedicated transfer family
+	uint32_t computeFamilyId  = ~0u; // graphicsFamilyId unless VFXs simulate on an async compute queue
 	VkQueue	 graphicsQueue	  = VK_NULL_HANDLE;
 	VkQueue	 presentQueue	  = VK_NULL_HANDLE;
+	VkQueue	 transferQueue	  = VK_NULL_HANDLE;
+	VkQueue	 computeQueue	  = VK_NULL_HANDLE;
 
 	VkRenderPass renderPass = VK_NULL_HANDLE;
-
-	std::array< VkPipeline, SWAPCHAIN_BUFFERING_LEVEL > boundGraphicsPipelines {};
 };
 
 vulkanContext_t &GetVulkanContext();
 
+bool HasAsyncCompute();
+// Buffers accessed by both the graphics and the async compute queue are shared concurrently, they must never be
+// written by the transfer queue
+void SetConcurrentSharingMode( VkBufferCreateInfo &bufferCI );
+
+// CPU/GPU overlap of the frame loop, averaged over the frames presented since the previous GetFrameStats call
+struct frameStats_t
+{
+	uint32_t framesInFlight = 0;
+	uint64_t frameCount		= 0;
+	double	 cpuFrameMs		= 0.0; // Between two presents, the inverse of the throughput
+	double	 fenceWaitMs	= 0.0; // Part of cpuFrameMs blocked on the fence of an older frame
+	double	 overlap		= 0.0; // 1 - fenceWaitMs / cpuFrameMs, share of the frame the CPU runs alongside the GPU
+	double	 stallRatio		= 0.0; // Frames that blocked on a fence, close to 1 when GPU bound
+	double	 latencyMs		= 0.0; // From the submit of a frame to the CPU seeing its fence signaled
+	double	 latencyFrames	= 0.0; // Frames recorded meanwhile
+	double	 recordMs		= 0.0; // CPU time from the first recorded command to the submit
+};
+
 class VulkanBackend : public Backend
 {
    public:
@@ -57,6 +80,10 @@ class VulkanBackend : public Backend
 
 	static VulkanBackend &GetInstance();
 
+	// Before Init: renders into offscreen images of the given size, without a surface nor a UI
+	void SetHeadless( uint32_t width, uint32_t height );
+	bool IsHeadless() const { return m_headless; }
+
 	void Init() final;
 	void Shutdown() final;
 
@@ -68,17 +95,53 @@ class VulkanBackend : public Backend
 
 	void ExecuteComputeCommands( int count, const gpuCmd_t *cmds );
 
+	// Clamped to [1, SWAPCHAIN_BUFFERING_LEVEL]
+	void	 SetFramesInFlight( uint32_t count );
+	uint32_t GetFramesInFlight() const { return m_framesInFlight; }
+
+	frameStats_t GetFrameStats();
+
+	// Command lists long enough are split into ranges recorded in parallel into secondary command buffers, one range
+	// per thread at most. Clamped to [1, RECORDING_MAX_THREADS], 1 records every command in the primary.
+	void	 SetRecordingThreadCount( uint32_t count );
+	uint32_t GetRecordingThreadCount() const { return m_recordingThreadCount; }
+
    private:
 	bool StartFrame();
-	void BeginRenderPass();
-	void Draw( const drawSurf_t &surf );
-	void Dispatch( uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ );
-	void InsertBarriers( const gpuBarrier_t &gpuBarrier );
+	void SetDynamicState( VkCommandBuffer cmdBuffer );
+	void BeginRenderPass( VkSubpassContents contents );
+	void Draw( VkCommandBuffer cmdBuffer, const drawSurf_t &surf );
 	void EndFrame();
+	void SubmitAsyncCompute( int count, const gpuCmd_t *cmds, uint32_t rangeCount );
 	void StartComputeFrame();
 	void Dispatch( VkCommandBuffer cmdBuffer, uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ );
+	void InsertBarriers( VkCommandBuffer cmdBuffer, const gpuBarrier_t &gpuBarrier );
 	void EndComputeFrame();
 
+	uint32_t GetRangeCount( int cmdCount, uint32_t threadCount ) const;
+	void	 PreparePipelines( int count, const gpuCmd_t *cmds );
+	void	 RecordCmds( VkCommandBuffer cmdBuffer,
+						 int			 count,
+						 const gpuCmd_t *cmds,
+						 uint32_t		 rangeCount,
+						 bool			 renderPass );
+	// Tracy GPU zones are only recorded by the render thread, ranges recorded in parallel are timed by GPUProfiler only
+	void	 RecordPreRenderRange( VkCommandBuffer cmdBuffer,
+								   const gpuCmd_t *cmds,
+								   int			   begin,
+								   int			   end,
+								   bool			   tracyZones );
+	void	 RecordRenderRange( VkCommandBuffer	cmdBuffer,
+								const gpuCmd_t *cmds,
+								int				begin,
+								int				end,
+								bool			tracyZones );
+
+	// Frames complete in submission order: the fence of a frame signals once every earlier frame has completed
+	void WaitForFrame( uint64_t frameId );
+	void PollCompletedFrames();
+	void RetireFrame( int64_t ticks );
+
    private:
 	void CreateInstance();
 	void DestroyInstance();
@@ -102,6 +165,9 @@ class VulkanBackend : public Backend
 	void CreateSwapChain();
 	void DestroySwapChain();
 
+	void CreateOffscreenImages();
+	void DestroyOffscreenImages();
+
 	void CreateRenderTargets();
 	void DestroyRenderTargets();
 
@@ -117,12 +183,16 @@ class VulkanBackend : public Backend
    private:
 	VkInstance	 m_instance			   = VK_NULL_HANDLE;
 	VkSurfaceKHR m_presentationSurface = VK_NULL_HANDLE;
+	bool		 m_headless			   = false;
 
 	uint32_t m_current				 = 0;
 	uint64_t m_frameCount			 = 0;
+	uint64_t m_completedFrameCount	 = 0; // Frames whose fence has signaled
 	uint32_t m_currentSwapChainImage = UINT32_MAX;
 	uint32_t m_computeCurrent		 = 0;
 	uint64_t m_computeFrameCount	 = 0;
+	uint32_t m_framesInFlight		 = FRAMES_IN_FLIGHT;
+	bool	 m_frameSubmitted		 = false; // StartFrame fails when the swapchain is out of date
 
 	VkSwapchainKHR										 m_swapchain = VK_NULL_HANDLE;
 	std::array< VkImage, SWAPCHAIN_BUFFERING_LEVEL >	 m_swapchainImages {};
@@ -130,6 +200,7 @@ class VulkanBackend : public Backend
 	VkFormat											 m_swapchainFormat = VK_FORMAT_UNDEFINED;
 	VkExtent2D											 m_swapchainExtent = { 0, 0 };
 	VkPresentModeKHR									 m_presentMode	   = VK_PRESENT_MODE_FIFO_KHR;
+	std::array< Image *, SWAPCHAIN_BUFFERING_LEVEL >	 m_offscreenImages {}; // Swapchain images when headless
 
 	std::array< VkCommandBuffer, SWAPCHAIN_BUFFERING_LEVEL > m_commandBuffers {};
 	std::array< VkFence, SWAPCHAIN_BUFFERING_LEVEL >		 m_commandBufferFences {};
@@ -137,13 +208,47 @@ class VulkanBackend : public Backend
 	std::array< VkSemaphore, SWAPCHAIN_BUFFERING_LEVEL >	 m_renderCompleteSemaphores {};
 
 	std::array< VkFramebuffer, SWAPCHAIN_BUFFERING_LEVEL > m_framebuffers {};
+	uint64_t											   m_framebuffersVersion = 0; // Of the g_renderGraph transients
 
 	std::array< VkCommandBuffer, COMPUTE_CHAIN_BUFFERING_LEVEL > m_computeCommandBuffers {};
 	std::array< VkFence, COMPUTE_CHAIN_BUFFERING_LEVEL >		 m_computeCommandBufferFences {};
 
-	VkCommandPool m_commandPool = VK_NULL_HANDLE;
-
-	Image *m_depthImage = nullptr;
+	// Pre-render commands of each frame when VFXs simulate on the async compute queue
+	std::array< VkCommandBuffer, SWAPCHAIN_BUFFERING_LEVEL > m_asyncComputeCommandBuffers {};
+	std::array< VkSemaphore, SWAPCHAIN_BUFFERING_LEVEL >	 m_computeCompleteSemaphores {};
+	uint64_t												 m_computeMailValue = 0; // Last GPU mail waited on
+
+	VkCommandPool m_commandPool		   = VK_NULL_HANDLE;
+	VkCommandPool m_computeCommandPool = VK_NULL_HANDLE;
+
+	// Each range of a split command list is recorded with the context of its index, by a single thread
+	struct recordingContext_t
+	{
+		VkCommandPool	preRenderCommandPool = VK_NULL_HANDLE; // Of the family executing the pre-render commands
+		VkCommandPool	renderCommandPool	 = VK_NULL_HANDLE;
+		VkCommandBuffer preRenderCmdBuffer	 = VK_NULL_HANDLE;
+		VkCommandBuffer renderCmdBuffer		 = VK_NULL_HANDLE;
+	};
+
+	std::array< std::array< recordingContext_t, RECORDING_MAX_THREADS >, SWAPCHAIN_BUFFERING_LEVEL >
+		m_recordingContexts {};
+
+	sys::ThreadPool m_recordingThreads;
+	uint32_t		m_recordingThreadCount = RECORDING_THREAD_COUNT;
+
+	rgResource_t m_depthImage  = RG_NULL_RESOURCE; // Transient image of g_renderGraph
+	VkFormat	 m_depthFormat = VK_FORMAT_UNDEFINED;
+
+	// Accumulated since the previous GetFrameStats call
+	std::array< int64_t, SWAPCHAIN_BUFFERING_LEVEL > m_submitTicks {};
+	int64_t											 m_statsTicks	  = 0;
+	int64_t											 m_fenceWaitTicks = 0;
+	int64_t											 m_recordTicks	  = 0;
+	int64_t											 m_latencyTicks	  = 0;
+	uint64_t										 m_latencyFrames  = 0;
+	uint64_t										 m_presentedCount = 0;
+	uint64_t										 m_stalledCount	  = 0;
+	uint64_t										 m_retiredCount	  = 0;
 };
 
 } // namespace render
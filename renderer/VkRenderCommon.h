@@ -49,12 +49,22 @@ struct gpuBarrier_t
 	std::vector< VkImageMemoryBarrier >	 imageBarriers;
 };
 
+struct gpuBufferCopy_t
+{
+	Buffer * srcBuffer = nullptr;
+	uint64_t srcOffset = 0; // byte offset
+	Buffer * dstBuffer = nullptr;
+	uint64_t dstOffset = 0; // byte offset
+	uint64_t size	   = 0;
+};
+
 enum gpuCmdType_t : uint16_t
 {
 	CT_GRAPHIC,
 	CT_COMPUTE,
 	CT_BARRIER,
 	CT_UI,
+	CT_COPY, // obj is a gpuBufferCopy_t
 	CT_UNKNOWN
 };
 
@@ -65,6 +75,7 @@ struct gpuCmd_t
 	std::array< uint32_t, 3 > groupCountDim = { 0, 0, 0 };
 	pipelineProg_t *		  pipeline		= nullptr;
 	void *					  obj			= nullptr;
+	const char *			  profileName	= nullptr; // GPUProfiler sums the timings of commands sharing a name
 };
 
 } // namespace render
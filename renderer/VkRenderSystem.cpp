@@ -2,11 +2,10 @@
 
 #include "renderer/VkRenderSystem.h"
 
+#include "renderer/RenderGraph.h"
 #include "renderer/RenderProgs.h"
 #include "renderer/VFX.h"
-#include "renderer/uiBackend.h"
-
-#include <cstring>
+#include "renderer/UiBackend.h"
 
 namespace vkRuna
 {
@@ -18,8 +17,6 @@ RenderSystem *const g_renderSystem = &g_vkRenderSystem;
 void VkRenderSystem::Init()
 {
 	g_vfxManager.Init();
-
-	m_renderCmds.resize( 8 );
 }
 
 void VkRenderSystem::Shutdown()
@@ -39,40 +36,35 @@ void VkRenderSystem::EndFrame()
 
 int VkRenderSystem::GetRenderCmds( gpuCmd_t **firstCmd )
 {
-	gpuCmd_t *vfxCmds;
-	const int vfxCount = g_vfxManager.GetRenderCmds( &vfxCmds );
-
-	auto *uiRenderData = g_uiBackend.GetDrawData();
-
-	const int cmdCount = vfxCount + ( uiRenderData != nullptr );
+	return g_renderGraph.GetRenderCmds( firstCmd );
+}
 
-	if ( cmdCount > m_renderCmds.size() )
-	{
-		m_renderCmds.resize( cmdCount );
-	}
+int VkRenderSystem::GetPreRenderCmds( gpuCmd_t **firstCmd )
+{
+	// Reloaded pipelines are swapped in before any command refers to them
+	g_pipelineManager.UpdateReloads();
 
-	int i = 0;
-	// for ( ; i < vfxCount; ++i ) {
-	//	std::memcpy( &m_renderCmds[ i ], &vfxCmds[ i ], sizeof( m_renderCmds[ i ] ) );
-	//}
+	// Declares and compiles the whole frame, GetRenderCmds returns the render commands of the same compilation
+	g_renderGraph.BeginFrame();
 
-	std::memcpy( &m_renderCmds[ i ], &vfxCmds[ i ], vfxCount * sizeof( m_renderCmds[ i ] ) );
-	i = vfxCount;
+	g_vfxManager.AddPasses();
 
+	auto *uiRenderData = g_uiBackend.GetDrawData();
 	if ( uiRenderData )
 	{
-		m_renderCmds[ i ].type = CT_UI;
-		m_renderCmds[ i ].obj  = uiRenderData;
+		gpuCmd_t uiCmd;
+		uiCmd.type		  = CT_UI;
+		uiCmd.obj		  = uiRenderData;
+		uiCmd.profileName = "UI";
+
+		g_renderGraph.AddPass( "UI", RGP_RENDER );
+		g_renderGraph.Use( g_renderGraph.GetBackbuffer(), RGU_COLOR_ATTACHMENT );
+		g_renderGraph.AddCmd( uiCmd );
 	}
 
-	*firstCmd = m_renderCmds.data();
+	g_renderGraph.Compile();
 
-	return cmdCount;
-}
-
-int VkRenderSystem::GetPreRenderCmds( gpuCmd_t **firstCmd )
-{
-	return g_vfxManager.GetPreRenderCmds( firstCmd );
+	return g_renderGraph.GetPreRenderCmds( firstCmd );
 }
 
 void VkRenderSystem::SetUBOVar( int count, const char *const *vars, const float *values )
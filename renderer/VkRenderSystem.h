@@ -4,8 +4,6 @@
 
 #include "renderer/RenderSystem.h"
 
-#include <vector>
-
 namespace vkRuna
 {
 namespace render
@@ -23,9 +21,6 @@ class VkRenderSystem : public RenderSystem
 	int GetPreRenderCmds( gpuCmd_t **firstCmd ) final;
 
 	void SetUBOVar( int count, const char *const *vars, const float *values ) final;
-
-   private:
-	std::vector< gpuCmd_t > m_renderCmds;
 };
 
 } // namespace render
@@ -3,13 +3,17 @@
 #include "renderer/VkUtil.h"
 
 #include "platform/Sys.h"
-#include "platform/Window.h"
 #include "platform/defines.h"
 #include "renderer/Check.h"
 
 #include <algorithm>
+#include <cstring>
 #include <iostream>
 
+#ifdef VK_USE_PLATFORM_WIN32_KHR
+	#include "platform/Window.h"
+#endif
+
 namespace vkRuna
 {
 namespace render
@@ -162,6 +166,7 @@ VkExtent2D ChooseSurfaceExtent( const VkSurfaceCapabilitiesKHR &caps )
 {
 	auto extent = caps.currentExtent;
 
+#ifdef VK_USE_PLATFORM_WIN32_KHR
 	if ( extent.width == -1 || extent.height == -1 )
 	{
 		const auto &winProps = Window::GetInstance().GetProps();
@@ -172,6 +177,7 @@ VkExtent2D ChooseSurfaceExtent( const VkSurfaceCapabilitiesKHR &caps )
 		extent.width  = std::min( std::max( extent.width, caps.minImageExtent.width ), caps.maxImageExtent.width );
 		extent.height = std::min( std::max( extent.height, caps.minImageExtent.height ), caps.maxImageExtent.height );
 	}
+#endif
 
 	return extent;
 }
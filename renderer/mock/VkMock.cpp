@@ -0,0 +1,1462 @@
+// Copyright (c) 2021 Arno Galvez
+
+#include "renderer/mock/VkMock.h"
+
+#include "platform/defines.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bitset>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace vkRuna
+{
+namespace render
+{
+namespace mock
+{
+static constexpr VkDeviceSize MOCK_ALIGNMENT		= 256;
+static constexpr uint32_t	  MOCK_MEMORY_TYPE_BITS = 0b111;
+static constexpr uint32_t	  MOCK_SURFACE_WIDTH	= 1280;
+static constexpr uint32_t	  MOCK_SURFACE_HEIGHT	= 720;
+static constexpr uint32_t	  MOCK_SWAPCHAIN_IMAGES = 3;
+static constexpr uint32_t	  MOCK_VENDOR_ID		= 0x10005; // VK_VENDOR_ID_MESA
+static constexpr uint32_t	  MOCK_DEVICE_ID		= 1;
+static constexpr uint32_t	  MOCK_DRIVER_VERSION	= VK_MAKE_VERSION( 1, 0, 0 );
+
+static const uint8_t MOCK_PIPELINE_CACHE_UUID[ VK_UUID_SIZE ] = { 'v', 'k', 'R', 'u', 'n', 'a', ' ', 'm',
+																  'o', 'c', 'k', ' ', 'p', 's', 'o', '1' };
+
+static const char *g_callNames[] = {
+#define X( NAME ) #NAME,
+	RUNA_MOCK_ENTRY_POINTS( X )
+#undef X
+};
+
+static std::array< std::atomic< uint64_t >, MC_COUNT > g_callCounts {};
+static std::atomic< uint64_t >						   g_handleId { 1 };
+static std::atomic< VkDeviceSize >					   g_deviceMemoryBytes { 0 };
+
+struct mockMemory_t
+{
+	byte *		 data = nullptr;
+	VkDeviceSize size = 0;
+};
+
+struct mockBuffer_t
+{
+	VkDeviceSize  size	 = 0;
+	mockMemory_t *memory = nullptr;
+	VkDeviceSize  offset = 0;
+};
+
+struct mockImage_t
+{
+	VkDeviceSize size = 0;
+};
+
+struct mockFence_t
+{
+	std::atomic< bool > signaled { false };
+};
+
+// Timestamps are written when recorded, in nanoseconds of the host steady clock. Pipeline statistics stay at 0.
+struct mockQueryPool_t
+{
+	std::vector< uint64_t > values;
+	uint32_t				valueCount = 1; // Per query
+};
+
+struct mockSemaphore_t
+{
+	std::atomic< uint64_t > value { 0 }; // Timeline semaphores only
+};
+
+// Dispatchable handles are dereferenced by nothing but the loader, any unique address does
+static int													g_physicalDevice;
+static std::array< int, 3 >									g_queues;
+static std::array< mockImage_t, MOCK_SWAPCHAIN_IMAGES >		g_swapchainImages;
+
+static void CountCall( mockCall_t call )
+{
+	g_callCounts[ call ].fetch_add( 1, std::memory_order_relaxed );
+}
+
+template< typename T, typename U >
+static T ToHandle( U *object )
+{
+	return ( T )( reinterpret_cast< uintptr_t >( object ) );
+}
+
+template< typename U, typename T >
+static U *FromHandle( T handle )
+{
+	return reinterpret_cast< U * >( ( uintptr_t )( handle ) );
+}
+
+// Handles of objects the mock does not back with memory are unique ids, never dereferenced
+template< typename T >
+static T NewHandle()
+{
+	return ( T )( static_cast< uintptr_t >( g_handleId.fetch_add( 1, std::memory_order_relaxed ) ) );
+}
+
+static VkDeviceSize Align( VkDeviceSize size, VkDeviceSize alignment )
+{
+	return ( size + alignment - 1 ) & ~( alignment - 1 );
+}
+
+static VkResult EnumerateExtensions( const char *const *  extensions,
+									 uint32_t			  extensionCount,
+									 uint32_t *			  pPropertyCount,
+									 VkExtensionProperties *pProperties )
+{
+	if ( pProperties == nullptr )
+	{
+		*pPropertyCount = extensionCount;
+		return VK_SUCCESS;
+	}
+
+	const uint32_t count = std::min( *pPropertyCount, extensionCount );
+	for ( uint32_t i = 0; i < count; ++i )
+	{
+		pProperties[ i ] = {};
+		std::snprintf( pProperties[ i ].extensionName, VK_MAX_EXTENSION_NAME_SIZE, "%s", extensions[ i ] );
+		pProperties[ i ].specVersion = 1;
+	}
+
+	*pPropertyCount = count;
+	return count < extensionCount ? VK_INCOMPLETE : VK_SUCCESS;
+}
+
+static void FillPhysicalDeviceProperties( VkPhysicalDeviceProperties &properties )
+{
+	properties = {};
+
+	properties.apiVersion	 = VK_API_VERSION_1_2;
+	properties.driverVersion = MOCK_DRIVER_VERSION;
+	properties.vendorID		 = MOCK_VENDOR_ID;
+	properties.deviceID		 = MOCK_DEVICE_ID;
+	properties.deviceType	 = VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU;
+	std::snprintf( properties.deviceName, VK_MAX_PHYSICAL_DEVICE_NAME_SIZE, "vkRuna mock device" );
+	std::memcpy( properties.pipelineCacheUUID, MOCK_PIPELINE_CACHE_UUID, VK_UUID_SIZE );
+
+	VkPhysicalDeviceLimits &limits					= properties.limits;
+	limits.maxImageDimension2D						= 16384;
+	limits.maxUniformBufferRange					= 65536;
+	limits.maxStorageBufferRange					= UINT32_MAX;
+	limits.maxPushConstantsSize						= 256;
+	limits.bufferImageGranularity					= 1024;
+	limits.maxBoundDescriptorSets					= 8;
+	limits.maxDescriptorSetUniformBuffersDynamic	= 16;
+	limits.maxDescriptorSetStorageBuffersDynamic	= 8;
+	limits.maxComputeWorkGroupCount[ 0 ]			= 65535;
+	limits.maxComputeWorkGroupCount[ 1 ]			= 65535;
+	limits.maxComputeWorkGroupCount[ 2 ]			= 65535;
+	limits.maxComputeWorkGroupInvocations			= 1024;
+	limits.maxComputeWorkGroupSize[ 0 ]				= 1024;
+	limits.maxComputeWorkGroupSize[ 1 ]				= 1024;
+	limits.maxComputeWorkGroupSize[ 2 ]				= 64;
+	limits.minMemoryMapAlignment					= 64;
+	limits.minTexelBufferOffsetAlignment			= 16;
+	limits.minUniformBufferOffsetAlignment			= 256;
+	limits.minStorageBufferOffsetAlignment			= 256;
+	limits.optimalBufferCopyOffsetAlignment			= 256;
+	limits.optimalBufferCopyRowPitchAlignment		= 256;
+	limits.nonCoherentAtomSize						= 256;
+	limits.timestampComputeAndGraphics				= VK_TRUE;
+	limits.timestampPeriod							= 1.0f;
+}
+
+uint64_t GetCallCount( mockCall_t call )
+{
+	return g_callCounts[ call ].load( std::memory_order_relaxed );
+}
+
+const char *GetCallName( mockCall_t call )
+{
+	return g_callNames[ call ];
+}
+
+void ResetCallCounts()
+{
+	for ( std::atomic< uint64_t > &count : g_callCounts )
+	{
+		count.store( 0, std::memory_order_relaxed );
+	}
+}
+
+void PrintCallCounts()
+{
+	for ( int i = 0; i < MC_COUNT; ++i )
+	{
+		const uint64_t count = GetCallCount( static_cast< mockCall_t >( i ) );
+		if ( count > 0 )
+		{
+			std::printf( "%-48s %llu\n", g_callNames[ i ], static_cast< unsigned long long >( count ) );
+		}
+	}
+}
+
+VkDeviceSize GetDeviceMemoryBytes()
+{
+	return g_deviceMemoryBytes.load( std::memory_order_relaxed );
+}
+
+} // namespace mock
+} // namespace render
+} // namespace vkRuna
+
+using namespace vkRuna::render::mock;
+
+extern "C"
+{
+VKAPI_ATTR VkResult VKAPI_CALL vkAcquireNextImageKHR( VkDevice		 device,
+													  VkSwapchainKHR swapchain,
+													  uint64_t		 timeout,
+													  VkSemaphore	 semaphore,
+													  VkFence		 fence,
+													  uint32_t *	 pImageIndex )
+{
+	CountCall( MC_vkAcquireNextImageKHR );
+
+	static std::atomic< uint32_t > imageIndex { 0 };
+	*pImageIndex = imageIndex++ % MOCK_SWAPCHAIN_IMAGES;
+
+	if ( fence != VK_NULL_HANDLE )
+	{
+		FromHandle< mockFence_t >( fence )->signaled = true;
+	}
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkAllocateCommandBuffers( VkDevice							device,
+														 const VkCommandBufferAllocateInfo *pAllocateInfo,
+														 VkCommandBuffer *					pCommandBuffers )
+{
+	CountCall( MC_vkAllocateCommandBuffers );
+
+	for ( uint32_t i = 0; i < pAllocateInfo->commandBufferCount; ++i )
+	{
+		pCommandBuffers[ i ] = NewHandle< VkCommandBuffer >();
+	}
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkAllocateDescriptorSets( VkDevice							device,
+														 const VkDescriptorSetAllocateInfo *pAllocateInfo,
+														 VkDescriptorSet *					pDescriptorSets )
+{
+	CountCall( MC_vkAllocateDescriptorSets );
+
+	for ( uint32_t i = 0; i < pAllocateInfo->descriptorSetCount; ++i )
+	{
+		pDescriptorSets[ i ] = NewHandle< VkDescriptorSet >();
+	}
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkAllocateMemory( VkDevice					  device,
+												 const VkMemoryAllocateInfo * pAllocateInfo,
+												 const VkAllocationCallbacks *pAllocator,
+												 VkDeviceMemory *			  pMemory )
+{
+	CountCall( MC_vkAllocateMemory );
+
+	auto *memory = new mockMemory_t;
+	memory->data = static_cast< byte * >( std::calloc( 1, static_cast< size_t >( pAllocateInfo->allocationSize ) ) );
+	memory->size = pAllocateInfo->allocationSize;
+	if ( memory->data == nullptr )
+	{
+		delete memory;
+		return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+	}
+
+	g_deviceMemoryBytes += memory->size;
+
+	*pMemory = ToHandle< VkDeviceMemory >( memory );
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkBeginCommandBuffer( VkCommandBuffer				 commandBuffer,
+													 const VkCommandBufferBeginInfo *pBeginInfo )
+{
+	CountCall( MC_vkBeginCommandBuffer );
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkBindBufferMemory( VkDevice		  device,
+												   VkBuffer		  buffer,
+												   VkDeviceMemory memory,
+												   VkDeviceSize	  memoryOffset )
+{
+	CountCall( MC_vkBindBufferMemory );
+
+	auto *mockBuffer	= FromHandle< mockBuffer_t >( buffer );
+	mockBuffer->memory = FromHandle< mockMemory_t >( memory );
+	mockBuffer->offset = memoryOffset;
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkBindImageMemory( VkDevice		 device,
+												  VkImage		 image,
+												  VkDeviceMemory memory,
+												  VkDeviceSize	 memoryOffset )
+{
+	CountCall( MC_vkBindImageMemory );
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdBeginQuery( VkCommandBuffer		commandBuffer,
+											VkQueryPool			queryPool,
+											uint32_t			query,
+											VkQueryControlFlags	flags )
+{
+	CountCall( MC_vkCmdBeginQuery );
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdBeginRenderPass( VkCommandBuffer			  commandBuffer,
+												 const VkRenderPassBeginInfo *pRenderPassBegin,
+												 VkSubpassContents			  contents )
+{
+	CountCall( MC_vkCmdBeginRenderPass );
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdBindDescriptorSets( VkCommandBuffer		   commandBuffer,
+													VkPipelineBindPoint	   pipelineBindPoint,
+													VkPipelineLayout	   layout,
+													uint32_t			   firstSet,
+													uint32_t			   descriptorSetCount,
+													const VkDescriptorSet *pDescriptorSets,
+													uint32_t			   dynamicOffsetCount,
+													const uint32_t *	   pDynamicOffsets )
+{
+	CountCall( MC_vkCmdBindDescriptorSets );
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdBindIndexBuffer( VkCommandBuffer commandBuffer,
+												 VkBuffer		 buffer,
+												 VkDeviceSize	 offset,
+												 VkIndexType	 indexType )
+{
+	CountCall( MC_vkCmdBindIndexBuffer );
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdBindPipeline( VkCommandBuffer	  commandBuffer,
+											  VkPipelineBindPoint pipelineBindPoint,
+											  VkPipeline		  pipeline )
+{
+	CountCall( MC_vkCmdBindPipeline );
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdBindVertexBuffers( VkCommandBuffer	   commandBuffer,
+												   uint32_t			   firstBinding,
+												   uint32_t			   bindingCount,
+												   const VkBuffer *	   pBuffers,
+												   const VkDeviceSize *pOffsets )
+{
+	CountCall( MC_vkCmdBindVertexBuffers );
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdCopyBuffer( VkCommandBuffer		commandBuffer,
+											VkBuffer			srcBuffer,
+											VkBuffer			dstBuffer,
+											uint32_t			regionCount,
+											const VkBufferCopy *pRegions )
+{
+	CountCall( MC_vkCmdCopyBuffer );
+
+	const auto *src = FromHandle< mockBuffer_t >( srcBuffer );
+	const auto *dst = FromHandle< mockBuffer_t >( dstBuffer );
+	if ( src->memory == nullptr || dst->memory == nullptr )
+	{
+		return;
+	}
+
+	for ( uint32_t i = 0; i < regionCount; ++i )
+	{
+		const VkBufferCopy &region = pRegions[ i ];
+		std::memmove( dst->memory->data + dst->offset + region.dstOffset,
+					  src->memory->data + src->offset + region.srcOffset,
+					  static_cast< size_t >( region.size ) );
+	}
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdCopyBufferToImage( VkCommandBuffer			commandBuffer,
+												   VkBuffer					srcBuffer,
+												   VkImage					dstImage,
+												   VkImageLayout			dstImageLayout,
+												   uint32_t					regionCount,
+												   const VkBufferImageCopy *pRegions )
+{
+	CountCall( MC_vkCmdCopyBufferToImage );
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdDispatch( VkCommandBuffer commandBuffer,
+										  uint32_t		  groupCountX,
+										  uint32_t		  groupCountY,
+										  uint32_t		  groupCountZ )
+{
+	CountCall( MC_vkCmdDispatch );
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdDraw( VkCommandBuffer commandBuffer,
+									  uint32_t		  vertexCount,
+									  uint32_t		  instanceCount,
+									  uint32_t		  firstVertex,
+									  uint32_t		  firstInstance )
+{
+	CountCall( MC_vkCmdDraw );
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdDrawIndexed( VkCommandBuffer commandBuffer,
+											 uint32_t		 indexCount,
+											 uint32_t		 instanceCount,
+											 uint32_t		 firstIndex,
+											 int32_t		 vertexOffset,
+											 uint32_t		 firstInstance )
+{
+	CountCall( MC_vkCmdDrawIndexed );
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdEndQuery( VkCommandBuffer commandBuffer, VkQueryPool queryPool, uint32_t query )
+{
+	CountCall( MC_vkCmdEndQuery );
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdEndRenderPass( VkCommandBuffer commandBuffer )
+{
+	CountCall( MC_vkCmdEndRenderPass );
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdExecuteCommands( VkCommandBuffer		commandBuffer,
+												 uint32_t				commandBufferCount,
+												 const VkCommandBuffer *pCommandBuffers )
+{
+	CountCall( MC_vkCmdExecuteCommands );
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdFillBuffer( VkCommandBuffer	commandBuffer,
+											VkBuffer		dstBuffer,
+											VkDeviceSize	dstOffset,
+											VkDeviceSize	size,
+											uint32_t		data )
+{
+	CountCall( MC_vkCmdFillBuffer );
+
+	const auto *dst = FromHandle< mockBuffer_t >( dstBuffer );
+	if ( dst->memory == nullptr )
+	{
+		return;
+	}
+
+	if ( size == VK_WHOLE_SIZE )
+	{
+		size = ( dst->size - dstOffset ) & ~VkDeviceSize( 3 );
+	}
+
+	byte *ptr = dst->memory->data + dst->offset + dstOffset;
+	for ( VkDeviceSize i = 0; i < size; i += sizeof( data ) )
+	{
+		std::memcpy( ptr + i, &data, sizeof( data ) );
+	}
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdPipelineBarrier( VkCommandBuffer			  commandBuffer,
+												 VkPipelineStageFlags		  srcStageMask,
+												 VkPipelineStageFlags		  dstStageMask,
+												 VkDependencyFlags			  dependencyFlags,
+												 uint32_t					  memoryBarrierCount,
+												 const VkMemoryBarrier *	  pMemoryBarriers,
+												 uint32_t					  bufferMemoryBarrierCount,
+												 const VkBufferMemoryBarrier *pBufferMemoryBarriers,
+												 uint32_t					  imageMemoryBarrierCount,
+												 const VkImageMemoryBarrier * pImageMemoryBarriers )
+{
+	CountCall( MC_vkCmdPipelineBarrier );
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdPushConstants( VkCommandBuffer	  commandBuffer,
+											   VkPipelineLayout	  layout,
+											   VkShaderStageFlags stageFlags,
+											   uint32_t			  offset,
+											   uint32_t			  size,
+											   const void *		  pValues )
+{
+	CountCall( MC_vkCmdPushConstants );
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdResetQueryPool( VkCommandBuffer	commandBuffer,
+												VkQueryPool		queryPool,
+												uint32_t		firstQuery,
+												uint32_t		queryCount )
+{
+	CountCall( MC_vkCmdResetQueryPool );
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdSetDepthBounds( VkCommandBuffer	commandBuffer,
+												float			minDepthBounds,
+												float			maxDepthBounds )
+{
+	CountCall( MC_vkCmdSetDepthBounds );
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdSetScissor( VkCommandBuffer	commandBuffer,
+											uint32_t		firstScissor,
+											uint32_t		scissorCount,
+											const VkRect2D *pScissors )
+{
+	CountCall( MC_vkCmdSetScissor );
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdSetViewport( VkCommandBuffer   commandBuffer,
+											 uint32_t		   firstViewport,
+											 uint32_t		   viewportCount,
+											 const VkViewport *pViewports )
+{
+	CountCall( MC_vkCmdSetViewport );
+}
+
+VKAPI_ATTR void VKAPI_CALL vkCmdWriteTimestamp( VkCommandBuffer			commandBuffer,
+												VkPipelineStageFlagBits	pipelineStage,
+												VkQueryPool				queryPool,
+												uint32_t				query )
+{
+	CountCall( MC_vkCmdWriteTimestamp );
+
+	const auto now = std::chrono::steady_clock::now().time_since_epoch();
+
+	FromHandle< mockQueryPool_t >( queryPool )->values[ query ] =
+		static_cast< uint64_t >( std::chrono::duration_cast< std::chrono::nanoseconds >( now ).count() );
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateBuffer( VkDevice						device,
+											   const VkBufferCreateInfo *	pCreateInfo,
+											   const VkAllocationCallbacks *pAllocator,
+											   VkBuffer *					pBuffer )
+{
+	CountCall( MC_vkCreateBuffer );
+
+	auto *buffer = new mockBuffer_t;
+	buffer->size = pCreateInfo->size;
+
+	*pBuffer = ToHandle< VkBuffer >( buffer );
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateCommandPool( VkDevice					   device,
+													const VkCommandPoolCreateInfo *pCreateInfo,
+													const VkAllocationCallbacks *  pAllocator,
+													VkCommandPool *				   pCommandPool )
+{
+	CountCall( MC_vkCreateCommandPool );
+	*pCommandPool = NewHandle< VkCommandPool >();
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateComputePipelines( VkDevice							device,
+														 VkPipelineCache					pipelineCache,
+														 uint32_t							createInfoCount,
+														 const VkComputePipelineCreateInfo *pCreateInfos,
+														 const VkAllocationCallbacks *		pAllocator,
+														 VkPipeline *						pPipelines )
+{
+	CountCall( MC_vkCreateComputePipelines );
+
+	for ( uint32_t i = 0; i < createInfoCount; ++i )
+	{
+		pPipelines[ i ] = NewHandle< VkPipeline >();
+	}
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateDescriptorPool( VkDevice							 device,
+													   const VkDescriptorPoolCreateInfo *pCreateInfo,
+													   const VkAllocationCallbacks *	 pAllocator,
+													   VkDescriptorPool *				 pDescriptorPool )
+{
+	CountCall( MC_vkCreateDescriptorPool );
+	*pDescriptorPool = NewHandle< VkDescriptorPool >();
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateDescriptorSetLayout( VkDevice							   device,
+															const VkDescriptorSetLayoutCreateInfo *pCreateInfo,
+															const VkAllocationCallbacks *		   pAllocator,
+															VkDescriptorSetLayout *				   pSetLayout )
+{
+	CountCall( MC_vkCreateDescriptorSetLayout );
+	*pSetLayout = NewHandle< VkDescriptorSetLayout >();
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateDevice( VkPhysicalDevice				physicalDevice,
+											   const VkDeviceCreateInfo *	pCreateInfo,
+											   const VkAllocationCallbacks *pAllocator,
+											   VkDevice *					pDevice )
+{
+	CountCall( MC_vkCreateDevice );
+	*pDevice = NewHandle< VkDevice >();
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateFence( VkDevice					   device,
+											  const VkFenceCreateInfo *	   pCreateInfo,
+											  const VkAllocationCallbacks *pAllocator,
+											  VkFence *					   pFence )
+{
+	CountCall( MC_vkCreateFence );
+
+	auto *fence		= new mockFence_t;
+	fence->signaled = ( pCreateInfo->flags & VK_FENCE_CREATE_SIGNALED_BIT ) != 0;
+
+	*pFence = ToHandle< VkFence >( fence );
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateFramebuffer( VkDevice					   device,
+													const VkFramebufferCreateInfo *pCreateInfo,
+													const VkAllocationCallbacks *  pAllocator,
+													VkFramebuffer *				   pFramebuffer )
+{
+	CountCall( MC_vkCreateFramebuffer );
+	*pFramebuffer = NewHandle< VkFramebuffer >();
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateGraphicsPipelines( VkDevice							  device,
+														  VkPipelineCache					  pipelineCache,
+														  uint32_t							  createInfoCount,
+														  const VkGraphicsPipelineCreateInfo *pCreateInfos,
+														  const VkAllocationCallbacks *		  pAllocator,
+														  VkPipeline *						  pPipelines )
+{
+	CountCall( MC_vkCreateGraphicsPipelines );
+
+	for ( uint32_t i = 0; i < createInfoCount; ++i )
+	{
+		pPipelines[ i ] = NewHandle< VkPipeline >();
+	}
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateImage( VkDevice					   device,
+											  const VkImageCreateInfo *	   pCreateInfo,
+											  const VkAllocationCallbacks *pAllocator,
+											  VkImage *					   pImage )
+{
+	CountCall( MC_vkCreateImage );
+
+	auto *image = new mockImage_t;
+	image->size = VkDeviceSize( pCreateInfo->extent.width ) * pCreateInfo->extent.height * pCreateInfo->extent.depth *
+				  pCreateInfo->arrayLayers * 4;
+	image->size += image->size / 3; // Mip chain
+
+	*pImage = ToHandle< VkImage >( image );
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateImageView( VkDevice					   device,
+												  const VkImageViewCreateInfo *pCreateInfo,
+												  const VkAllocationCallbacks *pAllocator,
+												  VkImageView *				   pView )
+{
+	CountCall( MC_vkCreateImageView );
+	*pView = NewHandle< VkImageView >();
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateInstance( const VkInstanceCreateInfo * pCreateInfo,
+												 const VkAllocationCallbacks *pAllocator,
+												 VkInstance *				  pInstance )
+{
+	CountCall( MC_vkCreateInstance );
+	*pInstance = NewHandle< VkInstance >();
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreatePipelineCache( VkDevice						   device,
+													  const VkPipelineCacheCreateInfo *pCreateInfo,
+													  const VkAllocationCallbacks *	   pAllocator,
+													  VkPipelineCache *				   pPipelineCache )
+{
+	CountCall( MC_vkCreatePipelineCache );
+	*pPipelineCache = NewHandle< VkPipelineCache >();
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreatePipelineLayout( VkDevice							 device,
+													   const VkPipelineLayoutCreateInfo *pCreateInfo,
+													   const VkAllocationCallbacks *	 pAllocator,
+													   VkPipelineLayout *				 pPipelineLayout )
+{
+	CountCall( MC_vkCreatePipelineLayout );
+	*pPipelineLayout = NewHandle< VkPipelineLayout >();
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateQueryPool( VkDevice					   device,
+												  const VkQueryPoolCreateInfo *pCreateInfo,
+												  const VkAllocationCallbacks *pAllocator,
+												  VkQueryPool *				   pQueryPool )
+{
+	CountCall( MC_vkCreateQueryPool );
+
+	auto *queryPool = new mockQueryPool_t;
+	if ( pCreateInfo->queryType == VK_QUERY_TYPE_PIPELINE_STATISTICS )
+	{
+		queryPool->valueCount = static_cast< uint32_t >( std::bitset< 32 >( pCreateInfo->pipelineStatistics ).count() );
+	}
+	queryPool->values.resize( pCreateInfo->queryCount * queryPool->valueCount, 0 );
+
+	*pQueryPool = ToHandle< VkQueryPool >( queryPool );
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateRenderPass( VkDevice						 device,
+												   const VkRenderPassCreateInfo *pCreateInfo,
+												   const VkAllocationCallbacks * pAllocator,
+												   VkRenderPass *				 pRenderPass )
+{
+	CountCall( MC_vkCreateRenderPass );
+	*pRenderPass = NewHandle< VkRenderPass >();
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateSampler( VkDevice					 device,
+												const VkSamplerCreateInfo *	 pCreateInfo,
+												const VkAllocationCallbacks *pAllocator,
+												VkSampler *					 pSampler )
+{
+	CountCall( MC_vkCreateSampler );
+	*pSampler = NewHandle< VkSampler >();
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateSemaphore( VkDevice					   device,
+												  const VkSemaphoreCreateInfo *pCreateInfo,
+												  const VkAllocationCallbacks *pAllocator,
+												  VkSemaphore *				   pSemaphore )
+{
+	CountCall( MC_vkCreateSemaphore );
+
+	auto *semaphore = new mockSemaphore_t;
+	for ( auto *next = static_cast< const VkBaseInStructure * >( pCreateInfo->pNext ); next; next = next->pNext )
+	{
+		if ( next->sType == VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO )
+		{
+			semaphore->value = reinterpret_cast< const VkSemaphoreTypeCreateInfo * >( next )->initialValue;
+		}
+	}
+
+	*pSemaphore = ToHandle< VkSemaphore >( semaphore );
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateShaderModule( VkDevice						 device,
+													 const VkShaderModuleCreateInfo *pCreateInfo,
+													 const VkAllocationCallbacks *	 pAllocator,
+													 VkShaderModule *				 pShaderModule )
+{
+	CountCall( MC_vkCreateShaderModule );
+	*pShaderModule = NewHandle< VkShaderModule >();
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateSwapchainKHR( VkDevice						 device,
+													 const VkSwapchainCreateInfoKHR *pCreateInfo,
+													 const VkAllocationCallbacks *	 pAllocator,
+													 VkSwapchainKHR *				 pSwapchain )
+{
+	CountCall( MC_vkCreateSwapchainKHR );
+	*pSwapchain = NewHandle< VkSwapchainKHR >();
+	return VK_SUCCESS;
+}
+
+#if defined( VK_USE_PLATFORM_WIN32_KHR )
+VKAPI_ATTR VkResult VKAPI_CALL vkCreateWin32SurfaceKHR( VkInstance						   instance,
+														const VkWin32SurfaceCreateInfoKHR *pCreateInfo,
+														const VkAllocationCallbacks *	   pAllocator,
+														VkSurfaceKHR *					   pSurface )
+{
+	CountCall( MC_vkCreateWin32SurfaceKHR );
+	*pSurface = NewHandle< VkSurfaceKHR >();
+	return VK_SUCCESS;
+}
+#endif
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyBuffer( VkDevice device, VkBuffer buffer, const VkAllocationCallbacks *pAllocator )
+{
+	CountCall( MC_vkDestroyBuffer );
+	delete FromHandle< mockBuffer_t >( buffer );
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyCommandPool( VkDevice					  device,
+												 VkCommandPool				  commandPool,
+												 const VkAllocationCallbacks *pAllocator )
+{
+	CountCall( MC_vkDestroyCommandPool );
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyDescriptorPool( VkDevice					 device,
+													VkDescriptorPool			 descriptorPool,
+													const VkAllocationCallbacks *pAllocator )
+{
+	CountCall( MC_vkDestroyDescriptorPool );
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyDescriptorSetLayout( VkDevice					  device,
+														 VkDescriptorSetLayout		  descriptorSetLayout,
+														 const VkAllocationCallbacks *pAllocator )
+{
+	CountCall( MC_vkDestroyDescriptorSetLayout );
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyDevice( VkDevice device, const VkAllocationCallbacks *pAllocator )
+{
+	CountCall( MC_vkDestroyDevice );
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyFence( VkDevice device, VkFence fence, const VkAllocationCallbacks *pAllocator )
+{
+	CountCall( MC_vkDestroyFence );
+	delete FromHandle< mockFence_t >( fence );
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyFramebuffer( VkDevice					  device,
+												 VkFramebuffer				  framebuffer,
+												 const VkAllocationCallbacks *pAllocator )
+{
+	CountCall( MC_vkDestroyFramebuffer );
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyImage( VkDevice device, VkImage image, const VkAllocationCallbacks *pAllocator )
+{
+	CountCall( MC_vkDestroyImage );
+	delete FromHandle< mockImage_t >( image );
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyImageView( VkDevice						device,
+											   VkImageView					imageView,
+											   const VkAllocationCallbacks *pAllocator )
+{
+	CountCall( MC_vkDestroyImageView );
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyInstance( VkInstance instance, const VkAllocationCallbacks *pAllocator )
+{
+	CountCall( MC_vkDestroyInstance );
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyPipeline( VkDevice					   device,
+											  VkPipeline				   pipeline,
+											  const VkAllocationCallbacks *pAllocator )
+{
+	CountCall( MC_vkDestroyPipeline );
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyPipelineCache( VkDevice						device,
+												   VkPipelineCache				pipelineCache,
+												   const VkAllocationCallbacks *pAllocator )
+{
+	CountCall( MC_vkDestroyPipelineCache );
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyPipelineLayout( VkDevice					 device,
+													VkPipelineLayout			 pipelineLayout,
+													const VkAllocationCallbacks *pAllocator )
+{
+	CountCall( MC_vkDestroyPipelineLayout );
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyQueryPool( VkDevice						device,
+											   VkQueryPool					queryPool,
+											   const VkAllocationCallbacks *pAllocator )
+{
+	CountCall( MC_vkDestroyQueryPool );
+	delete FromHandle< mockQueryPool_t >( queryPool );
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyRenderPass( VkDevice					 device,
+												VkRenderPass				 renderPass,
+												const VkAllocationCallbacks *pAllocator )
+{
+	CountCall( MC_vkDestroyRenderPass );
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroySampler( VkDevice					  device,
+											 VkSampler					  sampler,
+											 const VkAllocationCallbacks *pAllocator )
+{
+	CountCall( MC_vkDestroySampler );
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroySemaphore( VkDevice						device,
+											   VkSemaphore					semaphore,
+											   const VkAllocationCallbacks *pAllocator )
+{
+	CountCall( MC_vkDestroySemaphore );
+	delete FromHandle< mockSemaphore_t >( semaphore );
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroyShaderModule( VkDevice					   device,
+												  VkShaderModule			   shaderModule,
+												  const VkAllocationCallbacks *pAllocator )
+{
+	CountCall( MC_vkDestroyShaderModule );
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroySurfaceKHR( VkInstance					 instance,
+												VkSurfaceKHR				 surface,
+												const VkAllocationCallbacks *pAllocator )
+{
+	CountCall( MC_vkDestroySurfaceKHR );
+}
+
+VKAPI_ATTR void VKAPI_CALL vkDestroySwapchainKHR( VkDevice					   device,
+												  VkSwapchainKHR			   swapchain,
+												  const VkAllocationCallbacks *pAllocator )
+{
+	CountCall( MC_vkDestroySwapchainKHR );
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkDeviceWaitIdle( VkDevice device )
+{
+	CountCall( MC_vkDeviceWaitIdle );
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkEndCommandBuffer( VkCommandBuffer commandBuffer )
+{
+	CountCall( MC_vkEndCommandBuffer );
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkEnumerateDeviceExtensionProperties( VkPhysicalDevice		physicalDevice,
+																	 const char *			pLayerName,
+																	 uint32_t *				pPropertyCount,
+																	 VkExtensionProperties *pProperties )
+{
+	CountCall( MC_vkEnumerateDeviceExtensionProperties );
+	static const char *extensions[] = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
+	return EnumerateExtensions( extensions, ARRAY_SIZE( extensions ), pPropertyCount, pProperties );
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkEnumerateInstanceExtensionProperties( const char *			  pLayerName,
+																	   uint32_t *			  pPropertyCount,
+																	   VkExtensionProperties *pProperties )
+{
+	CountCall( MC_vkEnumerateInstanceExtensionProperties );
+
+	static const char *extensions[] = { VK_KHR_SURFACE_EXTENSION_NAME,
+										"VK_KHR_win32_surface",
+										VK_EXT_DEBUG_REPORT_EXTENSION_NAME };
+	return EnumerateExtensions( extensions, ARRAY_SIZE( extensions ), pPropertyCount, pProperties );
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkEnumerateInstanceLayerProperties( uint32_t *		  pPropertyCount,
+																   VkLayerProperties *pProperties )
+{
+	CountCall( MC_vkEnumerateInstanceLayerProperties );
+
+	static const char *layers[] = { "VK_LAYER_KHRONOS_validation" };
+	if ( pProperties == nullptr )
+	{
+		*pPropertyCount = ARRAY_SIZE( layers );
+		return VK_SUCCESS;
+	}
+
+	*pPropertyCount = std::min( *pPropertyCount, uint32_t( ARRAY_SIZE( layers ) ) );
+	for ( uint32_t i = 0; i < *pPropertyCount; ++i )
+	{
+		pProperties[ i ] = {};
+		std::snprintf( pProperties[ i ].layerName, VK_MAX_EXTENSION_NAME_SIZE, "%s", layers[ i ] );
+		pProperties[ i ].specVersion = VK_API_VERSION_1_2;
+	}
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkEnumeratePhysicalDevices( VkInstance		 instance,
+														   uint32_t *		 pPhysicalDeviceCount,
+														   VkPhysicalDevice *pPhysicalDevices )
+{
+	CountCall( MC_vkEnumeratePhysicalDevices );
+
+	if ( pPhysicalDevices != nullptr && *pPhysicalDeviceCount > 0 )
+	{
+		pPhysicalDevices[ 0 ] = ToHandle< VkPhysicalDevice >( &g_physicalDevice );
+	}
+	*pPhysicalDeviceCount = 1;
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkFlushMappedMemoryRanges( VkDevice					 device,
+														  uint32_t					 memoryRangeCount,
+														  const VkMappedMemoryRange *pMemoryRanges )
+{
+	CountCall( MC_vkFlushMappedMemoryRanges );
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkFreeCommandBuffers( VkDevice				device,
+												 VkCommandPool			commandPool,
+												 uint32_t				commandBufferCount,
+												 const VkCommandBuffer *pCommandBuffers )
+{
+	CountCall( MC_vkFreeCommandBuffers );
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkFreeDescriptorSets( VkDevice				device,
+													 VkDescriptorPool		descriptorPool,
+													 uint32_t				descriptorSetCount,
+													 const VkDescriptorSet *pDescriptorSets )
+{
+	CountCall( MC_vkFreeDescriptorSets );
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkFreeMemory( VkDevice					  device,
+										 VkDeviceMemory				  memory,
+										 const VkAllocationCallbacks *pAllocator )
+{
+	CountCall( MC_vkFreeMemory );
+
+	if ( memory == VK_NULL_HANDLE )
+	{
+		return;
+	}
+
+	auto *mockMemory = FromHandle< mockMemory_t >( memory );
+	g_deviceMemoryBytes -= mockMemory->size;
+	std::free( mockMemory->data );
+	delete mockMemory;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetBufferMemoryRequirements( VkDevice				device,
+														  VkBuffer				buffer,
+														  VkMemoryRequirements *pMemoryRequirements )
+{
+	CountCall( MC_vkGetBufferMemoryRequirements );
+
+	pMemoryRequirements->size			= Align( FromHandle< mockBuffer_t >( buffer )->size, MOCK_ALIGNMENT );
+	pMemoryRequirements->alignment		= MOCK_ALIGNMENT;
+	pMemoryRequirements->memoryTypeBits = MOCK_MEMORY_TYPE_BITS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetDeviceQueue( VkDevice device,
+											 uint32_t queueFamilyIndex,
+											 uint32_t queueIndex,
+											 VkQueue *pQueue )
+{
+	CountCall( MC_vkGetDeviceQueue );
+	*pQueue = ToHandle< VkQueue >( &g_queues[ std::min( queueFamilyIndex, uint32_t( g_queues.size() - 1 ) ) ] );
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkGetFenceStatus( VkDevice device, VkFence fence )
+{
+	CountCall( MC_vkGetFenceStatus );
+	return FromHandle< mockFence_t >( fence )->signaled ? VK_SUCCESS : VK_NOT_READY;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetImageMemoryRequirements( VkDevice			   device,
+														 VkImage			   image,
+														 VkMemoryRequirements *pMemoryRequirements )
+{
+	CountCall( MC_vkGetImageMemoryRequirements );
+
+	pMemoryRequirements->size			= Align( FromHandle< mockImage_t >( image )->size, MOCK_ALIGNMENT );
+	pMemoryRequirements->alignment		= MOCK_ALIGNMENT;
+	pMemoryRequirements->memoryTypeBits = MOCK_MEMORY_TYPE_BITS;
+}
+
+VKAPI_ATTR PFN_vkVoidFunction VKAPI_CALL vkGetInstanceProcAddr( VkInstance instance, const char *pName )
+{
+	CountCall( MC_vkGetInstanceProcAddr );
+	return nullptr;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceFeatures( VkPhysicalDevice		  physicalDevice,
+														VkPhysicalDeviceFeatures *pFeatures )
+{
+	CountCall( MC_vkGetPhysicalDeviceFeatures );
+
+	std::memset( pFeatures, 0, sizeof( *pFeatures ) );
+	pFeatures->depthBounds			   = VK_TRUE;
+	pFeatures->fillModeNonSolid		   = VK_TRUE;
+	pFeatures->samplerAnisotropy	   = VK_TRUE;
+	pFeatures->pipelineStatisticsQuery = VK_TRUE;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceFormatProperties( VkPhysicalDevice	physicalDevice,
+																VkFormat			format,
+																VkFormatProperties *pFormatProperties )
+{
+	CountCall( MC_vkGetPhysicalDeviceFormatProperties );
+
+	pFormatProperties->linearTilingFeatures	 = ~VkFormatFeatureFlags( 0 );
+	pFormatProperties->optimalTilingFeatures = ~VkFormatFeatureFlags( 0 );
+	pFormatProperties->bufferFeatures		 = ~VkFormatFeatureFlags( 0 );
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceMemoryProperties( VkPhysicalDevice				  physicalDevice,
+																VkPhysicalDeviceMemoryProperties *pMemoryProperties )
+{
+	CountCall( MC_vkGetPhysicalDeviceMemoryProperties );
+
+	*pMemoryProperties = {};
+
+	pMemoryProperties->memoryHeapCount		  = 2;
+	pMemoryProperties->memoryHeaps[ 0 ].size  = VkDeviceSize( 4 ) << 30;
+	pMemoryProperties->memoryHeaps[ 0 ].flags = VK_MEMORY_HEAP_DEVICE_LOCAL_BIT;
+	pMemoryProperties->memoryHeaps[ 1 ].size  = VkDeviceSize( 4 ) << 30;
+	pMemoryProperties->memoryHeaps[ 1 ].flags = 0;
+
+	pMemoryProperties->memoryTypeCount				  = 3;
+	pMemoryProperties->memoryTypes[ 0 ].propertyFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+	pMemoryProperties->memoryTypes[ 0 ].heapIndex	  = 0;
+	pMemoryProperties->memoryTypes[ 1 ].propertyFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+														VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	pMemoryProperties->memoryTypes[ 1 ].heapIndex	  = 1;
+	pMemoryProperties->memoryTypes[ 2 ].propertyFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT |
+														VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+														VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	pMemoryProperties->memoryTypes[ 2 ].heapIndex	  = 0;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceProperties( VkPhysicalDevice			  physicalDevice,
+														  VkPhysicalDeviceProperties *pProperties )
+{
+	CountCall( MC_vkGetPhysicalDeviceProperties );
+	FillPhysicalDeviceProperties( *pProperties );
+}
+
+VKAPI_ATTR void VKAPI_CALL vkGetPhysicalDeviceProperties2( VkPhysicalDevice				physicalDevice,
+														   VkPhysicalDeviceProperties2 *pProperties )
+{
+	CountCall( MC_vkGetPhysicalDeviceProperties2 );
+	FillPhysicalDeviceProperties( pProperties->properties );
+}
+
+VKAPI_ATTR void VKAPI_CALL
+vkGetPhysicalDeviceQueueFamilyProperties( VkPhysicalDevice		   physicalDevice,
+										  uint32_t *			   pQueueFamilyPropertyCount,
+										  VkQueueFamilyProperties *pQueueFamilyProperties )
+{
+	CountCall( MC_vkGetPhysicalDeviceQueueFamilyProperties );
+
+	// One universal family, one compute only family and one transfer only family, as found on most discrete GPUs
+	static const VkQueueFamilyProperties families[] = {
+		{ VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT, 1, 64, { 1, 1, 1 } },
+		{ VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT, 1, 64, { 1, 1, 1 } },
+		{ VK_QUEUE_TRANSFER_BIT, 1, 64, { 1, 1, 1 } }
+	};
+
+	if ( pQueueFamilyProperties == nullptr )
+	{
+		*pQueueFamilyPropertyCount = ARRAY_SIZE( families );
+		return;
+	}
+
+	*pQueueFamilyPropertyCount = std::min( *pQueueFamilyPropertyCount, uint32_t( ARRAY_SIZE( families ) ) );
+	std::memcpy( pQueueFamilyProperties, families, *pQueueFamilyPropertyCount * sizeof( VkQueueFamilyProperties ) );
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL
+vkGetPhysicalDeviceSurfaceCapabilitiesKHR( VkPhysicalDevice			 physicalDevice,
+										   VkSurfaceKHR				 surface,
+										   VkSurfaceCapabilitiesKHR *pSurfaceCapabilities )
+{
+	CountCall( MC_vkGetPhysicalDeviceSurfaceCapabilitiesKHR );
+
+	*pSurfaceCapabilities = {};
+
+	pSurfaceCapabilities->minImageCount			  = 2;
+	pSurfaceCapabilities->maxImageCount			  = 8;
+	pSurfaceCapabilities->currentExtent			  = { MOCK_SURFACE_WIDTH, MOCK_SURFACE_HEIGHT };
+	pSurfaceCapabilities->minImageExtent		  = { 1, 1 };
+	pSurfaceCapabilities->maxImageExtent		  = { 16384, 16384 };
+	pSurfaceCapabilities->maxImageArrayLayers	  = 1;
+	pSurfaceCapabilities->supportedTransforms	  = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR;
+	pSurfaceCapabilities->currentTransform		  = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR;
+	pSurfaceCapabilities->supportedCompositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
+	pSurfaceCapabilities->supportedUsageFlags	  = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+													VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkGetPhysicalDeviceSurfaceFormatsKHR( VkPhysicalDevice	 physicalDevice,
+																	 VkSurfaceKHR		 surface,
+																	 uint32_t *			 pSurfaceFormatCount,
+																	 VkSurfaceFormatKHR *pSurfaceFormats )
+{
+	CountCall( MC_vkGetPhysicalDeviceSurfaceFormatsKHR );
+
+	if ( pSurfaceFormats != nullptr && *pSurfaceFormatCount > 0 )
+	{
+		pSurfaceFormats[ 0 ] = { VK_FORMAT_B8G8R8A8_UNORM, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR };
+	}
+	*pSurfaceFormatCount = 1;
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkGetPhysicalDeviceSurfacePresentModesKHR( VkPhysicalDevice	physicalDevice,
+																		  VkSurfaceKHR		surface,
+																		  uint32_t *		pPresentModeCount,
+																		  VkPresentModeKHR *pPresentModes )
+{
+	CountCall( MC_vkGetPhysicalDeviceSurfacePresentModesKHR );
+
+	if ( pPresentModes != nullptr && *pPresentModeCount > 0 )
+	{
+		pPresentModes[ 0 ] = VK_PRESENT_MODE_FIFO_KHR;
+	}
+	*pPresentModeCount = 1;
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkGetPhysicalDeviceSurfaceSupportKHR( VkPhysicalDevice physicalDevice,
+																	 uint32_t		  queueFamilyIndex,
+																	 VkSurfaceKHR	  surface,
+																	 VkBool32 *		  pSupported )
+{
+	CountCall( MC_vkGetPhysicalDeviceSurfaceSupportKHR );
+	*pSupported = queueFamilyIndex == 0 ? VK_TRUE : VK_FALSE;
+	return VK_SUCCESS;
+}
+
+// Pipelines are not compiled, the cache only holds the header every driver writes
+VKAPI_ATTR VkResult VKAPI_CALL vkGetPipelineCacheData( VkDevice		device,
+													   VkPipelineCache pipelineCache,
+													   size_t *		pDataSize,
+													   void *			pData )
+{
+	CountCall( MC_vkGetPipelineCacheData );
+
+	std::array< uint32_t, 4 + VK_UUID_SIZE / 4 > header {};
+	header[ 0 ] = static_cast< uint32_t >( sizeof( header ) );
+	header[ 1 ] = VK_PIPELINE_CACHE_HEADER_VERSION_ONE;
+	header[ 2 ] = MOCK_VENDOR_ID;
+	header[ 3 ] = MOCK_DEVICE_ID;
+	std::memcpy( &header[ 4 ], MOCK_PIPELINE_CACHE_UUID, VK_UUID_SIZE );
+
+	if ( pData == nullptr )
+	{
+		*pDataSize = sizeof( header );
+		return VK_SUCCESS;
+	}
+
+	const size_t size = std::min( *pDataSize, sizeof( header ) );
+	std::memcpy( pData, header.data(), size );
+	*pDataSize = size;
+	return size < sizeof( header ) ? VK_INCOMPLETE : VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkGetQueryPoolResults( VkDevice			 device,
+													  VkQueryPool		 queryPool,
+													  uint32_t			 firstQuery,
+													  uint32_t			 queryCount,
+													  size_t			 dataSize,
+													  void *			 pData,
+													  VkDeviceSize		 stride,
+													  VkQueryResultFlags flags )
+{
+	CountCall( MC_vkGetQueryPoolResults );
+
+	const mockQueryPool_t *pool = FromHandle< mockQueryPool_t >( queryPool );
+	for ( uint32_t i = 0; i < queryCount; ++i )
+	{
+		byte *result = static_cast< byte * >( pData ) + i * stride;
+		for ( uint32_t j = 0; j < pool->valueCount; ++j )
+		{
+			const uint64_t value = pool->values[ ( firstQuery + i ) * pool->valueCount + j ];
+			if ( flags & VK_QUERY_RESULT_64_BIT )
+			{
+				reinterpret_cast< uint64_t * >( result )[ j ] = value;
+			}
+			else
+			{
+				reinterpret_cast< uint32_t * >( result )[ j ] = static_cast< uint32_t >( value );
+			}
+		}
+	}
+
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkGetSemaphoreCounterValue( VkDevice	   device,
+														   VkSemaphore semaphore,
+														   uint64_t *  pValue )
+{
+	CountCall( MC_vkGetSemaphoreCounterValue );
+	*pValue = FromHandle< mockSemaphore_t >( semaphore )->value;
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkGetSwapchainImagesKHR( VkDevice	   device,
+														VkSwapchainKHR swapchain,
+														uint32_t *	   pSwapchainImageCount,
+														VkImage *	   pSwapchainImages )
+{
+	CountCall( MC_vkGetSwapchainImagesKHR );
+
+	if ( pSwapchainImages == nullptr )
+	{
+		*pSwapchainImageCount = MOCK_SWAPCHAIN_IMAGES;
+		return VK_SUCCESS;
+	}
+
+	*pSwapchainImageCount = std::min( *pSwapchainImageCount, MOCK_SWAPCHAIN_IMAGES );
+	for ( uint32_t i = 0; i < *pSwapchainImageCount; ++i )
+	{
+		pSwapchainImages[ i ] = ToHandle< VkImage >( &g_swapchainImages[ i ] );
+	}
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkMapMemory( VkDevice		 device,
+											VkDeviceMemory	 memory,
+											VkDeviceSize	 offset,
+											VkDeviceSize	 size,
+											VkMemoryMapFlags flags,
+											void **			 ppData )
+{
+	CountCall( MC_vkMapMemory );
+	*ppData = FromHandle< mockMemory_t >( memory )->data + offset;
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkQueuePresentKHR( VkQueue queue, const VkPresentInfoKHR *pPresentInfo )
+{
+	CountCall( MC_vkQueuePresentKHR );
+
+	if ( pPresentInfo->pResults != nullptr )
+	{
+		for ( uint32_t i = 0; i < pPresentInfo->swapchainCount; ++i )
+		{
+			pPresentInfo->pResults[ i ] = VK_SUCCESS;
+		}
+	}
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkQueueSubmit( VkQueue			  queue,
+											  uint32_t			  submitCount,
+											  const VkSubmitInfo *pSubmits,
+											  VkFence			  fence )
+{
+	CountCall( MC_vkQueueSubmit );
+
+	for ( uint32_t i = 0; i < submitCount; ++i )
+	{
+		const VkSubmitInfo &submit = pSubmits[ i ];
+		for ( auto *next = static_cast< const VkBaseInStructure * >( submit.pNext ); next; next = next->pNext )
+		{
+			if ( next->sType != VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO )
+			{
+				continue;
+			}
+
+			const auto *timelineInfo = reinterpret_cast< const VkTimelineSemaphoreSubmitInfo * >( next );
+			for ( uint32_t j = 0; j < timelineInfo->signalSemaphoreValueCount; ++j )
+			{
+				FromHandle< mockSemaphore_t >( submit.pSignalSemaphores[ j ] )->value =
+					timelineInfo->pSignalSemaphoreValues[ j ];
+			}
+		}
+	}
+
+	if ( fence != VK_NULL_HANDLE )
+	{
+		FromHandle< mockFence_t >( fence )->signaled = true;
+	}
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkQueueWaitIdle( VkQueue queue )
+{
+	CountCall( MC_vkQueueWaitIdle );
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkResetCommandPool( VkDevice				   device,
+												   VkCommandPool		   commandPool,
+												   VkCommandPoolResetFlags flags )
+{
+	CountCall( MC_vkResetCommandPool );
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkResetFences( VkDevice device, uint32_t fenceCount, const VkFence *pFences )
+{
+	CountCall( MC_vkResetFences );
+
+	for ( uint32_t i = 0; i < fenceCount; ++i )
+	{
+		FromHandle< mockFence_t >( pFences[ i ] )->signaled = false;
+	}
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR void VKAPI_CALL vkUnmapMemory( VkDevice device, VkDeviceMemory memory )
+{
+	CountCall( MC_vkUnmapMemory );
+}
+
+VKAPI_ATTR void VKAPI_CALL vkUpdateDescriptorSets( VkDevice					   device,
+												   uint32_t					   descriptorWriteCount,
+												   const VkWriteDescriptorSet *pDescriptorWrites,
+												   uint32_t					   descriptorCopyCount,
+												   const VkCopyDescriptorSet * pDescriptorCopies )
+{
+	CountCall( MC_vkUpdateDescriptorSets );
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkWaitForFences( VkDevice	   device,
+												uint32_t	   fenceCount,
+												const VkFence *pFences,
+												VkBool32	   waitAll,
+												uint64_t	   timeout )
+{
+	CountCall( MC_vkWaitForFences );
+
+	// Submissions complete immediately, a fence that is not signaled was never submitted
+	for ( uint32_t i = 0; i < fenceCount; ++i )
+	{
+		if ( !FromHandle< mockFence_t >( pFences[ i ] )->signaled )
+		{
+			return VK_TIMEOUT;
+		}
+	}
+	return VK_SUCCESS;
+}
+
+VKAPI_ATTR VkResult VKAPI_CALL vkWaitSemaphores( VkDevice					device,
+												 const VkSemaphoreWaitInfo *pWaitInfo,
+												 uint64_t					timeout )
+{
+	CountCall( MC_vkWaitSemaphores );
+
+	// Submissions complete immediately, a value not reached yet was never submitted
+	for ( uint32_t i = 0; i < pWaitInfo->semaphoreCount; ++i )
+	{
+		const uint64_t value   = FromHandle< mockSemaphore_t >( pWaitInfo->pSemaphores[ i ] )->value;
+		const bool	   reached = value >= pWaitInfo->pValues[ i ];
+		if ( reached && ( pWaitInfo->flags & VK_SEMAPHORE_WAIT_ANY_BIT ) )
+		{
+			return VK_SUCCESS;
+		}
+		if ( !reached && !( pWaitInfo->flags & VK_SEMAPHORE_WAIT_ANY_BIT ) )
+		{
+			return VK_TIMEOUT;
+		}
+	}
+	return ( pWaitInfo->flags & VK_SEMAPHORE_WAIT_ANY_BIT ) ? VK_TIMEOUT : VK_SUCCESS;
+}
+
+} // extern "C"
@@ -0,0 +1,150 @@
+// Copyright (c) 2021 Arno Galvez
+
+#pragma once
+
+#include "external/vulkan/vulkan.hpp"
+
+#include <cstdint>
+
+// Host backed fake of the Vulkan entry points used by the engine. Linking vkmock_lib in place of the Vulkan loader
+// (RUNA_MOCK_VULKAN CMake option) runs the CPU side of the renderer without a GPU:
+// - device memory is allocated on the heap and can be mapped,
+// - copy and fill commands are executed on the host when recorded,
+// - submissions complete immediately and signal their fence and timeline semaphores,
+// - every entry point counts its calls.
+
+#define RUNA_MOCK_ENTRY_POINTS( X )                \
+	X( vkAcquireNextImageKHR )                     \
+	X( vkAllocateCommandBuffers )                  \
+	X( vkAllocateDescriptorSets )                  \
+	X( vkAllocateMemory )                          \
+	X( vkBeginCommandBuffer )                      \
+	X( vkBindBufferMemory )                        \
+	X( vkBindImageMemory )                         \
+	X( vkCmdBeginQuery )                           \
+	X( vkCmdBeginRenderPass )                      \
+	X( vkCmdBindDescriptorSets )                   \
+	X( vkCmdBindIndexBuffer )                      \
+	X( vkCmdBindPipeline )                         \
+	X( vkCmdBindVertexBuffers )                    \
+	X( vkCmdCopyBuffer )                           \
+	X( vkCmdCopyBufferToImage )                    \
+	X( vkCmdDispatch )                             \
+	X( vkCmdDraw )                                 \
+	X( vkCmdDrawIndexed )                          \
+	X( vkCmdEndQuery )                             \
+	X( vkCmdEndRenderPass )                        \
+	X( vkCmdExecuteCommands )                      \
+	X( vkCmdFillBuffer )                           \
+	X( vkCmdPipelineBarrier )                      \
+	X( vkCmdPushConstants )                        \
+	X( vkCmdResetQueryPool )                       \
+	X( vkCmdSetDepthBounds )                       \
+	X( vkCmdSetScissor )                           \
+	X( vkCmdSetViewport )                          \
+	X( vkCmdWriteTimestamp )                       \
+	X( vkCreateBuffer )                            \
+	X( vkCreateCommandPool )                       \
+	X( vkCreateComputePipelines )                  \
+	X( vkCreateDescriptorPool )                    \
+	X( vkCreateDescriptorSetLayout )               \
+	X( vkCreateDevice )                            \
+	X( vkCreateFence )                             \
+	X( vkCreateFramebuffer )                       \
+	X( vkCreateGraphicsPipelines )                 \
+	X( vkCreateImage )                             \
+	X( vkCreateImageView )                         \
+	X( vkCreateInstance )                          \
+	X( vkCreatePipelineCache )                     \
+	X( vkCreatePipelineLayout )                    \
+	X( vkCreateQueryPool )                         \
+	X( vkCreateRenderPass )                        \
+	X( vkCreateSampler )                           \
+	X( vkCreateSemaphore )                         \
+	X( vkCreateShaderModule )                      \
+	X( vkCreateSwapchainKHR )                      \
+	X( vkCreateWin32SurfaceKHR )                   \
+	X( vkDestroyBuffer )                           \
+	X( vkDestroyCommandPool )                      \
+	X( vkDestroyDescriptorPool )                   \
+	X( vkDestroyDescriptorSetLayout )              \
+	X( vkDestroyDevice )                           \
+	X( vkDestroyFence )                            \
+	X( vkDestroyFramebuffer )                      \
+	X( vkDestroyImage )                            \
+	X( vkDestroyImageView )                        \
+	X( vkDestroyInstance )                         \
+	X( vkDestroyPipeline )                         \
+	X( vkDestroyPipelineCache )                    \
+	X( vkDestroyPipelineLayout )                   \
+	X( vkDestroyQueryPool )                        \
+	X( vkDestroyRenderPass )                       \
+	X( vkDestroySampler )                          \
+	X( vkDestroySemaphore )                        \
+	X( vkDestroyShaderModule )                     \
+	X( vkDestroySurfaceKHR )                       \
+	X( vkDestroySwapchainKHR )                     \
+	X( vkDeviceWaitIdle )                          \
+	X( vkEndCommandBuffer )                        \
+	X( vkEnumerateDeviceExtensionProperties )      \
+	X( vkEnumerateInstanceExtensionProperties )    \
+	X( vkEnumerateInstanceLayerProperties )        \
+	X( vkEnumeratePhysicalDevices )                \
+	X( vkFlushMappedMemoryRanges )                 \
+	X( vkFreeCommandBuffers )                      \
+	X( vkFreeDescriptorSets )                      \
+	X( vkFreeMemory )                              \
+	X( vkGetBufferMemoryRequirements )             \
+	X( vkGetDeviceQueue )                          \
+	X( vkGetFenceStatus )                          \
+	X( vkGetImageMemoryRequirements )              \
+	X( vkGetInstanceProcAddr )                     \
+	X( vkGetPhysicalDeviceFeatures )               \
+	X( vkGetPhysicalDeviceFormatProperties )       \
+	X( vkGetPhysicalDeviceMemoryProperties )       \
+	X( vkGetPhysicalDeviceProperties )             \
+	X( vkGetPhysicalDeviceProperties2 )            \
+	X( vkGetPhysicalDeviceQueueFamilyProperties )  \
+	X( vkGetPhysicalDeviceSurfaceCapabilitiesKHR ) \
+	X( vkGetPhysicalDeviceSurfaceFormatsKHR )      \
+	X( vkGetPhysicalDeviceSurfacePresentModesKHR ) \
+	X( vkGetPhysicalDeviceSurfaceSupportKHR )      \
+	X( vkGetPipelineCacheData )                    \
+	X( vkGetQueryPoolResults )                     \
+	X( vkGetSemaphoreCounterValue )                \
+	X( vkGetSwapchainImagesKHR )                   \
+	X( vkMapMemory )                               \
+	X( vkQueuePresentKHR )                         \
+	X( vkQueueSubmit )                             \
+	X( vkQueueWaitIdle )                           \
+	X( vkResetCommandPool )                        \
+	X( vkResetFences )                             \
+	X( vkUnmapMemory )                             \
+	X( vkUpdateDescriptorSets )                    \
+	X( vkWaitForFences )                           \
+	X( vkWaitSemaphores )
+
+namespace vkRuna
+{
+namespace render
+{
+namespace mock
+{
+enum mockCall_t
+{
+#define RUNA_MOCK_CALL_ENUM( name ) MC_##name,
+	RUNA_MOCK_ENTRY_POINTS( RUNA_MOCK_CALL_ENUM )
+#undef RUNA_MOCK_CALL_ENUM
+	MC_COUNT
+};
+
+uint64_t	GetCallCount( mockCall_t call );
+const char *GetCallName( mockCall_t call );
+void		ResetCallCounts();
+void		PrintCallCounts(); // Entry points called at least once
+
+VkDeviceSize GetDeviceMemoryBytes(); // Bytes currently allocated with vkAllocateMemory
+
+} // namespace mock
+} // namespace render
+} // namespace vkRuna
@@ -3,7 +3,6 @@
 #include "Camera.h"
 
 #include "external/glm/gtc/matrix_transform.hpp"
-#include "platform/Window.h"
 
 namespace vkRuna
 {
@@ -12,11 +11,7 @@ static const glm::vec3 camUp( 0.0f, 0.0f, 1.0f );
 
 void Camera::UpdateProjView()
 {
-	const auto &winProps = Window::GetInstance().GetProps();
-
-	float aspect = static_cast< float >( winProps.width ) / static_cast< float >( winProps.height );
-
-	m_proj = glm::perspective( glm::radians( m_frame.fov ), aspect, m_frame.nearPlane, m_frame.farPlane );
+	m_proj = glm::perspective( glm::radians( m_frame.fov ), m_aspect, m_frame.nearPlane, m_frame.farPlane );
 	m_proj[ 1 ][ 1 ] *= -1.0f; // In Vulkan viewport Y-axis points down
 
 	float i_rad = glm::radians( m_frame.i );
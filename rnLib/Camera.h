@@ -32,6 +32,7 @@ class Camera
    public:
 	void UpdateProjView();
 	void Reset();
+	void SetAspect( float aspect ) { m_aspect = aspect; } // Width over height of the viewport
 
 	glm::vec3		 GetFront();
 	glm::vec3		 GetRight();
@@ -46,6 +47,7 @@ class Camera
 	cameraFrame_t m_frame;
 	glm::mat4	  m_proj;
 	glm::mat4	  m_view;
+	float		  m_aspect = 1.0f;
 };
 
 } // namespace vkRuna
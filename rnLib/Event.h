@@ -7,6 +7,7 @@
 #include <cstdarg>
 #include <functional>
 #include <string>
+#include <vector>
 
 namespace vkRuna
 {
@@ -36,7 +37,8 @@ class Event
 class EventOnShaderRead : public Event
 {
    public:
-	using Func = std::function< bool( std::string *, shaderStage_t ) >;
+	// lineMap: filled when the shader code is rewritten, from the lines of the new code to the ones of the old code
+	using Func = std::function< bool( std::string *, shaderStage_t, std::vector< shaderLineMap_t > * ) >;
 
    public:
 	EventOnShaderRead( Func &&f )
@@ -48,17 +50,22 @@ class EventOnShaderRead : public Event
 		va_list args;
 		va_start( args, dummy );
 
-		std::string * str	= va_arg( args, std::string * );
-		shaderStage_t stage = va_arg( args, shaderStage_t );
+		// Enums go through an ellipsis as their promoted underlying type
+		std::string *					 str	 = va_arg( args, std::string * );
+		shaderStage_t					 stage	 = static_cast< shaderStage_t >( va_arg( args, uint32_t ) );
+		std::vector< shaderLineMap_t > *lineMap = va_arg( args, std::vector< shaderLineMap_t > * );
 
-		bool ret = Call( str, stage );
+		bool ret = Call( str, stage, lineMap );
 
 		va_end( args );
 
 		return ret;
 	}
 
-	bool Call( std::string *s, shaderStage_t stage ) { return m_f( s, stage ); }
+	bool Call( std::string *s, shaderStage_t stage, std::vector< shaderLineMap_t > *lineMap )
+	{
+		return m_f( s, stage, lineMap );
+	}
 
    private:
 	Func m_f;
@@ -0,0 +1,22 @@
+// Copyright (c) 2021 Arno Galvez
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+static constexpr uint64_t FNV1A_OFFSET_BASIS = 0xcbf29ce484222325ull;
+static constexpr uint64_t FNV1A_PRIME		 = 0x100000001b3ull;
+
+// 64 bits FNV-1a, stable across platforms and runs unlike std::hash. Chain calls by passing the previous hash.
+inline uint64_t HashFNV1a( const void *data, size_t size, uint64_t hash = FNV1A_OFFSET_BASIS )
+{
+	const uint8_t *bytes = static_cast< const uint8_t * >( data );
+	for ( size_t i = 0; i < size; ++i )
+	{
+		hash ^= bytes[ i ];
+		hash *= FNV1A_PRIME;
+	}
+
+	return hash;
+}
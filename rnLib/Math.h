@@ -4,6 +4,10 @@
 
 #include <cstdint>
 
+#if defined( _MSC_VER )
+	#include <intrin.h>
+#endif
+
 template< typename T >
 inline T Align( T x, T alignment )
 {
@@ -46,6 +50,30 @@ constexpr int bsr( uint64_t n )
 	return i;
 }
 
+// Index of least significant set bit, using hardware bit scan. n must not be 0.
+inline int bitScanForward( uint64_t n )
+{
+#if defined( _MSC_VER )
+	unsigned long i;
+	_BitScanForward64( &i, n );
+	return static_cast< int >( i );
+#else
+	return __builtin_ctzll( n );
+#endif
+}
+
+// Index of most significant set bit, using hardware bit scan. n must not be 0.
+inline int bitScanReverse( uint64_t n )
+{
+#if defined( _MSC_VER )
+	unsigned long i;
+	_BitScanReverse64( &i, n );
+	return static_cast< int >( i );
+#else
+	return 63 - __builtin_clzll( n );
+#endif
+}
+
 constexpr uint64_t enumMask( uint64_t second, uint64_t last )
 {
 	uint64_t sm	  = fls( second ) - 1;
@@ -7,6 +7,9 @@
 #include "renderer/VFX.h"
 #include "rnLib/Math.h"
 
+#include <array>
+#include <cstring>
+
 namespace vkRuna
 {
 using namespace sys;
@@ -84,6 +87,49 @@ bool PipelineController::Reload()
 	return m_isValid;
 }
 
+bool PipelineController::GetReloadDesc( render::pipelineReloadDesc_t &desc ) const
+{
+	std::shared_ptr< render::pipelineProg_t > pp = m_pipeline.lock();
+	if ( !pp )
+	{
+		return false;
+	}
+
+	desc		   = render::pipelineReloadDesc_t();
+	desc.pipeline  = m_pipeline;
+	desc.stateBits = pp->stateBits;
+
+	for ( const shaderView_t &sv : m_shaderViews )
+	{
+		if ( sv.path.size() > 0 )
+		{
+			desc.stages.emplace_back( sv.stage );
+			desc.paths.emplace_back( sv.path );
+		}
+	}
+
+	return !desc.paths.empty();
+}
+
+void PipelineController::Update()
+{
+	std::shared_ptr< render::pipelineProg_t > pp = m_pipeline.lock();
+	if ( !pp || pp->generation == m_generation )
+	{
+		return;
+	}
+
+	// The views point to the UBOs of the previous pipeline
+	m_generation = pp->generation;
+	m_isValid	 = pp->GetStatus() == render::pipelineStatus_t::Ok;
+
+	m_gpuVarViews.clear();
+	if ( m_isValid )
+	{
+		ExtractGPUVarViews( pp );
+	}
+}
+
 void PipelineController::SetPipeline( std::weak_ptr< render::pipelineProg_t > pipeline, uint32_t stageBits )
 {
 	m_pipeline = pipeline;
@@ -99,7 +145,8 @@ void PipelineController::SetPipeline( std::weak_ptr< render::pipelineProg_t > pi
 		return;
 	}
 
-	m_isValid = pp->GetStatus() == render::pipelineStatus_t::Ok;
+	m_generation = pp->generation;
+	m_isValid	 = pp->GetStatus() == render::pipelineStatus_t::Ok;
 
 	bool shaderNamesValid = m_isValid || pp->GetStatus() == render::pipelineStatus_t::ShaderNotCompiled;
 
@@ -199,10 +246,23 @@ bool VFXController::Reload()
 		return false;
 	}
 
-	Log( "Reloading VFX %s", vfxPtr->GetPath().c_str() );
-
 	m_capacity = Align< uint32_t >( m_capacity, render::COMPUTE_GROUP_SIZE_X );
 
+	// Only new buffers require to stop the VFX, which restarts anyway
+	if ( vfxPtr->IsValid() && !BuffersChanged( *vfxPtr ) )
+	{
+		return ReloadAsync( *vfxPtr );
+	}
+
+	if ( render::g_pipelineManager.IsReloading( *vfxPtr->m_computePipeline ) ||
+		 render::g_pipelineManager.IsReloading( *vfxPtr->m_graphicsPipeline ) )
+	{
+		Error( "VFX %s is being reloaded, its buffers cannot change meanwhile.", vfxPtr->GetPath().c_str() );
+		return false;
+	}
+
+	Log( "Reloading VFX %s", vfxPtr->GetPath().c_str() );
+
 	// #TODO and what about VFX::m_reviveAcc ?? this whole function is garbage
 
 	// #TODO private method to set capacity, that deallocates index buffer (wait
@@ -250,6 +310,75 @@ bool VFXController::Reload()
 	return ret;
 }
 
+void VFXController::Update()
+{
+	m_computePipController.Update();
+	m_graphicsPipController.Update();
+}
+
+bool VFXController::ReloadAsync( render::VFX &vfx )
+{
+	std::array< render::pipelineReloadDesc_t, 2 > descs;
+	if ( !m_computePipController.GetReloadDesc( descs[ 0 ] ) || !m_graphicsPipController.GetReloadDesc( descs[ 1 ] ) )
+	{
+		Error( "VFX %s has no shader to reload.", vfx.GetPath().c_str() );
+		return false;
+	}
+	descs[ 1 ].stateBits = render::VFX::GetPrimitiveState( descs[ 1 ].stateBits, m_renderPrimitive );
+
+	Log( "Reloading VFX %s in the background", vfx.GetPath().c_str() );
+
+	// Applied with the new pipelines, the controller may be gone by then
+	std::weak_ptr< render::VFX > weakVFX		 = m_vfx;
+	const float					 lifeMin		 = m_lifeMin;
+	const float					 lifeMax		 = m_lifeMax;
+	const vfxRenderPrimitive_t	 renderPrimitive = m_renderPrimitive;
+
+	auto onDone = [ weakVFX, lifeMin, lifeMax, renderPrimitive ]( bool swapped ) {
+		std::shared_ptr< render::VFX > vfxPtr = weakVFX.lock();
+		if ( swapped && vfxPtr )
+		{
+			vfxPtr->OnPipelinesReloaded( lifeMin, lifeMax, renderPrimitive );
+			Log( "Reloading %s done.", vfxPtr->GetPath().c_str() );
+		}
+	};
+
+	if ( !render::g_pipelineManager.ReloadAsync( descs.size(), descs.data(), onDone ) )
+	{
+		Error( "Error during reload, the VFX keeps its previous shaders." );
+		return false;
+	}
+
+	return true;
+}
+
+bool VFXController::BuffersChanged( const render::VFX &vfx ) const
+{
+	if ( m_capacity != vfx.GetCapacity() || int( m_attributeBufferViews.size() ) != vfx.m_userAttributesCount )
+	{
+		return true;
+	}
+
+	for ( size_t i = 0; i < m_attributeBufferViews.size(); ++i )
+	{
+		const render::VFX::VFXBuffer_t &vfxBuffer = vfx.m_attributesBuffers[ i ];
+
+		const vfxBufferView_t &bufferView = m_attributeBufferViews[ i ];
+
+		vfxBufferData_t dataType = VFX_BD_FLOAT;
+		int8_t			arity	 = -1;
+		BufferViewInfoToInternalBufferInfo( bufferView, dataType, arity );
+
+		if ( dataType != vfxBuffer.dataType || arity != vfxBuffer.arity ||
+			 std::strncmp( bufferView.name.c_str(), vfxBuffer.name, render::VFX_MAX_BUFFER_NAME_LENGTH ) != 0 )
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
 bool VFXController::Save()
 {
 	auto vfxPtr = m_vfx.lock();
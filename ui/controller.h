@@ -19,6 +19,7 @@ namespace render
 {
 class VFX;
 struct pipelineProg_t;
+struct pipelineReloadDesc_t;
 
 } // namespace render
 
@@ -59,6 +60,10 @@ class PipelineController
 	bool IsValid() { return m_isValid; }
 
 	NO_DISCARD bool Reload();
+	// Shaders of the views, to reload the pipeline in the background. False when there is none.
+	NO_DISCARD bool GetReloadDesc( render::pipelineReloadDesc_t &desc ) const;
+	// Follows the pipeline once a background reload swapped it
+	void Update();
 
 	void SetPipeline( std::weak_ptr< render::pipelineProg_t > pipeline, uint32_t stageBits );
 
@@ -76,7 +81,8 @@ class PipelineController
 	std::vector< gpuVarView_t >						   m_gpuVarViews {};
 	std::unique_ptr< std::vector< SerializableData > > m_userValues {};
 
-	bool m_isValid = false;
+	uint32_t m_generation = 0; // Of the pipeline the views point to
+	bool	 m_isValid	  = false;
 };
 
 class VFXController
@@ -124,8 +130,10 @@ class VFXController
    public:
 	VFXController( std::weak_ptr< render::VFX > vfx );
 
+	// Reloads the shaders in the background while the VFX keeps rendering, unless its buffers change
 	bool Reload();
 	bool Save();
+	void Update();
 	bool SaveAs( const char *path );
 
 	void						 SetVFX( std::weak_ptr< render::VFX > vfx );
@@ -146,6 +154,9 @@ class VFXController
 	vfxRenderPrimitive_t &			GetRenderPrimitiveRef() { return m_renderPrimitive; }
 
    private:
+	bool ReloadAsync( render::VFX &vfx );
+	bool BuffersChanged( const render::VFX &vfx ) const;
+
 	static void BufferViewInfoToInternalBufferInfo( const vfxBufferView_t &bufferView,
 													vfxBufferData_t &	   bufferType,
 													int8_t &			   arity );
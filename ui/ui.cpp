@@ -3,7 +3,7 @@
 #include "Ui.h"
 
 #include "external/imgui/imgui.h"
-#include "renderer/uiBackend.h"
+#include "renderer/UiBackend.h"
 #include "ui/Vfxui.h"
 
 namespace vkRuna
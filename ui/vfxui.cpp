@@ -5,6 +5,7 @@
 #include "external/imgui/ImGuiFileDialog/ImGuiFileDialog.h"
 #include "external/imgui/imgui.h"
 #include "platform/Sys.h"
+#include "renderer/GPUProfiler.h"
 #include "renderer/VFX.h"
 
 #include <iostream>
@@ -141,6 +142,7 @@ void VFXUI::Draw()
 	for ( size_t i = 0; i < m_vfxControllers.size(); ++i )
 	{
 		VFXController &vfxCtrl = m_vfxControllers[ i ];
+		vfxCtrl.Update();
 
 		std::string imguiChildName = vfxCtrl.GetName();
 		imguiChildName += "##" + std::to_string( i );
@@ -242,6 +244,38 @@ void VFXUI::Draw()
 									   ImGuiSliderFlags_AlwaysClamp );
 				}
 
+				if ( render::g_gpuProfiler.HasPipelineStats() )
+				{
+					const render::gpuPipelineStats_t stats =
+						render::g_gpuProfiler.GetPipelineStats( vfxCtrl.GetName() );
+
+					ImGui::TableNextRow();
+
+					ImGui::TableNextColumn();
+					ImGui::TextUnformatted( "Shader Invocations" );
+
+					ImGui::TableNextColumn();
+					ImGui::Text( "%llu compute, %llu vertex, %llu fragment",
+								 static_cast< unsigned long long >( stats.computeInvocations ),
+								 static_cast< unsigned long long >( stats.vertexInvocations ),
+								 static_cast< unsigned long long >( stats.fragmentInvocations ) );
+
+					if ( capacityPtr && *capacityPtr > 0 )
+					{
+						const double capacity = double( *capacityPtr );
+
+						ImGui::TableNextRow();
+
+						ImGui::TableNextColumn();
+						ImGui::TextUnformatted( "Per Particle" );
+
+						ImGui::TableNextColumn();
+						ImGui::Text( "%.1f vertex, %.1f fragment",
+									 double( stats.vertexInvocations ) / capacity,
+									 double( stats.fragmentInvocations ) / capacity );
+					}
+				}
+
 				float *lifeMin = vfxCtrl.GetLifeMinPtr();
 				if ( lifeMin )
 				{
@@ -303,6 +337,18 @@ void VFXUI::Draw()
 					ImGui::Checkbox( "##Infinite Spawn Rate", infiniteSpawnRate );
 				}
 
+				{
+					const render::gpuTimings_t timings = render::g_gpuProfiler.GetTimings( vfxCtrl.GetName() );
+
+					ImGui::TableNextRow();
+
+					ImGui::TableNextColumn();
+					ImGui::TextUnformatted( "GPU Time" );
+
+					ImGui::TableNextColumn();
+					ImGui::Text( "%.3f ms compute, %.3f ms render", timings.computeMs, timings.renderMs );
+				}
+
 				ImGui::EndTable();
 			}
 		}